@@ -32,10 +32,12 @@ extern "C" {
 #include <zend_types.h>
 #include <zend_language_parser.h>
 #include "WordPress_instrumentation.h"
+#include "AST_instrumentation_rules.h"
 #include "util.h"
 #include "util_for_PHP.h"
 #include "AST_util.h"
 #include "elastic_apm_alloc.h"
+#include <chrono>
 
 #define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_AUTO_INSTRUMENT
 
@@ -44,6 +46,9 @@ static zend_ast_process_t g_originalZendAstProcess = NULL;
 
 static bool g_isLoadingAgentPhpCode = false;
 
+static bool g_astProcessCollectStats = false;
+static AstProcessStats g_astProcessStats = { 0 };
+
 void elasticApmBeforeLoadingAgentPhpCode()
 {
     g_isLoadingAgentPhpCode = true;
@@ -456,7 +461,14 @@ zend_ast* createAstListWithThreeChildren( zend_ast_kind kind, zend_ast* child0,
     return result;
 }
 
-ResultCode createCapturedArgsAstArray( zend_ast_decl* astDecl, ArgCaptureSpecArrayView argCaptureSpecs, uint32_t lineNumber, /* out */ zend_ast** pResult )
+zend_ast* createAstZValLong( zend_long value, uint32_t lineNumber )
+{
+    zval longAsZVal;
+    ZVAL_LONG( &longAsZVal, value );
+    return createAstZValWithAttribute( &longAsZVal, /* attr */ 0, lineNumber );
+}
+
+ResultCode createCapturedArgsAstArray( zend_ast_decl* astDecl, ArgCaptureSpecArrayView argCaptureSpecs, bool keyByParameterIndex, uint32_t lineNumber, /* out */ zend_ast** pResult )
 {
     // AST for PHP code:
     //
@@ -472,6 +484,9 @@ ResultCode createCapturedArgsAstArray( zend_ast_decl* astDecl, ArgCaptureSpecArr
     //            ZEND_AST_VAR (256) (line: 121, attr: 0)
     //                ZEND_AST_ZVAL (64) (line: 121, attr: 0) [type: string, value: callback]
     //            NULL
+    //
+    // When keyByParameterIndex is true each element's key is the index of the captured parameter
+    // (i.e., [0 => $hook_name, 1 => &$callback]) so the receiving side can tell which parameters were captured
 
     ELASTIC_APM_ASSERT_VALID_OUT_PTR_TO_PTR( pResult );
 
@@ -495,7 +510,8 @@ ResultCode createCapturedArgsAstArray( zend_ast_decl* astDecl, ArgCaptureSpecArr
         }
         zend_ast* varAst = createAstVar( parameterName, lineNumber );
         // Array element value is the first child (i.e., index 0) and array element key is the second child (i.e., index 1)
-        zend_ast* arrayElement = createAstWithAttributeAndTwoChildren( ZEND_AST_ARRAY_ELEM, arrayElemAttr, /* array element value */ varAst, /* array element key */ NULL );
+        zend_ast* arrayElemKeyAst = keyByParameterIndex ? createAstZValLong( (zend_long)i, lineNumber ) : NULL;
+        zend_ast* arrayElement = createAstWithAttributeAndTwoChildren( ZEND_AST_ARRAY_ELEM, arrayElemAttr, /* array element value */ varAst, /* array element key */ arrayElemKeyAst );
         addChildToAstList( arrayElement, /* in,out */ &result );
     }
 
@@ -533,7 +549,7 @@ zend_ast* createAstStandaloneNotFqFunctionCall( StringView funcName, zend_ast* a
     return createAstStandaloneFunctionCall( funcName, /* isFullyQualified */ false, astArgList );
 }
 
-ResultCode createPreHookAstArgListByCaptureSpec( zend_ast_decl* astDecl, ArgCaptureSpecArrayView argCaptureSpecs, /* out */ zend_ast** pResult )
+ResultCode createPreHookAstArgListByCaptureSpec( zend_ast_decl* astDecl, ArgCaptureSpecArrayView argCaptureSpecs, bool keyByParameterIndex, /* out */ zend_ast** pResult )
 {
     // AST for PHP code:
     //
@@ -552,7 +568,7 @@ ResultCode createPreHookAstArgListByCaptureSpec( zend_ast_decl* astDecl, ArgCapt
     uint32_t lineNumber = astDecl->start_lineno;
     zend_ast* capturedArgsAstArray = NULL;
 
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( createCapturedArgsAstArray( astDecl, argCaptureSpecs, lineNumber, /* out */ &capturedArgsAstArray ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( createCapturedArgsAstArray( astDecl, argCaptureSpecs, keyByParameterIndex, lineNumber, /* out */ &capturedArgsAstArray ) );
 
     *pResult = createAstListWithThreeChildren(
             ZEND_AST_ARG_LIST
@@ -649,7 +665,7 @@ ResultCode insertAstForFunctionPreHook( zend_ast_decl* funcAstDecl, ArgCaptureSp
         ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
     }
 
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( createPreHookAstArgListByCaptureSpec( funcAstDecl, argCaptureSpecs, /* out */ &preHookCallAstArgList ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( createPreHookAstArgListByCaptureSpec( funcAstDecl, argCaptureSpecs, /* keyByParameterIndex */ false, /* out */ &preHookCallAstArgList ) );
 
     funcAstDecl->child[ g_funcDeclBodyChildIndex ] = createAstListWithTwoChildren(
             ZEND_AST_STMT_LIST
@@ -1036,7 +1052,7 @@ void createWrapperFunctionBodyPrologAst( /* in,out */ zend_ast** appendToAstStmt
     addChildToAstList( createAstAssign( g_postHookVarName, preHookAstCall ), /* in,out */ appendToAstStmtList );
 }
 
-zend_ast* createCallPostHookIfNotNullAst( zend_ast* thrownAst, zend_ast* retValAst )
+zend_ast* createCallPostHookIfNotNullAstEx( StringView postHookVarName, zend_ast* thrownAst, zend_ast* retValAst )
 {
     // PHP code:
     //
@@ -1083,18 +1099,23 @@ zend_ast* createCallPostHookIfNotNullAst( zend_ast* thrownAst, zend_ast* retValA
             ZEND_AST_IF_ELEM
             , zend_ast_create_binary_op(
                 ZEND_IS_NOT_IDENTICAL
-                , createAstVar( g_postHookVarName, lineNumber )
+                , createAstVar( postHookVarName, lineNumber )
                 , createAstConstNull( lineNumber )
             )
             , createAstWithTwoChildren(
                 ZEND_AST_CALL
-                , createAstVar( g_postHookVarName, lineNumber )
+                , createAstVar( postHookVarName, lineNumber )
                 , createAstListWithTwoChildren( ZEND_AST_ARG_LIST, thrownAst, retValAst )
             )
         )
     );
 }
 
+zend_ast* createCallPostHookIfNotNullAst( zend_ast* thrownAst, zend_ast* retValAst )
+{
+    return createCallPostHookIfNotNullAstEx( g_postHookVarName, thrownAst, retValAst );
+}
+
 zend_ast* createWrappedFunctionCallAstArgList( uint32_t lineNumber )
 {
     // PHP code:
@@ -1371,6 +1392,193 @@ ResultCode wrapStandaloneFunctionAstWithPrePostHooks( /* in,out */ zend_ast_decl
     goto finally;
 }
 
+// Variables are added to the wrapped function's local scope - their names are not valid PHP identifiers
+// so they cannot collide with the function's own variables (or be referred to by $name in its code)
+// and they are unset in finally block
+static StringView g_bodyWrapPostHookVarName = ELASTIC_APM_STRING_LITERAL_TO_VIEW( "ElasticApm\\postHook" );
+static StringView g_bodyWrapThrownVarName = ELASTIC_APM_STRING_LITERAL_TO_VIEW( "ElasticApm\\thrown" );
+
+zend_ast* createBodyWrapCatchPartAst( uint32_t lineNumber )
+{
+    // PHP code:
+    //
+    //    } catch (\Throwable ${'ElasticApm\thrown'}) {
+    //        if (${'ElasticApm\postHook'} !== null) ${'ElasticApm\postHook'}(${'ElasticApm\thrown'}, /* retVal */ null);
+    //        ${'ElasticApm\postHook'} = null;
+    //        throw ${'ElasticApm\thrown'};
+    //    }
+    //
+    // Post-hook is reset so that finally block does not call it the second time.
+    // Throwable is fully qualified because the wrapped function might be declared in a namespace.
+
+    return createAstListWithOneChild(
+        ZEND_AST_CATCH_LIST
+        , createAstWithThreeChildren(
+            ZEND_AST_CATCH
+            , createAstListWithOneChild( ZEND_AST_NAME_LIST, createAstZValStringWithAttribute( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "Throwable" ), ZEND_NAME_FQ, lineNumber ) )
+            , createAstZValString( g_bodyWrapThrownVarName, lineNumber )
+            , createAstListWithThreeChildren(
+                ZEND_AST_STMT_LIST
+                , createCallPostHookIfNotNullAstEx( g_bodyWrapPostHookVarName, createAstVar( g_bodyWrapThrownVarName, lineNumber ), /* retValAst */ createAstConstNull( lineNumber ) )
+                , createAstAssign( g_bodyWrapPostHookVarName, createAstConstNull( lineNumber ) )
+                , createAstWithOneChild( ZEND_AST_THROW, createAstVar( g_bodyWrapThrownVarName, lineNumber ) )
+            )
+        )
+    );
+}
+
+/**
+ * yield (or yield from) makes the function a generator - its body (including the pre-hook) runs only when the generator is resumed.
+ * yield in a nested closure, arrow function or class declaration makes only that nested function a generator.
+ */
+static
+bool doesAstContainYield( zend_ast* ast )
+{
+    if ( ast == NULL )
+    {
+        return false;
+    }
+
+    if ( ast->kind == ZEND_AST_YIELD || ast->kind == ZEND_AST_YIELD_FROM )
+    {
+        return true;
+    }
+
+    if ( isAstDecl( ast->kind ) )
+    {
+        return false;
+    }
+
+    ZendAstPtrArrayView children = getAstChildren( ast );
+    ELASTIC_APM_FOR_EACH_INDEX( i, children.count )
+    {
+        if ( doesAstContainYield( children.values[ i ] ) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+ResultCode wrapFunctionBodyWithPrePostHooks( zend_ast_decl* funcAstDecl, ArgCaptureSpecArrayView argCaptureSpecs, StringView spanType )
+{
+    // Unlike wrapStandaloneFunctionAstWithPrePostHooks this transformation works for methods as well
+    // because it does not need to declare an additional function - the original body is wrapped in place.
+    // The price is that the post-hook does not have access to the return value.
+    //
+    // Before:
+    //
+    //    public function handle( $request, $type = 1 ) {
+    //        // original function body
+    //    }
+    //
+    // After:
+    //
+    //    public function handle( $request, $type = 1 ) { /* fold-into-one-line-begin */
+    //        ${'ElasticApm\postHook'} = \elastic_apm_ast_instrumentation_pre_hook( __CLASS__, __FUNCTION__, [ 0 => $request ], 'app' );
+    //        try { /* fold-into-one-line-end */
+    //            // original function body
+    //        } catch (\Throwable ${'ElasticApm\thrown'}) {
+    //            // ...
+    //        } finally {
+    //            if (${'ElasticApm\postHook'} !== null) ${'ElasticApm\postHook'}(/* thrown */ null, /* retVal */ null);
+    //            unset(${'ElasticApm\postHook'});
+    //            unset(${'ElasticApm\thrown'});
+    //        }
+    //    }
+    //
+    // Generator functions are not wrapped: the pre-hook would run on the first resume instead of the call
+    // and the span it begins would stay the current one across all the yields.
+    //
+    //    ZEND_AST_METHOD (name: handle, line: 7, flags: 1, attr: 0, childCount: 4)
+    //        ZEND_AST_PARAM_LIST (line: 7, attr: 0, childCount: 2)
+    //        NULL
+    //        ZEND_AST_STMT_LIST (line: 7, attr: 0, childCount: 2)                                  <- new function body
+    //            ZEND_AST_ASSIGN (line: 7, attr: 0, childCount: 2)                                 <- pre-hook call
+    //            ZEND_AST_TRY (line: 7, attr: 0, childCount: 3)
+    //                ZEND_AST_STMT_LIST (line: 7, attr: 0, childCount: 4)                          <- original function body
+    //                ZEND_AST_CATCH_LIST (line: 7, attr: 0, childCount: 1)
+    //                ZEND_AST_STMT_LIST (line: 7, attr: 0, childCount: 3)                          <- finally block
+    //        NULL
+
+    ELASTIC_APM_ASSERT_VALID_PTR( funcAstDecl );
+
+    ResultCode resultCode;
+    char txtOutStreamBuf[ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE];
+    TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
+    String dbgCompiledFileName = stringIfNotNullElse( nullableZStringToStringView( CG(compiled_filename) ).begin, "<N/A>" );
+    uint32_t lineNumber = funcAstDecl->start_lineno;
+    zend_ast* originalFuncBodyAst = nullptr;
+    zend_ast* preHookCallAstArgList = nullptr;
+    zend_ast* preHookAstCall = nullptr;
+    zend_ast* astTryCatchFinally = nullptr;
+
+    ELASTIC_APM_ASSERT( funcAstDecl->kind == ZEND_AST_FUNC_DECL || funcAstDecl->kind == ZEND_AST_METHOD, "funcAstDecl->kind: %s", streamZendAstKind( funcAstDecl->kind, &txtOutStream ) );
+    textOutputStreamRewind( &txtOutStream );
+
+    StringView dbgFuncName;
+    if ( ! getAstDeclName( funcAstDecl, /* out */ &dbgFuncName ) )
+    {
+        ELASTIC_APM_LOG_ERROR( "Failed to get function name - returning failure" );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "dbgFuncName: %s, spanType: %.*s, compiled_filename: %s", dbgFuncName.begin, (int)spanType.length, spanType.begin, dbgCompiledFileName );
+    debugDumpAstTreeToLog( (zend_ast*) funcAstDecl, logLevel_debug );
+
+    originalFuncBodyAst = funcAstDecl->child[ g_funcDeclBodyChildIndex ];
+    if ( originalFuncBodyAst == NULL )
+    {
+        // abstract method or method declared by interface
+        ELASTIC_APM_LOG_DEBUG( "originalFuncBodyAst == NULL - there is no body to wrap" );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+    if ( originalFuncBodyAst->kind != ZEND_AST_STMT_LIST )
+    {
+        ELASTIC_APM_LOG_TRACE( "Expected originalFuncBodyAst->kind to be ZEND_AST_STMT_LIST but it is %s", streamZendAstKind( originalFuncBodyAst->kind, &txtOutStream ) );
+        textOutputStreamRewind( &txtOutStream );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+    if ( doesAstContainYield( originalFuncBodyAst ) )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Function is a generator (its body contains yield) - it is not wrapped" );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( createPreHookAstArgListByCaptureSpec( funcAstDecl, argCaptureSpecs, /* keyByParameterIndex */ true, /* out */ &preHookCallAstArgList ) );
+    addChildToAstList( createAstZValString( spanType, lineNumber ), /* in,out */ &preHookCallAstArgList );
+    preHookAstCall = createAstStandaloneFqFunctionCall( g_elastic_apm_ast_instrumentation_pre_hook_funcName, preHookCallAstArgList );
+
+    /**
+     * @see zend_compile_try
+     */
+    astTryCatchFinally = createAstWithThreeChildren(
+        ZEND_AST_TRY
+        , originalFuncBodyAst
+        , createBodyWrapCatchPartAst( lineNumber )
+        , createAstListWithThreeChildren(
+            ZEND_AST_STMT_LIST
+            , createCallPostHookIfNotNullAstEx( g_bodyWrapPostHookVarName, /* thrownAst */ createAstConstNull( lineNumber ), /* retValAst */ createAstConstNull( lineNumber ) )
+            , createAstWithOneChild( ZEND_AST_UNSET, createAstVar( g_bodyWrapPostHookVarName, lineNumber ) )
+            , createAstWithOneChild( ZEND_AST_UNSET, createAstVar( g_bodyWrapThrownVarName, lineNumber ) )
+        )
+    );
+
+    funcAstDecl->child[ g_funcDeclBodyChildIndex ] = createAstListWithTwoChildren(
+            ZEND_AST_STMT_LIST
+            , createAstAssign( g_bodyWrapPostHookVarName, preHookAstCall )
+            , astTryCatchFinally
+    );
+
+    resultCode = resultSuccess;
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT_MSG();
+    debugDumpAstTreeToLog( (zend_ast*) funcAstDecl, logLevel_debug );
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
 bool getAstName( zend_ast* ast, /* out */ StringView* name )
 {
     char txtOutStreamBuf[ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE];
@@ -1573,7 +1781,7 @@ zend_ast_decl** findChildSlotForStandaloneFunctionAst( zend_ast* rootAst, String
 zend_ast_decl* findClassAst( zend_ast* rootAst, StringView nameSpace, StringView className )
 {
     zend_ast** result = findChildSlotAstByKind( rootAst, ZEND_AST_CLASS, nameSpace, className, /* checkFuncDeclReqs */ NULL, /* checkFindAstReqsCtx */ NULL );
-    return (zend_ast_decl*)(*result);
+    return result == NULL ? NULL : (zend_ast_decl*)(*result);
 }
 
 zend_ast_decl** findChildSlotForMethodAst( zend_ast_decl* astClass, StringView methodName, size_t minParamsCount )
@@ -1598,27 +1806,82 @@ zend_ast_decl** findChildSlotForMethodAst( zend_ast_decl* astClass, StringView m
     return (zend_ast_decl**) findChildSlotAstByKind( astAsDecl->child[ 2 ], ZEND_AST_METHOD, /* namespace */ ELASTIC_APM_EMPTY_STRING_VIEW, methodName, checkFunctionReqs, &minParamsCount );
 }
 
-void elasticApmTransformAstImpl( zend_ast* ast )
+bool elasticApmTransformAstImpl( zend_ast* ast )
 {
     StringView compiledFileFullPath = nullableZStringToStringView( CG( compiled_filename) );
     if ( compiledFileFullPath.begin == NULL )
     {
-        return;
+        return false;
     }
 
-    size_t fileIndex;
-    if ( ! wordPressInstrumentationShouldTransformAstInFile( compiledFileFullPath, /* out */ &fileIndex ) )
+    size_t wordPressFileIndex;
+    bool shouldTransformForWordPress = wordPressInstrumentationShouldTransformAstInFile( compiledFileFullPath, /* out */ &wordPressFileIndex );
+    size_t rulesFileIndex;
+    bool shouldTransformForRules = astInstrumentationRulesShouldTransformAstInFile( compiledFileFullPath, /* out */ &rulesFileIndex );
+    if ( ! ( shouldTransformForWordPress || shouldTransformForRules ) )
     {
-        return;
+        return false;
     }
 
     ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "compiledFileFullPath: %s", compiledFileFullPath.begin );
     debugDumpAstTree( compiledFileFullPath, ast, /* isBeforeProcess */ true );
 
-    wordPressInstrumentationTransformAst( fileIndex, compiledFileFullPath, ast );
+    if ( shouldTransformForWordPress )
+    {
+        wordPressInstrumentationTransformAst( wordPressFileIndex, compiledFileFullPath, ast );
+    }
+    if ( shouldTransformForRules )
+    {
+        astInstrumentationRulesTransformAst( rulesFileIndex, compiledFileFullPath, ast );
+    }
 
     ELASTIC_APM_LOG_DEBUG_FUNCTION_EXIT_MSG( "compiledFileFullPath: %s", compiledFileFullPath.begin );
     debugDumpAstTree( compiledFileFullPath, ast, /* isBeforeProcess */ false );
+    return true;
+}
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "misc-no-recursion"
+UInt64 countAstNodes( zend_ast* ast )
+{
+    if ( ast == NULL )
+    {
+        return 0;
+    }
+
+    UInt64 result = 1;
+    ZendAstPtrArrayView children = getAstChildren( ast );
+    ELASTIC_APM_FOR_EACH_INDEX( i, children.count )
+    {
+        result += countAstNodes( children.values[ i ] );
+    }
+    return result;
+}
+#pragma clang diagnostic pop
+
+void elasticApmTransformAstCollectingStats( zend_ast* ast )
+{
+    UInt64 astNodesCountBeforeProcess = countAstNodes( ast );
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool isTransformed = elasticApmTransformAstImpl( ast );
+
+    auto duration = std::chrono::steady_clock::now() - startTime;
+    ++g_astProcessStats.compiledFilesCount;
+    if ( isTransformed )
+    {
+        ++g_astProcessStats.transformedFilesCount;
+    }
+    g_astProcessStats.astNodesCountBeforeProcess += astNodesCountBeforeProcess;
+    g_astProcessStats.astNodesCountAfterProcess += countAstNodes( ast );
+    g_astProcessStats.processDurationNanoseconds += (UInt64)std::chrono::duration_cast<std::chrono::nanoseconds>( duration ).count();
+}
+
+void getAstProcessStats( /* out */ AstProcessStats* stats )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( stats );
+
+    *stats = g_astProcessStats;
 }
 
 void elasticApmTransformAst( zend_ast* ast )
@@ -1627,7 +1890,14 @@ void elasticApmTransformAst( zend_ast* ast )
 
     if ( ( ! g_isLoadingAgentPhpCode ) && ast != NULL )
     {
-        elasticApmTransformAstImpl( ast );
+        if ( g_astProcessCollectStats )
+        {
+            elasticApmTransformAstCollectingStats( ast );
+        }
+        else
+        {
+            elasticApmTransformAstImpl( ast );
+        }
     }
 
     if ( g_originalZendAstProcess != NULL )
@@ -1644,6 +1914,9 @@ void astInstrumentationOnModuleInit( const ConfigSnapshot* config )
         g_isOriginalZendAstProcessSet = true;
         zend_ast_process = elasticApmTransformAst;
         ELASTIC_APM_LOG_DEBUG( "Changed zend_ast_process: from %p to elasticApmTransformAst (%p)", g_originalZendAstProcess, elasticApmTransformAst );
+        g_astProcessCollectStats = config->astProcessCollectStats;
+        wordPressInstrumentationOnModuleInit();
+        astInstrumentationRulesOnModuleInit( config->astInstrumentationRules );
     } else {
         ELASTIC_APM_LOG_DEBUG( "AST processing will be DISABLED because configuration option %s (astProcessEnabled) is set to false", ELASTIC_APM_CFG_OPT_NAME_AST_PROCESS_ENABLED );
     }
@@ -1651,6 +1924,9 @@ void astInstrumentationOnModuleInit( const ConfigSnapshot* config )
 
 void astInstrumentationOnModuleShutdown()
 {
+    astInstrumentationRulesOnModuleShutdown();
+    wordPressInstrumentationOnModuleShutdown();
+
     if ( g_isOriginalZendAstProcessSet )
     {
         zend_ast_process_t zendAstProcessBeforeRestore = zend_ast_process;
@@ -25,6 +25,7 @@
 #include "TextOutputStream.h"
 #include "ResultCode.h"
 #include "ArrayView.h"
+#include "basic_types.h"
 
 enum ArgCaptureSpec
 {
@@ -35,6 +36,22 @@ enum ArgCaptureSpec
 typedef enum ArgCaptureSpec ArgCaptureSpec;
 ELASTIC_APM_DECLARE_ARRAY_VIEW( ArgCaptureSpec, ArgCaptureSpecArrayView );
 
+struct AstProcessStats
+{
+    UInt64 compiledFilesCount;
+    UInt64 transformedFilesCount;
+    UInt64 astNodesCountBeforeProcess;
+    UInt64 astNodesCountAfterProcess;
+    UInt64 processDurationNanoseconds;
+};
+typedef struct AstProcessStats AstProcessStats;
+
+/**
+ * Stats are accumulated since module init and only when ast_process_collect_stats configuration option is set
+ * because counting AST nodes requires walking the whole tree of each compiled file
+ */
+void getAstProcessStats( /* out */ AstProcessStats* stats );
+
 void astInstrumentationOnModuleInit( const ConfigSnapshot* config );
 void astInstrumentationOnModuleShutdown();
 
@@ -48,5 +65,6 @@ zend_ast_decl** findChildSlotForMethodAst( zend_ast_decl* astClass, StringView m
 ResultCode insertAstForFunctionPreHook( zend_ast_decl* funcAstDecl, ArgCaptureSpecArrayView argCaptureSpecs );
 ResultCode appendDirectCallToInstrumentation( zend_ast_decl** pAstChildSlot, StringView constNameForMethodName );
 ResultCode wrapStandaloneFunctionAstWithPrePostHooks( zend_ast_decl** pAstChildSlot );
+ResultCode wrapFunctionBodyWithPrePostHooks( zend_ast_decl* funcAstDecl, ArgCaptureSpecArrayView argCaptureSpecs, StringView spanType );
 
 String streamZendAstKind( zend_ast_kind kind, TextOutputStream* txtOutStream );
@@ -0,0 +1,208 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "AST_instrumentation_rules.h"
+#include "AST_instrumentation.h"
+#include "log.h"
+#include "util.h"
+#include "PathSuffixIndex.h"
+#include "AstInstrumentationRule.h"
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_AUTO_INSTRUMENT
+
+namespace {
+
+struct AstInstrumentationRuleToApply
+{
+    elasticapm::php::AstInstrumentationRule rule;
+    std::vector<ArgCaptureSpec> argCaptureSpecs;
+};
+
+struct AstInstrumentationRulesForFile
+{
+    std::string pathSuffix;
+    std::vector<size_t> ruleIndexes;
+};
+
+std::vector<AstInstrumentationRuleToApply> g_astInstrumentationRules;
+std::vector<AstInstrumentationRulesForFile> g_astInstrumentationRulesByFile;
+// Maps path suffix to index in g_astInstrumentationRulesByFile
+elasticapm::php::PathSuffixIndex g_astInstrumentationRulesFilesIndex;
+
+void addRuleToRulesForFile( size_t ruleIndex )
+{
+    const std::string& fileSuffix = g_astInstrumentationRules[ ruleIndex ].rule.fileSuffix;
+    for ( AstInstrumentationRulesForFile& rulesForFile : g_astInstrumentationRulesByFile )
+    {
+        if ( rulesForFile.pathSuffix == fileSuffix )
+        {
+            rulesForFile.ruleIndexes.push_back( ruleIndex );
+            return;
+        }
+    }
+    g_astInstrumentationRulesByFile.push_back( { fileSuffix, { ruleIndex } } );
+}
+
+/**
+ * Path that ends with a suffix also ends with all the shorter suffixes that the suffix ends with
+ * so rules for those shorter suffixes are added to the longer suffix's rules.
+ * Then looking up only the longest matching suffix finds all the rules for the compiled file.
+ */
+void buildFilesIndex()
+{
+    std::vector<AstInstrumentationRulesForFile> rulesByFile = g_astInstrumentationRulesByFile;
+    ELASTIC_APM_FOR_EACH_INDEX( i, rulesByFile.size() )
+    {
+        for ( const AstInstrumentationRulesForFile& other : g_astInstrumentationRulesByFile )
+        {
+            if ( other.pathSuffix.size() < rulesByFile[ i ].pathSuffix.size() && rulesByFile[ i ].pathSuffix.ends_with( other.pathSuffix ) )
+            {
+                rulesByFile[ i ].ruleIndexes.insert( rulesByFile[ i ].ruleIndexes.end(), other.ruleIndexes.begin(), other.ruleIndexes.end() );
+            }
+        }
+        // rules are applied in the order they are configured
+        std::sort( rulesByFile[ i ].ruleIndexes.begin(), rulesByFile[ i ].ruleIndexes.end() );
+        g_astInstrumentationRulesFilesIndex.add( rulesByFile[ i ].pathSuffix, i );
+    }
+    g_astInstrumentationRulesByFile = std::move( rulesByFile );
+}
+
+StringView toStringView( const std::string& str )
+{
+    return makeStringView( str.data(), str.size() );
+}
+
+zend_ast_decl** findChildSlotForRule( zend_ast* ast, const elasticapm::php::AstInstrumentationRule& rule )
+{
+    size_t minParamsCount = rule.capturedArgs.size();
+
+    if ( rule.className.empty() )
+    {
+        return findChildSlotForStandaloneFunctionAst( ast, toStringView( rule.nameSpace ), toStringView( rule.functionName ), minParamsCount );
+    }
+
+    zend_ast_decl* astClass = findClassAst( ast, toStringView( rule.nameSpace ), toStringView( rule.className ) );
+    if ( astClass == NULL )
+    {
+        return NULL;
+    }
+    return findChildSlotForMethodAst( astClass, toStringView( rule.functionName ), minParamsCount );
+}
+
+ResultCode applyRule( zend_ast* ast, const AstInstrumentationRuleToApply& ruleToApply )
+{
+    const elasticapm::php::AstInstrumentationRule& rule = ruleToApply.rule;
+    zend_ast_decl** pAstFuncDeclSlot = findChildSlotForRule( ast, rule );
+    if ( pAstFuncDeclSlot == NULL )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Function declaration not found (or it has less than %d parameters); rule: %s|%s|%s"
+                               , (int)rule.capturedArgs.size(), rule.nameSpace.c_str(), rule.className.c_str(), rule.functionName.c_str() );
+        return resultFailure;
+    }
+
+    return wrapFunctionBodyWithPrePostHooks(
+            *pAstFuncDeclSlot
+            , ELASTIC_APM_MAKE_ARRAY_VIEW( ArgCaptureSpecArrayView, ruleToApply.argCaptureSpecs.size(), ruleToApply.argCaptureSpecs.data() )
+            , toStringView( rule.spanType ) );
+}
+
+}
+
+void astInstrumentationRulesOnModuleInit( String rulesConfig )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "rulesConfig: %s", rulesConfig == NULL ? "NULL" : rulesConfig );
+
+    astInstrumentationRulesOnModuleShutdown();
+
+    if ( rulesConfig == NULL )
+    {
+        return;
+    }
+
+    elasticapm::php::forEachAstInstrumentationRule( rulesConfig, []( std::string_view ruleAsString )
+    {
+        std::string error;
+        std::optional<elasticapm::php::AstInstrumentationRule> rule = elasticapm::php::parseAstInstrumentationRule( ruleAsString, &error );
+        if ( ! rule )
+        {
+            ELASTIC_APM_LOG_ERROR( "Ignoring invalid AST instrumentation rule: %.*s; reason: %s", (int)ruleAsString.length(), ruleAsString.data(), error.c_str() );
+            return;
+        }
+
+        AstInstrumentationRuleToApply ruleToApply;
+        for ( bool isCaptured : rule->capturedArgs )
+        {
+            ruleToApply.argCaptureSpecs.push_back( isCaptured ? captureArgByValue : dontCaptureArg );
+        }
+        ruleToApply.rule = std::move( *rule );
+        g_astInstrumentationRules.push_back( std::move( ruleToApply ) );
+        addRuleToRulesForFile( g_astInstrumentationRules.size() - 1 );
+    } );
+    buildFilesIndex();
+
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_EXIT_MSG( "rules: %d, files: %d", (int)g_astInstrumentationRules.size(), (int)g_astInstrumentationRulesByFile.size() );
+}
+
+void astInstrumentationRulesOnModuleShutdown()
+{
+    g_astInstrumentationRules.clear();
+    g_astInstrumentationRulesByFile.clear();
+    g_astInstrumentationRulesFilesIndex.clear();
+}
+
+bool astInstrumentationRulesShouldTransformAstInFile( StringView compiledFileFullPath, size_t* pFileIndex )
+{
+    if ( g_astInstrumentationRulesFilesIndex.empty() )
+    {
+        return false;
+    }
+
+    std::optional<size_t> fileIndex = g_astInstrumentationRulesFilesIndex.findLongestSuffix( std::string_view( compiledFileFullPath.begin, compiledFileFullPath.length ) );
+    if ( ! fileIndex )
+    {
+        return false;
+    }
+
+    *pFileIndex = *fileIndex;
+    return true;
+}
+
+void astInstrumentationRulesTransformAst( size_t fileIndex, StringView compiledFileFullPath, zend_ast* ast )
+{
+    ELASTIC_APM_ASSERT_LT_UINT64( fileIndex, g_astInstrumentationRulesByFile.size() );
+
+    ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY_MSG( "compiledFileFullPath: %s", compiledFileFullPath.begin );
+
+    // A rule that fails does not affect the other rules for the same file -
+    // the function it targets is just left as it is
+    for ( size_t ruleIndex : g_astInstrumentationRulesByFile[ fileIndex ].ruleIndexes )
+    {
+        if ( applyRule( ast, g_astInstrumentationRules[ ruleIndex ] ) != resultSuccess )
+        {
+            ELASTIC_APM_LOG_DEBUG( "Failed to apply AST instrumentation rule #%d to %s", (int)ruleIndex, compiledFileFullPath.begin );
+        }
+    }
+
+    ELASTIC_APM_LOG_TRACE_FUNCTION_EXIT();
+}
@@ -0,0 +1,53 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+extern "C" {
+#include <Zend/zend_ast.h>
+}
+#include "StringView.h"
+#include "basic_types.h"
+
+/**
+ * Declarative rules for compile time (AST) instrumentation.
+ *
+ * Rules are taken from ast_instrumentation_rules configuration option, separated by ';'.
+ * Each rule has the following fields separated by '|':
+ *
+ *      <compiled file path suffix>|<namespace>|<class>|<method or function>|<captured arg indices>|<span type>
+ *
+ * for example:
+ *
+ *      src/Kernel/HttpKernel.php|App\Kernel|HttpKernel|handle|0|app;lib/helpers.php|||render_view|0,1|template
+ *
+ * Empty class means that the rule is for a standalone function. Captured arg indices are comma separated (can be empty)
+ * and span type defaults to "app". Names are matched as they are written in the source (i.e., case sensitive).
+ * Body of each matched function is wrapped with pre/post hooks (see wrapFunctionBodyWithPrePostHooks)
+ * and the PHP part of the agent creates a span of the rule's type for each call.
+ * Generator functions (body contains yield) are not instrumented.
+ *
+ * Rules are parsed once on module init - the configuration is not re-read per request.
+ */
+
+void astInstrumentationRulesOnModuleInit( String rulesConfig );
+void astInstrumentationRulesOnModuleShutdown();
+
+bool astInstrumentationRulesShouldTransformAstInFile( StringView compiledFileFullPath, /* out */ size_t* pFileIndex );
+void astInstrumentationRulesTransformAst( size_t fileIndex, StringView compiledFileFullPath, zend_ast* ast );
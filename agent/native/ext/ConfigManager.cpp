@@ -667,7 +667,7 @@ static OptionMetadata buildDurationOptionMetadata(
     };
 }
 
-[[maybe_unused]] static OptionMetadata buildSizeOptionMetadata(
+static OptionMetadata buildSizeOptionMetadata(
         String name
         , StringView iniName
         , bool isSecret
@@ -797,7 +797,9 @@ ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, apiKey )
 #   if ( ELASTIC_APM_ASSERT_ENABLED_01 != 0 )
 ELASTIC_APM_DEFINE_ENUM_FIELD_ACCESS_FUNCS( AssertLevel, assertLevel )
 #   endif
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, astInstrumentationRules )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, astProcessEnabled )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, astProcessCollectStats )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, astProcessDebugDumpConvertedBackToSource )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, astProcessDebugDumpForPathPrefix )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, astProcessDebugDumpOutDir )
@@ -807,6 +809,7 @@ ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, breakdownMetrics )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, captureErrors )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, captureErrorsWithPhpPart )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( optionalBoolValue, captureExceptions )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, captureMemoryStats )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, devInternal )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, devInternalBackendCommLogVerbose )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, devInternalCaptureErrorsOnlyToLog )
@@ -829,11 +832,21 @@ ELASTIC_APM_DEFINE_ENUM_FIELD_ACCESS_FUNCS( LogLevel, logLevelWinSysDebug )
 #   endif
 #   if ( ELASTIC_APM_MEMORY_TRACKING_ENABLED_01 != 0 )
 ELASTIC_APM_DEFINE_ENUM_FIELD_ACCESS_FUNCS( MemoryTrackingLevel, memoryTrackingLevel )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( sizeValue, memoryTrackingSamplingInterval )
 #   endif
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, nativeFastPathSpansEnabled )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, nonKeywordStringMaxLength )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, observerInstrumentationEnabled )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, profilingContinuousEnabled )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, profilingContinuousExportDir )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, profilingContinuousExportInterval )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, profilingContinuousExportUrl )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, profilingContinuousSamplingInterval )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( boolValue, profilingInferredSpansEnabled )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, profilingInferredSpansMinDuration )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, profilingInferredSpansOverheadBudget )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, profilingInferredSpansSamplingInterval )
+ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, profilingInferredSpansSamplingTimer )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, sanitizeFieldNames )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, secretToken )
 ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( durationValue, serverTimeout )
@@ -882,6 +895,9 @@ ELASTIC_APM_DEFINE_FIELD_ACCESS_FUNCS( stringValue, debugDiagnosticsFile )
 #define ELASTIC_APM_INIT_DURATION_METADATA( fieldName, optName, defaultValue, defaultUnits, isNegativeValid ) \
     ELASTIC_APM_INIT_METADATA_EX( buildDurationOptionMetadata, fieldName, optName, /* isSecret */ false, /* isDynamic */ false, defaultValue, defaultUnits, isNegativeValid )
 
+#define ELASTIC_APM_INIT_SIZE_METADATA( fieldName, optName, defaultValue, defaultUnits ) \
+    ELASTIC_APM_INIT_METADATA_EX( buildSizeOptionMetadata, fieldName, optName, /* isSecret */ false, /* isDynamic */ false, defaultValue, defaultUnits )
+
 #define ELASTIC_APM_INIT_SECRET_METADATA( buildFunc, fieldName, optName, defaultValue ) \
     ELASTIC_APM_INIT_METADATA_EX( buildFunc, fieldName, optName, /* isSecret */ true, /* isDynamic */ false, defaultValue )
 
@@ -967,12 +983,24 @@ static void initOptionsMetadata( OptionMetadata* optsMeta )
             /* isUniquePrefixEnough: */ true );
     #endif
 
+    ELASTIC_APM_INIT_METADATA(
+            buildStringOptionMetadata,
+            astInstrumentationRules,
+            ELASTIC_APM_CFG_OPT_NAME_AST_INSTRUMENTATION_RULES,
+            /* defaultValue: */ NULL );
+
     ELASTIC_APM_INIT_METADATA(
             buildBoolOptionMetadata,
             astProcessEnabled,
             ELASTIC_APM_CFG_OPT_NAME_AST_PROCESS_ENABLED,
             /* defaultValue: */ false );
 
+    ELASTIC_APM_INIT_METADATA(
+            buildBoolOptionMetadata,
+            astProcessCollectStats,
+            ELASTIC_APM_CFG_OPT_NAME_AST_PROCESS_COLLECT_STATS,
+            /* defaultValue: */ false );
+
     ELASTIC_APM_INIT_METADATA(
             buildBoolOptionMetadata,
             astProcessDebugDumpConvertedBackToSource,
@@ -1027,6 +1055,12 @@ static void initOptionsMetadata( OptionMetadata* optsMeta )
             ELASTIC_APM_CFG_OPT_NAME_CAPTURE_EXCEPTIONS,
             /* defaultValue: */ makeNotSetOptionalBool() );
 
+    ELASTIC_APM_INIT_METADATA(
+            buildBoolOptionMetadata,
+            captureMemoryStats,
+            ELASTIC_APM_CFG_OPT_NAME_CAPTURE_MEMORY_STATS,
+            /* defaultValue: */ false );
+
     ELASTIC_APM_INIT_METADATA(
             buildStringOptionMetadata,
             devInternal,
@@ -1123,14 +1157,62 @@ static void initOptionsMetadata( OptionMetadata* optsMeta )
             &interpretEmptyIniRawValueAsOff,
             memoryTrackingLevelNames,
             /* isUniquePrefixEnough: */ true );
+
+    ELASTIC_APM_INIT_SIZE_METADATA(
+            memoryTrackingSamplingInterval
+            , ELASTIC_APM_CFG_OPT_NAME_MEMORY_TRACKING_SAMPLING_INTERVAL
+            , /* defaultValue */ makeSize( 0, sizeUnits_byte )
+            , /* defaultUnits: */ sizeUnits_byte );
     #endif
 
+    ELASTIC_APM_INIT_METADATA(
+            buildBoolOptionMetadata,
+            nativeFastPathSpansEnabled,
+            ELASTIC_APM_CFG_OPT_NAME_NATIVE_FAST_PATH_SPANS_ENABLED,
+            /* defaultValue: */ false );
+
     ELASTIC_APM_INIT_METADATA(
             buildStringOptionMetadata,
             nonKeywordStringMaxLength,
             ELASTIC_APM_CFG_OPT_NAME_NON_KEYWORD_STRING_MAX_LENGTH,
             /* defaultValue: */ NULL );
 
+    ELASTIC_APM_INIT_METADATA(
+            buildBoolOptionMetadata,
+            observerInstrumentationEnabled,
+            ELASTIC_APM_CFG_OPT_NAME_OBSERVER_INSTRUMENTATION_ENABLED,
+            /* defaultValue: */ true );
+
+    ELASTIC_APM_INIT_METADATA(
+            buildBoolOptionMetadata,
+            profilingContinuousEnabled,
+            ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_ENABLED,
+            /* defaultValue: */ false );
+
+    ELASTIC_APM_INIT_METADATA(
+            buildStringOptionMetadata,
+            profilingContinuousExportDir,
+            ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_EXPORT_DIR,
+            /* defaultValue: */ NULL );
+
+    ELASTIC_APM_INIT_METADATA(
+            buildStringOptionMetadata,
+            profilingContinuousExportInterval,
+            ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_EXPORT_INTERVAL,
+            "60s" );
+
+    ELASTIC_APM_INIT_METADATA(
+            buildStringOptionMetadata,
+            profilingContinuousExportUrl,
+            ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_EXPORT_URL,
+            /* defaultValue: */ NULL );
+
+    ELASTIC_APM_INIT_METADATA(
+            buildStringOptionMetadata,
+            profilingContinuousSamplingInterval,
+            ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_SAMPLING_INTERVAL,
+            "10ms" );
+
     ELASTIC_APM_INIT_METADATA(
             buildBoolOptionMetadata,
             profilingInferredSpansEnabled,
@@ -1143,12 +1225,24 @@ static void initOptionsMetadata( OptionMetadata* optsMeta )
             ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_MIN_DURATION,
             /* defaultValue: */ NULL );
 
+    ELASTIC_APM_INIT_METADATA(
+            buildStringOptionMetadata,
+            profilingInferredSpansOverheadBudget,
+            ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_OVERHEAD_BUDGET,
+            /* defaultValue: */ NULL );
+
     ELASTIC_APM_INIT_METADATA(
             buildStringOptionMetadata,
             profilingInferredSpansSamplingInterval,
             ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_SAMPLING_INTERVAL,
             "50ms" );
 
+    ELASTIC_APM_INIT_METADATA(
+            buildStringOptionMetadata,
+            profilingInferredSpansSamplingTimer,
+            ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_SAMPLING_TIMER,
+            /* defaultValue: */ NULL );
+
     ELASTIC_APM_INIT_SECRET_METADATA(
             buildStringOptionMetadata,
             sanitizeFieldNames,
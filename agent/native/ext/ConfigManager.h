@@ -66,7 +66,9 @@ enum OptionId
     #if ( ELASTIC_APM_ASSERT_ENABLED_01 != 0 )
     optionId_assertLevel,
     #endif
+    optionId_astInstrumentationRules,
     optionId_astProcessEnabled,
+    optionId_astProcessCollectStats,
     optionId_astProcessDebugDumpConvertedBackToSource,
     optionId_astProcessDebugDumpForPathPrefix,
     optionId_astProcessDebugDumpOutDir,
@@ -76,6 +78,7 @@ enum OptionId
     optionId_captureErrors,
     optionId_captureErrorsWithPhpPart,
     optionId_captureExceptions,
+    optionId_captureMemoryStats,
     optionId_devInternal,
     optionId_devInternalBackendCommLogVerbose,
     optionId_devInternalCaptureErrorsOnlyToLog,
@@ -98,11 +101,21 @@ enum OptionId
     #endif
     #if ( ELASTIC_APM_MEMORY_TRACKING_ENABLED_01 != 0 )
     optionId_memoryTrackingLevel,
+    optionId_memoryTrackingSamplingInterval,
     #endif
+    optionId_nativeFastPathSpansEnabled,
     optionId_nonKeywordStringMaxLength,
+    optionId_observerInstrumentationEnabled,
+    optionId_profilingContinuousEnabled,
+    optionId_profilingContinuousExportDir,
+    optionId_profilingContinuousExportInterval,
+    optionId_profilingContinuousExportUrl,
+    optionId_profilingContinuousSamplingInterval,
     optionId_profilingInferredSpansEnabled,
     optionId_profilingInferredSpansMinDuration,
+    optionId_profilingInferredSpansOverheadBudget,
     optionId_profilingInferredSpansSamplingInterval,
+    optionId_profilingInferredSpansSamplingTimer,
     optionId_sanitizeFieldNames,
     optionId_secretToken,
     optionId_serverTimeout,
@@ -238,11 +251,23 @@ const ConfigSnapshot* getGlobalCurrentConfigSnapshot();
 #define ELASTIC_APM_CFG_OPT_NAME_ASSERT_LEVEL "assert_level"
 #   endif
 
+/**
+ * Internal configuration option (not included in public documentation)
+ * Rules are read only on module init - see AST_instrumentation_rules.h for the format
+ */
+#define ELASTIC_APM_CFG_OPT_NAME_AST_INSTRUMENTATION_RULES "ast_instrumentation_rules"
+
 /**
  * Internal configuration option (not included in public documentation)
  */
 #define ELASTIC_APM_CFG_OPT_NAME_AST_PROCESS_ENABLED "ast_process_enabled"
 
+/**
+ * Internal configuration option (not included in public documentation)
+ * Used by benchmarks - see benchmarks/run_ast_compile_overhead.sh
+ */
+#define ELASTIC_APM_CFG_OPT_NAME_AST_PROCESS_COLLECT_STATS "ast_process_collect_stats"
+
 /**
  * Internal configuration options (not included in public documentation)
  * In addition to supportability this option is used by component tests as well.
@@ -264,6 +289,11 @@ const ConfigSnapshot* getGlobalCurrentConfigSnapshot();
 #define ELASTIC_APM_CFG_OPT_NAME_CAPTURE_ERRORS_WITH_PHP_PART "capture_errors_with_php_part"
 #define ELASTIC_APM_CFG_OPT_NAME_CAPTURE_EXCEPTIONS "capture_exceptions"
 
+/**
+ * Internal configuration option (not included in public documentation)
+ */
+#define ELASTIC_APM_CFG_OPT_NAME_CAPTURE_MEMORY_STATS "capture_memory_stats"
+
 /**
  * Internal configuration option (not included in public documentation)
  */
@@ -310,11 +340,45 @@ const ConfigSnapshot* getGlobalCurrentConfigSnapshot();
 #define ELASTIC_APM_CFG_OPT_NAME_MEMORY_TRACKING_LEVEL "memory_tracking_level"
 #   endif
 
+/**
+ * Internal configuration option (not included in public documentation)
+ * Average number of bytes allocated between two sampled allocations; 0 disables sampling.
+ * @see memoryTrackerWriteSampledHeapProfile
+ */
+#   if ( ELASTIC_APM_MEMORY_TRACKING_ENABLED_01 != 0 )
+#define ELASTIC_APM_CFG_OPT_NAME_MEMORY_TRACKING_SAMPLING_INTERVAL "memory_tracking_sampling_interval"
+#   endif
+
+/**
+ * Internal configuration option (not included in public documentation)
+ * Calls to DB functions registered by PHP part as fast path spans are timed without calling PHP part
+ */
+#define ELASTIC_APM_CFG_OPT_NAME_NATIVE_FAST_PATH_SPANS_ENABLED "native_fast_path_spans_enabled"
+
 /**
  * Internal configuration option (not included in public documentation)
  */
 #define ELASTIC_APM_CFG_OPT_NAME_NON_KEYWORD_STRING_MAX_LENGTH "non_keyword_string_max_length"
 
+/**
+ * Internal configuration option (not included in public documentation)
+ * Used only on PHP 8+ and read only on module init - observer has to be registered before PHP startup completes.
+ */
+#define ELASTIC_APM_CFG_OPT_NAME_OBSERVER_INSTRUMENTATION_ENABLED "observer_instrumentation_enabled"
+
+/**
+ * Internal configuration option (not included in public documentation)
+ *
+ * Continuous sampling profiler - aggregated stacks are exported as pprof profile
+ * to export_dir (one file per export) and/or POSTed to export_url.
+ * export_interval set to 0 exports profile at the end of each request.
+ */
+#define ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_ENABLED "profiling_continuous_enabled"
+#define ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_EXPORT_DIR "profiling_continuous_export_dir"
+#define ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_EXPORT_INTERVAL "profiling_continuous_export_interval"
+#define ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_EXPORT_URL "profiling_continuous_export_url"
+#define ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_SAMPLING_INTERVAL "profiling_continuous_sampling_interval"
+
 /**
  * Experimental configuration option (not included in public documentation)
  */
@@ -322,6 +386,22 @@ const ConfigSnapshot* getGlobalCurrentConfigSnapshot();
 #define ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_MIN_DURATION "profiling_inferred_spans_min_duration"
 #define ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_SAMPLING_INTERVAL "profiling_inferred_spans_sampling_interval"
 
+/**
+ * Internal configuration option (not included in public documentation)
+ *
+ * Selects the driver for inferred spans sampling: "cpu" (per-thread CPU time interval timer)
+ * or not set (background periodic task thread)
+ */
+#define ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_SAMPLING_TIMER "profiling_inferred_spans_sampling_timer"
+
+/**
+ * Internal configuration option (not included in public documentation)
+ *
+ * Share of request time that inferred spans sampling may take, as percent (for example "1%" or "0.5").
+ * When set, sampling interval is raised above the configured one while the measured cost of samples exceeds the budget.
+ */
+#define ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_OVERHEAD_BUDGET "profiling_inferred_spans_overhead_budget"
+
 #define ELASTIC_APM_CFG_OPT_NAME_SANITIZE_FIELD_NAMES "sanitize_field_names"
 #define ELASTIC_APM_CFG_OPT_NAME_SECRET_TOKEN "secret_token"
 #define ELASTIC_APM_CFG_OPT_NAME_SERVER_TIMEOUT "server_timeout"
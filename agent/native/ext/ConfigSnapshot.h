@@ -25,6 +25,7 @@
 #include "LogLevel.h"
 #include "OptionalBool.h"
 #include "time_util.h" // Duration
+#include "util.h" // Size
 #include "elastic_apm_assert_enabled.h"
 
 struct ConfigSnapshot
@@ -37,7 +38,9 @@ struct ConfigSnapshot
     AssertLevel assertLevel = assertLevel_off;
         #endif
     String apiKey = nullptr;
+    String astInstrumentationRules = nullptr;
     bool astProcessEnabled = false;
+    bool astProcessCollectStats = false;
     bool astProcessDebugDumpConvertedBackToSource = false;
     String astProcessDebugDumpForPathPrefix = nullptr;
     String astProcessDebugDumpOutDir = nullptr;
@@ -47,6 +50,7 @@ struct ConfigSnapshot
     bool captureErrors = false;
     bool captureErrorsWithPhpPart = false;
     OptionalBool captureExceptions = ELASTIC_APM_MAKE_NOT_SET_OPTIONAL_BOOL();
+    bool captureMemoryStats = false;
     String debugDiagnosticsFile = nullptr;
     String devInternal = nullptr;
     bool devInternalBackendCommLogVerbose = false;
@@ -70,11 +74,21 @@ struct ConfigSnapshot
         #endif
         #if ( ELASTIC_APM_MEMORY_TRACKING_ENABLED_01 != 0 )
     MemoryTrackingLevel memoryTrackingLevel = memoryTrackingLevel_off;
+    Size memoryTrackingSamplingInterval = { 0, sizeUnits_byte };
         #endif
+    bool nativeFastPathSpansEnabled = false;
     String nonKeywordStringMaxLength = nullptr;
+    bool observerInstrumentationEnabled = true;
+    bool profilingContinuousEnabled = false;
+    String profilingContinuousExportDir = nullptr;
+    String profilingContinuousExportInterval = nullptr;
+    String profilingContinuousExportUrl = nullptr;
+    String profilingContinuousSamplingInterval = nullptr;
     bool profilingInferredSpansEnabled = false;
     String profilingInferredSpansMinDuration = nullptr;
+    String profilingInferredSpansOverheadBudget = nullptr;
     String profilingInferredSpansSamplingInterval = nullptr;
+    String profilingInferredSpansSamplingTimer = nullptr;
     String sanitizeFieldNames = nullptr;
     String secretToken = nullptr;
     String serverUrl = nullptr;
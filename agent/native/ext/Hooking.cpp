@@ -72,26 +72,32 @@ void elastic_apm_error_cb(int type, zend_string *error_filename, const uint32_t
     }
 }
 
+#if PHP_VERSION_ID < 80200
+// Before PHP 8.2 VM handles interrupt only on the next user opcode - after the internal frame is already gone,
+// so samples requested during a long internal call (curl_exec, sleep, PDO::execute, etc.) would miss the function actually taking the time.
+// The hook is kept as thin as possible: no zend_try (catching bailout here used to swallow fatal errors)
+// and only an atomic load per call when no sample is pending.
 static void elastic_execute_internal(INTERNAL_FUNCTION_PARAMETERS) {
-
-    zend_try {
-        if (Hooking::getInstance().getOriginalExecuteInternal()) {
-            Hooking::getInstance().getOriginalExecuteInternal()(INTERNAL_FUNCTION_PARAM_PASSTHRU);
-        } else {
-            execute_internal(INTERNAL_FUNCTION_PARAM_PASSTHRU);
-        }
-    } zend_catch {
-        ELASTIC_APM_LOG_DIRECT_DEBUG("%s: original call error; parent PID: %d", __FUNCTION__, (int)getParentProcessId());
-    } zend_end_try();
+    if (Hooking::getInstance().getOriginalExecuteInternal()) {
+        Hooking::getInstance().getOriginalExecuteInternal()(INTERNAL_FUNCTION_PARAM_PASSTHRU);
+    } else {
+        execute_internal(INTERNAL_FUNCTION_PARAM_PASSTHRU);
+    }
 
     ELASTICAPM_G(globals)->inferredSpans_->attachBacktraceIfInterrupted();
+    if (ELASTICAPM_G(continuousProfiler)) {
+        ELASTICAPM_G(continuousProfiler)->getSampler()->attachBacktraceIfInterrupted();
+    }
 }
-
+#endif
 
 static void elastic_interrupt_function(zend_execute_data *execute_data) {
     ELASTIC_APM_LOG_DIRECT_DEBUG( "%s: interrupt; parent PID: %d", __FUNCTION__, (int)getParentProcessId() );
 
     ELASTICAPM_G(globals)->inferredSpans_->attachBacktraceIfInterrupted();
+    if (ELASTICAPM_G(continuousProfiler)) {
+        ELASTICAPM_G(continuousProfiler)->getSampler()->attachBacktraceIfInterrupted();
+    }
 
     zend_try {
         if (Hooking::getInstance().getOriginalZendInterruptFunction()) {
@@ -102,13 +108,19 @@ static void elastic_interrupt_function(zend_execute_data *execute_data) {
     } zend_end_try();
 }
 
-void Hooking::replaceHooks(bool cfgCaptureErrors, bool cfgCaptureErrorsWithPhpPart, bool cfgInferredSpansEnabled) {
-    if (cfgInferredSpansEnabled) {
+void Hooking::replaceHooks(bool cfgCaptureErrors, bool cfgCaptureErrorsWithPhpPart, bool cfgInferredSpansEnabled, bool cfgContinuousProfilingEnabled) {
+    if (cfgInferredSpansEnabled || cfgContinuousProfilingEnabled) {
+#if PHP_VERSION_ID < 80200
         zend_execute_internal = elastic_execute_internal;
+        ELASTIC_APM_LOG_DEBUG( "Replaced zend_execute_internal hook" );
+#else
+        // Since PHP 8.2 VM calls zend_interrupt_function right after internal function returns while its frame is still current
+        // (ZEND_VM_FCALL_INTERRUPT_CHECK) so there is no need to wrap internal calls - which would also turn off VM's fast path for them
+#endif
         zend_interrupt_function = elastic_interrupt_function;
-        ELASTIC_APM_LOG_DEBUG( "Replaced zend_execute_internal and zend_interrupt_function hooks" );
+        ELASTIC_APM_LOG_DEBUG( "Replaced zend_interrupt_function hook" );
     } else {
-        ELASTIC_APM_LOG_DEBUG( "NOT replacing zend_execute_internal and zend_interrupt_function hooks because profiling_inferred_spans_enabled configuration option is set to false" );
+        ELASTIC_APM_LOG_DEBUG( "NOT replacing zend_execute_internal and zend_interrupt_function hooks because both profiling_inferred_spans_enabled and profiling_continuous_enabled configuration options are set to false" );
     }
 
     if (cfgCaptureErrors && (!cfgCaptureErrorsWithPhpPart)) {
@@ -24,13 +24,14 @@
 #define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_MEM_TRACKER
 
 #include <algorithm>
+#include <math.h> // log
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h> // memcpy
 #include "util.h"
 #include "TextOutputStream.h"
 #include "elastic_apm_assert.h"
 #include "basic_macros.h"
-#include "IntrusiveDoublyLinkedList.h"
 #include "log.h"
 #include "platform.h"
 
@@ -50,35 +51,236 @@ static const UInt32 invalidMagicValue = 0xDEADBEEF;
 static constexpr size_t maxNumberOfLeakedAllocationsToReport = 10;
 static const size_t maxNumberOfBytesFromLeakedAllocationToReport = 100;
 
+static const size_t hashTableInitialCapacity = 64;
+
+/**
+ * Stack traces are interned - all the blocks allocated from the same call stack share one instance
+ * and the instance is freed when the last of these blocks is freed.
+ */
+struct TrackedStackTrace
+{
+    UInt64 hash;
+    size_t refCount;
+    size_t addressesCount;
+    void* addresses[ 1 ]; // addressesCount is the actual number of elements in addresses
+};
+typedef struct TrackedStackTrace TrackedStackTrace;
+
 struct EmbeddedTrackingDataHeader
 {
     UInt32 prefixMagic;
 
-    IntrusiveDoublyLinkedListNode intrusiveNode;
+    /// Sequence number of the allocation - used to report the oldest leaked allocations first
+    UInt64 allocationIndex;
+    /// false only if there was not enough memory to add this block to the tracked blocks index
+    bool isIndexed;
 
     String fileName;
     UInt lineNumber;
     size_t originallyRequestedSize;
     bool isString;
 
-    size_t stackTraceAddressesCount;
+    TrackedStackTrace* stackTrace;
+
+    UInt32 suffixMagic;
 };
 typedef struct EmbeddedTrackingDataHeader EmbeddedTrackingDataHeader;
 
+static
+void initMemoryTrackerHashTable( MemoryTrackerHashTable* table )
+{
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
+
+static
+void destructMemoryTrackerHashTable( MemoryTrackerHashTable* table )
+{
+    // Hash tables' storage is allocated directly with malloc so it is not tracked itself
+    free( (void*)( table->slots ) );
+    initMemoryTrackerHashTable( table );
+}
+
+static inline
+UInt64 hashPointer( const void* ptr )
+{
+    return ( (UInt64)(uintptr_t)ptr * UINT64_C( 0x9E3779B97F4A7C15 ) ) >> 16;
+}
+
+static
+UInt64 hashStackTrace( void* const* stackTraceAddresses, size_t stackTraceAddressesCount )
+{
+    // FNV-1a
+    UInt64 hash = UINT64_C( 0xCBF29CE484222325 );
+    ELASTIC_APM_FOR_EACH_INDEX( i, stackTraceAddressesCount )
+    {
+        hash ^= (UInt64)(uintptr_t)( stackTraceAddresses[ i ] );
+        hash *= UINT64_C( 0x100000001B3 );
+    }
+    return hash;
+}
+
+typedef UInt64 (* HashTableEntryHashFunc )( const void* entry );
+
+static
+UInt64 trackedBlockEntryHash( const void* entry )
+{
+    return hashPointer( entry );
+}
+
+static
+UInt64 trackedStackTraceEntryHash( const void* entry )
+{
+    return ( (const TrackedStackTrace*)entry )->hash;
+}
+
+static inline
+size_t hashTableHomeIndex( const MemoryTrackerHashTable* table, UInt64 hash )
+{
+    return (size_t)( hash & ( table->capacity - 1 ) );
+}
+
+static inline
+size_t hashTableNextIndex( const MemoryTrackerHashTable* table, size_t index )
+{
+    return ( index + 1 ) & ( table->capacity - 1 );
+}
+
+static
+void insertIntoHashTableNoGrow( MemoryTrackerHashTable* table, const void* entry, UInt64 entryHash )
+{
+    size_t i = hashTableHomeIndex( table, entryHash );
+    while ( table->slots[ i ] != NULL ) i = hashTableNextIndex( table, i );
+    table->slots[ i ] = entry;
+    ++table->count;
+}
+
+static
+ResultCode insertIntoHashTable( MemoryTrackerHashTable* table, const void* entry, UInt64 entryHash, HashTableEntryHashFunc hashEntry )
+{
+    // Keep load factor at most 1/2 so that probe sequences stay short
+    if ( ( table->count + 1 ) * 2 > table->capacity )
+    {
+        MemoryTrackerHashTable grownTable;
+        grownTable.capacity = ( table->capacity == 0 ) ? hashTableInitialCapacity : ( table->capacity * 2 );
+        grownTable.count = 0;
+        grownTable.slots = (const void**)calloc( grownTable.capacity, sizeof( const void* ) );
+        if ( grownTable.slots == NULL ) return resultOutOfMemory;
+
+        ELASTIC_APM_FOR_EACH_INDEX( i, table->capacity )
+        {
+            if ( table->slots[ i ] != NULL ) insertIntoHashTableNoGrow( &grownTable, table->slots[ i ], hashEntry( table->slots[ i ] ) );
+        }
+
+        destructMemoryTrackerHashTable( table );
+        *table = grownTable;
+    }
+
+    insertIntoHashTableNoGrow( table, entry, entryHash );
+    return resultSuccess;
+}
+
 /**
- * EmbeddedTrackingDataHeaderVariadicSuffix is used only to calculate sizes of its fields.
- * It symbolizes a trailing part of the EmbeddedTrackingDataHeader with variadic data (stackTraceAddresses).
+ * @return index of the slot containing entry or table->capacity if entry is not found
  */
-#pragma clang diagnostic push
-#pragma ide diagnostic ignored "OCUnusedGlobalDeclarationInspection"
-#pragma ide diagnostic ignored "UnusedLocalVariable"
-struct EmbeddedTrackingDataHeaderVariadicSuffix
+static
+size_t findInHashTable( const MemoryTrackerHashTable* table, const void* entry, UInt64 entryHash )
 {
-    void* stackTraceAddresses[ 1 ]; // EmbeddedTrackingDataHeader::stackTraceAddressesCount is the actual number of elements in stackTraceAddresses
-    UInt32 suffixMagic;
-};
-#pragma clang diagnostic pop
-typedef struct EmbeddedTrackingDataHeaderVariadicSuffix EmbeddedTrackingDataHeaderVariadicSuffix;
+    if ( table->count == 0 ) return table->capacity;
+
+    for ( size_t i = hashTableHomeIndex( table, entryHash ) ; table->slots[ i ] != NULL ; i = hashTableNextIndex( table, i ) )
+    {
+        if ( table->slots[ i ] == entry ) return i;
+    }
+    return table->capacity;
+}
+
+static
+void removeFromHashTableAt( MemoryTrackerHashTable* table, size_t index, HashTableEntryHashFunc hashEntry )
+{
+    ELASTIC_APM_ASSERT_LT_UINT64( index, table->capacity );
+    ELASTIC_APM_ASSERT( table->slots[ index ] != NULL, "" );
+
+    --table->count;
+
+    // Backward shift deletion - move entries of the same probe sequence into the freed slot
+    size_t i = index;
+    for ( ;; )
+    {
+        table->slots[ i ] = NULL;
+        size_t j = i;
+        for ( ;; )
+        {
+            j = hashTableNextIndex( table, j );
+            if ( table->slots[ j ] == NULL ) return;
+            const size_t home = hashTableHomeIndex( table, hashEntry( table->slots[ j ] ) );
+            const bool isHomeInShiftedRange = ( i <= j ) ? ( i < home && home <= j ) : ( i < home || home <= j );
+            if ( ! isHomeInShiftedRange ) break;
+        }
+        table->slots[ i ] = table->slots[ j ];
+        i = j;
+    }
+}
+
+static
+size_t calcTrackedStackTraceSize( size_t addressesCount )
+{
+    return offsetof( TrackedStackTrace, addresses ) + sizeof( void* ) * addressesCount;
+}
+
+static
+TrackedStackTrace* internStackTrace( MemoryTracker* memTracker, void* const* stackTraceAddresses, size_t stackTraceAddressesCount )
+{
+    if ( stackTraceAddressesCount == 0 ) return NULL;
+
+    MemoryTrackerHashTable* stackTraces = &memTracker->stackTraces;
+    const UInt64 hash = hashStackTrace( stackTraceAddresses, stackTraceAddressesCount );
+    if ( stackTraces->count != 0 )
+    {
+        for ( size_t i = hashTableHomeIndex( stackTraces, hash ) ; stackTraces->slots[ i ] != NULL ; i = hashTableNextIndex( stackTraces, i ) )
+        {
+            TrackedStackTrace* stackTrace = (TrackedStackTrace*)( stackTraces->slots[ i ] );
+            if ( stackTrace->hash == hash
+                 && stackTrace->addressesCount == stackTraceAddressesCount
+                 && memcmp( stackTrace->addresses, stackTraceAddresses, sizeof( void* ) * stackTraceAddressesCount ) == 0 )
+            {
+                ++stackTrace->refCount;
+                return stackTrace;
+            }
+        }
+    }
+
+    // Interned stack traces are allocated directly with malloc so they are not tracked themselves
+    TrackedStackTrace* stackTrace = (TrackedStackTrace*)malloc( calcTrackedStackTraceSize( stackTraceAddressesCount ) );
+    if ( stackTrace == NULL ) return NULL;
+    stackTrace->hash = hash;
+    stackTrace->refCount = 1;
+    stackTrace->addressesCount = stackTraceAddressesCount;
+    memcpy( stackTrace->addresses, stackTraceAddresses, sizeof( void* ) * stackTraceAddressesCount );
+
+    if ( insertIntoHashTable( stackTraces, stackTrace, hash, &trackedStackTraceEntryHash ) != resultSuccess )
+    {
+        free( stackTrace );
+        return NULL;
+    }
+
+    return stackTrace;
+}
+
+static
+void releaseStackTrace( MemoryTracker* memTracker, TrackedStackTrace* stackTrace )
+{
+    if ( stackTrace == NULL ) return;
+
+    ELASTIC_APM_ASSERT_GT_UINT64( stackTrace->refCount, 0 );
+    if ( --stackTrace->refCount != 0 ) return;
+
+    const size_t index = findInHashTable( &memTracker->stackTraces, stackTrace, stackTrace->hash );
+    ELASTIC_APM_ASSERT_LT_UINT64( index, memTracker->stackTraces.capacity );
+    removeFromHashTableAt( &memTracker->stackTraces, index, &trackedStackTraceEntryHash );
+    free( stackTrace );
+}
 
 void constructMemoryTracker( MemoryTracker* memTracker )
 {
@@ -90,9 +292,15 @@ void constructMemoryTracker( MemoryTracker* memTracker )
     memTracker->level = memoryTrackingLevel_all;
     memTracker->abortOnMemoryLeak = ELASTIC_APM_MEMORY_TRACKING_DEFAULT_ABORT_ON_MEMORY_LEAK;
     memTracker->allocatedPersistent = 0;
-    initIntrusiveDoublyLinkedList( &memTracker->allocatedPersistentBlocks );
+    initMemoryTrackerHashTable( &memTracker->allocatedPersistentBlocks );
     memTracker->allocatedRequestScoped = 0;
-    initIntrusiveDoublyLinkedList( &memTracker->allocatedRequestScopedBlocks );
+    initMemoryTrackerHashTable( &memTracker->allocatedRequestScopedBlocks );
+    initMemoryTrackerHashTable( &memTracker->stackTraces );
+    memTracker->nextAllocationIndex = 0;
+    memTracker->samplingIntervalInBytes = 0;
+    memTracker->bytesUntilNextSample = 0;
+    memTracker->sampledLiveBlocksCount = 0;
+    memTracker->sampledProfile = NULL;
 
     ELASTIC_APM_ASSERT_VALID_MEMORY_TRACKER( memTracker );
 }
@@ -110,23 +318,13 @@ size_t calcSizeBeforeTrackingData( size_t originallyRequestedSize )
     return calcAlignedSize( originallyRequestedSize, embeddedTrackingDataAlignment );
 }
 
-static
-size_t calcStackTraceAddressesSize( size_t stackTraceAddressesCount )
-{
-    return stackTraceAddressesCount * ELASTIC_APM_FIELD_SIZEOF( EmbeddedTrackingDataHeaderVariadicSuffix, stackTraceAddresses[ 0 ] );
-}
-
 size_t memoryTrackerCalcSizeToAlloc(
         MemoryTracker* memTracker,
-        size_t originallyRequestedSize,
-        size_t stackTraceAddressesCount )
+        size_t originallyRequestedSize )
 {
     if ( memTracker->level < memoryTrackingLevel_eachAllocation ) return originallyRequestedSize;
 
-    return calcSizeBeforeTrackingData( originallyRequestedSize ) +
-           sizeof( EmbeddedTrackingDataHeader ) +
-           calcStackTraceAddressesSize( stackTraceAddressesCount ) +
-           ELASTIC_APM_FIELD_SIZEOF( EmbeddedTrackingDataHeaderVariadicSuffix, suffixMagic );
+    return calcSizeBeforeTrackingData( originallyRequestedSize ) + sizeof( EmbeddedTrackingDataHeader );
 }
 
 static
@@ -156,26 +354,20 @@ void addToTrackedAllocatedBlocks(
     EmbeddedTrackingDataHeader* trackingDataHeader = allocatedBlockToTrackingData( allocatedBlock, originallyRequestedSize );
     ELASTIC_APM_ZERO_STRUCT( trackingDataHeader );
     UInt64* allocated = isPersistent ? &memTracker->allocatedPersistent : &memTracker->allocatedRequestScoped;
-    IntrusiveDoublyLinkedList* allocatedBlocks = isPersistent ? &memTracker->allocatedPersistentBlocks : &memTracker->allocatedRequestScopedBlocks;
+    MemoryTrackerHashTable* allocatedBlocks = isPersistent ? &memTracker->allocatedPersistentBlocks : &memTracker->allocatedRequestScopedBlocks;
 
     *allocated += originallyRequestedSize;
-    addToIntrusiveDoublyLinkedListBack( allocatedBlocks, &trackingDataHeader->intrusiveNode );
+    trackingDataHeader->isIndexed =
+            ( insertIntoHashTable( allocatedBlocks, trackingDataHeader, hashPointer( trackingDataHeader ), &trackedBlockEntryHash ) == resultSuccess );
 
     trackingDataHeader->prefixMagic = prefixMagicExpectedValue;
+    trackingDataHeader->allocationIndex = memTracker->nextAllocationIndex++;
     trackingDataHeader->fileName = extractLastPartOfFilePathStringView( filePath ).begin;
     trackingDataHeader->lineNumber = lineNumber;
     trackingDataHeader->originallyRequestedSize = originallyRequestedSize;
     trackingDataHeader->isString = isString;
-    trackingDataHeader->stackTraceAddressesCount = stackTraceAddressesCount;
-
-    Byte* postHeader = ((Byte*)trackingDataHeader) + sizeof( EmbeddedTrackingDataHeader );
-    if ( stackTraceAddressesCount != 0 )
-    {
-        memcpy( postHeader, stackTraceAddresses, calcStackTraceAddressesSize( stackTraceAddressesCount ) );
-        postHeader += calcStackTraceAddressesSize( stackTraceAddressesCount );
-    }
-
-    memcpy( postHeader, &suffixMagicExpectedValue, ELASTIC_APM_FIELD_SIZEOF( EmbeddedTrackingDataHeaderVariadicSuffix, suffixMagic ) );
+    trackingDataHeader->stackTrace = internStackTrace( memTracker, stackTraceAddresses, stackTraceAddressesCount );
+    trackingDataHeader->suffixMagic = suffixMagicExpectedValue;
 }
 
 void memoryTrackerAfterAlloc(
@@ -238,7 +430,7 @@ void removeFromTrackedAllocatedBlocks(
         MemoryTracker* memTracker,
         const void* allocatedBlock,
         size_t originallyRequestedSize,
-        IntrusiveDoublyLinkedList* allocatedBlocks,
+        MemoryTrackerHashTable* allocatedBlocks,
         size_t* possibleActuallyRequestedSize )
 {
     if (!allocatedBlock) {
@@ -248,21 +440,27 @@ void removeFromTrackedAllocatedBlocks(
     EmbeddedTrackingDataHeader* trackingDataHeader = allocatedBlockToTrackingData( allocatedBlock, originallyRequestedSize );
 
     verifyMagic( "prefix", trackingDataHeader->prefixMagic, prefixMagicExpectedValue );
+    verifyMagic( "suffix", trackingDataHeader->suffixMagic, suffixMagicExpectedValue );
 
-    Byte* postHeader = ((Byte*)trackingDataHeader) + sizeof( EmbeddedTrackingDataHeader );
-    postHeader += calcStackTraceAddressesSize( trackingDataHeader->stackTraceAddressesCount );
-    UInt32 actualSuffixMagic;
-    memcpy( &actualSuffixMagic, postHeader, sizeof( actualSuffixMagic ) );
-    verifyMagic( "suffix", actualSuffixMagic, suffixMagicExpectedValue );
+    *possibleActuallyRequestedSize = memoryTrackerCalcSizeToAlloc( memTracker, originallyRequestedSize );
 
-    *possibleActuallyRequestedSize =
-            memoryTrackerCalcSizeToAlloc(memTracker, originallyRequestedSize, trackingDataHeader->stackTraceAddressesCount );
+    if ( trackingDataHeader->isIndexed )
+    {
+        const size_t index = findInHashTable( allocatedBlocks, trackingDataHeader, hashPointer( trackingDataHeader ) );
+        if ( index == allocatedBlocks->capacity )
+        {
+            ELASTIC_APM_REPORT_MEMORY_CORRUPTION_AND_ABORT(
+                    "Freed block is not found among tracked allocated blocks. Source location: %s:%u. Originally requested allocation size: %" PRIu64 ".",
+                    trackingDataHeader->fileName, trackingDataHeader->lineNumber, (UInt64)originallyRequestedSize );
+        }
+        removeFromHashTableAt( allocatedBlocks, index, &trackedBlockEntryHash );
+    }
 
-    removeCurrentNodeIntrusiveDoublyLinkedList(
-            nodeToIntrusiveDoublyLinkedListIterator( allocatedBlocks, &trackingDataHeader->intrusiveNode ) );
+    releaseStackTrace( memTracker, trackingDataHeader->stackTrace );
+    trackingDataHeader->stackTrace = NULL;
 
     trackingDataHeader->prefixMagic = invalidMagicValue;
-    memcpy( postHeader, &invalidMagicValue, ELASTIC_APM_FIELD_SIZEOF( EmbeddedTrackingDataHeaderVariadicSuffix, suffixMagic ) );
+    trackingDataHeader->suffixMagic = invalidMagicValue;
 }
 
 void memoryTrackerBeforeFree(
@@ -276,7 +474,7 @@ void memoryTrackerBeforeFree(
     ELASTIC_APM_ASSERT_VALID_PTR( possibleActuallyRequestedSize );
 
     UInt64* allocated = isPersistent ? &memTracker->allocatedPersistent : &memTracker->allocatedRequestScoped;
-    IntrusiveDoublyLinkedList* allocatedBlocks = isPersistent ? &memTracker->allocatedPersistentBlocks : &memTracker->allocatedRequestScopedBlocks;
+    MemoryTrackerHashTable* allocatedBlocks = isPersistent ? &memTracker->allocatedPersistentBlocks : &memTracker->allocatedRequestScopedBlocks;
 
     ELASTIC_APM_ASSERT( *allocated >= originallyRequestedSize
             , "Attempting to free more %s memory than allocated. Allocated: %" PRIu64 ". Attempting to free: %" PRIu64
@@ -292,12 +490,6 @@ void memoryTrackerBeforeFree(
     *allocated -= originallyRequestedSize;
 }
 
-static
-const EmbeddedTrackingDataHeader* fromIntrusiveNodeToTrackingData( const IntrusiveDoublyLinkedListNode* intrusiveListNode )
-{
-    return (const EmbeddedTrackingDataHeader*)( ((const Byte*) intrusiveListNode ) - offsetof( EmbeddedTrackingDataHeader, intrusiveNode ) );
-}
-
 static
 void streamMemoryBlockAsString(
         const Byte* memBlock,
@@ -354,20 +546,18 @@ String streamAllocCallStackTrace(
         TextOutputStream* txtOutStream,
         const EmbeddedTrackingDataHeader* trackingDataHeader )
 {
-    if ( trackingDataHeader->stackTraceAddressesCount == 0 )
+    const TrackedStackTrace* stackTrace = trackingDataHeader->stackTrace;
+    if ( stackTrace == NULL )
         return "\t\t<STACK TRACE IS NOT CAPTURED>";
 
     TextOutputStreamState txtOutStreamStateOnEntryStart;
     if ( ! textOutputStreamStartEntry( txtOutStream, &txtOutStreamStateOnEntryStart ) )
         return ELASTIC_APM_TEXT_OUTPUT_STREAM_NOT_ENOUGH_SPACE_MARKER;
 
-    Byte* postHeader = ((Byte*)trackingDataHeader) + sizeof( EmbeddedTrackingDataHeader );
-    ELASTIC_APM_ASSERT_LE_UINT64( trackingDataHeader->stackTraceAddressesCount, maxCaptureStackTraceDepth );
-    void* stackTraceAddresses[ maxCaptureStackTraceDepth ];
-    memcpy( stackTraceAddresses, postHeader, sizeof( void* ) * trackingDataHeader->stackTraceAddressesCount );
+    ELASTIC_APM_ASSERT_LE_UINT64( stackTrace->addressesCount, maxCaptureStackTraceDepth );
     streamStackTrace(
-            &(stackTraceAddresses[ 0 ]),
-            trackingDataHeader->stackTraceAddressesCount,
+            &(stackTrace->addresses[ 0 ]),
+            stackTrace->addressesCount,
             /* linePrefix: */ "\t\t",
             txtOutStream );
 
@@ -375,10 +565,8 @@ String streamAllocCallStackTrace(
 }
 
 static
-void reportAllocation( const IntrusiveDoublyLinkedListNode* intrusiveListNode, size_t allocationIndex, size_t numberOfAllocations )
+void reportAllocation( const EmbeddedTrackingDataHeader* trackingDataHeader, size_t allocationIndex, size_t numberOfAllocations )
 {
-    const EmbeddedTrackingDataHeader* trackingDataHeader = fromIntrusiveNodeToTrackingData( intrusiveListNode );
-
     char txtOutStreamBuf[ ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE * 10 ];
     TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
 
@@ -399,6 +587,40 @@ void reportAllocation( const IntrusiveDoublyLinkedListNode* intrusiveListNode, s
 void ELASTIC_APM_ON_MEMORY_LEAK_CUSTOM_FUNC();
 #endif
 
+/**
+ * Selects (in a single pass over the index) the oldest allocations - the ones that were reported first before
+ * when tracked blocks were kept in allocation order
+ */
+static
+size_t selectOldestAllocations(
+        const MemoryTrackerHashTable* allocatedBlocks,
+        const EmbeddedTrackingDataHeader* selected[ maxNumberOfLeakedAllocationsToReport ] )
+{
+    size_t selectedCount = 0;
+    ELASTIC_APM_FOR_EACH_INDEX( slotIndex, allocatedBlocks->capacity )
+    {
+        const EmbeddedTrackingDataHeader* trackingDataHeader = (const EmbeddedTrackingDataHeader*)( allocatedBlocks->slots[ slotIndex ] );
+        if ( trackingDataHeader == NULL ) continue;
+
+        if ( selectedCount == maxNumberOfLeakedAllocationsToReport )
+        {
+            if ( trackingDataHeader->allocationIndex > selected[ selectedCount - 1 ]->allocationIndex ) continue;
+            --selectedCount;
+        }
+
+        // insertion sort by allocation index
+        size_t insertAt = selectedCount;
+        while ( insertAt > 0 && selected[ insertAt - 1 ]->allocationIndex > trackingDataHeader->allocationIndex )
+        {
+            selected[ insertAt ] = selected[ insertAt - 1 ];
+            --insertAt;
+        }
+        selected[ insertAt ] = trackingDataHeader;
+        ++selectedCount;
+    }
+    return selectedCount;
+}
+
 static
 void verifyBalanceIsZero( const MemoryTracker* memTracker, String whenDesc, UInt64 allocated, bool isPersistent )
 {
@@ -407,21 +629,13 @@ void verifyBalanceIsZero( const MemoryTracker* memTracker, String whenDesc, UInt
         return;
     }
 
-    const IntrusiveDoublyLinkedList* allocatedBlocks = isPersistent ? &memTracker->allocatedPersistentBlocks : &memTracker->allocatedRequestScopedBlocks;
-    const size_t numberOfAllocations = calcIntrusiveDoublyLinkedListSize( allocatedBlocks );
-    const size_t numberOfAllocationsToReport = std::min(numberOfAllocations, maxNumberOfLeakedAllocationsToReport);
-    const IntrusiveDoublyLinkedListNode* allocationsToReport[ maxNumberOfLeakedAllocationsToReport ];
+    const MemoryTrackerHashTable* allocatedBlocks = isPersistent ? &memTracker->allocatedPersistentBlocks : &memTracker->allocatedRequestScopedBlocks;
+    const size_t numberOfAllocations = allocatedBlocks->count;
+    const EmbeddedTrackingDataHeader* allocationsToReport[ maxNumberOfLeakedAllocationsToReport ];
 
     // Copy allocation nodes we are going to report
     // because the code below might do more allocations
-    {
-        size_t allocationIndex = 0;
-        ELASTIC_APM_FOR_EACH_IN_INTRUSIVE_LINKED_LIST( allocationsIt, allocatedBlocks )
-        {
-            allocationsToReport[ allocationIndex++ ] = currentNodeIntrusiveDoublyLinkedList( allocationsIt );
-            if ( allocationIndex == numberOfAllocationsToReport ) break;
-        }
-    }
+    const size_t numberOfAllocationsToReport = selectOldestAllocations( allocatedBlocks, allocationsToReport );
 
     ELASTIC_APM_FORCE_LOG_CRITICAL(
             "Memory leak detected! On %s amount of allocated %s memory should be 0, instead it is %" PRIu64 ,
@@ -444,6 +658,321 @@ void verifyBalanceIsZero( const MemoryTracker* memTracker, String whenDesc, UInt
     #endif
 }
 
+enum { maxSampledStackTraceDepth = 32 };
+// Both capacities have to be powers of 2
+enum { sampledCallSitesCapacity = 512 };
+enum { sampledLiveBlocksCapacity = 4096 };
+
+struct MemoryTrackerSampledCallSite
+{
+    bool isUsed;
+    UInt64 stackTraceHash;
+    size_t stackTraceAddressesCount;
+    void* stackTraceAddresses[ maxSampledStackTraceDepth ];
+
+    UInt64 allocatedCount;
+    UInt64 allocatedBytes;
+    UInt64 inUseCount;
+    UInt64 inUseBytes;
+};
+typedef struct MemoryTrackerSampledCallSite MemoryTrackerSampledCallSite;
+
+struct MemoryTrackerSampledLiveBlock
+{
+    const void* allocatedBlock; // NULL means the slot is free
+    size_t originallyRequestedSize;
+    size_t callSiteIndex;
+};
+typedef struct MemoryTrackerSampledLiveBlock MemoryTrackerSampledLiveBlock;
+
+struct MemoryTrackerSampledProfile
+{
+    UInt64 randomState;
+    size_t callSitesCount;
+    UInt64 droppedSamplesCount;
+    MemoryTrackerSampledCallSite callSites[ sampledCallSitesCapacity ];
+    MemoryTrackerSampledLiveBlock liveBlocks[ sampledLiveBlocksCapacity ];
+};
+
+static
+UInt64 nextSamplingRandom( MemoryTrackerSampledProfile* profile )
+{
+    // xorshift64*
+    UInt64 x = profile->randomState;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    profile->randomState = x;
+    return x * UINT64_C( 0x2545F4914F6CDD1D );
+}
+
+/**
+ * Distance between samples in a Poisson process is exponentially distributed
+ * so each byte allocated has the same probability of being sampled
+ * regardless of the sizes of allocations it's part of.
+ */
+static
+UInt64 drawBytesUntilNextSample( MemoryTracker* memTracker )
+{
+    // 53 random bits mapped to (0, 1]
+    const double uniform = ( (double)( nextSamplingRandom( memTracker->sampledProfile ) >> 11 ) + 1.0 ) / 9007199254740992.0;
+    return (UInt64)( -log( uniform ) * (double)( memTracker->samplingIntervalInBytes ) ) + 1;
+}
+
+static
+void discardMemoryTrackerSampledProfile( MemoryTracker* memTracker )
+{
+    memTracker->samplingIntervalInBytes = 0;
+    memTracker->bytesUntilNextSample = 0;
+    memTracker->sampledLiveBlocksCount = 0;
+    if ( memTracker->sampledProfile != NULL )
+    {
+        free( memTracker->sampledProfile );
+        memTracker->sampledProfile = NULL;
+    }
+}
+
+void reconfigureMemoryTrackerSampling( MemoryTracker* memTracker, UInt64 newSamplingIntervalInBytes )
+{
+    ELASTIC_APM_ASSERT_VALID_MEMORY_TRACKER( memTracker );
+
+    if ( newSamplingIntervalInBytes == memTracker->samplingIntervalInBytes ) return;
+
+    if ( newSamplingIntervalInBytes == 0 )
+    {
+        // Samples taken so far are dropped - when sampling is enabled again it starts with an empty profile
+        // instead of reporting blocks that were freed while sampling was disabled as still in use
+        ELASTIC_APM_LOG_DEBUG( "Memory tracking sampling is disabled (interval was %" PRIu64 " bytes) - discarding sampled profile", memTracker->samplingIntervalInBytes );
+        discardMemoryTrackerSampledProfile( memTracker );
+        return;
+    }
+
+    if ( memTracker->sampledProfile == NULL )
+    {
+        // Profile is allocated directly with calloc so it is not tracked itself
+        MemoryTrackerSampledProfile* profile = (MemoryTrackerSampledProfile*)calloc( 1, sizeof( MemoryTrackerSampledProfile ) );
+        if ( profile == NULL )
+        {
+            ELASTIC_APM_LOG_ERROR( "Failed to allocate memory for sampled profile - memory tracking sampling is disabled" );
+            return;
+        }
+        profile->randomState = ( (UInt64)(uintptr_t)profile ) ^ UINT64_C( 0x9E3779B97F4A7C15 );
+        memTracker->sampledProfile = profile;
+    }
+
+    ELASTIC_APM_LOG_DEBUG( "Memory tracking sampling interval: %" PRIu64 " -> %" PRIu64 " (bytes)"
+                           , memTracker->samplingIntervalInBytes, newSamplingIntervalInBytes );
+
+    memTracker->samplingIntervalInBytes = newSamplingIntervalInBytes;
+    memTracker->bytesUntilNextSample = drawBytesUntilNextSample( memTracker );
+}
+
+static
+MemoryTrackerSampledCallSite* findOrAddSampledCallSite(
+        MemoryTrackerSampledProfile* profile,
+        void* const* stackTraceAddresses,
+        size_t stackTraceAddressesCount,
+        /* out */ size_t* callSiteIndex )
+{
+    const UInt64 hash = hashStackTrace( stackTraceAddresses, stackTraceAddressesCount );
+    const size_t mask = sampledCallSitesCapacity - 1;
+
+    for ( size_t i = (size_t)hash & mask, probesCount = 0 ; probesCount != sampledCallSitesCapacity ; i = ( i + 1 ) & mask, ++probesCount )
+    {
+        MemoryTrackerSampledCallSite* callSite = &( profile->callSites[ i ] );
+        if ( ! callSite->isUsed )
+        {
+            // Keep load factor below 3/4 so that probe sequences stay short
+            if ( profile->callSitesCount >= ( sampledCallSitesCapacity / 4 ) * 3 ) return NULL;
+
+            callSite->isUsed = true;
+            callSite->stackTraceHash = hash;
+            callSite->stackTraceAddressesCount = stackTraceAddressesCount;
+            memcpy( callSite->stackTraceAddresses, stackTraceAddresses, sizeof( void* ) * stackTraceAddressesCount );
+            ++profile->callSitesCount;
+            *callSiteIndex = i;
+            return callSite;
+        }
+
+        if ( callSite->stackTraceHash == hash
+             && callSite->stackTraceAddressesCount == stackTraceAddressesCount
+             && memcmp( callSite->stackTraceAddresses, stackTraceAddresses, sizeof( void* ) * stackTraceAddressesCount ) == 0 )
+        {
+            *callSiteIndex = i;
+            return callSite;
+        }
+    }
+
+    return NULL;
+}
+
+static
+size_t sampledLiveBlockHomeIndex( const void* allocatedBlock )
+{
+    return (size_t)( ( (UInt64)(uintptr_t)allocatedBlock * UINT64_C( 0x9E3779B97F4A7C15 ) ) >> 32 ) & ( sampledLiveBlocksCapacity - 1 );
+}
+
+void memoryTrackerRecordSample( MemoryTracker* memTracker, const void* allocatedBlock, size_t originallyRequestedSize )
+{
+    MemoryTrackerSampledProfile* profile = memTracker->sampledProfile;
+    if ( profile == NULL ) return;
+
+    memTracker->bytesUntilNextSample = drawBytesUntilNextSample( memTracker );
+
+    // Skip this function's own frame - allocation macros are expanded inline in the allocating function
+    static constexpr size_t numberOfFramesToSkip = 1;
+    void* stackTraceAddresses[ maxSampledStackTraceDepth + numberOfFramesToSkip ];
+    size_t stackTraceAddressesCount = ELASTIC_APM_CAPTURE_STACK_TRACE( &( stackTraceAddresses[ 0 ] ), ELASTIC_APM_STATIC_ARRAY_SIZE( stackTraceAddresses ) );
+    stackTraceAddressesCount = ( stackTraceAddressesCount > numberOfFramesToSkip ) ? ( stackTraceAddressesCount - numberOfFramesToSkip ) : 0;
+
+    size_t callSiteIndex = 0;
+    MemoryTrackerSampledCallSite* callSite = findOrAddSampledCallSite( profile, &( stackTraceAddresses[ numberOfFramesToSkip ] ), stackTraceAddressesCount, /* out */ &callSiteIndex );
+    if ( callSite == NULL )
+    {
+        ++profile->droppedSamplesCount;
+        return;
+    }
+
+    ++callSite->allocatedCount;
+    callSite->allocatedBytes += originallyRequestedSize;
+
+    // Keep load factor below 3/4 so that probe sequences stay short
+    if ( memTracker->sampledLiveBlocksCount >= ( sampledLiveBlocksCapacity / 4 ) * 3 )
+    {
+        ++profile->droppedSamplesCount;
+        return;
+    }
+
+    const size_t mask = sampledLiveBlocksCapacity - 1;
+    size_t i = sampledLiveBlockHomeIndex( allocatedBlock );
+    while ( profile->liveBlocks[ i ].allocatedBlock != NULL ) i = ( i + 1 ) & mask;
+    profile->liveBlocks[ i ] = MemoryTrackerSampledLiveBlock{ .allocatedBlock = allocatedBlock, .originallyRequestedSize = originallyRequestedSize, .callSiteIndex = callSiteIndex };
+    ++memTracker->sampledLiveBlocksCount;
+
+    ++callSite->inUseCount;
+    callSite->inUseBytes += originallyRequestedSize;
+}
+
+void memoryTrackerForgetSample( MemoryTracker* memTracker, const void* allocatedBlock )
+{
+    MemoryTrackerSampledProfile* profile = memTracker->sampledProfile;
+    if ( profile == NULL || allocatedBlock == NULL ) return;
+
+    const size_t mask = sampledLiveBlocksCapacity - 1;
+    size_t i = sampledLiveBlockHomeIndex( allocatedBlock );
+    for ( ;; i = ( i + 1 ) & mask )
+    {
+        if ( profile->liveBlocks[ i ].allocatedBlock == NULL ) return;
+        if ( profile->liveBlocks[ i ].allocatedBlock == allocatedBlock ) break;
+    }
+
+    MemoryTrackerSampledCallSite* callSite = &( profile->callSites[ profile->liveBlocks[ i ].callSiteIndex ] );
+    --callSite->inUseCount;
+    callSite->inUseBytes -= profile->liveBlocks[ i ].originallyRequestedSize;
+    --memTracker->sampledLiveBlocksCount;
+
+    // Backward shift deletion - move entries of the same probe sequence into the freed slot
+    for ( ;; )
+    {
+        profile->liveBlocks[ i ].allocatedBlock = NULL;
+        size_t j = i;
+        for ( ;; )
+        {
+            j = ( j + 1 ) & mask;
+            if ( profile->liveBlocks[ j ].allocatedBlock == NULL ) return;
+            const size_t home = sampledLiveBlockHomeIndex( profile->liveBlocks[ j ].allocatedBlock );
+            const bool isHomeInShiftedRange = ( i <= j ) ? ( i < home && home <= j ) : ( i < home || home <= j );
+            if ( ! isHomeInShiftedRange ) break;
+        }
+        profile->liveBlocks[ i ] = profile->liveBlocks[ j ];
+        i = j;
+    }
+}
+
+ResultCode memoryTrackerWriteSampledHeapProfile( MemoryTracker* memTracker, String filePath )
+{
+    ELASTIC_APM_ASSERT_VALID_MEMORY_TRACKER( memTracker );
+    ELASTIC_APM_ASSERT_VALID_PTR( filePath );
+
+    ResultCode resultCode;
+    FILE* file = NULL;
+    const MemoryTrackerSampledProfile* profile = memTracker->sampledProfile;
+    UInt64 totalInUseCount = 0;
+    UInt64 totalInUseBytes = 0;
+    UInt64 totalAllocatedCount = 0;
+    UInt64 totalAllocatedBytes = 0;
+
+    if ( profile == NULL )
+    {
+        ELASTIC_APM_LOG_ERROR( "Memory tracking sampling is not enabled - there is no heap profile to write" );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    {
+        int openFileErrNo = openFile( filePath, "w", /* out */ &file );
+        if ( openFileErrNo != 0 )
+        {
+            ELASTIC_APM_LOG_ERROR( "Failed to open file for heap profile; filePath: %s, errno: %d", filePath, openFileErrNo );
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+        }
+    }
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, sampledCallSitesCapacity )
+    {
+        const MemoryTrackerSampledCallSite* callSite = &( profile->callSites[ i ] );
+        if ( ! callSite->isUsed ) continue;
+        totalInUseCount += callSite->inUseCount;
+        totalInUseBytes += callSite->inUseBytes;
+        totalAllocatedCount += callSite->allocatedCount;
+        totalAllocatedBytes += callSite->allocatedBytes;
+    }
+
+    fprintf( file, "heap profile: %" PRIu64 ": %" PRIu64 " [%" PRIu64 ": %" PRIu64 "] @ heap_v2/%" PRIu64 "\n"
+             , totalInUseCount, totalInUseBytes, totalAllocatedCount, totalAllocatedBytes, memTracker->samplingIntervalInBytes );
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, sampledCallSitesCapacity )
+    {
+        const MemoryTrackerSampledCallSite* callSite = &( profile->callSites[ i ] );
+        if ( ! callSite->isUsed ) continue;
+        fprintf( file, "%" PRIu64 ": %" PRIu64 " [%" PRIu64 ": %" PRIu64 "] @"
+                 , callSite->inUseCount, callSite->inUseBytes, callSite->allocatedCount, callSite->allocatedBytes );
+        ELASTIC_APM_FOR_EACH_INDEX( frameIndex, callSite->stackTraceAddressesCount )
+            fprintf( file, " 0x%" PRIxPTR, (uintptr_t)( callSite->stackTraceAddresses[ frameIndex ] ) );
+        fprintf( file, "\n" );
+    }
+
+    #ifndef PHP_WIN32
+    // pprof needs memory mappings to symbolize addresses
+    {
+        FILE* procSelfMapsFile = NULL;
+        if ( openFile( "/proc/self/maps", "r", /* out */ &procSelfMapsFile ) == 0 )
+        {
+            fprintf( file, "\nMAPPED_LIBRARIES:\n" );
+            char buffer[ 4096 ];
+            size_t readCount;
+            while ( ( readCount = fread( buffer, 1, sizeof( buffer ), procSelfMapsFile ) ) != 0 )
+                fwrite( buffer, 1, readCount, file );
+            fclose( procSelfMapsFile );
+        }
+    }
+    #endif
+
+    ELASTIC_APM_LOG_DEBUG( "Wrote sampled heap profile; filePath: %s, call sites: %" PRIu64 ", dropped samples: %" PRIu64
+                           , filePath, (UInt64)profile->callSitesCount, profile->droppedSamplesCount );
+
+    resultCode = resultSuccess;
+
+    finally:
+    if ( file != NULL )
+    {
+        fclose( file );
+    }
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
 void memoryTrackerRequestShutdown( MemoryTracker* memTracker )
 {
     verifyBalanceIsZero(
@@ -465,6 +994,18 @@ void destructMemoryTracker( MemoryTracker* memTracker )
     }
 
     memTracker->level = memoryTrackingLevel_off;
+
+    // Blocks that are still allocated (if any) are not tracked any more after the level is set to off
+    // so interned stack traces are not referenced by anyone
+    ELASTIC_APM_FOR_EACH_INDEX( i, memTracker->stackTraces.capacity )
+    {
+        free( (void*)( memTracker->stackTraces.slots[ i ] ) );
+    }
+    destructMemoryTrackerHashTable( &memTracker->stackTraces );
+    destructMemoryTrackerHashTable( &memTracker->allocatedPersistentBlocks );
+    destructMemoryTrackerHashTable( &memTracker->allocatedRequestScopedBlocks );
+
+    discardMemoryTrackerSampledProfile( memTracker );
 }
 
 MemoryTrackingLevel internalChecksToMemoryTrackingLevel( InternalChecksLevel internalChecksLevel )
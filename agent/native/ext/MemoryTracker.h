@@ -24,9 +24,9 @@
 #include "basic_types.h"
 #include "StringView.h"
 #include "basic_macros.h"
-#include "IntrusiveDoublyLinkedList.h"
 #include "internal_checks.h"
 #include "TextOutputStream_forward_decl.h"
+#include "ResultCode.h"
 
 #ifndef ELASTIC_APM_MEMORY_TRACKING_ENABLED_01
 #   if defined( ELASTIC_APM_MEMORY_TRACKING_ENABLED ) && ( ELASTIC_APM_MEMORY_TRACKING_ENABLED == 0 )
@@ -77,25 +77,65 @@ extern const char* memoryTrackingLevelNames[ numberOfMemoryTrackingLevels ];
 
 MemoryTrackingLevel internalChecksToMemoryTrackingLevel( InternalChecksLevel internalChecksLevel );
 
+/**
+ * Open addressing hash table of pointers (NULL marks a free slot).
+ * Its storage is allocated directly with malloc so it is not tracked itself.
+ */
+struct MemoryTrackerHashTable
+{
+    const void** slots;
+    size_t capacity; // always 0 or a power of 2
+    size_t count;
+};
+typedef struct MemoryTrackerHashTable MemoryTrackerHashTable;
+
+struct MemoryTrackerSampledProfile;
+typedef struct MemoryTrackerSampledProfile MemoryTrackerSampledProfile;
+
 struct MemoryTracker
 {
     MemoryTrackingLevel level;
     bool abortOnMemoryLeak;
 
     UInt64 allocatedPersistent;
-    IntrusiveDoublyLinkedList allocatedPersistentBlocks;
+    MemoryTrackerHashTable allocatedPersistentBlocks;
     UInt64 allocatedRequestScoped;
-    IntrusiveDoublyLinkedList allocatedRequestScopedBlocks;
+    MemoryTrackerHashTable allocatedRequestScopedBlocks;
+    /// Captured stack traces are interned and shared by all the blocks allocated from the same call stack
+    MemoryTrackerHashTable stackTraces;
+    UInt64 nextAllocationIndex;
+
+    /**
+     * Sampling mode is independent of level and is intended to be cheap enough for production.
+     * On average one allocation per samplingIntervalInBytes bytes is sampled (Poisson process)
+     * and its C call stack is aggregated in sampledProfile.
+     * 0 means sampling is disabled.
+     */
+    UInt64 samplingIntervalInBytes;
+    UInt64 bytesUntilNextSample;
+    size_t sampledLiveBlocksCount;
+    MemoryTrackerSampledProfile* sampledProfile;
 };
 typedef struct MemoryTracker MemoryTracker;
 
+static inline
+void assertValidMemoryTrackerHashTable( const MemoryTrackerHashTable* table )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( table );
+    ELASTIC_APM_ASSERT( ( table->capacity == 0 ) == ( table->slots == NULL )
+                        , "capacity: %" PRIu64 ", slots: %p", (UInt64)( table->capacity ), table->slots );
+    ELASTIC_APM_ASSERT( ( table->capacity & ( table->capacity - 1 ) ) == 0, "capacity: %" PRIu64, (UInt64)( table->capacity ) );
+    ELASTIC_APM_ASSERT_LE_UINT64( table->count, table->capacity );
+}
+
 static inline
 void assertValidMemoryTracker( MemoryTracker* memTracker )
 {
     ELASTIC_APM_ASSERT_VALID_PTR( memTracker );
     ELASTIC_APM_ASSERT_VALID_MEMORY_TRACKING_LEVEL( memTracker->level );
-    ELASTIC_APM_ASSERT_VALID_INTRUSIVE_LINKED_LIST( &memTracker->allocatedPersistentBlocks );
-    ELASTIC_APM_ASSERT_VALID_INTRUSIVE_LINKED_LIST( &memTracker->allocatedRequestScopedBlocks );
+    assertValidMemoryTrackerHashTable( &memTracker->allocatedPersistentBlocks );
+    assertValidMemoryTrackerHashTable( &memTracker->allocatedRequestScopedBlocks );
+    assertValidMemoryTrackerHashTable( &memTracker->stackTraces );
 }
 
 #define ELASTIC_APM_ASSERT_VALID_MEMORY_TRACKER( memTracker ) \
@@ -129,12 +169,48 @@ void reconfigureMemoryTracker(
     memTracker->abortOnMemoryLeak = newConfiguredAbortOnMemoryLeak;
 }
 
+static inline
+bool isMemoryTrackerSamplingEnabled( MemoryTracker* memTracker )
+{
+    return memTracker->samplingIntervalInBytes != 0;
+}
+
+void reconfigureMemoryTrackerSampling( MemoryTracker* memTracker, UInt64 newSamplingIntervalInBytes );
+
+void memoryTrackerRecordSample( MemoryTracker* memTracker, const void* allocatedBlock, size_t originallyRequestedSize );
+void memoryTrackerForgetSample( MemoryTracker* memTracker, const void* allocatedBlock );
+
+static inline
+void memoryTrackerSampledAfterAlloc( MemoryTracker* memTracker, const void* allocatedBlock, size_t originallyRequestedSize )
+{
+    if ( memTracker->bytesUntilNextSample > originallyRequestedSize )
+    {
+        memTracker->bytesUntilNextSample -= originallyRequestedSize;
+        return;
+    }
+
+    memoryTrackerRecordSample( memTracker, allocatedBlock, originallyRequestedSize );
+}
+
+static inline
+void memoryTrackerSampledBeforeFree( MemoryTracker* memTracker, const void* allocatedBlock )
+{
+    if ( memTracker->sampledLiveBlocksCount == 0 ) return;
+
+    memoryTrackerForgetSample( memTracker, allocatedBlock );
+}
+
+/**
+ * Writes sampled allocations aggregated per call site in the legacy text heap profile format (heap_v2)
+ * understood by pprof (for example `pprof -http=: <path to php binary> <filePath>`)
+ */
+ResultCode memoryTrackerWriteSampledHeapProfile( MemoryTracker* memTracker, String filePath );
+
 void constructMemoryTracker( MemoryTracker* memTracker );
 void memoryTrackerRequestInit( MemoryTracker* memTracker );
 size_t memoryTrackerCalcSizeToAlloc(
         MemoryTracker* memTracker,
-        size_t originallyRequestedSize,
-        size_t stackTraceAddressesCount );
+        size_t originallyRequestedSize );
 void memoryTrackerAfterAlloc(
         MemoryTracker* memTracker,
         const void* allocatedBlock,
@@ -97,6 +97,9 @@ void ensureMemoryTrackerHasLatestConfig( MemoryTracker* memTracker, const Config
     }
 
     reconfigureMemoryTracker( memTracker, newLevel, config->abortOnMemoryLeak );
+
+    const Int64 samplingIntervalInBytes = sizeToBytes( config->memoryTrackingSamplingInterval );
+    reconfigureMemoryTrackerSampling( memTracker, samplingIntervalInBytes > 0 ? (UInt64)samplingIntervalInBytes : 0 );
 }
 
 #endif // #if ( ELASTIC_APM_MEMORY_TRACKING_ENABLED_01 != 0 )
@@ -157,16 +160,20 @@ ResultCode ensureLoggerInitialConfigIsLatest( Tracer* tracer )
     goto finally;
 }
 
-ResultCode ensureAllComponentsHaveLatestConfig( Tracer* tracer )
+ResultCode ensureAllComponentsHaveLatestConfig( Tracer* tracer, bool* didConfigChange )
 {
     ELASTIC_APM_ASSERT_VALID_PTR( tracer );
 
     ResultCode resultCode;
     const ConfigSnapshot* config = NULL;
-    bool didConfigChange;
+    bool didConfigChangeLocal = false;
 
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( ensureConfigManagerHasLatestConfig( tracer->configManager, &didConfigChange ) );
-    if ( ! didConfigChange )
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( ensureConfigManagerHasLatestConfig( tracer->configManager, &didConfigChangeLocal ) );
+    if ( didConfigChange != NULL )
+    {
+        *didConfigChange = didConfigChangeLocal;
+    }
+    if ( ! didConfigChangeLocal )
     {
         resultCode = resultSuccess;
         goto finally;
@@ -56,7 +56,7 @@ typedef struct Tracer Tracer;
 
 ResultCode constructTracer( Tracer* tracer );
 ResultCode ensureLoggerInitialConfigIsLatest( Tracer* tracer );
-ResultCode ensureAllComponentsHaveLatestConfig( Tracer* tracer );
+ResultCode ensureAllComponentsHaveLatestConfig( Tracer* tracer, bool* didConfigChange = nullptr );
 const ConfigSnapshot* getTracerCurrentConfigSnapshot( const Tracer* tracer );
 void moveTracerToFailedState( Tracer* tracer );
 bool isTracerInFunctioningState( const Tracer* tracer );
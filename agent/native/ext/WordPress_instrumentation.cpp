@@ -22,6 +22,7 @@
 #include "AST_instrumentation.h"
 #include "util.h"
 #include "TextOutputStream.h"
+#include "PathSuffixIndex.h"
 
 #define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_AUTO_INSTRUMENT
 
@@ -45,6 +46,9 @@ static StringView g_filesToTransformAstPathSuffix[ number_of_WordPress_instrumen
 
 #undef ELASTIC_APM_WP_INCLUDES_PREFIX
 
+// Maps path suffix to WordPressInstrumentationFileToTransformAstIndex - built once on module init
+static elasticapm::php::PathSuffixIndex g_filesToTransformAstIndex;
+
 struct WordPressInstrumentationRequestScopedState
 {
     bool isInFailedMode;
@@ -66,6 +70,20 @@ void wordPressInstrumentationSwitchToFailedMode( String dbgCalledFromFunc )
     g_wordPressInstrumentationRequestScopedState.isInFailedMode = true;
 }
 
+void wordPressInstrumentationOnModuleInit()
+{
+    g_filesToTransformAstIndex.clear();
+    ELASTIC_APM_FOR_EACH_INDEX( i, number_of_WordPress_instrumentation_files_to_transform_AST )
+    {
+        g_filesToTransformAstIndex.add( std::string_view( g_filesToTransformAstPathSuffix[ i ].begin, g_filesToTransformAstPathSuffix[ i ].length ), i );
+    }
+}
+
+void wordPressInstrumentationOnModuleShutdown()
+{
+    g_filesToTransformAstIndex.clear();
+}
+
 void wordPressInstrumentationOnRequestInit()
 {
     ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
@@ -202,21 +220,14 @@ bool wordPressInstrumentationShouldTransformAstInFile( StringView compiledFileFu
         return false;
     }
 
-    ELASTIC_APM_FOR_EACH_INDEX( i, number_of_WordPress_instrumentation_files_to_transform_AST )
+    std::optional<size_t> fileIndex = g_filesToTransformAstIndex.findLongestSuffix( std::string_view( compiledFileFullPath.begin, compiledFileFullPath.length ) );
+    if ( ! fileIndex || g_wordPressInstrumentationRequestScopedState.seenFile[ *fileIndex ] )
     {
-        if ( g_wordPressInstrumentationRequestScopedState.seenFile[ i ] )
-        {
-            continue;
-        }
-
-        if ( isStringViewSuffix( compiledFileFullPath, g_filesToTransformAstPathSuffix[ i ] ) )
-        {
-            *pFileIndex = i;
-            return true;
-        }
+        return false;
     }
 
-    return false;
+    *pFileIndex = *fileIndex;
+    return true;
 }
 
 typedef ResultCode (* WordPressTransformAstForFileFunc )( zend_ast* ast );
@@ -24,6 +24,9 @@ extern "C" {
 }
 #include "StringView.h"
 
+void wordPressInstrumentationOnModuleInit();
+void wordPressInstrumentationOnModuleShutdown();
+
 void wordPressInstrumentationOnRequestInit();
 void wordPressInstrumentationOnRequestShutdown();
 
@@ -31,6 +31,7 @@
 #include "util_for_PHP.h"
 #include "basic_macros.h"
 #include "backend_comm_backoff.h"
+#include "backend_comm_data_to_send_pool.h"
 
 #include <string_view>
 
@@ -106,46 +107,6 @@ String streamLibCurlInfo( TextOutputStream* txtOutStream )
     return textOutputStreamEndEntry( &txtOutStreamStateOnEntryStart, txtOutStream );
 }
 
-static ResultCode dupMallocStringView( StringView src, StringBuffer* dst )
-{
-    ELASTIC_APM_ASSERT_VALID_PTR( src.begin );
-    ELASTIC_APM_ASSERT_VALID_PTR( dst );
-    ELASTIC_APM_ASSERT_PTR_IS_NULL( dst->begin );
-    ELASTIC_APM_ASSERT( dst->size == 0, "" );
-
-    ResultCode resultCode;
-    char* memBlockForDup = NULL;
-
-    ELASTIC_APM_MALLOC_STRING_IF_FAILED_GOTO( /* length */ src.length, /* out */ memBlockForDup );
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( safeStringCopy( src, /* dstBuf */ memBlockForDup, /* dstBufCapacity */ src.length + 1 ) );
-
-    dst->begin = memBlockForDup;
-    memBlockForDup = NULL;
-    dst->size = src.length + 1;
-
-    resultCode = resultSuccess;
-    finally:
-    return resultCode;
-
-    failure:
-    ELASTIC_APM_FREE_STRING_AND_SET_TO_NULL( /* length */ src.length, /* out */ memBlockForDup );
-    goto finally;
-}
-
-static void freeMallocedStringBuffer( /* in,out */ StringBuffer* strBuf )
-{
-    ELASTIC_APM_ASSERT_VALID_PTR( strBuf );
-    if ( strBuf->begin != NULL )
-    {
-        ELASTIC_APM_FREE_AND_SET_TO_NULL( char, strBuf->size, /* in,out */ strBuf->begin );
-        ELASTIC_APM_ZERO_STRUCT( strBuf );
-    }
-    else
-    {
-        ELASTIC_APM_ASSERT( strBuf->size == 0, "" );
-    }
-}
-
 // Log response
 static
 size_t logResponse( void* data, size_t unusedSizeParam, size_t dataSize, void* unusedUserDataParam )
@@ -543,30 +504,6 @@ ResultCode syncSendEventsToApmServer( const ConfigSnapshot* config, StringView u
 
 #undef ELASTIC_APM_CURL_EASY_SETOPT
 
-struct DataToSendNode;
-typedef struct DataToSendNode DataToSendNode;
-
-struct DataToSendNode
-{
-    UInt64 id;
-
-    DataToSendNode* prev;
-    DataToSendNode* next;
-
-    StringBuffer userAgentHttpHeader;
-    StringBuffer serializedEvents;
-};
-
-static void freeDataToSendNode( DataToSendNode** nodeOutPtr )
-{
-    ELASTIC_APM_ASSERT_VALID_IN_PTR_TO_PTR( nodeOutPtr );
-
-    freeMallocedStringBuffer( /* in,out */ &( (*nodeOutPtr)->userAgentHttpHeader ) );
-    freeMallocedStringBuffer( /* in,out */ &( (*nodeOutPtr)->serializedEvents ) );
-    ELASTIC_APM_ZERO_STRUCT( *nodeOutPtr );
-    ELASTIC_APM_FREE_INSTANCE_AND_SET_TO_NULL( DataToSendNode, /* in,out */ *nodeOutPtr );
-}
-
 struct DataToSendQueue
 {
     DataToSendNode head;
@@ -585,6 +522,7 @@ static void initDataToSendQueue( DataToSendQueue* dataQueue )
 }
 
 static ResultCode addCopyToDataToSendQueue( DataToSendQueue* dataQueue
+                                            , DataToSendPool* pool
                                             , UInt64 id
                                             , StringView userAgentHttpHeader
                                             , StringView serializedEvents )
@@ -594,11 +532,10 @@ static ResultCode addCopyToDataToSendQueue( DataToSendQueue* dataQueue
     ResultCode resultCode;
     DataToSendNode* newNode = NULL;
 
-    ELASTIC_APM_MALLOC_INSTANCE_IF_FAILED_GOTO( DataToSendNode, /* out */ newNode );
-    ELASTIC_APM_ZERO_STRUCT( newNode );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( acquireDataToSendPoolNode( pool, /* out */ &newNode ) );
 
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( dupMallocStringView( userAgentHttpHeader, /* out */ &( newNode->userAgentHttpHeader ) ) );
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( dupMallocStringView( serializedEvents, /* out */ &( newNode->serializedEvents ) ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( acquireDataToSendPoolBuffer( pool, userAgentHttpHeader, /* out */ &( newNode->userAgentHttpHeader ) ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( acquireDataToSendPoolBuffer( pool, serializedEvents, /* out */ &( newNode->serializedEvents ) ) );
 
     resultCode = resultSuccess;
 
@@ -613,7 +550,10 @@ static ResultCode addCopyToDataToSendQueue( DataToSendQueue* dataQueue
     return resultCode;
 
     failure:
-    freeDataToSendNode( &newNode );
+    if ( newNode != NULL )
+    {
+        releaseDataToSendPoolNode( pool, &newNode );
+    }
     goto finally;
 }
 
@@ -632,7 +572,7 @@ DataToSendNode* getFirstNodeInDataToSendQueue( DataToSendQueue* dataQueue )
     return isDataToSendQueueEmpty( dataQueue ) ? NULL : dataQueue->head.next;
 }
 
-size_t removeFirstNodeInDataToSendQueue( DataToSendQueue* dataQueue )
+size_t removeFirstNodeInDataToSendQueue( DataToSendQueue* dataQueue, DataToSendPool* pool )
 {
     ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
     ELASTIC_APM_ASSERT( ! isDataToSendQueueEmpty( dataQueue ), "" );
@@ -645,18 +585,23 @@ size_t removeFirstNodeInDataToSendQueue( DataToSendQueue* dataQueue )
     dataQueue->head.next = newFirstNode;
     newFirstNode->prev = &( dataQueue->head );
 
-    freeDataToSendNode( &firstNode );
+    releaseDataToSendPoolNode( pool, &firstNode );
+
+    if ( isDataToSendQueueEmpty( dataQueue ) )
+    {
+        trimDataToSendPool( pool );
+    }
 
     return firstNodeDataSize;
 }
 
-static void freeDataToSendQueue( DataToSendQueue* dataQueue )
+static void freeDataToSendQueue( DataToSendQueue* dataQueue, DataToSendPool* pool )
 {
     ELASTIC_APM_ASSERT_VALID_PTR( dataQueue );
 
     while ( ! isDataToSendQueueEmpty( dataQueue ) )
     {
-        removeFirstNodeInDataToSendQueue( dataQueue );
+        removeFirstNodeInDataToSendQueue( dataQueue, pool );
     }
 }
 
@@ -668,6 +613,7 @@ struct BackgroundBackendComm
     ConditionVariable* condVar;
     Thread* thread;
     DataToSendQueue dataToSendQueue;
+    DataToSendPool dataToSendPool;
     size_t dataToSendTotalSize;
     size_t nextEventsBatchId;
     bool shouldExit;
@@ -824,7 +770,7 @@ ResultCode backgroundBackendCommThreadFunc_removeFirstEventsBatchAndUpdateSnapsh
     size_t firstNodeDataSize = 0;
     ELASTIC_APM_BACKGROUND_BACKEND_COMM_DO_UNDER_LOCK_PROLOG()
 
-    firstNodeDataSize = removeFirstNodeInDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) );
+    firstNodeDataSize = removeFirstNodeInDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ), &( backgroundBackendComm->dataToSendPool ) );
     backgroundBackendComm->dataToSendTotalSize -= firstNodeDataSize;
 
     backgroundBackendCommThreadFunc_underLockCopySharedStateToSnapshot( backgroundBackendComm, /* out */ sharedStateSnapshot );
@@ -1020,7 +966,8 @@ ResultCode unwindBackgroundBackendComm( BackgroundBackendComm** backgroundBacken
     }
 
     resultCode = resultSuccess;
-    freeDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) );
+    freeDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ), &( backgroundBackendComm->dataToSendPool ) );
+    destructDataToSendPool( &( backgroundBackendComm->dataToSendPool ) );
     ELASTIC_APM_FREE_INSTANCE_AND_SET_TO_NULL( BackgroundBackendComm, *backgroundBackendCommOutPtr );
 
     finally:
@@ -1057,6 +1004,7 @@ ResultCode newBackgroundBackendComm( const ConfigSnapshot* config, BackgroundBac
     backgroundBackendComm->mutex = NULL;
     backgroundBackendComm->thread = NULL;
     initDataToSendQueue( &( backgroundBackendComm->dataToSendQueue ) );
+    initDataToSendPool( &( backgroundBackendComm->dataToSendPool ) );
     backgroundBackendComm->dataToSendTotalSize = 0;
     backgroundBackendComm->nextEventsBatchId = 1;
     backgroundBackendComm->shouldExit = false;
@@ -1194,6 +1142,7 @@ ResultCode enqueueEventsToSendToApmServer( StringView userAgentHttpHeader, Strin
     id = backgroundBackendComm->nextEventsBatchId;
     ELASTIC_APM_CALL_IF_FAILED_GOTO(
             addCopyToDataToSendQueue( &( backgroundBackendComm->dataToSendQueue )
+                                      , &( backgroundBackendComm->dataToSendPool )
                                       , id
                                       , userAgentHttpHeader
                                       , serializedEvents ) );
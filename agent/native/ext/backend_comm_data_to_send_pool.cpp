@@ -0,0 +1,276 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_data_to_send_pool.h"
+#include <inttypes.h>
+#include "basic_macros.h"
+#include "elastic_apm_alloc.h"
+#include "elastic_apm_assert.h"
+#include "log.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+void initDataToSendPool( DataToSendPool* pool )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( pool );
+
+    ELASTIC_APM_ZERO_STRUCT( pool );
+}
+
+static inline
+size_t dataToSendPoolBufferSizeClassToSize( size_t sizeClass )
+{
+    return ELASTIC_APM_DATA_TO_SEND_POOL_MIN_BUFFER_SIZE << sizeClass;
+}
+
+/**
+ * @return ELASTIC_APM_DATA_TO_SEND_POOL_NUMBER_OF_BUFFER_SIZE_CLASSES if the buffer is too large to be pooled
+ */
+static
+size_t dataToSendPoolBufferSizeToSizeClass( size_t bufferSize )
+{
+    size_t sizeClass = 0;
+    while ( sizeClass < ELASTIC_APM_DATA_TO_SEND_POOL_NUMBER_OF_BUFFER_SIZE_CLASSES && dataToSendPoolBufferSizeClassToSize( sizeClass ) < bufferSize )
+    {
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+static
+void dataToSendPoolFreeBuffersInSizeClass( DataToSendPool* pool, size_t sizeClass, size_t numberOfBuffersToFree )
+{
+    const size_t bufferSize = dataToSendPoolBufferSizeClassToSize( sizeClass );
+    ELASTIC_APM_FOR_EACH_INDEX( i, numberOfBuffersToFree )
+    {
+        DataToSendPoolFreeBuffer* freeBuffer = pool->freeBuffers[ sizeClass ];
+        ELASTIC_APM_ASSERT_VALID_PTR( freeBuffer );
+        pool->freeBuffers[ sizeClass ] = freeBuffer->next;
+        --pool->freeBuffersCount[ sizeClass ];
+        pool->freeBuffersTotalSize -= bufferSize;
+        ELASTIC_APM_FREE_AND_SET_TO_NULL( DataToSendPoolFreeBuffer, bufferSize, /* in,out */ freeBuffer );
+    }
+}
+
+static
+void dataToSendPoolFreeNodes( DataToSendPool* pool, size_t numberOfNodesToFree )
+{
+    ELASTIC_APM_FOR_EACH_INDEX( i, numberOfNodesToFree )
+    {
+        DataToSendNode* freeNode = pool->freeNodes;
+        ELASTIC_APM_ASSERT_VALID_PTR( freeNode );
+        pool->freeNodes = freeNode->next;
+        --pool->freeNodesCount;
+        ELASTIC_APM_FREE_INSTANCE_AND_SET_TO_NULL( DataToSendNode, /* in,out */ freeNode );
+    }
+}
+
+ResultCode acquireDataToSendPoolBuffer( DataToSendPool* pool, StringView src, /* out */ StringBuffer* dst )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( pool );
+    ELASTIC_APM_ASSERT_VALID_PTR( src.begin );
+    ELASTIC_APM_ASSERT_VALID_PTR( dst );
+    ELASTIC_APM_ASSERT_PTR_IS_NULL( dst->begin );
+    ELASTIC_APM_ASSERT( dst->size == 0, "" );
+
+    ResultCode resultCode;
+    char* buffer = NULL;
+    // +1 for terminating '\0'
+    const size_t requiredSize = src.length + 1;
+    const size_t sizeClass = dataToSendPoolBufferSizeToSizeClass( requiredSize );
+    const bool isPooled = ( sizeClass != ELASTIC_APM_DATA_TO_SEND_POOL_NUMBER_OF_BUFFER_SIZE_CLASSES );
+    const size_t bufferSize = isPooled ? dataToSendPoolBufferSizeClassToSize( sizeClass ) : requiredSize;
+
+    if ( isPooled && pool->freeBuffers[ sizeClass ] != NULL )
+    {
+        DataToSendPoolFreeBuffer* freeBuffer = pool->freeBuffers[ sizeClass ];
+        pool->freeBuffers[ sizeClass ] = freeBuffer->next;
+        --pool->freeBuffersCount[ sizeClass ];
+        pool->freeBuffersTotalSize -= bufferSize;
+        buffer = (char*)freeBuffer;
+    }
+    else
+    {
+        ELASTIC_APM_MALLOC_IF_FAILED_GOTO( char, bufferSize, /* out */ buffer );
+    }
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( safeStringCopy( src, /* dstBuf */ buffer, /* dstBufCapacity */ bufferSize ) );
+
+    dst->begin = buffer;
+    buffer = NULL;
+    dst->size = requiredSize;
+
+    ++pool->buffersInUseCount;
+    if ( pool->buffersInUseCount > pool->buffersInUseHighWaterMark )
+    {
+        pool->buffersInUseHighWaterMark = pool->buffersInUseCount;
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    ELASTIC_APM_FREE_AND_SET_TO_NULL( char, bufferSize, /* in,out */ buffer );
+    goto finally;
+}
+
+void releaseDataToSendPoolBuffer( DataToSendPool* pool, /* in,out */ StringBuffer* strBuf )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( pool );
+    ELASTIC_APM_ASSERT_VALID_PTR( strBuf );
+
+    if ( strBuf->begin == NULL )
+    {
+        ELASTIC_APM_ASSERT( strBuf->size == 0, "" );
+        return;
+    }
+
+    ELASTIC_APM_ASSERT( pool->buffersInUseCount > 0, "" );
+    --pool->buffersInUseCount;
+
+    const size_t sizeClass = dataToSendPoolBufferSizeToSizeClass( strBuf->size );
+    const bool isPooled = ( sizeClass != ELASTIC_APM_DATA_TO_SEND_POOL_NUMBER_OF_BUFFER_SIZE_CLASSES );
+    const size_t bufferSize = isPooled ? dataToSendPoolBufferSizeClassToSize( sizeClass ) : strBuf->size;
+
+    if ( isPooled && pool->freeBuffersTotalSize + bufferSize <= ELASTIC_APM_DATA_TO_SEND_POOL_MAX_RETAINED_BUFFERS_TOTAL_SIZE )
+    {
+        DataToSendPoolFreeBuffer* freeBuffer = (DataToSendPoolFreeBuffer*)( strBuf->begin );
+        freeBuffer->next = pool->freeBuffers[ sizeClass ];
+        pool->freeBuffers[ sizeClass ] = freeBuffer;
+        ++pool->freeBuffersCount[ sizeClass ];
+        pool->freeBuffersTotalSize += bufferSize;
+    }
+    else
+    {
+        ELASTIC_APM_FREE_AND_SET_TO_NULL( char, bufferSize, /* in,out */ strBuf->begin );
+    }
+
+    ELASTIC_APM_ZERO_STRUCT( strBuf );
+}
+
+ResultCode acquireDataToSendPoolNode( DataToSendPool* pool, /* out */ DataToSendNode** nodeOut )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( pool );
+    ELASTIC_APM_ASSERT_VALID_OUT_PTR_TO_PTR( nodeOut );
+
+    ResultCode resultCode;
+    DataToSendNode* node = NULL;
+
+    if ( pool->freeNodes != NULL )
+    {
+        node = pool->freeNodes;
+        pool->freeNodes = node->next;
+        --pool->freeNodesCount;
+    }
+    else
+    {
+        ELASTIC_APM_MALLOC_INSTANCE_IF_FAILED_GOTO( DataToSendNode, /* out */ node );
+    }
+    ELASTIC_APM_ZERO_STRUCT( node );
+
+    ++pool->nodesInUseCount;
+    if ( pool->nodesInUseCount > pool->nodesInUseHighWaterMark )
+    {
+        pool->nodesInUseHighWaterMark = pool->nodesInUseCount;
+    }
+
+    *nodeOut = node;
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+void releaseDataToSendPoolNode( DataToSendPool* pool, DataToSendNode** nodeOutPtr )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( pool );
+    ELASTIC_APM_ASSERT_VALID_IN_PTR_TO_PTR( nodeOutPtr );
+
+    DataToSendNode* node = *nodeOutPtr;
+
+    releaseDataToSendPoolBuffer( pool, /* in,out */ &( node->userAgentHttpHeader ) );
+    releaseDataToSendPoolBuffer( pool, /* in,out */ &( node->serializedEvents ) );
+    ELASTIC_APM_ZERO_STRUCT( node );
+
+    ELASTIC_APM_ASSERT( pool->nodesInUseCount > 0, "" );
+    --pool->nodesInUseCount;
+
+    if ( pool->freeNodesCount < ELASTIC_APM_DATA_TO_SEND_POOL_MAX_RETAINED_NODES )
+    {
+        node->next = pool->freeNodes;
+        pool->freeNodes = node;
+        ++pool->freeNodesCount;
+    }
+    else
+    {
+        ELASTIC_APM_FREE_INSTANCE_AND_SET_TO_NULL( DataToSendNode, /* in,out */ node );
+    }
+
+    *nodeOutPtr = NULL;
+}
+
+void trimDataToSendPool( DataToSendPool* pool )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( pool );
+
+    size_t freeBuffersCount = 0;
+    ELASTIC_APM_FOR_EACH_INDEX( sizeClass, ELASTIC_APM_DATA_TO_SEND_POOL_NUMBER_OF_BUFFER_SIZE_CLASSES )
+    {
+        freeBuffersCount += pool->freeBuffersCount[ sizeClass ];
+    }
+
+    for ( size_t sizeClass = ELASTIC_APM_DATA_TO_SEND_POOL_NUMBER_OF_BUFFER_SIZE_CLASSES
+          ; sizeClass != 0 && freeBuffersCount > pool->buffersInUseHighWaterMark
+          ; --sizeClass )
+    {
+        size_t numberOfBuffersToFree = freeBuffersCount - pool->buffersInUseHighWaterMark;
+        if ( numberOfBuffersToFree > pool->freeBuffersCount[ sizeClass - 1 ] )
+        {
+            numberOfBuffersToFree = pool->freeBuffersCount[ sizeClass - 1 ];
+        }
+        dataToSendPoolFreeBuffersInSizeClass( pool, sizeClass - 1, numberOfBuffersToFree );
+        freeBuffersCount -= numberOfBuffersToFree;
+    }
+
+    if ( pool->freeNodesCount > pool->nodesInUseHighWaterMark )
+    {
+        dataToSendPoolFreeNodes( pool, pool->freeNodesCount - pool->nodesInUseHighWaterMark );
+    }
+
+    pool->buffersInUseHighWaterMark = pool->buffersInUseCount;
+    pool->nodesInUseHighWaterMark = pool->nodesInUseCount;
+}
+
+void destructDataToSendPool( DataToSendPool* pool )
+{
+    ELASTIC_APM_ASSERT_VALID_PTR( pool );
+    ELASTIC_APM_ASSERT( pool->buffersInUseCount == 0, "buffersInUseCount: %" PRIu64, (UInt64) pool->buffersInUseCount );
+    ELASTIC_APM_ASSERT( pool->nodesInUseCount == 0, "nodesInUseCount: %" PRIu64, (UInt64) pool->nodesInUseCount );
+
+    ELASTIC_APM_FOR_EACH_INDEX( sizeClass, ELASTIC_APM_DATA_TO_SEND_POOL_NUMBER_OF_BUFFER_SIZE_CLASSES )
+    {
+        dataToSendPoolFreeBuffersInSizeClass( pool, sizeClass, pool->freeBuffersCount[ sizeClass ] );
+    }
+    dataToSendPoolFreeNodes( pool, pool->freeNodesCount );
+
+    ELASTIC_APM_ZERO_STRUCT( pool );
+}
@@ -0,0 +1,94 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+#include "basic_types.h"
+#include "ResultCode.h"
+#include "StringView.h"
+#include "util.h"
+
+struct DataToSendNode;
+typedef struct DataToSendNode DataToSendNode;
+
+struct DataToSendNode
+{
+    UInt64 id;
+
+    DataToSendNode* prev;
+    DataToSendNode* next;
+
+    StringBuffer userAgentHttpHeader;
+    StringBuffer serializedEvents;
+};
+
+/**
+ * Nodes and payload buffers are recycled instead of being freed by the background thread
+ * and allocated again by the PHP thread on the next batch.
+ * Buffers are kept in free lists per power-of-two size class.
+ * Buffers larger than the largest size class are not pooled.
+ *
+ * Free lists are trimmed down to the high-water mark of blocks in use since the previous trim
+ * every time the queue becomes empty, so memory retained by the pool follows recent demand.
+ *
+ * DataToSendPool is accessed only under BackgroundBackendComm's mutex.
+ */
+#define ELASTIC_APM_DATA_TO_SEND_POOL_MIN_BUFFER_SIZE ((size_t)64)
+#define ELASTIC_APM_DATA_TO_SEND_POOL_NUMBER_OF_BUFFER_SIZE_CLASSES 19 // largest size class is 16MB
+#define ELASTIC_APM_DATA_TO_SEND_POOL_MAX_RETAINED_BUFFERS_TOTAL_SIZE (4 * 1024 * 1024)
+#define ELASTIC_APM_DATA_TO_SEND_POOL_MAX_RETAINED_NODES 64
+
+struct DataToSendPoolFreeBuffer;
+typedef struct DataToSendPoolFreeBuffer DataToSendPoolFreeBuffer;
+
+struct DataToSendPoolFreeBuffer
+{
+    DataToSendPoolFreeBuffer* next;
+};
+
+struct DataToSendPool
+{
+    DataToSendPoolFreeBuffer* freeBuffers[ ELASTIC_APM_DATA_TO_SEND_POOL_NUMBER_OF_BUFFER_SIZE_CLASSES ];
+    size_t freeBuffersCount[ ELASTIC_APM_DATA_TO_SEND_POOL_NUMBER_OF_BUFFER_SIZE_CLASSES ];
+    size_t freeBuffersTotalSize;
+    size_t buffersInUseCount;
+    size_t buffersInUseHighWaterMark;
+
+    DataToSendNode* freeNodes;
+    size_t freeNodesCount;
+    size_t nodesInUseCount;
+    size_t nodesInUseHighWaterMark;
+};
+typedef struct DataToSendPool DataToSendPool;
+
+void initDataToSendPool( DataToSendPool* pool );
+void destructDataToSendPool( DataToSendPool* pool );
+
+ResultCode acquireDataToSendPoolBuffer( DataToSendPool* pool, StringView src, /* out */ StringBuffer* dst );
+void releaseDataToSendPoolBuffer( DataToSendPool* pool, /* in,out */ StringBuffer* strBuf );
+
+ResultCode acquireDataToSendPoolNode( DataToSendPool* pool, /* out */ DataToSendNode** nodeOut );
+// Releases the node's buffers as well
+void releaseDataToSendPoolNode( DataToSendPool* pool, DataToSendNode** nodeOutPtr );
+
+/**
+ * Retains at most as many free blocks as there were blocks in use at the high-water mark since the previous trim.
+ * Larger buffers are freed first.
+ */
+void trimDataToSendPool( DataToSendPool* pool );
@@ -0,0 +1,142 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Measures compile time of a corpus of PHP files - it is where AST processing (zend_ast_process hook) adds its cost.
+ * Files are compiled without being executed via opcache_compile_file() (each file is invalidated before each compile)
+ * and the best time of the repeats is taken per file.
+ * When the extension is loaded with ast_process_collect_stats the number of AST nodes before/after processing
+ * and the time spent in the extension's AST processing are reported as well.
+ * Use run_ast_compile_overhead.sh to compare runs with and without AST processing.
+ *
+ * Usage: php ast_compile_overhead.php <repeats> <per-file CSV output path or -> <corpus dir> [<corpus dir> ...]
+ */
+
+declare(strict_types=1);
+
+if ($argc < 4) {
+    fwrite(STDERR, 'Usage: php ' . basename(__FILE__) . ' <repeats> <per-file CSV output path or -> <corpus dir> [<corpus dir> ...]' . PHP_EOL);
+    exit(1);
+}
+
+$repeats = max((int)$argv[1], 1);
+$csvPath = $argv[2];
+$corpusDirs = array_slice($argv, 3);
+
+if (!function_exists('opcache_compile_file') || !(opcache_get_status(false)['opcache_enabled'] ?? false)) {
+    fwrite(STDERR, 'OPcache has to be loaded and enabled for CLI (opcache.enable_cli=1)' . PHP_EOL);
+    exit(1);
+}
+
+$statsFunc = 'elastic_apm_get_ast_process_stats';
+$hasStats = function_exists($statsFunc) && filter_var(ini_get('elastic_apm.ast_process_collect_stats'), FILTER_VALIDATE_BOOLEAN);
+
+function nowNs(): int
+{
+    return function_exists('hrtime') ? (int)hrtime(true) : (int)(microtime(true) * 1000000000);
+}
+
+/**
+ * @return string[]
+ */
+function findPhpFiles(string $dir): array
+{
+    $files = [];
+    $iterator = new RecursiveIteratorIterator(new RecursiveDirectoryIterator($dir, FilesystemIterator::SKIP_DOTS));
+    /** @var SplFileInfo $fileInfo */
+    foreach ($iterator as $fileInfo) {
+        if ($fileInfo->isFile() && $fileInfo->getExtension() === 'php') {
+            $files[] = $fileInfo->getRealPath();
+        }
+    }
+    sort($files);
+    return $files;
+}
+
+/**
+ * @return ?int compile time in nanoseconds or null if the file could not be compiled
+ */
+function compileFile(string $file): ?int
+{
+    opcache_invalidate($file, /* force */ true);
+    $start = nowNs();
+    try {
+        $isCompiled = @opcache_compile_file($file);
+    } catch (Throwable $throwable) {
+        return null;
+    }
+    $elapsedNs = nowNs() - $start;
+    return $isCompiled ? $elapsedNs : null;
+}
+
+$csv = $csvPath === '-' ? null : fopen($csvPath, 'w');
+if ($csv !== null) {
+    fputcsv($csv, ['file', 'compile_ns', 'ast_nodes_before', 'ast_nodes_after', 'ast_process_ns']);
+}
+
+$filesCount = 0;
+$failedFilesCount = 0;
+$totalCompileNs = 0;
+$totals = [0, 0, 0, 0, 0];
+foreach ($corpusDirs as $corpusDir) {
+    foreach (findPhpFiles($corpusDir) as $file) {
+        $statsBefore = $hasStats ? $statsFunc() : null;
+        $bestNs = null;
+        for ($repeat = 0; $repeat < $repeats; ++$repeat) {
+            $elapsedNs = compileFile($file);
+            if ($elapsedNs === null) {
+                break;
+            }
+            $bestNs = $bestNs === null ? $elapsedNs : min($bestNs, $elapsedNs);
+        }
+        if ($bestNs === null) {
+            ++$failedFilesCount;
+            continue;
+        }
+
+        ++$filesCount;
+        $totalCompileNs += $bestNs;
+        // stats are accumulated for all the repeats so per-file values are averaged
+        $fileStats = [0, 0, 0, 0, 0];
+        if ($statsBefore !== null) {
+            $statsAfter = $statsFunc();
+            $compiledCount = max($statsAfter[0] - $statsBefore[0], 1);
+            foreach ($statsAfter as $index => $value) {
+                $fileStats[$index] = intdiv($value - $statsBefore[$index], $compiledCount);
+                $totals[$index] += $fileStats[$index];
+            }
+        }
+        if ($csv !== null) {
+            fputcsv($csv, [$file, $bestNs, $fileStats[2], $fileStats[3], $fileStats[4]]);
+        }
+    }
+}
+
+if ($csv !== null) {
+    fclose($csv);
+}
+
+printf("files compiled: %d (failed to compile: %d), best of %d per file\n", $filesCount, $failedFilesCount, $repeats);
+printf("total compile time: %.2f ms, %.2f us per file\n", $totalCompileNs / 1e6, $totalCompileNs / max($filesCount, 1) / 1e3);
+if ($hasStats) {
+    printf("AST nodes: %d before processing, %d after processing\n", $totals[2], $totals[3]);
+    printf("time spent in AST processing: %.2f ms (%.2f%% of compile time), files transformed: %d\n", $totals[4] / 1e6, 100.0 * $totals[4] / max($totalCompileNs, 1), $totals[1]);
+}
@@ -0,0 +1,96 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Microbenchmark of code dominated by calls to intercepted curl functions (curl_setopt/curl_setopt_array)
+ * which do not perform any I/O - time per call is the cost of the interception itself
+ * (native handler, arguments capture and PHP part's pre/post hooks).
+ * Use run_curl_setopt_overhead.sh to compare runs with and without the extension.
+ *
+ * Usage: php curl_setopt_overhead.php [iterations] [repeats]
+ */
+
+declare(strict_types=1);
+
+$iterations = (int)($argv[1] ?? 100000);
+$repeats = (int)($argv[2] ?? 5);
+
+if (!extension_loaded('curl')) {
+    fwrite(STDERR, 'curl extension is required' . PHP_EOL);
+    exit(1);
+}
+
+function nowNs(): int
+{
+    return function_exists('hrtime') ? (int)hrtime(true) : (int)(microtime(true) * 1000000000);
+}
+
+/**
+ * @return int number of intercepted calls made
+ */
+function setOptLoop(int $iterations): int
+{
+    $handle = curl_init();
+    $headers = ['Accept: application/json', 'X-Request-Id: 1234567890'];
+    $body = str_repeat('x', 4096);
+    for ($i = 0; $i < $iterations; ++$i) {
+        curl_setopt($handle, CURLOPT_URL, 'http://localhost/path');
+        curl_setopt($handle, CURLOPT_HTTPHEADER, $headers);
+        curl_setopt($handle, CURLOPT_POSTFIELDS, $body);
+        curl_setopt($handle, CURLOPT_RETURNTRANSFER, true);
+        curl_setopt($handle, CURLOPT_TIMEOUT, 5);
+    }
+    curl_close($handle);
+    return $iterations * 5 + 2;
+}
+
+/**
+ * @return int number of intercepted calls made
+ */
+function setOptArrayLoop(int $iterations): int
+{
+    $handle = curl_init();
+    $options = [
+        CURLOPT_URL            => 'http://localhost/path',
+        CURLOPT_HTTPHEADER     => ['Accept: application/json'],
+        CURLOPT_RETURNTRANSFER => true,
+        CURLOPT_TIMEOUT        => 5,
+    ];
+    for ($i = 0; $i < $iterations; ++$i) {
+        curl_setopt_array($handle, $options);
+    }
+    curl_close($handle);
+    return $iterations + 2;
+}
+
+foreach (['setopt' => 'setOptLoop', 'setopt_array' => 'setOptArrayLoop'] as $name => $func) {
+    $func(intdiv($iterations, 10)); // warm up
+
+    $bestNsPerCall = PHP_FLOAT_MAX;
+    for ($repeat = 0; $repeat < $repeats; ++$repeat) {
+        $start = nowNs();
+        $callsCount = $func($iterations);
+        $elapsedNs = nowNs() - $start;
+        $bestNsPerCall = min($bestNsPerCall, $elapsedNs / max($callsCount, 1));
+    }
+
+    printf("%-12s best of %d: %.2f ns per curl call\n", $name, $repeats, $bestNsPerCall);
+}
@@ -0,0 +1,166 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Microbenchmark of serializing intake API payload (metadata line followed by span lines).
+ * Compares the way PHP part used to do it (json_encode of each event and concatenating the lines)
+ * with elastic_apm_serialize_events() which calls each event's jsonSerialize() and writes the result directly to one buffer.
+ * Events are synthetic JsonSerializable objects shaped like PHP part's Span (nested context, labels, stacktrace).
+ * Use run_events_serialization_overhead.sh to run it against a built extension.
+ *
+ * Usage: php events_serialization_overhead.php [iterations] [repeats] [spans per payload]
+ */
+
+declare(strict_types=1);
+
+$iterations = (int)($argv[1] ?? 2000);
+$repeats = (int)($argv[2] ?? 5);
+$spansPerPayload = (int)($argv[3] ?? 50);
+
+function nowNs(): int
+{
+    return function_exists('hrtime') ? (int)hrtime(true) : (int)(microtime(true) * 1000000000);
+}
+
+final class BenchmarkEvent implements JsonSerializable
+{
+    /** @var array<string, mixed> */
+    private $data;
+
+    /**
+     * @param array<string, mixed> $data
+     */
+    public function __construct(array $data)
+    {
+        $this->data = $data;
+    }
+
+    /**
+     * @return array<string, mixed>
+     */
+    public function jsonSerialize(): array
+    {
+        return $this->data;
+    }
+}
+
+function buildMetadata(): BenchmarkEvent
+{
+    return new BenchmarkEvent(
+        [
+            'process' => ['pid' => 12345],
+            'service' => [
+                'name'     => 'benchmark',
+                'agent'    => ['name' => 'php', 'version' => '1.0.0', 'ephemeral_id' => 'c0b5d4e2-9b4e-4f0e-8f3a-3e0a2f1b7c6d'],
+                'language' => ['name' => 'PHP', 'version' => PHP_VERSION],
+                'runtime'  => ['name' => 'PHP', 'version' => PHP_VERSION],
+            ],
+            'system'  => ['hostname' => 'benchmark-host'],
+        ]
+    );
+}
+
+/**
+ * @return BenchmarkEvent[]
+ */
+function buildSpans(int $count): array
+{
+    $spans = [];
+    for ($i = 0; $i < $count; ++$i) {
+        $spans[] = new BenchmarkEvent(
+            [
+                'name'           => 'SELECT * FROM users WHERE id = ? /* ' . $i . ' */',
+                'type'           => 'db',
+                'subtype'        => 'mysql',
+                'action'         => 'query',
+                'timestamp'      => 1712345678123456 + $i,
+                'duration'       => 1.234 + $i / 1000,
+                'id'             => sprintf('%016x', $i + 1),
+                'transaction_id' => 'f0e1d2c3b4a59687',
+                'trace_id'       => '0123456789abcdef0123456789abcdef',
+                'parent_id'      => 'f0e1d2c3b4a59687',
+                'sample_rate'    => 1,
+                'context'        => [
+                    'db'          => ['instance' => 'app', 'statement' => 'SELECT * FROM users WHERE id = ?', 'type' => 'sql'],
+                    'destination' => ['service' => ['resource' => 'mysql', 'name' => 'mysql', 'type' => 'db']],
+                    'service'     => ['target' => ['type' => 'mysql', 'name' => 'app']],
+                    'tags'        => ['index' => $i, 'cached' => ($i % 2) === 0, 'host' => 'db-1.internal/primary'],
+                ],
+                'stacktrace'     => [
+                    ['filename' => '/app/src/Repository/UserRepository.php', 'lineno' => 42, 'function' => 'App\\Repository\\UserRepository->find()'],
+                    ['filename' => '/app/src/Controller/UserController.php', 'lineno' => 17, 'function' => 'App\\Controller\\UserController->show()'],
+                ],
+            ]
+        );
+    }
+    return $spans;
+}
+
+/**
+ * @param BenchmarkEvent[] $spans
+ */
+function serializeWithJsonEncode(BenchmarkEvent $metadata, array $spans): string
+{
+    // The same as PHP part's EventSender used to build the payload
+    $serializedEvents = '{"metadata":' . json_encode($metadata) . '}';
+    foreach ($spans as $span) {
+        $serializedEvents .= "\n" . '{"span":' . json_encode($span) . '}';
+    }
+    return $serializedEvents . "\n";
+}
+
+/**
+ * @param BenchmarkEvent[] $spans
+ */
+function serializeNatively(BenchmarkEvent $metadata, array $spans): string
+{
+    /** @noinspection PhpUndefinedFunctionInspection */
+    return (string)elastic_apm_serialize_events($metadata, $spans, /* errors: */ [], /* metricSets: */ [], /* transaction: */ null);
+}
+
+$metadata = buildMetadata();
+$spans = buildSpans($spansPerPayload);
+
+$serializers = ['json_encode' => 'serializeWithJsonEncode'];
+if (function_exists('elastic_apm_serialize_events')) {
+    $serializers['native'] = 'serializeNatively';
+} else {
+    echo "elastic_apm_serialize_events() is not available - only json_encode is measured\n";
+}
+
+foreach ($serializers as $name => $func) {
+    $payloadSize = strlen($func($metadata, $spans));
+    for ($i = 0; $i < intdiv($iterations, 10); ++$i) {
+        $func($metadata, $spans); // warm up
+    }
+
+    $bestNsPerEvent = PHP_FLOAT_MAX;
+    for ($repeat = 0; $repeat < $repeats; ++$repeat) {
+        $start = nowNs();
+        for ($i = 0; $i < $iterations; ++$i) {
+            $func($metadata, $spans);
+        }
+        $elapsedNs = nowNs() - $start;
+        $bestNsPerEvent = min($bestNsPerEvent, $elapsedNs / max($iterations * count($spans), 1));
+    }
+
+    printf("%-11s best of %d: %.2f ns per span (payload: %d bytes)\n", $name, $repeats, $bestNsPerEvent, $payloadSize);
+}
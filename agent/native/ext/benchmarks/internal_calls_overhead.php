@@ -0,0 +1,79 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Microbenchmark of code dominated by calls to cheap internal functions (str_* and array_* loops).
+ * Any per-internal-call work done by the extension shows up here directly.
+ * Functions which compiler turns into dedicated opcodes (strlen, count, array_key_exists, etc.) are avoided on purpose.
+ * Use run_internal_calls_overhead.sh to compare runs with and without inferred spans.
+ *
+ * Usage: php internal_calls_overhead.php [iterations] [repeats]
+ */
+
+declare(strict_types=1);
+
+$iterations = (int)($argv[1] ?? 1000000);
+$repeats = (int)($argv[2] ?? 5);
+
+function nowNs(): int
+{
+    return function_exists('hrtime') ? (int)hrtime(true) : (int)(microtime(true) * 1000000000);
+}
+
+/**
+ * @return int number of internal function calls made
+ */
+function strLoop(int $iterations): int
+{
+    $acc = 0;
+    for ($i = 0; $i < $iterations; ++$i) {
+        $str = str_repeat('a', 8);
+        $acc += (int)strpos(strtoupper($str), 'A') + ord(substr($str, 1, 1)) + ord(ucfirst($str));
+    }
+    return $acc >= 0 ? $iterations * 7 : 0;
+}
+
+/**
+ * @return int number of internal function calls made
+ */
+function arrayLoop(int $iterations): int
+{
+    $arr = range(0, 15);
+    $acc = 0;
+    for ($i = 0; $i < $iterations; ++$i) {
+        $acc += (int)in_array($i & 31, $arr, true) + (int)array_search($i & 15, $arr, true) + array_sum(array_slice(array_reverse($arr), 0, 4));
+    }
+    return $acc >= 0 ? $iterations * 5 : 0;
+}
+
+foreach (['str' => 'strLoop', 'array' => 'arrayLoop'] as $name => $func) {
+    $func(intdiv($iterations, 10)); // warm up
+
+    $bestNsPerCall = PHP_FLOAT_MAX;
+    for ($repeat = 0; $repeat < $repeats; ++$repeat) {
+        $start = nowNs();
+        $callsCount = $func($iterations);
+        $elapsedNs = nowNs() - $start;
+        $bestNsPerCall = min($bestNsPerCall, $elapsedNs / max($callsCount, 1));
+    }
+
+    printf("%-6s best of %d: %.2f ns per internal call\n", $name, $repeats, $bestNsPerCall);
+}
@@ -0,0 +1,92 @@
+#!/usr/bin/env bash
+set -e -o pipefail
+
+# Compiles a corpus of PHP projects without the extension, with the extension and AST processing disabled
+# and with AST processing enabled so that the cost AST instrumentation adds to compilation
+# (i.e., to every deploy and OPcache reset) is visible.
+# The last run collects AST stats (node counts, time spent in AST processing) and writes per-file results
+# to ${AST_BENCHMARK_OUT_DIR}/ast_compile_per_file.csv.
+#
+# Usage: run_ast_compile_overhead.sh <path to elastic_apm.so> [corpus dir ...]
+#
+# When no corpus directory is given WordPress and Symfony skeleton (pinned versions) are downloaded
+# to AST_BENCHMARK_CORPUS_DIR (composer is required for Symfony skeleton).
+# PHP binary can be overridden with PHP_BIN environment variable, number of repeats per file with AST_BENCHMARK_REPEATS
+# and AST instrumentation rules to apply with AST_BENCHMARK_RULES (see AST_instrumentation_rules.h).
+
+this_script_dir="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+repo_root_dir="$( realpath "${this_script_dir}/../../../.." )"
+
+extension_path="${1:?Path to elastic_apm extension binary is required}"
+shift
+php_bin="${PHP_BIN:-php}"
+repeats="${AST_BENCHMARK_REPEATS:-3}"
+corpus_dir="${AST_BENCHMARK_CORPUS_DIR:-${TMPDIR:-/tmp}/elastic_apm_ast_benchmark_corpus}"
+out_dir="${AST_BENCHMARK_OUT_DIR:-${TMPDIR:-/tmp}}"
+benchmark_script="${this_script_dir}/ast_compile_overhead.php"
+
+wordpress_version="6.4.3"
+symfony_skeleton_version="7.0.*"
+
+function prepare_default_corpus() {
+    mkdir -p "${corpus_dir}"
+
+    if [ ! -d "${corpus_dir}/wordpress" ]; then
+        echo "Downloading WordPress ${wordpress_version} to ${corpus_dir} ..."
+        curl -fsSL "https://wordpress.org/wordpress-${wordpress_version}.tar.gz" | tar -xz -C "${corpus_dir}"
+    fi
+
+    if [ ! -d "${corpus_dir}/symfony" ]; then
+        if command -v composer > /dev/null; then
+            echo "Creating Symfony skeleton ${symfony_skeleton_version} in ${corpus_dir} ..."
+            composer create-project --quiet --no-interaction --no-scripts "symfony/skeleton:${symfony_skeleton_version}" "${corpus_dir}/symfony"
+        else
+            echo "composer is not found - Symfony skeleton is skipped"
+        fi
+    fi
+}
+
+corpus_dirs=("$@")
+if [ ${#corpus_dirs[@]} -eq 0 ]; then
+    prepare_default_corpus
+    for dir in "${corpus_dir}"/*/; do
+        corpus_dirs+=("${dir%/}")
+    done
+fi
+
+opcache_ini_opts=(
+    -d "opcache.enable=1"
+    -d "opcache.enable_cli=1"
+    # so that the measured time is parsing, AST processing and compilation and not optimization passes
+    -d "opcache.optimization_level=0"
+    -d "opcache.memory_consumption=1024"
+    -d "opcache.max_accelerated_files=100000"
+    -d "opcache.max_wasted_percentage=50"
+)
+if ! "${php_bin}" -m | grep -q "Zend OPcache"; then
+    opcache_ini_opts=(-d "zend_extension=opcache" "${opcache_ini_opts[@]}")
+fi
+
+agent_ini_opts=(
+    -d "extension=${extension_path}"
+    -d "elastic_apm.bootstrap_php_part_file=${repo_root_dir}/agent/php/bootstrap_php_part.php"
+    -d "elastic_apm.log_level=OFF"
+    -d "elastic_apm.server_url=http://127.0.0.1:1"
+)
+if [ -n "${AST_BENCHMARK_RULES}" ]; then
+    agent_ini_opts+=(-d "elastic_apm.ast_instrumentation_rules=${AST_BENCHMARK_RULES}")
+fi
+
+echo "=== Without extension"
+"${php_bin}" "${opcache_ini_opts[@]}" "${benchmark_script}" "${repeats}" - "${corpus_dirs[@]}"
+
+echo "=== Extension loaded, AST processing disabled"
+"${php_bin}" "${opcache_ini_opts[@]}" "${agent_ini_opts[@]}" -d "elastic_apm.ast_process_enabled=false" "${benchmark_script}" "${repeats}" - "${corpus_dirs[@]}"
+
+echo "=== Extension loaded, AST processing enabled"
+"${php_bin}" "${opcache_ini_opts[@]}" "${agent_ini_opts[@]}" -d "elastic_apm.ast_process_enabled=true" "${benchmark_script}" "${repeats}" - "${corpus_dirs[@]}"
+
+echo "=== Extension loaded, AST processing enabled, collecting AST stats"
+"${php_bin}" "${opcache_ini_opts[@]}" "${agent_ini_opts[@]}" -d "elastic_apm.ast_process_enabled=true" -d "elastic_apm.ast_process_collect_stats=true" \
+    "${benchmark_script}" "${repeats}" "${out_dir}/ast_compile_per_file.csv" "${corpus_dirs[@]}"
+echo "Per-file results: ${out_dir}/ast_compile_per_file.csv"
@@ -0,0 +1,35 @@
+#!/usr/bin/env bash
+set -e -o pipefail
+
+# Runs curl_setopt_overhead.php without the extension and with the extension (curl instrumentation enabled and disabled)
+# so that the cost of intercepting curl_setopt* calls is visible.
+# To compare two versions of the extension run the script once for each binary.
+#
+# Usage: run_curl_setopt_overhead.sh <path to elastic_apm.so> [iterations] [repeats]
+#
+# PHP binary can be overridden with PHP_BIN environment variable.
+
+this_script_dir="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+repo_root_dir="$( realpath "${this_script_dir}/../../../.." )"
+
+extension_path="${1:?Path to elastic_apm extension binary is required}"
+iterations="${2:-100000}"
+repeats="${3:-5}"
+php_bin="${PHP_BIN:-php}"
+benchmark_script="${this_script_dir}/curl_setopt_overhead.php"
+
+agent_ini_opts=(
+    -d "extension=${extension_path}"
+    -d "elastic_apm.bootstrap_php_part_file=${repo_root_dir}/agent/php/bootstrap_php_part.php"
+    -d "elastic_apm.log_level=OFF"
+    -d "elastic_apm.server_url=http://127.0.0.1:1"
+)
+
+echo "=== Without extension"
+"${php_bin}" "${benchmark_script}" "${iterations}" "${repeats}"
+
+echo "=== Extension loaded, curl instrumentation disabled"
+"${php_bin}" "${agent_ini_opts[@]}" -d "elastic_apm.disable_instrumentations=curl" "${benchmark_script}" "${iterations}" "${repeats}"
+
+echo "=== Extension loaded, curl instrumentation enabled"
+"${php_bin}" "${agent_ini_opts[@]}" "${benchmark_script}" "${iterations}" "${repeats}"
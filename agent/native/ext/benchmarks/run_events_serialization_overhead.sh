@@ -0,0 +1,30 @@
+#!/usr/bin/env bash
+set -e -o pipefail
+
+# Runs events_serialization_overhead.php with the extension loaded so that json_encode based serialization
+# (the way PHP part used to build the payload) is compared with the native one (elastic_apm_serialize_events()).
+# To compare two versions of the extension run the script once for each binary.
+#
+# Usage: run_events_serialization_overhead.sh <path to elastic_apm.so> [iterations] [repeats] [spans per payload]
+#
+# PHP binary can be overridden with PHP_BIN environment variable.
+
+this_script_dir="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+repo_root_dir="$( realpath "${this_script_dir}/../../../.." )"
+
+extension_path="${1:?Path to elastic_apm extension binary is required}"
+iterations="${2:-2000}"
+repeats="${3:-5}"
+spans_per_payload="${4:-50}"
+php_bin="${PHP_BIN:-php}"
+benchmark_script="${this_script_dir}/events_serialization_overhead.php"
+
+agent_ini_opts=(
+    -d "extension=${extension_path}"
+    -d "elastic_apm.bootstrap_php_part_file=${repo_root_dir}/agent/php/bootstrap_php_part.php"
+    -d "elastic_apm.log_level=OFF"
+    -d "elastic_apm.server_url=http://127.0.0.1:1"
+)
+
+echo "=== Extension loaded"
+"${php_bin}" "${agent_ini_opts[@]}" "${benchmark_script}" "${iterations}" "${repeats}" "${spans_per_payload}"
@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+set -e -o pipefail
+
+# Runs internal_calls_overhead.php without the extension, with the extension but without profiling
+# and with inferred spans enabled so that overhead added to every internal function call is visible.
+#
+# Usage: run_internal_calls_overhead.sh <path to elastic_apm.so> [iterations] [repeats]
+#
+# PHP binary can be overridden with PHP_BIN environment variable.
+
+this_script_dir="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+repo_root_dir="$( realpath "${this_script_dir}/../../../.." )"
+
+extension_path="${1:?Path to elastic_apm extension binary is required}"
+iterations="${2:-1000000}"
+repeats="${3:-5}"
+php_bin="${PHP_BIN:-php}"
+benchmark_script="${this_script_dir}/internal_calls_overhead.php"
+
+agent_ini_opts=(
+    -d "extension=${extension_path}"
+    -d "elastic_apm.bootstrap_php_part_file=${repo_root_dir}/agent/php/bootstrap_php_part.php"
+    -d "elastic_apm.log_level=OFF"
+    -d "elastic_apm.server_url=http://127.0.0.1:1"
+)
+
+echo "=== Without extension"
+"${php_bin}" "${benchmark_script}" "${iterations}" "${repeats}"
+
+echo "=== Extension loaded, inferred spans disabled"
+"${php_bin}" "${agent_ini_opts[@]}" -d "elastic_apm.profiling_inferred_spans_enabled=false" "${benchmark_script}" "${iterations}" "${repeats}"
+
+echo "=== Extension loaded, inferred spans enabled"
+"${php_bin}" "${agent_ini_opts[@]}" -d "elastic_apm.profiling_inferred_spans_enabled=true" -d "elastic_apm.profiling_inferred_spans_sampling_interval=20ms" "${benchmark_script}" "${iterations}" "${repeats}"
@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+set -e -o pipefail
+
+# Runs span_heavy_transaction_overhead.php with the extension loaded and span compression disabled
+# (so that every span goes to the extension as it ends).
+# To compare two versions of the extension (e.g. with and without buffering of spans) run the script once for each binary.
+#
+# Usage: run_span_heavy_transaction_overhead.sh <path to elastic_apm.so> [transactions] [repeats] [spans per transaction]
+#
+# PHP binary can be overridden with PHP_BIN environment variable.
+
+this_script_dir="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+repo_root_dir="$( realpath "${this_script_dir}/../../../.." )"
+
+extension_path="${1:?Path to elastic_apm extension binary is required}"
+transactions="${2:-200}"
+repeats="${3:-5}"
+spans_per_transaction="${4:-500}"
+php_bin="${PHP_BIN:-php}"
+benchmark_script="${this_script_dir}/span_heavy_transaction_overhead.php"
+
+agent_ini_opts=(
+    -d "extension=${extension_path}"
+    -d "elastic_apm.bootstrap_php_part_file=${repo_root_dir}/agent/php/bootstrap_php_part.php"
+    -d "elastic_apm.log_level=OFF"
+    -d "elastic_apm.server_url=http://127.0.0.1:1"
+    -d "elastic_apm.span_compression_enabled=false"
+    -d "elastic_apm.transaction_max_spans=1000000"
+)
+
+echo "=== Extension loaded, ${spans_per_transaction} spans per transaction"
+"${php_bin}" "${agent_ini_opts[@]}" "${benchmark_script}" "${transactions}" "${repeats}" "${spans_per_transaction}"
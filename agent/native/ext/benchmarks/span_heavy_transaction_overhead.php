@@ -0,0 +1,78 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Microbenchmark of a span heavy transaction - each span is created through the public API and ended right away,
+ * so the time includes PHP part building the span and handing it to the extension (serialization and buffering).
+ * Reports time per span and peak memory usage.
+ * Use run_span_heavy_transaction_overhead.sh to run it against a built extension.
+ *
+ * Usage: php span_heavy_transaction_overhead.php [transactions] [repeats] [spans per transaction]
+ */
+
+declare(strict_types=1);
+
+use Elastic\Apm\ElasticApm;
+
+$transactions = (int)($argv[1] ?? 200);
+$repeats = (int)($argv[2] ?? 5);
+$spansPerTransaction = (int)($argv[3] ?? 500);
+
+function nowNs(): int
+{
+    return function_exists('hrtime') ? (int)hrtime(true) : (int)(microtime(true) * 1000000000);
+}
+
+function runTransactions(int $transactions, int $spansPerTransaction): void
+{
+    for ($txIndex = 0; $txIndex < $transactions; ++$txIndex) {
+        $tx = ElasticApm::beginTransaction('benchmark_transaction', 'benchmark');
+        for ($spanIndex = 0; $spanIndex < $spansPerTransaction; ++$spanIndex) {
+            $span = $tx->beginChildSpan('SELECT * FROM users WHERE id = ?', 'db', 'mysql', 'query');
+            $span->context()->db()->setStatement('SELECT * FROM users WHERE id = ?');
+            $span->context()->setLabel('index', $spanIndex);
+            $span->end();
+        }
+        $tx->end();
+    }
+}
+
+if (!class_exists(ElasticApm::class)) {
+    echo "Agent's PHP part is not loaded - run this script with the extension (see run_span_heavy_transaction_overhead.sh)\n";
+    exit(1);
+}
+
+runTransactions(max(intdiv($transactions, 10), 1), $spansPerTransaction); // warm up
+
+$bestNsPerSpan = PHP_FLOAT_MAX;
+for ($repeat = 0; $repeat < $repeats; ++$repeat) {
+    $start = nowNs();
+    runTransactions($transactions, $spansPerTransaction);
+    $elapsedNs = nowNs() - $start;
+    $bestNsPerSpan = min($bestNsPerSpan, $elapsedNs / max($transactions * $spansPerTransaction, 1));
+}
+
+printf(
+    "best of %d: %.2f ns per span; peak memory usage: %.1f MB\n",
+    $repeats,
+    $bestNsPerSpan,
+    memory_get_peak_usage() / (1024 * 1024)
+);
@@ -29,6 +29,9 @@
 #include "lifecycle.h"
 #include "supportability_zend.h"
 #include "elastic_apm_API.h"
+#include "fast_path_spans.h"
+#include "events_serialization.h"
+#include "AST_instrumentation.h"
 #include "ConfigManager.h"
 #include "elastic_apm_assert.h"
 #include "elastic_apm_alloc.h"
@@ -143,7 +146,9 @@ PHP_INI_BEGIN()
     #if ( ELASTIC_APM_ASSERT_ENABLED_01 != 0 )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_ASSERT_LEVEL )
     #endif
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_AST_INSTRUMENTATION_RULES )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_AST_PROCESS_ENABLED )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_AST_PROCESS_COLLECT_STATS )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_AST_PROCESS_DEBUG_DUMP_CONVERTED_BACK_TO_SOURCE )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_AST_PROCESS_DEBUG_DUMP_FOR_PATH_PREFIX )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_AST_PROCESS_DEBUG_DUMP_OUT_DIR )
@@ -153,6 +158,7 @@ PHP_INI_BEGIN()
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_CAPTURE_ERRORS )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_CAPTURE_ERRORS_WITH_PHP_PART )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_CAPTURE_EXCEPTIONS )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_CAPTURE_MEMORY_STATS )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_DEV_INTERNAL )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_DEV_INTERNAL_BACKEND_COMM_LOG_VERBOSE )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_DEV_INTERNAL_CAPTURE_ERRORS_ONLY_TO_LOG )
@@ -175,11 +181,21 @@ PHP_INI_BEGIN()
     #endif
     #if ( ELASTIC_APM_MEMORY_TRACKING_ENABLED_01 != 0 )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_MEMORY_TRACKING_LEVEL )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_MEMORY_TRACKING_SAMPLING_INTERVAL )
     #endif
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_NATIVE_FAST_PATH_SPANS_ENABLED )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_NON_KEYWORD_STRING_MAX_LENGTH )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_OBSERVER_INSTRUMENTATION_ENABLED )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_ENABLED )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_EXPORT_DIR )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_EXPORT_INTERVAL )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_EXPORT_URL )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_SAMPLING_INTERVAL )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_ENABLED )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_MIN_DURATION )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_OVERHEAD_BUDGET )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_SAMPLING_INTERVAL )
+    ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_SAMPLING_TIMER )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_SANITIZE_FIELD_NAMES )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_SECRET_TOKEN )
     ELASTIC_APM_INI_ENTRY( ELASTIC_APM_CFG_OPT_NAME_SERVER_TIMEOUT )
@@ -270,17 +286,34 @@ static PHP_GINIT_FUNCTION(elastic_apm)
     ELASTIC_APM_LOG_DIRECT_DEBUG( "%s: GINIT called; parent PID: %d", __FUNCTION__, (int)getParentProcessId() );
     // memset(&elastic_apm_globals->globalTracer, 0, sizeof(Tracer));
     elastic_apm_globals->globals = nullptr;
+    elastic_apm_globals->inferredSpansSamples = nullptr;
+    elastic_apm_globals->continuousProfiler = nullptr;
 
     auto phpBridge = std::make_shared<elasticapm::php::PhpBridge>();
 
-    auto inferredSpans = std::make_shared<elasticapm::php::InferredSpans>([interruptFlag = reinterpret_cast<void *>(&EG(vm_interrupt))]() {
+    // Globals are constructed per thread in ZTS build (the constructor runs in the new thread) so each thread has its own samplers
+    // and interrupt is requested only for the thread which executes the sampled request.
+    // TSRM cache has to be updated first - otherwise EG() would resolve to the globals of the thread that last updated it (or none at all)
+#if defined(ZTS) && defined(COMPILE_DL_ELASTIC_APM)
+    ZEND_TSRMLS_CACHE_UPDATE();
+#endif
+    auto requestVmInterrupt = [interruptFlag = reinterpret_cast<void *>(&EG(vm_interrupt))]() {
 #if PHP_VERSION_ID >= 80200
         zend_atomic_bool_store_ex(reinterpret_cast<zend_atomic_bool *>(interruptFlag), true);
 #else
         *static_cast<zend_bool *>(interruptFlag) = 1;
 #endif
-    }, [phpBridge](elasticapm::php::InferredSpans::time_point_t requestTime, elasticapm::php::InferredSpans::time_point_t now) {
-        phpBridge->callInferredSpans(now - requestTime);
+    };
+
+    // Samples buffer is allocated on the first request with inferred spans enabled (see startSamplersOnRequestInit)
+    auto inferredSpans = std::make_shared<elasticapm::php::InferredSpans>(requestVmInterrupt, [phpBridge](elasticapm::php::InferredSpans::time_point_t requestTime, [[maybe_unused]] elasticapm::php::InferredSpans::time_point_t now) {
+        elasticapm::php::InferredSpansSamples *inferredSpansSamples = ELASTICAPM_G(inferredSpansSamples);
+        if (!inferredSpansSamples || inferredSpansSamples->capture(EG(current_execute_data), requestTime)) {
+            return;
+        }
+        // Sample buffer is full - PHP part consumes the buffered samples and then there is room for the new one
+        phpBridge->callInferredSpans();
+        inferredSpansSamples->capture(EG(current_execute_data), requestTime);
     });
 
     elasticapm::php::PhpSapi sapi(phpBridge->getPhpSapiName());
@@ -303,6 +336,14 @@ static PHP_GSHUTDOWN_FUNCTION(elastic_apm) {
         delete elastic_apm_globals->globals;
     }
 
+    if (elastic_apm_globals->inferredSpansSamples) {
+        delete elastic_apm_globals->inferredSpansSamples;
+    }
+
+    if (elastic_apm_globals->continuousProfiler) {
+        delete elastic_apm_globals->continuousProfiler;
+    }
+
     if (elastic_apm_globals->lastErrorData) {
         ELASTIC_APM_LOG_DIRECT_WARNING( "%s: still holding error", __FUNCTION__);
         // we need to relese any dangling php error data beacause it is already freed (it was allocated in request pool)
@@ -391,6 +432,15 @@ PHP_FUNCTION( elastic_apm_is_enabled )
 }
 /* }}} */
 
+/* {{{ bool elastic_apm_is_request_ignored()
+ */
+PHP_FUNCTION( elastic_apm_is_request_ignored )
+{
+    ZEND_PARSE_PARAMETERS_NONE();
+    RETVAL_BOOL( isTracerPhpPartBootstrapSkipped() );
+}
+/* }}} */
+
 ZEND_BEGIN_ARG_INFO_EX( elastic_apm_get_config_option_by_name_arginfo, 0, 0, 1 )
                 ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, optionName, IS_STRING, /* allow_null: */ 0 )
 ZEND_END_ARG_INFO()
@@ -444,8 +494,10 @@ PHP_FUNCTION( elastic_apm_get_number_of_dynamic_config_options )
 ZEND_BEGIN_ARG_INFO_EX( elastic_apm_intercept_calls_to_internal_method_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 2 )
                 ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ className, IS_STRING, /* allow_null: */ 0 )
                 ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ methodName, IS_STRING, /* allow_null: */ 0 )
+                ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ maxCapturedArgsCount, IS_LONG, /* allow_null: */ 0 )
 ZEND_END_ARG_INFO()
-/* {{{ elastic_apm_intercept_calls_to_internal_method( string $className, string $methodName ): int // <- interceptRegistrationId
+/* {{{ elastic_apm_intercept_calls_to_internal_method( string $className, string $methodName, int $maxCapturedArgsCount = -1 ): int // <- interceptRegistrationId
+ * Pre-hook gets only the first $maxCapturedArgsCount arguments (all of them if it is negative)
  */
 PHP_FUNCTION( elastic_apm_intercept_calls_to_internal_method )
 {
@@ -461,17 +513,21 @@ PHP_FUNCTION( elastic_apm_intercept_calls_to_internal_method )
     size_t classNameLength = 0;
     char* methodName = NULL;
     size_t methodNameLength = 0;
+    zend_long maxCapturedArgsCount = -1;
     uint32_t interceptRegistrationId;
 
 
-    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 2, /* max_num_args: */ 2 )
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 2, /* max_num_args: */ 3 )
     Z_PARAM_STRING( className, classNameLength )
     Z_PARAM_STRING( methodName, methodNameLength )
+    Z_PARAM_OPTIONAL
+    Z_PARAM_LONG( maxCapturedArgsCount )
     ZEND_PARSE_PARAMETERS_END();
 
     if (elasticApmInterceptCallsToInternalMethod( className, methodName, &interceptRegistrationId ) != resultSuccess) {
         return;
     }
+    setInterceptedCallMaxCapturedArgsCount( interceptRegistrationId, maxCapturedArgsCount < 0 ? maxInterceptedCallCapturedArgsCount : (uint32_t) maxCapturedArgsCount );
 
     RETURN_LONG(interceptRegistrationId);
 }
@@ -479,8 +535,10 @@ PHP_FUNCTION( elastic_apm_intercept_calls_to_internal_method )
 
 ZEND_BEGIN_ARG_INFO_EX( elastic_apm_intercept_calls_to_internal_function_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 1 )
     ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ functionName, IS_STRING, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ maxCapturedArgsCount, IS_LONG, /* allow_null: */ 0 )
 ZEND_END_ARG_INFO()
-/* {{{ elastic_apm_intercept_calls_to_internal_function( string $className, string $functionName ): int // <- interceptRegistrationId
+/* {{{ elastic_apm_intercept_calls_to_internal_function( string $functionName, int $maxCapturedArgsCount = -1 ): int // <- interceptRegistrationId
+ * Pre-hook gets only the first $maxCapturedArgsCount arguments (all of them if it is negative)
  */
 PHP_FUNCTION( elastic_apm_intercept_calls_to_internal_function )
 {
@@ -494,15 +552,222 @@ PHP_FUNCTION( elastic_apm_intercept_calls_to_internal_function )
 
     char* functionName = NULL;
     size_t functionNameLength = 0;
+    zend_long maxCapturedArgsCount = -1;
     uint32_t interceptRegistrationId;
 
-    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 1, /* max_num_args: */ 1 )
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 1, /* max_num_args: */ 2 )
     Z_PARAM_STRING( functionName, functionNameLength )
+    Z_PARAM_OPTIONAL
+    Z_PARAM_LONG( maxCapturedArgsCount )
     ZEND_PARSE_PARAMETERS_END();
 
     if (elasticApmInterceptCallsToInternalFunction( functionName, &interceptRegistrationId ) != resultSuccess) {
         return;
     }
+    setInterceptedCallMaxCapturedArgsCount( interceptRegistrationId, maxCapturedArgsCount < 0 ? maxInterceptedCallCapturedArgsCount : (uint32_t) maxCapturedArgsCount );
+
+    RETURN_LONG(interceptRegistrationId);
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_intercept_calls_to_internal_method_as_fast_path_span_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 3 )
+                ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ className, IS_STRING, /* allow_null: */ 0 )
+                ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ methodName, IS_STRING, /* allow_null: */ 0 )
+                ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ statementArgIndex, IS_LONG, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+/* {{{ elastic_apm_intercept_calls_to_internal_method_as_fast_path_span( string $className, string $methodName, int $statementArgIndex ): int // <- interceptRegistrationId
+ * Returns -1 if fast path spans are disabled by configuration
+ */
+PHP_FUNCTION( elastic_apm_intercept_calls_to_internal_method_as_fast_path_span )
+{
+    RETVAL_LONG(-1);
+
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if (elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess) {
+        return;
+    }
+
+    char* className = NULL;
+    size_t classNameLength = 0;
+    char* methodName = NULL;
+    size_t methodNameLength = 0;
+    zend_long statementArgIndex = -1;
+    uint32_t interceptRegistrationId;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 3, /* max_num_args: */ 3 )
+    Z_PARAM_STRING( className, classNameLength )
+    Z_PARAM_STRING( methodName, methodNameLength )
+    Z_PARAM_LONG( statementArgIndex )
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (elasticApmInterceptCallsToInternalMethodAsFastPathSpan( className, methodName, (int) statementArgIndex, &interceptRegistrationId ) != resultSuccess) {
+        return;
+    }
+
+    RETURN_LONG(interceptRegistrationId);
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_intercept_calls_to_internal_function_as_fast_path_span_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 2 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ functionName, IS_STRING, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ statementArgIndex, IS_LONG, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+/* {{{ elastic_apm_intercept_calls_to_internal_function_as_fast_path_span( string $functionName, int $statementArgIndex ): int // <- interceptRegistrationId
+ * Returns -1 if fast path spans are disabled by configuration
+ */
+PHP_FUNCTION( elastic_apm_intercept_calls_to_internal_function_as_fast_path_span )
+{
+    RETVAL_LONG(-1);
+
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if (elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess) {
+        return;
+    }
+
+    char* functionName = NULL;
+    size_t functionNameLength = 0;
+    zend_long statementArgIndex = -1;
+    uint32_t interceptRegistrationId;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 2, /* max_num_args: */ 2 )
+    Z_PARAM_STRING( functionName, functionNameLength )
+    Z_PARAM_LONG( statementArgIndex )
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (elasticApmInterceptCallsToInternalFunctionAsFastPathSpan( functionName, (int) statementArgIndex, &interceptRegistrationId ) != resultSuccess) {
+        return;
+    }
+
+    RETURN_LONG(interceptRegistrationId);
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_set_fast_path_spans_recording_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 1 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ isRecording, _IS_BOOL, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+/* {{{ elastic_apm_set_fast_path_spans_recording( bool $isRecording ): void
+ * Calls registered as fast path spans are recorded only while there is a sampled transaction
+ */
+PHP_FUNCTION( elastic_apm_set_fast_path_spans_recording )
+{
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if (elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess) {
+        return;
+    }
+
+    zend_bool isRecording = 0;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 1, /* max_num_args: */ 1 )
+    Z_PARAM_BOOL( isRecording )
+    ZEND_PARSE_PARAMETERS_END();
+
+    fastPathSpansSetRecording( isRecording != 0 );
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_take_fast_path_spans_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 0 )
+ZEND_END_ARG_INFO()
+/* {{{ elastic_apm_take_fast_path_spans(): array
+ * Returns calls recorded as fast path spans that ended since the previous call
+ * as [number of calls not recorded because the buffer was full, list of spans] - see fastPathSpansTake()
+ */
+PHP_FUNCTION( elastic_apm_take_fast_path_spans )
+{
+    ResultCode resultCode;
+    ZVAL_NULL( /* out */ return_value );
+
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) );
+
+    fastPathSpansTake( /* out */ return_value );
+
+    finally:
+    return;
+
+    failure:
+    goto finally;
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_intercept_calls_to_user_method_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 2 )
+                ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ className, IS_STRING, /* allow_null: */ 0 )
+                ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ methodName, IS_STRING, /* allow_null: */ 0 )
+                ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ maxCapturedArgsCount, IS_LONG, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+/* {{{ elastic_apm_intercept_calls_to_user_method( string $className, string $methodName, int $maxCapturedArgsCount = -1 ): int // <- interceptRegistrationId
+ * Returns -1 if Observer API based interception is not active (PHP before 8 or disabled by configuration)
+ * Pre-hook gets only the first $maxCapturedArgsCount arguments (all of them if it is negative)
+ */
+PHP_FUNCTION( elastic_apm_intercept_calls_to_user_method )
+{
+    RETVAL_LONG(-1);
+
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if (elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess) {
+        return;
+    }
+
+    char* className = NULL;
+    size_t classNameLength = 0;
+    char* methodName = NULL;
+    size_t methodNameLength = 0;
+    zend_long maxCapturedArgsCount = -1;
+    uint32_t interceptRegistrationId;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 2, /* max_num_args: */ 3 )
+    Z_PARAM_STRING( className, classNameLength )
+    Z_PARAM_STRING( methodName, methodNameLength )
+    Z_PARAM_OPTIONAL
+    Z_PARAM_LONG( maxCapturedArgsCount )
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (elasticApmInterceptCallsToUserMethod( className, methodName, &interceptRegistrationId ) != resultSuccess) {
+        return;
+    }
+    setInterceptedCallMaxCapturedArgsCount( interceptRegistrationId, maxCapturedArgsCount < 0 ? maxInterceptedCallCapturedArgsCount : (uint32_t) maxCapturedArgsCount );
+
+    RETURN_LONG(interceptRegistrationId);
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_intercept_calls_to_user_function_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 1 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ functionName, IS_STRING, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, /* name */ maxCapturedArgsCount, IS_LONG, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+/* {{{ elastic_apm_intercept_calls_to_user_function( string $functionName, int $maxCapturedArgsCount = -1 ): int // <- interceptRegistrationId
+ * Returns -1 if Observer API based interception is not active (PHP before 8 or disabled by configuration)
+ * Pre-hook gets only the first $maxCapturedArgsCount arguments (all of them if it is negative)
+ */
+PHP_FUNCTION( elastic_apm_intercept_calls_to_user_function )
+{
+    RETVAL_LONG(-1);
+
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if (elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess) {
+        return;
+    }
+
+    char* functionName = NULL;
+    size_t functionNameLength = 0;
+    zend_long maxCapturedArgsCount = -1;
+    uint32_t interceptRegistrationId;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 1, /* max_num_args: */ 2 )
+    Z_PARAM_STRING( functionName, functionNameLength )
+    Z_PARAM_OPTIONAL
+    Z_PARAM_LONG( maxCapturedArgsCount )
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (elasticApmInterceptCallsToUserFunction( functionName, &interceptRegistrationId ) != resultSuccess) {
+        return;
+    }
+    setInterceptedCallMaxCapturedArgsCount( interceptRegistrationId, maxCapturedArgsCount < 0 ? maxInterceptedCallCapturedArgsCount : (uint32_t) maxCapturedArgsCount );
 
     RETURN_LONG(interceptRegistrationId);
 }
@@ -543,6 +808,136 @@ PHP_FUNCTION( elastic_apm_send_to_server ) {
 }
 /* }}} */
 
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_send_events_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 6 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, userAgentHttpHeader, IS_STRING, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, metadata, IS_OBJECT, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, spans, IS_ARRAY, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, errors, IS_ARRAY, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, metricSets, IS_ARRAY, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, transaction, IS_OBJECT, /* allow_null: */ 1 )
+ZEND_END_ARG_INFO()
+
+typedef ResultCode (* SendEventsFunc )( StringView userAgentHttpHeader, zval* metadata, zend_array* spans, zend_array* errors, zend_array* metricSets, zval* transaction );
+
+static void sendEventsPhpFunctionImpl( INTERNAL_FUNCTION_PARAMETERS, SendEventsFunc sendEventsFunc )
+{
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if (elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess) {
+        RETURN_BOOL(false);
+        return;
+    }
+
+    char* userAgentHttpHeader = NULL;
+    size_t userAgentHttpHeaderLength = 0;
+    zval* metadata = NULL;
+    zend_array* spans = NULL;
+    zend_array* errors = NULL;
+    zend_array* metricSets = NULL;
+    zval* transaction = NULL;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 6, /* max_num_args: */ 6 )
+        Z_PARAM_STRING( userAgentHttpHeader, userAgentHttpHeaderLength )
+        Z_PARAM_OBJECT( metadata )
+        Z_PARAM_ARRAY_HT( spans )
+        Z_PARAM_ARRAY_HT( errors )
+        Z_PARAM_ARRAY_HT( metricSets )
+        Z_PARAM_OBJECT_EX( transaction, /* check_null: */ 1, /* separate: */ 0 )
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (sendEventsFunc(makeStringView( userAgentHttpHeader, userAgentHttpHeaderLength ), metadata, spans, errors, metricSets, transaction) != resultSuccess) {
+        RETURN_BOOL(false);
+    }
+
+    RETURN_BOOL(true);
+}
+
+/* {{{ elastic_apm_send_events_to_server(
+ *          string $userAgentHttpHeader,
+ *          Metadata $metadata,
+ *          Span[] $spans,
+ *          Error[] $errors,
+ *          MetricSet[] $metricSets,
+ *          ?Transaction $transaction ): bool
+ */
+PHP_FUNCTION( elastic_apm_send_events_to_server ) {
+    sendEventsPhpFunctionImpl( INTERNAL_FUNCTION_PARAM_PASSTHRU, elasticApmSendEventsToServer );
+}
+/* }}} */
+
+/* {{{ elastic_apm_buffer_events(
+ *          string $userAgentHttpHeader,
+ *          Metadata $metadata,
+ *          Span[] $spans,
+ *          Error[] $errors,
+ *          MetricSet[] $metricSets,
+ *          ?Transaction $transaction ): bool
+ */
+PHP_FUNCTION( elastic_apm_buffer_events ) {
+    sendEventsPhpFunctionImpl( INTERNAL_FUNCTION_PARAM_PASSTHRU, elasticApmBufferEvents );
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_serialize_events_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 5 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, metadata, IS_OBJECT, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, spans, IS_ARRAY, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, errors, IS_ARRAY, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, metricSets, IS_ARRAY, /* allow_null: */ 0 )
+    ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, transaction, IS_OBJECT, /* allow_null: */ 1 )
+ZEND_END_ARG_INFO()
+
+/* {{{ elastic_apm_serialize_events(
+ *          Metadata $metadata,
+ *          Span[] $spans,
+ *          Error[] $errors,
+ *          MetricSet[] $metricSets,
+ *          ?Transaction $transaction ): ?string
+ * Returns the intake API payload elastic_apm_send_events_to_server() would send for the events (null on failure)
+ * without sending anything - used to compare native serialization with PHP part's one and to benchmark it
+ */
+PHP_FUNCTION( elastic_apm_serialize_events ) {
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if (elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess) {
+        RETURN_NULL();
+    }
+
+    zval* metadata = NULL;
+    zend_array* spans = NULL;
+    zend_array* errors = NULL;
+    zend_array* metricSets = NULL;
+    zval* transaction = NULL;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 5, /* max_num_args: */ 5 )
+        Z_PARAM_OBJECT( metadata )
+        Z_PARAM_ARRAY_HT( spans )
+        Z_PARAM_ARRAY_HT( errors )
+        Z_PARAM_ARRAY_HT( metricSets )
+        Z_PARAM_OBJECT_EX( transaction, /* check_null: */ 1, /* separate: */ 0 )
+    ZEND_PARSE_PARAMETERS_END();
+
+    std::string ndjson;
+    bool isSerialized = false;
+    bool hasBailedOut = false;
+    // buffer is released before bailout (e.g. fatal error in jsonSerialize()) is propagated
+    zend_try {
+        isSerialized = appendMetadataLineAsNdjson( metadata, ndjson ) == resultSuccess
+                       && appendAllEventsLinesAsNdjson( spans, errors, metricSets, transaction, ndjson ) == resultSuccess;
+    } zend_catch {
+        hasBailedOut = true;
+    } zend_end_try();
+
+    if (hasBailedOut) {
+        std::string().swap(ndjson);
+        zend_bailout();
+    }
+    if (!isSerialized) {
+        RETURN_NULL();
+    }
+    RETURN_STRINGL(ndjson.data(), ndjson.length());
+}
+/* }}} */
+
 ZEND_BEGIN_ARG_INFO_EX( elastic_apm_log_arginfo, /* _unused: */ 0, /* return_reference: */ 0, /* required_num_args: */ 7 )
                 ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, isForced, IS_LONG, /* allow_null: */ 0 )
                 ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, level, IS_LONG, /* allow_null: */ 0 )
@@ -653,6 +1048,91 @@ PHP_FUNCTION( elastic_apm_get_last_php_error )
 }
 /* }}} */
 
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_take_inferred_spans_samples_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 0 )
+ZEND_END_ARG_INFO()
+/* {{{ elastic_apm_take_inferred_spans_samples(): ?array
+ * Returns stack samples captured natively since the previous call
+ * as [id of the first new frame, flat array of new interned frames, list of [duration in ms, list of frame ids]]
+ */
+PHP_FUNCTION( elastic_apm_take_inferred_spans_samples )
+{
+    ResultCode resultCode;
+    ZVAL_NULL( /* out */ return_value );
+
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) );
+
+    if ( ELASTICAPM_G( inferredSpansSamples ) != nullptr && ELASTICAPM_G( inferredSpansSamples )->getSamplesCount() != 0 )
+    {
+        ELASTICAPM_G( inferredSpansSamples )->take( /* out */ return_value
+                                                    , std::chrono::time_point_cast< std::chrono::milliseconds >( std::chrono::steady_clock::now() ) );
+    }
+    else
+    {
+        array_init( /* out */ return_value );
+    }
+
+    finally:
+    return;
+
+    failure:
+    goto finally;
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_get_inferred_spans_stats_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 0 )
+ZEND_END_ARG_INFO()
+/* {{{ elastic_apm_get_inferred_spans_stats(): array
+ * Returns cost of inferred spans sampling in the current request and the effective sampling interval
+ * as [effective interval in ms, number of samples, time spent sampling in microseconds, overhead as fraction of request time]
+ */
+PHP_FUNCTION( elastic_apm_get_inferred_spans_stats )
+{
+    ResultCode resultCode;
+    array_init( /* out */ return_value );
+
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) );
+
+    if ( ELASTICAPM_G( globals ) != nullptr )
+    {
+        auto& inferredSpans = ELASTICAPM_G( globals )->inferredSpans_;
+        add_next_index_long( return_value, static_cast<zend_long>( inferredSpans->getInterval().count() ) );
+        add_next_index_long( return_value, static_cast<zend_long>( inferredSpans->getSamplesCount() ) );
+        add_next_index_long( return_value, static_cast<zend_long>( inferredSpans->getSamplingTime().count() / 1000 ) );
+        add_next_index_double( return_value, inferredSpans->getOverhead( elasticapm::php::InferredSpans::clock_t::now() ) );
+    }
+
+    finally:
+    return;
+
+    failure:
+    goto finally;
+}
+/* }}} */
+
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_get_ast_process_stats_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 0 )
+ZEND_END_ARG_INFO()
+/* {{{ elastic_apm_get_ast_process_stats(): array
+ * Returns AST processing stats accumulated since module init (collected only when ast_process_collect_stats is set)
+ * as [compiled files, transformed files, AST nodes before processing, AST nodes after processing, time spent processing in nanoseconds]
+ */
+PHP_FUNCTION( elastic_apm_get_ast_process_stats )
+{
+    AstProcessStats stats;
+    array_init( /* out */ return_value );
+
+    getAstProcessStats( /* out */ &stats );
+    add_next_index_long( return_value, static_cast<zend_long>( stats.compiledFilesCount ) );
+    add_next_index_long( return_value, static_cast<zend_long>( stats.transformedFilesCount ) );
+    add_next_index_long( return_value, static_cast<zend_long>( stats.astNodesCountBeforeProcess ) );
+    add_next_index_long( return_value, static_cast<zend_long>( stats.astNodesCountAfterProcess ) );
+    add_next_index_long( return_value, static_cast<zend_long>( stats.processDurationNanoseconds ) );
+}
+/* }}} */
+
 ZEND_BEGIN_ARG_INFO_EX( elastic_apm_before_loading_agent_php_code_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 0 )
 ZEND_END_ARG_INFO()
 /* {{{ elastic_apm_before_loading_agent_php_code(): void
@@ -706,6 +1186,36 @@ PHP_FUNCTION( elastic_apm_ast_instrumentation_direct_call )
 
 /* {{{ arginfo
  */
+ZEND_BEGIN_ARG_INFO_EX( elastic_apm_write_sampled_heap_profile_arginfo, /* _unused */ 0, /* return_reference: */ 0, /* required_num_args: */ 1 )
+                ZEND_ARG_TYPE_INFO( /* pass_by_ref: */ 0, filePath, IS_STRING, /* allow_null: */ 0 )
+ZEND_END_ARG_INFO()
+/* {{{ elastic_apm_write_sampled_heap_profile( string $filePath ): bool
+ * Writes allocations sampled by MemoryTracker (see memory_tracking_sampling_interval) as a pprof heap profile
+ */
+PHP_FUNCTION( elastic_apm_write_sampled_heap_profile )
+{
+    RETVAL_BOOL( false );
+
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmApiEntered( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        return;
+    }
+
+    char* filePath = NULL;
+    size_t filePathLength = 0;
+
+    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 1, /* max_num_args: */ 1 )
+        Z_PARAM_STRING( filePath, filePathLength )
+    ZEND_PARSE_PARAMETERS_END();
+
+    #if ( ELASTIC_APM_MEMORY_TRACKING_ENABLED_01 != 0 )
+    RETVAL_BOOL( memoryTrackerWriteSampledHeapProfile( getGlobalMemoryTracker(), filePath ) == resultSuccess );
+    #endif
+}
+/* }}} */
+
 ZEND_BEGIN_ARG_INFO(elastic_apm_no_paramters_arginfo, 0)
 ZEND_END_ARG_INFO()
 /* }}} */
@@ -715,18 +1225,32 @@ ZEND_END_ARG_INFO()
 static const zend_function_entry elastic_apm_functions[] =
 {
     PHP_FE( elastic_apm_is_enabled, elastic_apm_no_paramters_arginfo )
+    PHP_FE( elastic_apm_is_request_ignored, elastic_apm_no_paramters_arginfo )
     PHP_FE( elastic_apm_get_config_option_by_name, elastic_apm_get_config_option_by_name_arginfo )
     PHP_FE( elastic_apm_get_number_of_dynamic_config_options, elastic_apm_no_paramters_arginfo )
     PHP_FE( elastic_apm_intercept_calls_to_internal_method, elastic_apm_intercept_calls_to_internal_method_arginfo )
     PHP_FE( elastic_apm_intercept_calls_to_internal_function, elastic_apm_intercept_calls_to_internal_function_arginfo )
+    PHP_FE( elastic_apm_intercept_calls_to_internal_method_as_fast_path_span, elastic_apm_intercept_calls_to_internal_method_as_fast_path_span_arginfo )
+    PHP_FE( elastic_apm_intercept_calls_to_internal_function_as_fast_path_span, elastic_apm_intercept_calls_to_internal_function_as_fast_path_span_arginfo )
+    PHP_FE( elastic_apm_set_fast_path_spans_recording, elastic_apm_set_fast_path_spans_recording_arginfo )
+    PHP_FE( elastic_apm_take_fast_path_spans, elastic_apm_take_fast_path_spans_arginfo )
+    PHP_FE( elastic_apm_intercept_calls_to_user_method, elastic_apm_intercept_calls_to_user_method_arginfo )
+    PHP_FE( elastic_apm_intercept_calls_to_user_function, elastic_apm_intercept_calls_to_user_function_arginfo )
     PHP_FE( elastic_apm_send_to_server, elastic_apm_send_to_server_arginfo )
+    PHP_FE( elastic_apm_send_events_to_server, elastic_apm_send_events_arginfo )
+    PHP_FE( elastic_apm_buffer_events, elastic_apm_send_events_arginfo )
+    PHP_FE( elastic_apm_serialize_events, elastic_apm_serialize_events_arginfo )
     PHP_FE( elastic_apm_log, elastic_apm_log_arginfo )
     PHP_FE( elastic_apm_get_last_thrown, elastic_apm_get_last_thrown_arginfo )
     PHP_FE( elastic_apm_get_last_php_error, elastic_apm_get_last_php_error_arginfo )
+    PHP_FE( elastic_apm_take_inferred_spans_samples, elastic_apm_take_inferred_spans_samples_arginfo )
+    PHP_FE( elastic_apm_get_inferred_spans_stats, elastic_apm_get_inferred_spans_stats_arginfo )
+    PHP_FE( elastic_apm_get_ast_process_stats, elastic_apm_get_ast_process_stats_arginfo )
     PHP_FE( elastic_apm_before_loading_agent_php_code, elastic_apm_before_loading_agent_php_code_arginfo )
     PHP_FE( elastic_apm_after_loading_agent_php_code, elastic_apm_after_loading_agent_php_code_arginfo )
     PHP_FE( elastic_apm_ast_instrumentation_pre_hook, elastic_apm_ast_instrumentation_pre_hook_arginfo )
     PHP_FE( elastic_apm_ast_instrumentation_direct_call, elastic_apm_ast_instrumentation_direct_call_arginfo )
+    PHP_FE( elastic_apm_write_sampled_heap_profile, elastic_apm_write_sampled_heap_profile_arginfo )
     PHP_FE_END
 };
 /* }}} */
@@ -24,11 +24,17 @@
 #include "log.h"
 #include "Tracer.h"
 #include "elastic_apm_alloc.h"
-#include "numbered_intercepting_callbacks.h"
 #include "tracer_PHP_part.h"
 #include "backend_comm.h"
+#include "events_buffer.h"
 #include "lifecycle.h"
 #include "ConfigSnapshot.h"
+#include "observer_instrumentation.h"
+#include "fast_path_spans.h"
+#include <algorithm>
+#include <exception>
+#include <unordered_map>
+#include <vector>
 
 #define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_EXT_API
 
@@ -83,22 +89,179 @@ UInt elasticApmGetNumberOfDynamicConfigOptions()
     return result;
 }
 
-enum { maxFunctionsToIntercept = numberedInterceptingCallbacksCount };
-static uint32_t g_nextFreeFunctionToInterceptId = 0;
 struct CallToInterceptData
 {
     zif_handler originalHandler;
-    zend_function* funcEntry;
+    uint32_t interceptRegistrationId;
+    // Handlers stay replaced for the whole worker lifetime (see resetCallInterceptionOnRequestShutdown)
+    // but PHP part's hooks are called only if PHP part registered the function again in the current request
+    bool isRegisteredInCurrentRequest;
 };
 typedef struct CallToInterceptData CallToInterceptData;
-static CallToInterceptData g_functionsToInterceptData[maxFunctionsToIntercept];
 
-static uint32_t g_interceptedCallInProgressRegistrationId = 0;
+// All the intercepted internal functions share the same handler which finds the registration by the called function.
+// Internal functions are allocated on module startup so the map is kept across requests.
+static std::unordered_map< zend_function*, CallToInterceptData > g_functionsToInterceptData;
+// Copies of intercepted internal methods inherited by user classes - the copies can be allocated per request
+// so unlike g_functionsToInterceptData this map is cleared on each request shutdown
+static std::unordered_map< zend_function*, zend_function* > g_inheritedFunctionToDeclared;
+
+struct InterceptedFunctionHandlerToRestore
+{
+    zend_function* funcEntry;
+    zif_handler originalHandler;
+};
+typedef struct InterceptedFunctionHandlerToRestore InterceptedFunctionHandlerToRestore;
+static std::vector< InterceptedFunctionHandlerToRestore > g_interceptedFunctionsHandlersToRestore;
+
+// Registration IDs are shared by both interception engines (replacing handler and Observer API)
+// so that PHP part can keep all the registrations in one map
+static uint32_t g_nextInterceptRegistrationId = 0;
+
+// Indexed by registration ID
+static std::vector< uint32_t > g_interceptedCallMaxCapturedArgsCount;
+
+void setInterceptedCallMaxCapturedArgsCount( uint32_t interceptRegistrationId, uint32_t maxCapturedArgsCount )
+{
+    try
+    {
+        if ( interceptRegistrationId >= g_interceptedCallMaxCapturedArgsCount.size() )
+        {
+            g_interceptedCallMaxCapturedArgsCount.resize( interceptRegistrationId + 1, maxInterceptedCallCapturedArgsCount );
+        }
+        g_interceptedCallMaxCapturedArgsCount[ interceptRegistrationId ] = std::min< uint32_t >( maxCapturedArgsCount, maxInterceptedCallCapturedArgsCount );
+    }
+    catch ( std::exception const& e )
+    {
+        ELASTIC_APM_LOG_ERROR( "Failed to set max captured arguments count: '%s'; interceptRegistrationId: %u", e.what(), interceptRegistrationId );
+    }
+}
+
+uint32_t getInterceptedCallMaxCapturedArgsCount( uint32_t interceptRegistrationId )
+{
+    return interceptRegistrationId < g_interceptedCallMaxCapturedArgsCount.size()
+           ? g_interceptedCallMaxCapturedArgsCount[ interceptRegistrationId ]
+           : maxInterceptedCallCapturedArgsCount;
+}
+
+// Fixed capacity so that intercepting a call does not allocate
+static InterceptedCallInProgress g_interceptedCallsInProgress[ maxInterceptedCallsNestingDepth ];
+static uint32_t g_interceptedCallsInProgressCount = 0;
+
+InterceptedCallInProgress* pushInterceptedCallInProgress( zend_execute_data* executeData, uint32_t interceptRegistrationId )
+{
+    if ( g_interceptedCallsInProgressCount >= maxInterceptedCallsNestingDepth )
+    {
+        return NULL;
+    }
+
+    InterceptedCallInProgress* call = &( g_interceptedCallsInProgress[ g_interceptedCallsInProgressCount ++ ] );
+    call->executeData = executeData;
+    call->interceptRegistrationId = interceptRegistrationId;
+    call->shouldCallPostHook = false;
+    call->fastPathSpanSequenceNumber = 0;
+    return call;
+}
+
+InterceptedCallInProgress* topInterceptedCallInProgress()
+{
+    return g_interceptedCallsInProgressCount == 0 ? NULL : &( g_interceptedCallsInProgress[ g_interceptedCallsInProgressCount - 1 ] );
+}
+
+void popInterceptedCallInProgress()
+{
+    if ( g_interceptedCallsInProgressCount != 0 )
+    {
+        -- g_interceptedCallsInProgressCount;
+    }
+}
+
+// Class extending internal class gets its own copies of the inherited internal methods
+// (with the already replaced handler if the class is declared after the method was intercepted)
+// but the copy keeps the declaring class as its scope
+static
+zend_function* findDeclaredFunctionOfInheritedCopy( zend_function* func )
+{
+    if ( func->common.scope == NULL || func->common.function_name == NULL )
+    {
+        return NULL;
+    }
+
+    zend_string* lowerCaseName = zend_string_tolower( func->common.function_name );
+    auto declaredFunc = static_cast< zend_function* >( zend_hash_find_ptr( &func->common.scope->function_table, lowerCaseName ) );
+    zend_string_release( lowerCaseName );
+    return declaredFunc == func ? NULL : declaredFunc;
+}
+
+static
+const CallToInterceptData* findCallToInterceptData( zend_function* func )
+{
+    auto found = g_functionsToInterceptData.find( func );
+    if ( found != g_functionsToInterceptData.end() )
+    {
+        return &( found->second );
+    }
+
+    auto inherited = g_inheritedFunctionToDeclared.find( func );
+    if ( inherited != g_inheritedFunctionToDeclared.end() )
+    {
+        found = g_functionsToInterceptData.find( inherited->second );
+        return found == g_functionsToInterceptData.end() ? NULL : &( found->second );
+    }
+
+    zend_function* declaredFunc = findDeclaredFunctionOfInheritedCopy( func );
+    if ( declaredFunc == NULL )
+    {
+        return NULL;
+    }
+
+    found = g_functionsToInterceptData.find( declaredFunc );
+    if ( found == g_functionsToInterceptData.end() )
+    {
+        return NULL;
+    }
+
+    // remembered so that the next call of the copy is found directly
+    g_inheritedFunctionToDeclared.emplace( func, declaredFunc );
+    return &( found->second );
+}
 
 static
-void internalFunctionCallInterceptingImpl( uint32_t interceptRegistrationId, zend_execute_data* execute_data, zval* return_value )
+ZEND_NAMED_FUNCTION( internalFunctionCallInterceptingImpl )
 {
     ResultCode resultCode;
+    const CallToInterceptData* const data = findCallToInterceptData( execute_data->func );
+    if ( data == NULL )
+    {
+        // Copy of the inherited method can outlive the registration (e.g. class cached by opcache
+        // while the method was intercepted) - after the registrations are invalidated the declared method
+        // has its original handler back so the call falls through to it.
+        // The copy's handler is not patched since the copy can be in memory shared with other processes.
+        zend_function* declaredFunc = findDeclaredFunctionOfInheritedCopy( execute_data->func );
+        if ( declaredFunc != NULL && declaredFunc->type == ZEND_INTERNAL_FUNCTION
+             && declaredFunc->internal_function.handler != internalFunctionCallInterceptingImpl )
+        {
+            ELASTIC_APM_LOG_TRACE( "Intercepted function is not registered - calling handler of the declared function; function: `%s'"
+                                   , ZSTR_VAL( execute_data->func->common.function_name ) );
+            declaredFunc->internal_function.handler( execute_data, return_value );
+            return;
+        }
+
+        ELASTIC_APM_LOG_CRITICAL( "Intercepted function is not registered - it cannot be called. function: `%s'"
+                                  , execute_data->func->common.function_name == NULL ? "<unknown>" : ZSTR_VAL( execute_data->func->common.function_name ) );
+        zend_throw_error( NULL, "Elastic APM: intercepted function is not registered" );
+        return;
+    }
+    // copied because the map may change while the call is in progress (PHP part may register more functions)
+    const zif_handler originalHandler = data->originalHandler;
+    const uint32_t interceptRegistrationId = data->interceptRegistrationId;
+
+    if ( ! data->isRegisteredInCurrentRequest )
+    {
+        // PHP part did not register this function (yet) in the current request
+        originalHandler( execute_data, return_value );
+        return;
+    }
 
     // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
     // which might deadlock in forked child
@@ -108,25 +271,34 @@ void internalFunctionCallInterceptingImpl( uint32_t interceptRegistrationId, zen
 
     bool shouldCallPostHook;
 
-    if ( g_interceptedCallInProgressRegistrationId != 0 )
+    if ( isFastPathSpansRegistration( interceptRegistrationId ) )
     {
-        ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY_MSG(
-                "There's already an intercepted call in progress with interceptRegistrationId: %u."
-                "Nesting intercepted calls is not supported yet so invoking the original handler directly..."
-                , g_interceptedCallInProgressRegistrationId );
-        g_functionsToInterceptData[ interceptRegistrationId ].originalHandler( execute_data, return_value );
-        return;
+        // PHP part is not called at all - it takes the recorded span later
+        const uint32_t fastPathSpanSequenceNumber = fastPathSpanOnCallBegin( interceptRegistrationId, execute_data );
+        originalHandler( execute_data, return_value );
+        if ( fastPathSpanSequenceNumber != 0 )
+        {
+            fastPathSpanOnCallEnd( fastPathSpanSequenceNumber, return_value );
+        }
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
     }
 
-    g_interceptedCallInProgressRegistrationId = interceptRegistrationId;
+    if ( pushInterceptedCallInProgress( execute_data, interceptRegistrationId ) == NULL )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Intercepted calls are nested too deep (maxInterceptedCallsNestingDepth: %u) so invoking the original handler directly..."
+                               , (unsigned) maxInterceptedCallsNestingDepth );
+        originalHandler( execute_data, return_value );
+        return;
+    }
 
+    // frame is not referenced across the calls below - nested intercepted calls push and pop above it
     shouldCallPostHook = tracerPhpPartInternalFuncCallPreHook( interceptRegistrationId, execute_data );
-    g_functionsToInterceptData[ interceptRegistrationId ].originalHandler( execute_data, return_value );
+    originalHandler( execute_data, return_value );
     if ( shouldCallPostHook ) {
-        tracerPhpPartInternalFuncCallPostHook( interceptRegistrationId, return_value );
+        tracerPhpPartInternalFuncCallPostHook( interceptRegistrationId, /* hasExitedByException */ false, return_value );
     }
 
-    g_interceptedCallInProgressRegistrationId = 0;
+    popInterceptedCallInProgress();
 
     ELASTIC_APM_LOG_TRACE_FUNCTION_EXIT_MSG( "interceptRegistrationId: %u", interceptRegistrationId );
     resultCode = resultSuccess;
@@ -139,37 +311,109 @@ void internalFunctionCallInterceptingImpl( uint32_t interceptRegistrationId, zen
 
 void resetCallInterceptionOnRequestShutdown()
 {
+    // Replaced handlers and registration IDs are kept for the next request in the same worker -
+    // PHP part registers its hooks again (it cannot keep PHP callbacks across requests)
+    // but it gets back the same IDs and the handlers are not replaced and restored on every request
+    for ( auto& functionToInterceptData : g_functionsToInterceptData )
+    {
+        functionToInterceptData.second.isRegisteredInCurrentRequest = false;
+    }
+    g_inheritedFunctionToDeclared.clear();
+    // frames of calls exited by bailout are never popped
+    g_interceptedCallsInProgressCount = 0;
+
+    observerInstrumentationOnRequestShutdown();
+    fastPathSpansOnRequestShutdown();
+}
+
+void invalidateCallInterceptionRegistrations( String reason )
+{
+    ELASTIC_APM_LOG_DEBUG( "Invalidating registrations of intercepted calls; reason: %s; number of replaced handlers: %u"
+                           , reason, (unsigned) g_interceptedFunctionsHandlersToRestore.size() );
+
     // We restore original handlers in the reverse order
     // so that if the same function is registered for interception more than once
     // the original handler will be restored correctly
-    ELASTIC_APM_FOR_EACH_BACKWARDS( i, g_nextFreeFunctionToInterceptId )
+    for ( auto it = g_interceptedFunctionsHandlersToRestore.rbegin(); it != g_interceptedFunctionsHandlersToRestore.rend(); ++it )
     {
-        CallToInterceptData* data = &( g_functionsToInterceptData[ i ] );
-
-        data->funcEntry->internal_function.handler = data->originalHandler;
+        it->funcEntry->internal_function.handler = it->originalHandler;
     }
 
-    g_nextFreeFunctionToInterceptId = 0;
+    g_interceptedFunctionsHandlersToRestore.clear();
+    g_functionsToInterceptData.clear();
+    g_inheritedFunctionToDeclared.clear();
+    g_interceptedCallMaxCapturedArgsCount.clear();
+    g_nextInterceptRegistrationId = 0;
+
+    observerInstrumentationInvalidateRegistrations();
 }
 
 bool addToFunctionsToInterceptData( zend_function* funcEntry, uint32_t* interceptRegistrationId, zif_handler replacementFunc )
 {
-    if ( g_nextFreeFunctionToInterceptId >= maxFunctionsToIntercept )
+    try
     {
-        ELASTIC_APM_LOG_ERROR( "Reached maxFunctionsToIntercept."
-                               " maxFunctionsToIntercept: %u. g_nextFreeFunctionToInterceptId: %u."
-                               , maxFunctionsToIntercept, g_nextFreeFunctionToInterceptId );
+        if ( replacementFunc != NULL )
+        {
+            *interceptRegistrationId = g_nextInterceptRegistrationId ++;
+            if ( funcEntry->internal_function.handler == replacementFunc )
+            {
+                // replaced in one of the previous requests
+                return true;
+            }
+            g_interceptedFunctionsHandlersToRestore.push_back( { funcEntry, funcEntry->internal_function.handler } );
+            g_functionsToInterceptData.erase( funcEntry );
+            funcEntry->internal_function.handler = replacementFunc;
+            return true;
+        }
+
+        auto found = g_functionsToInterceptData.find( funcEntry );
+        if ( found != g_functionsToInterceptData.end() && funcEntry->internal_function.handler == internalFunctionCallInterceptingImpl )
+        {
+            if ( found->second.isRegisteredInCurrentRequest )
+            {
+                // Function is already intercepted in this request - the latest registration is the one whose hooks are called
+                found->second.interceptRegistrationId = g_nextInterceptRegistrationId ++;
+            }
+            // otherwise it was registered in one of the previous requests and the same ID is given back
+            found->second.isRegisteredInCurrentRequest = true;
+            *interceptRegistrationId = found->second.interceptRegistrationId;
+            return true;
+        }
+
+        *interceptRegistrationId = g_nextInterceptRegistrationId ++;
+        g_interceptedFunctionsHandlersToRestore.push_back( { funcEntry, funcEntry->internal_function.handler } );
+        g_functionsToInterceptData[ funcEntry ] = CallToInterceptData{ funcEntry->internal_function.handler, *interceptRegistrationId, /* isRegisteredInCurrentRequest */ true };
+        funcEntry->internal_function.handler = internalFunctionCallInterceptingImpl;
+    }
+    catch ( std::exception const& e )
+    {
+        ELASTIC_APM_LOG_ERROR( "Failed to register function for interception: '%s'", e.what() );
         return false;
     }
 
-    *interceptRegistrationId = g_nextFreeFunctionToInterceptId ++;
-    g_functionsToInterceptData[ *interceptRegistrationId ].funcEntry = funcEntry;
-    g_functionsToInterceptData[ *interceptRegistrationId ].originalHandler = funcEntry->internal_function.handler;
-    funcEntry->internal_function.handler = ( replacementFunc == NULL ) ? g_numberedInterceptingCallback[ *interceptRegistrationId ] : replacementFunc;
-
     return true;
 }
 
+static
+ResultCode interceptCallsViaObserver( StringView className, StringView functionName, uint32_t* interceptRegistrationId )
+{
+    ResultCode resultCode;
+    const uint32_t newInterceptRegistrationId = g_nextInterceptRegistrationId;
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( observerInstrumentationInterceptCallsTo( className, functionName, newInterceptRegistrationId, interceptRegistrationId ) );
+    if ( *interceptRegistrationId == newInterceptRegistrationId )
+    {
+        ++g_nextInterceptRegistrationId;
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
 ResultCode elasticApmInterceptCallsToInternalMethod( String className, String methodName, uint32_t* interceptRegistrationId )
 {
     ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "className: `%s'; methodName: `%s'", className, methodName );
@@ -189,6 +433,15 @@ ResultCode elasticApmInterceptCallsToInternalMethod( String className, String me
         ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
     }
 
+    if ( canObserveInternalFunctions() )
+    {
+        // Observer is selected by the name of the class declaring the method
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( interceptCallsViaObserver( makeStringView( ZSTR_VAL( funcEntry->common.scope->name ), ZSTR_LEN( funcEntry->common.scope->name ) )
+                                                                    , makeStringViewFromString( methodName )
+                                                                    , interceptRegistrationId ) );
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+    }
+
     if ( ! addToFunctionsToInterceptData( funcEntry, interceptRegistrationId, /* replacementFunc */ NULL) )
     {
         ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
@@ -218,6 +471,12 @@ ResultCode elasticApmInterceptCallsToInternalFunctionEx( String functionName, ui
         ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
     }
 
+    if ( replacementFunc == NULL && canObserveInternalFunctions() )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( interceptCallsViaObserver( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "" ), makeStringViewFromString( functionName ), interceptRegistrationId ) );
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+    }
+
     if ( ! addToFunctionsToInterceptData( funcEntry, interceptRegistrationId, replacementFunc ) )
     {
         ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
@@ -239,6 +498,82 @@ ResultCode elasticApmInterceptCallsToInternalFunction( String functionName, uint
     return elasticApmInterceptCallsToInternalFunctionEx( functionName, interceptRegistrationId, /* replacementFunc */ NULL );
 }
 
+static
+ResultCode registerFastPathSpan( String dbgFunctionDesc, int statementArgIndex, ResultCode interceptResultCode, uint32_t* interceptRegistrationId )
+{
+    ResultCode resultCode;
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( interceptResultCode );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( fastPathSpansRegister( *interceptRegistrationId, statementArgIndex ) );
+
+    resultCode = resultSuccess;
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT_MSG( "function: %s; interceptRegistrationId: %u", dbgFunctionDesc, *interceptRegistrationId );
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static
+bool isFastPathSpansEnabled()
+{
+    if ( getTracerCurrentConfigSnapshot( getGlobalTracer() )->nativeFastPathSpansEnabled )
+    {
+        return true;
+    }
+
+    ELASTIC_APM_LOG_DEBUG( "Fast path spans are disabled because configuration option %s is set to false", ELASTIC_APM_CFG_OPT_NAME_NATIVE_FAST_PATH_SPANS_ENABLED );
+    return false;
+}
+
+ResultCode elasticApmInterceptCallsToInternalMethodAsFastPathSpan( String className, String methodName, int statementArgIndex, uint32_t* interceptRegistrationId )
+{
+    if ( ! isFastPathSpansEnabled() )
+    {
+        return resultFailure;
+    }
+
+    return registerFastPathSpan( methodName
+                                 , statementArgIndex
+                                 , elasticApmInterceptCallsToInternalMethod( className, methodName, interceptRegistrationId )
+                                 , interceptRegistrationId );
+}
+
+ResultCode elasticApmInterceptCallsToInternalFunctionAsFastPathSpan( String functionName, int statementArgIndex, uint32_t* interceptRegistrationId )
+{
+    if ( ! isFastPathSpansEnabled() )
+    {
+        return resultFailure;
+    }
+
+    return registerFastPathSpan( functionName
+                                 , statementArgIndex
+                                 , elasticApmInterceptCallsToInternalFunction( functionName, interceptRegistrationId )
+                                 , interceptRegistrationId );
+}
+
+ResultCode elasticApmInterceptCallsToUserMethod( String className, String methodName, uint32_t* interceptRegistrationId )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "className: `%s'; methodName: `%s'", className, methodName );
+
+    // Class does not have to be loaded yet - observer matches calls by name
+    const ResultCode resultCode = interceptCallsViaObserver( makeStringViewFromString( className ), makeStringViewFromString( methodName ), interceptRegistrationId );
+
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT_MSG( "interceptRegistrationId: %u", *interceptRegistrationId );
+    return resultCode;
+}
+
+ResultCode elasticApmInterceptCallsToUserFunction( String functionName, uint32_t* interceptRegistrationId )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "functionName: `%s'", functionName );
+
+    const ResultCode resultCode = interceptCallsViaObserver( ELASTIC_APM_STRING_LITERAL_TO_VIEW( "" ), makeStringViewFromString( functionName ), interceptRegistrationId );
+
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT_MSG( "interceptRegistrationId: %u", *interceptRegistrationId );
+    return resultCode;
+}
+
 static inline bool longToBool( long longVal )
 {
     return longVal != 0;
@@ -261,3 +596,53 @@ ResultCode elasticApmSendToServer( StringView userAgentHttpHeader, StringView se
     failure:
     goto finally;
 }
+
+ResultCode elasticApmBufferEvents(
+        StringView userAgentHttpHeader
+        , zval* metadata
+        , zend_array* spans
+        , zend_array* errors
+        , zend_array* metricSets
+        , zval* transaction )
+{
+    ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY();
+
+    ResultCode resultCode;
+    Tracer* const tracer = getGlobalTracer();
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( eventsBufferAppend( getTracerCurrentConfigSnapshot( tracer ), userAgentHttpHeader, metadata, spans, errors, metricSets, transaction ) );
+
+    resultCode = resultSuccess;
+    finally:
+    ELASTIC_APM_LOG_TRACE_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+ResultCode elasticApmSendEventsToServer(
+        StringView userAgentHttpHeader
+        , zval* metadata
+        , zend_array* spans
+        , zend_array* errors
+        , zend_array* metricSets
+        , zval* transaction )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
+
+    ResultCode resultCode;
+    Tracer* const tracer = getGlobalTracer();
+
+    // Events buffered earlier in the request (see elasticApmBufferEvents) are sent in the same batch
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( eventsBufferAppend( getTracerCurrentConfigSnapshot( tracer ), userAgentHttpHeader, metadata, spans, errors, metricSets, transaction ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( eventsBufferFlush( getTracerCurrentConfigSnapshot( tracer ) ) );
+
+    resultCode = resultSuccess;
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
+    return resultCode;
+
+    failure:
+    goto finally;
+}
@@ -37,9 +37,70 @@ ResultCode elasticApmInterceptCallsToInternalMethod( String className, String me
 
 ResultCode elasticApmInterceptCallsToInternalFunction( String functionName, uint32_t* interceptRegistrationId );
 
+// Fails if fast path spans are disabled by configuration - PHP part should register regular pre/post hooks then
+ResultCode elasticApmInterceptCallsToInternalMethodAsFastPathSpan( String className, String methodName, int statementArgIndex, uint32_t* interceptRegistrationId );
+
+ResultCode elasticApmInterceptCallsToInternalFunctionAsFastPathSpan( String functionName, int statementArgIndex, uint32_t* interceptRegistrationId );
+
+// Available only when Observer API based interception is active (PHP 8+)
+ResultCode elasticApmInterceptCallsToUserMethod( String className, String methodName, uint32_t* interceptRegistrationId );
+
+ResultCode elasticApmInterceptCallsToUserFunction( String functionName, uint32_t* interceptRegistrationId );
+
+// Hooks of intercepted calls get only the first maxCapturedArgsCount arguments
+// so that arguments the hooks do not use are not copied and passed to PHP part
+void setInterceptedCallMaxCapturedArgsCount( uint32_t interceptRegistrationId, uint32_t maxCapturedArgsCount );
+// Returns maxInterceptedCallCapturedArgsCount unless it was limited by setInterceptedCallMaxCapturedArgsCount()
+uint32_t getInterceptedCallMaxCapturedArgsCount( uint32_t interceptRegistrationId );
+
+// Replaced handlers and registration IDs are kept across requests - PHP part's hooks are called only for the functions
+// registered again in the current request
 void resetCallInterceptionOnRequestShutdown();
+// Restores original handlers and forgets all the registrations (configuration change, opcache reset, module shutdown)
+void invalidateCallInterceptionRegistrations( String reason );
+
+/**
+ * Intercepted call in progress - shared by both interception engines so that calls intercepted by one of them
+ * can be nested in calls intercepted by the other one in the same order as PHP part keeps its post hooks
+ */
+struct InterceptedCallInProgress
+{
+    zend_execute_data* executeData;
+    uint32_t interceptRegistrationId;
+    bool shouldCallPostHook;
+    // 0 if the call is not recorded as fast path span
+    uint32_t fastPathSpanSequenceNumber;
+};
+typedef struct InterceptedCallInProgress InterceptedCallInProgress;
+
+enum { maxInterceptedCallsNestingDepth = 64 };
+enum { maxInterceptedCallCapturedArgsCount = 100 };
+
+// Returns NULL if maxInterceptedCallsNestingDepth is reached - the call should not be instrumented then
+InterceptedCallInProgress* pushInterceptedCallInProgress( zend_execute_data* executeData, uint32_t interceptRegistrationId );
+// Returns NULL if there is no intercepted call in progress
+InterceptedCallInProgress* topInterceptedCallInProgress();
+void popInterceptedCallInProgress();
 
 ResultCode elasticApmSendToServer( StringView userAgentHttpHeader, StringView serializedEvents );
 
+// Serializes events as NDJSON natively and keeps them in per-request buffer (see events_buffer.h)
+ResultCode elasticApmBufferEvents(
+        StringView userAgentHttpHeader
+        , zval* metadata
+        , zend_array* spans
+        , zend_array* errors
+        , zend_array* metricSets
+        , zval* transaction );
+
+// The same as elasticApmBufferEvents but the buffer is sent (the same way as elasticApmSendToServer) right away
+ResultCode elasticApmSendEventsToServer(
+        StringView userAgentHttpHeader
+        , zval* metadata
+        , zend_array* spans
+        , zend_array* errors
+        , zend_array* metricSets
+        , zval* transaction );
+
 void elasticApmBeforeLoadingAgentPhpCode();
 void elasticApmAfterLoadingAgentPhpCode();
@@ -54,7 +54,7 @@ void ELASTIC_APM_PEFREE_FUNC ( void* allocatedBlock, bool isPersistent );
                     ELASTIC_APM_STATIC_ARRAY_SIZE( stackTraceAddressesBuffer ) ); \
         } \
         (actuallyRequestedSizeVar) = \
-                memoryTrackerCalcSizeToAlloc( memTracker, (requestedSize), stackTraceAddressesCount ); \
+                memoryTrackerCalcSizeToAlloc( memTracker, (requestedSize) ); \
     }
 
 #define ELASTIC_APM_PHP_ALLOC_MEMORY_TRACKING_AFTER( isString, requestedSize, actuallyRequestedSize, isPersistent ) \
@@ -71,6 +71,10 @@ void ELASTIC_APM_PEFREE_FUNC ( void* allocatedBlock, bool isPersistent );
             isString, \
             &( stackTraceAddressesBuffer[ 0 ] ), \
             stackTraceAddressesCount ); \
+    } \
+    if ( isMemoryTrackerSamplingEnabled( memTracker ) ) \
+    { \
+        memoryTrackerSampledAfterAlloc( memTracker, (phpAllocIfFailedGotoTmpPtr), (requestedSize) ); \
     }
 
 #else // #if ( ELASTIC_APM_MEMORY_TRACKING_ENABLED_01 != 0 )
@@ -188,6 +192,7 @@ void poisonMemoryRange( Byte* rangeBegin, size_t rangeSize )
         possibleActuallyRequestedSize = originallyRequestedSize; \
         memoryTrackerBeforeFree( memTracker, (ptr), originallyRequestedSize, (isPersistent), &possibleActuallyRequestedSize ); \
     } \
+    memoryTrackerSampledBeforeFree( memTracker, (ptr) ); \
     \
     if ( possibleActuallyRequestedSize != 0 && getGlobalInternalChecksLevel() >= internalChecksLevel_2 ) \
     { \
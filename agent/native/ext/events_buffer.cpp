@@ -0,0 +1,160 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "events_buffer.h"
+#include "events_serialization.h"
+#include "backend_comm.h"
+#include "basic_types.h"
+#include "log.h"
+#include "platform.h"
+
+#include <php.h>
+
+#include <string>
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+// State below is per thread because in ZTS build requests are handled concurrently by threads of the same process
+// and each request's events have to be sent with its own metadata line
+
+// Metadata line followed by events lines - empty if there is nothing buffered.
+// The string is kept across requests so that it grows to the typical payload size once instead of on each request.
+static thread_local std::string g_bufferedEvents;
+static thread_local std::string g_bufferedEventsUserAgentHttpHeader;
+static thread_local UInt g_bufferedEventsCount = 0;
+// Events buffered before fork belong to the parent process - child must not send them again
+static thread_local pid_t g_bufferedEventsProcessId = -1;
+
+static
+void discardBufferedEvents()
+{
+    g_bufferedEvents.clear();
+    g_bufferedEventsCount = 0;
+}
+
+static
+void discardBufferedEventsIfInheritedOnFork()
+{
+    if ( ! g_bufferedEvents.empty() && g_bufferedEventsProcessId != getCurrentProcessId() )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Discarding %u events buffered by the parent process (PID: %d)", (unsigned) g_bufferedEventsCount, (int) g_bufferedEventsProcessId );
+        discardBufferedEvents();
+    }
+}
+
+static
+ResultCode appendEvents(
+        StringView userAgentHttpHeader
+        , zval* metadata
+        , zend_array* spans
+        , zend_array* errors
+        , zend_array* metricSets
+        , zval* transaction )
+{
+    ResultCode resultCode;
+    bool hasTransaction = transaction != NULL && Z_TYPE_P( transaction ) != IS_NULL;
+
+    if ( g_bufferedEvents.empty() )
+    {
+        g_bufferedEventsUserAgentHttpHeader.assign( userAgentHttpHeader.begin, userAgentHttpHeader.length );
+        g_bufferedEventsProcessId = getCurrentProcessId();
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( appendMetadataLineAsNdjson( metadata, g_bufferedEvents ) );
+    }
+
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( appendAllEventsLinesAsNdjson( spans, errors, metricSets, transaction, g_bufferedEvents ) );
+    g_bufferedEventsCount += zend_hash_num_elements( spans ) + zend_hash_num_elements( errors ) + zend_hash_num_elements( metricSets ) + ( hasTransaction ? 1 : 0 );
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+ResultCode eventsBufferAppend(
+        const ConfigSnapshot* config
+        , StringView userAgentHttpHeader
+        , zval* metadata
+        , zend_array* spans
+        , zend_array* errors
+        , zend_array* metricSets
+        , zval* transaction )
+{
+    ResultCode resultCode = resultFailure;
+    bool hasBailedOut = false;
+
+    discardBufferedEventsIfInheritedOnFork();
+    const size_t sizeBeforeAppend = g_bufferedEvents.length();
+
+    // Events are serialized by calling their jsonSerialize() so bailout can unwind through here -
+    // partially serialized events are dropped before it is propagated further
+    zend_try
+    {
+        resultCode = appendEvents( userAgentHttpHeader, metadata, spans, errors, metricSets, transaction );
+    }
+    zend_catch
+    {
+        hasBailedOut = true;
+    }
+    zend_end_try();
+
+    if ( hasBailedOut || resultCode != resultSuccess )
+    {
+        // Events buffered before are kept
+        g_bufferedEvents.resize( sizeBeforeAppend );
+        if ( hasBailedOut )
+        {
+            zend_bailout();
+        }
+        return resultCode;
+    }
+
+    if ( g_bufferedEvents.length() >= eventsBufferFlushThresholdInBytes )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Buffered events size (%zu) reached flush threshold (%zu)", g_bufferedEvents.length(), (size_t) eventsBufferFlushThresholdInBytes );
+        return eventsBufferFlush( config );
+    }
+    return resultSuccess;
+}
+
+ResultCode eventsBufferFlush( const ConfigSnapshot* config )
+{
+    ResultCode resultCode;
+
+    discardBufferedEventsIfInheritedOnFork();
+    if ( g_bufferedEvents.empty() )
+    {
+        return resultSuccess;
+    }
+
+    ELASTIC_APM_LOG_DEBUG( "Flushing %u buffered events; size: %zu", (unsigned) g_bufferedEventsCount, g_bufferedEvents.length() );
+    resultCode = sendEventsToApmServer( config
+                                        , makeStringView( g_bufferedEventsUserAgentHttpHeader.data(), g_bufferedEventsUserAgentHttpHeader.length() )
+                                        , makeStringView( g_bufferedEvents.data(), g_bufferedEvents.length() ) );
+    // Events are copied to the send queue (or already sent) - on failure they are dropped as they would be without buffering
+    discardBufferedEvents();
+    return resultCode;
+}
+
+void eventsBufferOnRequestShutdown( const ConfigSnapshot* config )
+{
+    // Spans buffered but not followed by their transaction (e.g. it was not ended) are still sent
+    eventsBufferFlush( config );
+}
@@ -0,0 +1,55 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+#include <zend_types.h>
+#include "ConfigSnapshot_forward_decl.h"
+#include "ResultCode.h"
+#include "StringView.h"
+
+/**
+ * Per-request buffer of events serialized as NDJSON (see events_serialization.h) - it batches span sends.
+ *
+ * Spans PHP part sends as they end are serialized right away (so PHP part does not keep their objects)
+ * and they are queued to be sent to APM Server together with their transaction - as one batch with one metadata line
+ * instead of a batch (with its own metadata line) per span.
+ * PHP part still builds each span object and its jsonSerialize() result - span fields are not appended to the buffer
+ * one by one because the list of fields (and when they are omitted) is kept only in jsonSerialize() implementations.
+ * Buffer is flushed when events other than spans are sent (e.g. the transaction ends),
+ * when it grows above eventsBufferFlushThresholdInBytes and on request shutdown.
+ */
+
+enum { eventsBufferFlushThresholdInBytes = 1024 * 1024 };
+
+/**
+ * @param transaction can be NULL
+ */
+ResultCode eventsBufferAppend(
+        const ConfigSnapshot* config
+        , StringView userAgentHttpHeader
+        , zval* metadata
+        , zend_array* spans
+        , zend_array* errors
+        , zend_array* metricSets
+        , zval* transaction );
+
+ResultCode eventsBufferFlush( const ConfigSnapshot* config );
+
+void eventsBufferOnRequestShutdown( const ConfigSnapshot* config );
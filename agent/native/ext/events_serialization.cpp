@@ -0,0 +1,365 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "events_serialization.h"
+#include "log.h"
+#include "JsonWriter.h"
+
+#include <php.h>
+#include <Zend/zend_hash.h>
+
+#include <string_view>
+#include <unordered_map>
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_BACKEND_COMM
+
+using elasticapm::php::JsonWriter;
+
+// The same as json_encode's default depth
+enum { maxJsonNestingDepth = 512 };
+
+static ResultCode appendZvalAsJson( JsonWriter& writer, zval* value, int depth );
+
+// jsonSerialize() is looked up once per class - NULL is kept for classes without it.
+// Classes declared by the application do not outlive the request so the map is cleared on each request shutdown.
+// The map is per thread because in ZTS build requests handled concurrently have their own classes.
+static thread_local std::unordered_map< const zend_class_entry*, zend_function* > g_classToJsonSerializeFunc;
+
+static
+std::string_view zStringToStdStringView( const zend_string* zStr )
+{
+    return std::string_view( ZSTR_VAL( zStr ), ZSTR_LEN( zStr ) );
+}
+
+// The same as json_encode - array is written as JSON array only if its keys are 0, 1, 2, ... in this order
+static
+bool isZarrayList( zend_array* zArray )
+{
+    zend_ulong expectedIndex = 0;
+    zend_ulong index;
+    zend_string* key;
+    ZEND_HASH_FOREACH_KEY( zArray, index, key )
+    {
+        if ( key != NULL || index != expectedIndex )
+        {
+            return false;
+        }
+        ++expectedIndex;
+    }
+    ZEND_HASH_FOREACH_END();
+    return true;
+}
+
+static
+void appendObjectKey( JsonWriter& writer, zend_ulong index, const zend_string* key )
+{
+    if ( key == NULL )
+    {
+        writer.appendRaw( '"' );
+        writer.appendInt( (zend_long) index );
+        writer.appendRaw( '"' );
+    }
+    else
+    {
+        writer.appendString( zStringToStdStringView( key ) );
+    }
+    writer.appendRaw( ':' );
+}
+
+static
+ResultCode appendZarrayAsJson( JsonWriter& writer, zend_array* zArray, bool isObject, int depth )
+{
+    ResultCode resultCode;
+    bool isFirst = true;
+    zend_ulong index;
+    zend_string* key;
+    zval* element;
+    bool asList = ( ! isObject ) && isZarrayList( zArray );
+
+    writer.appendRaw( asList ? '[' : '{' );
+    ZEND_HASH_FOREACH_KEY_VAL_IND( zArray, index, key, element )
+    {
+        // Declared properties which are uninitialized (typed) or unset are IS_UNDEF slots in the object's properties table -
+        // json_encode skips them. Checked explicitly so that it does not depend on what ZEND_HASH_FOREACH_*_IND skips.
+        if ( Z_TYPE_P( element ) == IS_UNDEF )
+        {
+            continue;
+        }
+        // Names of protected and private properties start with '\0' - json_encode skips them
+        if ( isObject && key != NULL && ZSTR_LEN( key ) != 0 && ZSTR_VAL( key )[ 0 ] == '\0' )
+        {
+            continue;
+        }
+        if ( ! isFirst )
+        {
+            writer.appendRaw( ',' );
+        }
+        isFirst = false;
+        if ( ! asList )
+        {
+            appendObjectKey( writer, index, key );
+        }
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( appendZvalAsJson( writer, element, depth ) );
+    }
+    ZEND_HASH_FOREACH_END();
+    writer.appendRaw( asList ? ']' : '}' );
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static
+zend_function* findJsonSerializeFunc( zend_class_entry* classEntry )
+{
+    auto found = g_classToJsonSerializeFunc.find( classEntry );
+    if ( found != g_classToJsonSerializeFunc.end() )
+    {
+        return found->second;
+    }
+
+    // Lookup by the method name instead of instanceof JsonSerializable so that json extension's symbols are not required on PHP 7
+    auto func = static_cast< zend_function* >( zend_hash_str_find_ptr( &( classEntry->function_table ), ZEND_STRL( "jsonserialize" ) ) );
+    g_classToJsonSerializeFunc.emplace( classEntry, func );
+    return func;
+}
+
+// Bailout (e.g. fatal error in jsonSerialize()) is not caught - it has to unwind to the caller
+static
+void callJsonSerialize( zend_function* jsonSerializeFunc, zval* object, zval* retVal )
+{
+#if PHP_VERSION_ID >= 80000
+    zend_call_known_instance_method_with_0_params( jsonSerializeFunc, Z_OBJ_P( object ), retVal );
+#else
+    zend_fcall_info fci;
+    zend_fcall_info_cache fcc;
+
+    fci.size = sizeof( fci );
+    ZVAL_UNDEF( &fci.function_name );
+    fci.object = Z_OBJ_P( object );
+    fci.retval = retVal;
+    fci.params = NULL;
+    fci.param_count = 0;
+    fci.no_separation = 1;
+
+#   if PHP_VERSION_ID < 70300
+    fcc.initialized = 1;
+#   endif
+    fcc.function_handler = jsonSerializeFunc;
+    fcc.calling_scope = Z_OBJCE_P( object );
+    fcc.called_scope = Z_OBJCE_P( object );
+    fcc.object = Z_OBJ_P( object );
+
+    zend_call_function( &fci, &fcc );
+#endif
+}
+
+static
+ResultCode appendObjectAsJson( JsonWriter& writer, zval* object, int depth )
+{
+    ResultCode resultCode;
+    zval serialized;
+    ZVAL_UNDEF( &serialized );
+    zend_class_entry* classEntry = Z_OBJCE_P( object );
+    zend_function* jsonSerializeFunc = findJsonSerializeFunc( classEntry );
+
+    if ( jsonSerializeFunc == NULL )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( appendZarrayAsJson( writer, Z_OBJPROP_P( object ), /* isObject */ true, depth ) );
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+    }
+
+    callJsonSerialize( jsonSerializeFunc, object, &serialized );
+    if ( EG( exception ) != NULL || Z_ISUNDEF( serialized ) )
+    {
+        ELASTIC_APM_LOG_ERROR( "jsonSerialize() failed; class: %s", ZSTR_VAL( classEntry->name ) );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    // The same as json_encode - object returning itself from jsonSerialize() is written as its properties
+    if ( Z_TYPE( serialized ) == IS_OBJECT && Z_OBJ( serialized ) == Z_OBJ_P( object ) )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( appendZarrayAsJson( writer, Z_OBJPROP_P( object ), /* isObject */ true, depth ) );
+    }
+    else
+    {
+        // The value returned by jsonSerialize() is at the same depth as the object itself
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( appendZvalAsJson( writer, &serialized, depth - 1 ) );
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    zval_ptr_dtor( &serialized );
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static
+ResultCode appendZvalAsJson( JsonWriter& writer, zval* value, int depth )
+{
+    ResultCode resultCode;
+
+    ZVAL_DEREF( value );
+    switch ( Z_TYPE_P( value ) )
+    {
+        case IS_UNDEF:
+        case IS_NULL:
+            writer.appendNull();
+            break;
+
+        case IS_FALSE:
+            writer.appendBool( false );
+            break;
+
+        case IS_TRUE:
+            writer.appendBool( true );
+            break;
+
+        case IS_LONG:
+            writer.appendInt( Z_LVAL_P( value ) );
+            break;
+
+        case IS_DOUBLE:
+            if ( ! writer.appendDouble( Z_DVAL_P( value ) ) )
+            {
+                ELASTIC_APM_LOG_ERROR( "Inf and NaN cannot be serialized as JSON" );
+                ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+            }
+            break;
+
+        case IS_STRING:
+            writer.appendString( zStringToStdStringView( Z_STR_P( value ) ) );
+            break;
+
+        case IS_ARRAY:
+        case IS_OBJECT:
+            if ( depth >= maxJsonNestingDepth )
+            {
+                ELASTIC_APM_LOG_ERROR( "Maximum nesting depth (%d) is exceeded", (int) maxJsonNestingDepth );
+                ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+            }
+            if ( Z_TYPE_P( value ) == IS_ARRAY )
+            {
+                ELASTIC_APM_CALL_IF_FAILED_GOTO( appendZarrayAsJson( writer, Z_ARRVAL_P( value ), /* isObject */ false, depth + 1 ) );
+            }
+            else
+            {
+                ELASTIC_APM_CALL_IF_FAILED_GOTO( appendObjectAsJson( writer, value, depth + 1 ) );
+            }
+            break;
+
+        default:
+            ELASTIC_APM_LOG_ERROR( "Type is not supported; type: %s", zend_get_type_by_const( Z_TYPE_P( value ) ) );
+            ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+static
+ResultCode appendLine( JsonWriter& writer, std::string_view eventKind, zval* event, bool isFirstLine )
+{
+    ResultCode resultCode;
+
+    if ( ! isFirstLine )
+    {
+        writer.appendRaw( '\n' );
+    }
+    writer.appendRaw( "{\"" );
+    writer.appendRaw( eventKind );
+    writer.appendRaw( "\":" );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( appendZvalAsJson( writer, event, /* depth */ 1 ) );
+    writer.appendRaw( '}' );
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    ELASTIC_APM_LOG_ERROR( "Failed to serialize %.*s", (int) eventKind.length(), eventKind.data() );
+    goto finally;
+}
+
+ResultCode appendMetadataLineAsNdjson( zval* metadata, std::string& ndjson )
+{
+    JsonWriter writer( ndjson );
+    return appendLine( writer, "metadata", metadata, /* isFirstLine */ true );
+}
+
+ResultCode appendEventLineAsNdjson( std::string_view eventKind, zval* event, std::string& ndjson )
+{
+    JsonWriter writer( ndjson );
+    return appendLine( writer, eventKind, event, /* isFirstLine */ false );
+}
+
+ResultCode appendEventsLinesAsNdjson( std::string_view eventKind, zend_array* events, std::string& ndjson )
+{
+    ResultCode resultCode;
+    JsonWriter writer( ndjson );
+    zval* event;
+
+    ZEND_HASH_FOREACH_VAL( events, event )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( appendLine( writer, eventKind, event, /* isFirstLine */ false ) );
+    }
+    ZEND_HASH_FOREACH_END();
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+ResultCode appendAllEventsLinesAsNdjson( zend_array* spans, zend_array* errors, zend_array* metricSets, zval* transaction, std::string& ndjson )
+{
+    ResultCode resultCode;
+
+    // Order of the lines is the same as it was when payload was built by PHP part
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( appendEventsLinesAsNdjson( "span", spans, ndjson ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( appendEventsLinesAsNdjson( "error", errors, ndjson ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( appendEventsLinesAsNdjson( "metricset", metricSets, ndjson ) );
+    if ( transaction != NULL && Z_TYPE_P( transaction ) != IS_NULL )
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( appendEventLineAsNdjson( "transaction", transaction, ndjson ) );
+    }
+
+    resultCode = resultSuccess;
+    finally:
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+void eventsSerializationOnRequestShutdown()
+{
+    g_classToJsonSerializeFunc.clear();
+}
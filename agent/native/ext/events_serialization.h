@@ -0,0 +1,50 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+#include <zend_types.h>
+#include "ResultCode.h"
+#include <string>
+#include <string_view>
+
+/**
+ * Functions below append lines of intake API NDJSON payload to ndjson - metadata line has to be the first one.
+ *
+ * Events are PHP part's objects (Metadata, Span, Error, MetricSet, Transaction, ...) - each one is serialized using its jsonSerialize()
+ * and the result is written directly to ndjson, the same way as json_encode would do it
+ * but without intermediate string per event and concatenating them in PHP.
+ *
+ * On failure ndjson may contain part of the line and exception thrown by jsonSerialize() (if any) is left for the caller.
+ * Bailout in jsonSerialize() is not caught either.
+ */
+ResultCode appendMetadataLineAsNdjson( zval* metadata, std::string& ndjson );
+
+ResultCode appendEventLineAsNdjson( std::string_view eventKind, zval* event, std::string& ndjson );
+
+ResultCode appendEventsLinesAsNdjson( std::string_view eventKind, zend_array* events, std::string& ndjson );
+
+/**
+ * Appends lines of spans, errors, metric sets and transaction - in this order, the same as PHP part used to build the payload
+ *
+ * @param transaction can be NULL
+ */
+ResultCode appendAllEventsLinesAsNdjson( zend_array* spans, zend_array* errors, zend_array* metricSets, zval* transaction, std::string& ndjson );
+
+void eventsSerializationOnRequestShutdown();
@@ -0,0 +1,264 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "fast_path_spans.h"
+#include <php.h>
+#include <chrono>
+#include <exception>
+#include <unordered_map>
+#include <vector>
+#include "log.h"
+#include "time_util.h"
+#include "util.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_EXT_API
+
+struct FastPathSpan
+{
+    uint32_t sequenceNumber;
+    uint32_t interceptRegistrationId;
+    // References below are owned by the buffer until the span is taken by PHP part
+    zend_object* thisObj;
+    zend_string* statement;
+    zend_object* thrown;
+    UInt64 timestampMicroseconds;
+    std::chrono::steady_clock::time_point monotonicBeginTime;
+    double durationMilliseconds;
+    bool hasReturnedFalse;
+    bool hasEnded;
+};
+typedef struct FastPathSpan FastPathSpan;
+
+// State below is per request - it is per thread because in ZTS build requests are handled concurrently by threads of the same process
+
+// Value is the index of the argument to keep as statement
+static thread_local std::unordered_map< uint32_t, int > g_fastPathSpansRegistrations;
+static thread_local std::vector< FastPathSpan > g_fastPathSpans;
+static thread_local uint32_t g_nextFastPathSpanSequenceNumber = 1;
+static thread_local UInt64 g_fastPathSpansDroppedCount = 0;
+static thread_local bool g_isFastPathSpansRecording = false;
+
+ResultCode fastPathSpansRegister( uint32_t interceptRegistrationId, int statementArgIndex )
+{
+    try
+    {
+        g_fastPathSpansRegistrations[ interceptRegistrationId ] = statementArgIndex;
+    }
+    catch ( std::exception const& e )
+    {
+        ELASTIC_APM_LOG_ERROR( "Failed to register fast path span: '%s'; interceptRegistrationId: %u", e.what(), interceptRegistrationId );
+        return resultOutOfMemory;
+    }
+
+    ELASTIC_APM_LOG_DEBUG( "Registered fast path span; interceptRegistrationId: %u; statementArgIndex: %d", interceptRegistrationId, statementArgIndex );
+    return resultSuccess;
+}
+
+bool isFastPathSpansRegistration( uint32_t interceptRegistrationId )
+{
+    return ! g_fastPathSpansRegistrations.empty() && g_fastPathSpansRegistrations.find( interceptRegistrationId ) != g_fastPathSpansRegistrations.end();
+}
+
+void fastPathSpansSetRecording( bool isRecording )
+{
+    ELASTIC_APM_LOG_TRACE( "isRecording: %s", boolToString( isRecording ) );
+    g_isFastPathSpansRecording = isRecording;
+}
+
+static
+void releaseFastPathSpan( FastPathSpan* span )
+{
+    if ( span->thisObj != NULL )
+    {
+        OBJ_RELEASE( span->thisObj );
+    }
+    if ( span->statement != NULL )
+    {
+        zend_string_release( span->statement );
+    }
+    if ( span->thrown != NULL )
+    {
+        OBJ_RELEASE( span->thrown );
+    }
+}
+
+uint32_t fastPathSpanOnCallBegin( uint32_t interceptRegistrationId, zend_execute_data* execute_data )
+{
+    if ( ! g_isFastPathSpansRecording )
+    {
+        return 0;
+    }
+
+    auto registration = g_fastPathSpansRegistrations.find( interceptRegistrationId );
+    if ( registration == g_fastPathSpansRegistrations.end() )
+    {
+        return 0;
+    }
+
+    if ( g_fastPathSpans.size() >= fastPathSpansMaxBufferedCount )
+    {
+        ++g_fastPathSpansDroppedCount;
+        return 0;
+    }
+
+    FastPathSpan span = {};
+    span.sequenceNumber = g_nextFastPathSpanSequenceNumber++;
+    if ( g_nextFastPathSpanSequenceNumber == 0 )
+    {
+        // 0 is reserved for "not recorded"
+        g_nextFastPathSpanSequenceNumber = 1;
+    }
+    span.interceptRegistrationId = interceptRegistrationId;
+
+    const uint32_t argsCount = ZEND_CALL_NUM_ARGS( execute_data );
+    if ( Z_TYPE( execute_data->This ) == IS_OBJECT )
+    {
+        span.thisObj = Z_OBJ( execute_data->This );
+    }
+    else if ( argsCount != 0 && Z_TYPE_P( ZEND_CALL_ARG( execute_data, 1 ) ) == IS_OBJECT )
+    {
+        // procedural style API (for example mysqli_query) takes the connection as the first argument
+        span.thisObj = Z_OBJ_P( ZEND_CALL_ARG( execute_data, 1 ) );
+    }
+
+    const int statementArgIndex = registration->second;
+    if ( statementArgIndex >= 0 && (uint32_t) statementArgIndex < argsCount )
+    {
+        zval* statementArg = ZEND_CALL_ARG( execute_data, statementArgIndex + 1 );
+        ZVAL_DEREF( statementArg );
+        if ( Z_TYPE_P( statementArg ) == IS_STRING )
+        {
+            // statement is not copied - only its reference count is incremented
+            span.statement = zend_string_copy( Z_STR_P( statementArg ) );
+        }
+    }
+
+    if ( span.thisObj != NULL )
+    {
+        GC_ADDREF( span.thisObj );
+    }
+
+    span.timestampMicroseconds = getCurrentTimeEpochMicroseconds();
+    span.monotonicBeginTime = std::chrono::steady_clock::now();
+
+    try
+    {
+        g_fastPathSpans.push_back( span );
+    }
+    catch ( std::exception const& e )
+    {
+        ELASTIC_APM_LOG_ERROR( "Failed to record fast path span: '%s'", e.what() );
+        releaseFastPathSpan( &span );
+        return 0;
+    }
+
+    return span.sequenceNumber;
+}
+
+void fastPathSpanOnCallEnd( uint32_t spanSequenceNumber, const zval* returnValue )
+{
+    const auto monotonicEndTime = std::chrono::steady_clock::now();
+
+    // The call is almost always the last one recorded - only calls made by PHP code run during the call can follow it
+    for ( auto it = g_fastPathSpans.rbegin(); it != g_fastPathSpans.rend(); ++it )
+    {
+        if ( it->sequenceNumber != spanSequenceNumber )
+        {
+            continue;
+        }
+
+        it->durationMilliseconds = std::chrono::duration< double, std::milli >( monotonicEndTime - it->monotonicBeginTime ).count();
+        if ( EG( exception ) != NULL )
+        {
+            it->thrown = EG( exception );
+            GC_ADDREF( it->thrown );
+        }
+        it->hasReturnedFalse = ( returnValue != NULL && Z_TYPE_P( returnValue ) == IS_FALSE );
+        it->hasEnded = true;
+        return;
+    }
+}
+
+static
+void addObjectOrNull( zval* array, zend_object* obj )
+{
+    if ( obj == NULL )
+    {
+        add_next_index_null( array );
+        return;
+    }
+
+    zval objZval;
+    // the reference owned by the buffer is moved to the array
+    ZVAL_OBJ( &objZval, obj );
+    add_next_index_zval( array, &objZval );
+}
+
+void fastPathSpansTake( zval* return_value )
+{
+    array_init( return_value );
+    add_next_index_long( return_value, (zend_long) g_fastPathSpansDroppedCount );
+    g_fastPathSpansDroppedCount = 0;
+
+    zval spans;
+    array_init_size( &spans, (uint32_t) g_fastPathSpans.size() );
+    // Calls still in progress are kept in the buffer
+    size_t keptCount = 0;
+    for ( const FastPathSpan& span : g_fastPathSpans )
+    {
+        if ( ! span.hasEnded )
+        {
+            g_fastPathSpans[ keptCount++ ] = span;
+            continue;
+        }
+
+        zval spanZval;
+        array_init_size( &spanZval, 7 );
+        add_next_index_long( &spanZval, (zend_long) span.interceptRegistrationId );
+        addObjectOrNull( &spanZval, span.thisObj );
+        if ( span.statement == NULL )
+        {
+            add_next_index_null( &spanZval );
+        }
+        else
+        {
+            add_next_index_str( &spanZval, span.statement );
+        }
+        add_next_index_double( &spanZval, (double) span.timestampMicroseconds );
+        add_next_index_double( &spanZval, span.durationMilliseconds );
+        addObjectOrNull( &spanZval, span.thrown );
+        add_next_index_bool( &spanZval, span.hasReturnedFalse );
+        add_next_index_zval( &spans, &spanZval );
+    }
+    g_fastPathSpans.resize( keptCount );
+
+    add_next_index_zval( return_value, &spans );
+}
+
+void fastPathSpansOnRequestShutdown()
+{
+    for ( FastPathSpan& span : g_fastPathSpans )
+    {
+        releaseFastPathSpan( &span );
+    }
+    g_fastPathSpans.clear();
+    g_fastPathSpansRegistrations.clear();
+    g_fastPathSpansDroppedCount = 0;
+    g_isFastPathSpansRecording = false;
+}
@@ -0,0 +1,67 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <zend_types.h>
+#include "ResultCode.h"
+
+/**
+ * Fast path spans - calls to internal functions that PHP part registered as fast path spans (DB queries)
+ * are timed by the extension without calling PHP part's pre/post hooks.
+ * Only the start time, the duration, the statement argument, the object the call was made on and the outcome
+ * are kept in a native buffer and PHP part takes them when the current span changes or the transaction ends.
+ * So for each call PHP part pays nothing, and PHP span objects are created only for calls
+ * made while a sampled transaction is in progress - PHP part then builds them through the usual span API
+ * so transaction_max_spans and span compression apply to them as to any other span.
+ *
+ * Calls are recorded only while PHP part has recording enabled (there is a sampled transaction).
+ */
+
+enum { fastPathSpansMaxBufferedCount = 1000 };
+
+/**
+ * @param statementArgIndex index of the argument to keep as statement or -1 if there is no such argument
+ */
+ResultCode fastPathSpansRegister( uint32_t interceptRegistrationId, int statementArgIndex );
+
+bool isFastPathSpansRegistration( uint32_t interceptRegistrationId );
+
+void fastPathSpansSetRecording( bool isRecording );
+
+/**
+ * @return sequence number to pass to fastPathSpanOnCallEnd() or 0 if the call is not recorded
+ */
+uint32_t fastPathSpanOnCallBegin( uint32_t interceptRegistrationId, zend_execute_data* execute_data );
+
+/**
+ * @param returnValue can be NULL if the return value is not known
+ */
+void fastPathSpanOnCallEnd( uint32_t spanSequenceNumber, const zval* returnValue );
+
+/**
+ * Moves the ended calls to return_value as
+ * [number of calls not recorded because the buffer was full (PHP part reports them as dropped spans),
+ *  list of [interceptRegistrationId, thisObj or null, statement or null, start timestamp in microseconds, duration in milliseconds,
+ *           thrown object or null, has returned false]]
+ */
+void fastPathSpansTake( zval* return_value );
+
+void fastPathSpansOnRequestShutdown();
@@ -40,8 +40,12 @@
 #include "elastic_apm_alloc.h"
 #include "elastic_apm_API.h"
 #include "tracer_PHP_part.h"
+#include "request_tracing_decision.h"
 #include "backend_comm.h"
+#include "events_buffer.h"
+#include "events_serialization.h"
 #include "AST_instrumentation.h"
+#include "observer_instrumentation.h"
 #include "Hooking.h"
 #include "CommonUtils.h"
 #include "Diagnostics.h"
@@ -116,6 +120,28 @@ void logSupportabilityInfo( LogLevel logLevel )
 }
 
 static pid_t g_pidOnRequestInit = -1;
+static uint64_t g_opcacheRestartsCountOnLastRequestInit = 0;
+
+static bool g_isMemoryStatsOnRequestInitCaptured = false;
+static PhpMemoryStats g_memoryStatsOnRequestInit;
+
+static
+void capturePhpMemoryStats( PhpMemoryStats* dst )
+{
+    dst->memoryUsage = zend_memory_usage( /* real_usage */ false );
+    dst->peakMemoryUsage = zend_memory_peak_usage( /* real_usage */ false );
+    dst->realPeakMemoryUsage = zend_memory_peak_usage( /* real_usage */ true );
+
+#if PHP_VERSION_ID >= ELASTIC_APM_BUILD_PHP_VERSION_ID( 7, 3, 0 ) /* if PHP version from 7.3.0 */
+    zend_gc_status gcStatus;
+    zend_gc_get_status( &gcStatus );
+    dst->gcRuns = gcStatus.runs;
+    dst->gcCollected = gcStatus.collected;
+#else
+    dst->gcRuns = 0;
+    dst->gcCollected = 0;
+#endif
+}
 
 bool doesCurrentPidMatchPidOnInit( pid_t pidOnInit, String dbgDesc )
 {
@@ -296,8 +322,9 @@ void elasticApmModuleInit( int moduleType, int moduleNumber )
     tracer->curlInited = true;
 
     astInstrumentationOnModuleInit( config );
+    observerInstrumentationOnModuleInit( config );
 
-    elasticapm::php::Hooking::getInstance().replaceHooks(config->captureErrors, config->captureErrorsWithPhpPart, config->profilingInferredSpansEnabled);
+    elasticapm::php::Hooking::getInstance().replaceHooks(config->captureErrors, config->captureErrorsWithPhpPart, config->profilingInferredSpansEnabled, config->profilingContinuousEnabled);
 
     if (php_check_open_basedir_ex(config->bootstrapPhpPartFile, false) != 0) {
         ELASTIC_APM_LOG_WARNING(
@@ -341,12 +368,18 @@ void elasticApmModuleShutdown( int moduleType, int moduleNumber )
     }
 
     elasticapm::php::Hooking::getInstance().restoreOriginalHooks();
+    invalidateCallInterceptionRegistrations( "module shutdown" );
     astInstrumentationOnModuleShutdown();
 
     unregisterExceptionHooks();
 
     backgroundBackendCommOnModuleShutdown( config );
 
+    if ( ELASTICAPM_G( continuousProfiler ) != nullptr )
+    {
+        ELASTICAPM_G( continuousProfiler )->flush();
+    }
+
     if ( tracer->curlInited )
     {
         curl_global_cleanup();
@@ -387,9 +420,7 @@ void elasticApmGetLastPhpError(zval* return_value) {
 
 auto buildPeriodicTaskExecutor() {
     auto periodicTaskExecutor = std::make_unique<elasticapm::php::PeriodicTaskExecutor>(
-        std::vector<elasticapm::php::PeriodicTaskExecutor::task_t>{
-        [inferredSpans = ELASTICAPM_G(globals)->inferredSpans_](elasticapm::php::PeriodicTaskExecutor::time_point_t now) { inferredSpans->tryRequestInterrupt(now); }
-        },
+        std::vector<elasticapm::php::PeriodicTaskExecutor::task_t>{},
         []() {
             // block signals for this thread to be handled by main Apache/PHP thread
             // list of signals from Apaches mpm handlers
@@ -402,10 +433,167 @@ auto buildPeriodicTaskExecutor() {
         }
     );
 
+    // Each sampler has its own interval - tasks are enabled on request init according to configuration
+    auto &globals = ELASTICAPM_G(globals);
+    globals->inferredSpansTaskId_ = periodicTaskExecutor->addPeriodicTask([inferredSpans = globals->inferredSpans_](elasticapm::php::PeriodicTaskExecutor::time_point_t now) { inferredSpans->tryRequestInterrupt(now); }, std::chrono::milliseconds{50});
+    periodicTaskExecutor->setTaskEnabled(globals->inferredSpansTaskId_, false);
+
     ELASTIC_APM_LOG_DEBUG("starting inferred spans thread");
     return periodicTaskExecutor;
 }
 
+static void inferredSpansSamplingTimerHandler(void *context) {
+    static_cast<elasticapm::php::InferredSpans *>(context)->requestInterruptFromSignalHandler();
+}
+
+// SIGRTMIN is used by PHP 8.3+ ZTS for max_execution_time timers and SIGPROF by the non-ZTS ones
+#define ELASTIC_APM_INFERRED_SPANS_SAMPLING_SIGNAL ( SIGRTMIN + 1 )
+
+static constexpr std::chrono::milliseconds inferredSpansMaxAdaptedInterval{1000};
+
+/**
+ * @return overhead budget as fraction of time (0.01 for "1%" or "1"), 0 if it is not set or invalid
+ */
+static double parseInferredSpansOverheadBudget( String value )
+{
+    if ( value == NULL )
+    {
+        return 0;
+    }
+
+    char* end = NULL;
+    double percent = strtod( value, &end );
+    while ( end != NULL && isspace( (unsigned char)*end ) ) ++end;
+    if ( end != NULL && *end == '%' ) ++end;
+    while ( end != NULL && isspace( (unsigned char)*end ) ) ++end;
+    if ( end == value || end == NULL || *end != '\0' || !( percent > 0 && percent <= 100 ) )
+    {
+        ELASTIC_APM_LOG_ERROR( "Invalid value of " ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_OVERHEAD_BUDGET " option: `%s' - sampling interval is not adapted", value );
+        return 0;
+    }
+    return percent / 100;
+}
+
+/**
+ * @return true if timer driven sampling was started, false if periodic task thread should be used instead
+ */
+static bool startInferredSpansSamplingTimer( const ConfigSnapshot* config, std::chrono::milliseconds interval )
+{
+    if ( config->profilingInferredSpansSamplingTimer == NULL )
+    {
+        return false;
+    }
+
+    // wall clock timer is not supported - its signal would cut short blocking calls (sleep, stream_select, ...) of the request
+    if ( ! areStringsEqualIgnoringCase( config->profilingInferredSpansSamplingTimer, "cpu" ) )
+    {
+        ELASTIC_APM_LOG_WARNING( "Unknown value of " ELASTIC_APM_CFG_OPT_NAME_PROFILING_INFERRED_SPANS_SAMPLING_TIMER " option: `%s' - falling back to inferred spans thread", config->profilingInferredSpansSamplingTimer );
+        return false;
+    }
+
+    auto &globals = ELASTICAPM_G(globals);
+    if (!globals->samplingTimer_) {
+        globals->samplingTimer_ = std::make_unique<elasticapm::php::SamplingTimer>(ELASTIC_APM_INFERRED_SPANS_SAMPLING_SIGNAL, &inferredSpansSamplingTimerHandler, globals->inferredSpans_.get());
+    }
+
+    if (!globals->samplingTimer_->start(interval)) {
+        ELASTIC_APM_LOG_ERROR( "Failed to start inferred spans sampling timer (errno: %d) - falling back to inferred spans thread", errno );
+        globals->samplingTimer_.reset();
+        return false;
+    }
+
+    ELASTIC_APM_LOG_DEBUG( "started inferred spans sampling timer (%s) with sampling interval %zums", config->profilingInferredSpansSamplingTimer, interval.count() );
+    return true;
+}
+
+// Starts inferred spans sampling and continuous profiler for the request
+static void startSamplersOnRequestInit( const ConfigSnapshot* config, bool shouldSampleInferredSpans )
+{
+    std::chrono::milliseconds inferredSpansTaskInterval{0};
+    std::chrono::milliseconds continuousProfilerTaskInterval{0};
+
+    if (config->profilingInferredSpansEnabled && shouldSampleInferredSpans) {
+        std::chrono::milliseconds interval{50};
+        try {
+            if (config->profilingInferredSpansSamplingInterval) {
+                interval = elasticapm::utils::convertDurationWithUnit(config->profilingInferredSpansSamplingInterval);
+            }
+        } catch (std::invalid_argument const &e) {
+            ELASTIC_APM_LOG_ERROR( "profilingInferredSpansSamplingInterval '%s': '%s'", e.what(), config->profilingInferredSpansSamplingInterval);
+        }
+
+        if (interval.count() == 0) {
+            interval = std::chrono::milliseconds{50};
+            ELASTIC_APM_LOG_DEBUG("inferred spans thread interval too low, forced to default %zums", interval.count());
+        }
+
+        // Samples buffer takes hundreds of KB so it is allocated only in processes where inferred spans are enabled
+        if (!ELASTICAPM_G(inferredSpansSamples)) {
+            try {
+                ELASTICAPM_G(inferredSpansSamples) = new elasticapm::php::InferredSpansSamples(/* maxSamples */ 512, /* maxFrames */ 16 * 1024, /* maxFramesPerSample */ 256, /* maxInternedFrames */ 8 * 1024);
+            } catch (std::exception const &e) {
+                ELASTIC_APM_LOG_CRITICAL("Unable to allocate InferredSpansSamples. '%s'", e.what());
+            }
+        }
+
+        ELASTICAPM_G(globals)->inferredSpans_->setInterval(interval);
+        ELASTICAPM_G(globals)->inferredSpans_->setOverheadBudget(parseInferredSpansOverheadBudget(config->profilingInferredSpansOverheadBudget), std::max(interval, inferredSpansMaxAdaptedInterval));
+        interval = ELASTICAPM_G(globals)->inferredSpans_->getInterval();
+        ELASTICAPM_G(globals)->inferredSpans_->reset();
+
+        bool isTimerDriven = startInferredSpansSamplingTimer(config, interval);
+        ELASTICAPM_G(globals)->inferredSpans_->setPeriodicTaskDriven(!isTimerDriven);
+        if (!isTimerDriven) {
+            inferredSpansTaskInterval = interval;
+        }
+    } else {
+        ELASTICAPM_G(globals)->inferredSpans_->setPeriodicTaskDriven(false);
+    }
+
+    // Profiler (with its aggregated profile and frame buffers) is created only in processes where profiling is enabled
+    if (config->profilingContinuousEnabled && !ELASTICAPM_G(continuousProfiler)) {
+        try {
+            ELASTICAPM_G(continuousProfiler) = new elasticapm::php::ContinuousProfiler(ELASTICAPM_G(globals)->inferredSpans_->getInterruptFunction());
+        } catch (std::exception const &e) {
+            ELASTIC_APM_LOG_CRITICAL("Unable to allocate ContinuousProfiler. '%s'", e.what());
+        }
+    }
+
+    if (ELASTICAPM_G(continuousProfiler)) {
+        ELASTICAPM_G(continuousProfiler)->onRequestInit(config);
+        if (ELASTICAPM_G(continuousProfiler)->isEnabled()) {
+            continuousProfilerTaskInterval = ELASTICAPM_G(continuousProfiler)->getSamplingInterval();
+        }
+    }
+
+    // Each sampler is a separate task in the executor's timer wheel running at its own interval
+    if (inferredSpansTaskInterval.count() != 0 || continuousProfilerTaskInterval.count() != 0) {
+        if (!ELASTICAPM_G(globals)->periodicTaskExecutor_) {
+            ELASTICAPM_G(globals)->periodicTaskExecutor_ = buildPeriodicTaskExecutor();
+        }
+        auto &globals = ELASTICAPM_G(globals);
+        auto &periodicTaskExecutor = globals->periodicTaskExecutor_;
+
+        if (continuousProfilerTaskInterval.count() != 0 && globals->continuousProfilerTaskId_ == 0) {
+            globals->continuousProfilerTaskId_ = periodicTaskExecutor->addPeriodicTask([profilerSampler = ELASTICAPM_G(continuousProfiler)->getSampler()](elasticapm::php::PeriodicTaskExecutor::time_point_t now) { profilerSampler->tryRequestInterrupt(now); }, continuousProfilerTaskInterval);
+        }
+
+        periodicTaskExecutor->setTaskEnabled(globals->inferredSpansTaskId_, inferredSpansTaskInterval.count() != 0);
+        if (inferredSpansTaskInterval.count() != 0) {
+            periodicTaskExecutor->setTaskInterval(globals->inferredSpansTaskId_, inferredSpansTaskInterval);
+        }
+        if (globals->continuousProfilerTaskId_ != 0) {
+            periodicTaskExecutor->setTaskEnabled(globals->continuousProfilerTaskId_, continuousProfilerTaskInterval.count() != 0);
+            if (continuousProfilerTaskInterval.count() != 0) {
+                periodicTaskExecutor->setTaskInterval(globals->continuousProfilerTaskId_, continuousProfilerTaskInterval);
+            }
+        }
+
+        ELASTIC_APM_LOG_DEBUG("resuming periodic tasks thread; inferred spans interval: %zums, continuous profiler interval: %zums", static_cast<size_t>(inferredSpansTaskInterval.count()), static_cast<size_t>(continuousProfilerTaskInterval.count()));
+        periodicTaskExecutor->resumePeriodicTasks();
+    }
+}
+
 void elasticApmRequestInit()
 {
     if (!ELASTICAPM_G(globals)->sapi_.isSupported()) {
@@ -447,10 +635,13 @@ void elasticApmRequestInit()
 #endif
 
     g_pidOnRequestInit = getCurrentProcessId();
+    g_isMemoryStatsOnRequestInitCaptured = false;
 
     ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "parent PID: %d", (int)(getParentProcessId()) );
 
     ResultCode resultCode;
+    bool didConfigChange = false;
+    RequestTracingDecision tracingDecision = requestTracingDecision_left_to_PHP_part;
 
     if ( ! tracer->isInited )
     {
@@ -464,10 +655,19 @@ void elasticApmRequestInit()
         ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
     }
 
-    if (!isScriptRestricedByOpcacheAPI() && detectOpcacheRestartPending()) {
-        ELASTIC_APM_LOG_WARNING("Detected that opcache reset is in a pending state. Instrumentation has been disabled for this request. There may be warnings or errors logged for this request.");
-        resultCode = resultSuccess;
-        goto finally;
+    if (!isScriptRestricedByOpcacheAPI()) {
+        uint64_t opcacheRestartsCount = 0;
+        bool isOpcacheRestartPending = detectOpcacheRestartPending(&opcacheRestartsCount);
+        if (isOpcacheRestartPending || opcacheRestartsCount != g_opcacheRestartsCountOnLastRequestInit) {
+            // registrations of intercepted calls are kept across requests - they are not trusted after opcache reset
+            invalidateCallInterceptionRegistrations("opcache reset");
+            g_opcacheRestartsCountOnLastRequestInit = opcacheRestartsCount;
+        }
+        if (isOpcacheRestartPending) {
+            ELASTIC_APM_LOG_WARNING("Detected that opcache reset is in a pending state. Instrumentation has been disabled for this request. There may be warnings or errors logged for this request.");
+            resultCode = resultSuccess;
+            goto finally;
+        }
     }
 
     if ( ! config->enabled )
@@ -479,7 +679,12 @@ void elasticApmRequestInit()
 
     if ( isMemoryTrackingEnabled( &tracer->memTracker ) ) memoryTrackerRequestInit( &tracer->memTracker );
 
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( ensureAllComponentsHaveLatestConfig( tracer ) );
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( ensureAllComponentsHaveLatestConfig( tracer, &didConfigChange ) );
+    if ( didConfigChange )
+    {
+        // configuration decides which functions PHP part intercepts
+        invalidateCallInterceptionRegistrations( "configuration change" );
+    }
     logSupportabilityInfo( logLevel_trace );
 
     enableAccessToServerGlobal();
@@ -510,34 +715,27 @@ void elasticApmRequestInit()
         astInstrumentationOnRequestInit( config );
     }
 
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( tracerPhpPartOnRequestInit( config, &requestInitStartTime ) );
-
-    if (config->profilingInferredSpansEnabled) {
-        if (!ELASTICAPM_G(globals)->periodicTaskExecutor_) {
-            ELASTICAPM_G(globals)->periodicTaskExecutor_ = buildPeriodicTaskExecutor();
-        }
-
-        std::chrono::milliseconds interval{50};
-        try {
-            if (config->profilingInferredSpansSamplingInterval) {
-                interval = elasticapm::utils::convertDurationWithUnit(config->profilingInferredSpansSamplingInterval);
-            }
-        } catch (std::invalid_argument const &e) {
-            ELASTIC_APM_LOG_ERROR( "profilingInferredSpansSamplingInterval '%s': '%s'", e.what(), config->profilingInferredSpansSamplingInterval);
-        }
+    tracingDecision = decideRequestTracing( config );
+    ELASTIC_APM_LOG_DEBUG( "Request tracing decision: %s", requestTracingDecisionToString( tracingDecision ) );
+    if ( tracingDecision == requestTracingDecision_ignored )
+    {
+        // PHP part is not bootstrapped so there is no transaction to attach the errors to
+        ELASTICAPM_G(captureErrorsUsingNative) = false;
+    }
 
-        if (interval.count() == 0) {
-            interval = std::chrono::milliseconds{50};
-            ELASTIC_APM_LOG_DEBUG("inferred spans thread interval too low, forced to default %zums", interval.count());
-        }
+    ELASTIC_APM_CALL_IF_FAILED_GOTO( tracerPhpPartOnRequestInit( config, &requestInitStartTime, tracingDecision ) );
 
-        ELASTIC_APM_LOG_DEBUG("resuming inferred spans thread with sampling interval %zums", interval.count());
-        ELASTICAPM_G(globals)->inferredSpans_->setInterval(interval);
-        ELASTICAPM_G(globals)->inferredSpans_->reset();
-        ELASTICAPM_G(globals)->periodicTaskExecutor_->setInterval(interval);
-        ELASTICAPM_G(globals)->periodicTaskExecutor_->resumePeriodicTasks();
+    // Captured after PHP part is bootstrapped so that the delta reported on shutdown
+    // does not include memory allocated by the agent's own bootstrap
+    g_isMemoryStatsOnRequestInitCaptured = config->captureMemoryStats && tracingDecision != requestTracingDecision_ignored;
+    if ( g_isMemoryStatsOnRequestInitCaptured )
+    {
+        capturePhpMemoryStats( &g_memoryStatsOnRequestInit );
     }
 
+    // inferred spans are only added to sampled transactions
+    startSamplersOnRequestInit( config, /* shouldSampleInferredSpans */ tracingDecision != requestTracingDecision_ignored && tracingDecision != requestTracingDecision_not_sampled );
+
     resultCode = resultSuccess;
 
     finally:
@@ -606,9 +804,49 @@ void elasticApmRequestShutdown()
         ELASTICAPM_G(globals)->periodicTaskExecutor_->suspendPeriodicTasks();
     }
 
+    if (ELASTICAPM_G(globals)->samplingTimer_) {
+        ELASTIC_APM_LOG_DEBUG("stopping inferred spans sampling timer");
+        ELASTICAPM_G(globals)->samplingTimer_->stop();
+    }
+
     ELASTICAPM_G(captureErrorsUsingNative) = false; // disabling error capturing on shutdown
 
-    tracerPhpPartOnRequestShutdown();
+    if ( g_isMemoryStatsOnRequestInitCaptured )
+    {
+        PhpMemoryStats memoryStatsOnRequestShutdown;
+        capturePhpMemoryStats( &memoryStatsOnRequestShutdown );
+        tracerPhpPartOnRequestShutdown( &g_memoryStatsOnRequestInit, &memoryStatsOnRequestShutdown );
+        g_isMemoryStatsOnRequestInitCaptured = false;
+    }
+    else
+    {
+        tracerPhpPartOnRequestShutdown( /* memoryStatsOnInit */ NULL, /* memoryStatsOnShutdown */ NULL );
+    }
+
+    // After PHP part's shutdown - ending the transaction flushes the buffer so only events sent after it are left
+    eventsBufferOnRequestShutdown( config );
+    eventsSerializationOnRequestShutdown();
+
+    // Samples reference request scoped strings - whatever PHP part did not consume is dropped
+    if ( ELASTICAPM_G( inferredSpansSamples ) != nullptr )
+    {
+        ELASTICAPM_G( inferredSpansSamples )->clear();
+    }
+
+    if ( ELASTICAPM_G( continuousProfiler ) != nullptr )
+    {
+        ELASTICAPM_G( continuousProfiler )->onRequestShutdown();
+    }
+
+    // Interval for the next request handled by this worker is based on the cost of samples taken in this one
+    if ( ELASTICAPM_G( globals )->inferredSpans_->getSamplesCount() != 0 )
+    {
+        auto& inferredSpans = ELASTICAPM_G( globals )->inferredSpans_;
+        inferredSpans->adaptInterval();
+        ELASTIC_APM_LOG_DEBUG( "inferred spans: %" PRIu64 " samples took %" PRId64 "us (overhead: %.4f%%), effective sampling interval: %zums"
+                               , inferredSpans->getSamplesCount(), static_cast<int64_t>( inferredSpans->getSamplingTime().count() / 1000 )
+                               , inferredSpans->getOverhead( elasticapm::php::InferredSpans::clock_t::now() ) * 100, static_cast<size_t>( inferredSpans->getInterval().count() ) );
+    }
 
     // there is no guarantee that following code will be executed - in case of error on php side
 
@@ -1,2052 +0,0 @@
-/*
- * Licensed to Elasticsearch B.V. under one or more contributor
- * license agreements. See the NOTICE file distributed with
- * this work for additional information regarding copyright
- * ownership. Elasticsearch B.V. licenses this file to you under
- * the Apache License, Version 2.0 (the "License"); you may
- * not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- *     http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing,
- * software distributed under the License is distributed on an
- * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
- * KIND, either express or implied.  See the License for the
- * specific language governing permissions and limitations
- * under the License.
- */
-
-#pragma once
-
-#include "basic_macros.h"
-
-static
-void internalFunctionCallInterceptingImpl( uint32_t interceptRegistrationId, zend_execute_data* execute_data, zval* return_value );
-
-static void
-numberedInterceptingCallback( uint32_t index, zend_execute_data* execute_data, zval* return_value )
-{
-    internalFunctionCallInterceptingImpl( /* interceptRegistrationId: */ index, execute_data, return_value );
-}
-
-#define ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( n ) ELASTIC_APM_PP_CONCAT( elasticApmNumberedInterceptingCallback_, n )
-
-#define ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( n ) \
-    ZEND_NAMED_FUNCTION( ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( n ) ) \
-    { \
-        numberedInterceptingCallback( n, INTERNAL_FUNCTION_PARAM_PASSTHRU ); \
-    } \
-/**/
-
-// Uncomment // gen_numbered_intercepting_callbacks_src( 1000 );
-// in main() in "agent/native/ext/unit_tests/main.c" to generate the part below
-
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 0 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 1 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 2 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 3 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 4 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 5 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 6 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 7 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 8 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 9 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 10 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 11 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 12 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 13 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 14 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 15 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 16 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 17 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 18 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 19 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 20 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 21 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 22 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 23 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 24 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 25 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 26 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 27 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 28 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 29 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 30 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 31 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 32 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 33 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 34 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 35 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 36 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 37 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 38 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 39 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 40 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 41 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 42 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 43 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 44 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 45 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 46 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 47 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 48 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 49 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 50 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 51 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 52 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 53 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 54 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 55 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 56 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 57 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 58 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 59 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 60 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 61 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 62 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 63 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 64 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 65 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 66 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 67 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 68 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 69 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 70 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 71 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 72 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 73 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 74 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 75 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 76 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 77 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 78 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 79 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 80 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 81 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 82 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 83 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 84 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 85 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 86 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 87 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 88 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 89 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 90 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 91 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 92 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 93 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 94 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 95 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 96 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 97 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 98 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 99 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 100 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 101 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 102 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 103 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 104 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 105 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 106 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 107 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 108 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 109 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 110 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 111 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 112 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 113 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 114 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 115 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 116 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 117 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 118 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 119 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 120 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 121 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 122 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 123 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 124 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 125 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 126 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 127 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 128 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 129 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 130 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 131 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 132 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 133 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 134 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 135 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 136 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 137 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 138 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 139 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 140 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 141 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 142 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 143 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 144 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 145 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 146 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 147 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 148 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 149 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 150 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 151 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 152 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 153 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 154 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 155 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 156 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 157 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 158 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 159 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 160 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 161 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 162 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 163 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 164 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 165 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 166 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 167 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 168 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 169 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 170 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 171 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 172 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 173 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 174 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 175 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 176 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 177 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 178 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 179 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 180 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 181 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 182 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 183 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 184 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 185 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 186 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 187 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 188 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 189 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 190 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 191 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 192 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 193 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 194 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 195 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 196 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 197 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 198 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 199 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 200 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 201 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 202 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 203 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 204 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 205 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 206 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 207 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 208 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 209 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 210 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 211 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 212 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 213 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 214 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 215 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 216 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 217 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 218 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 219 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 220 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 221 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 222 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 223 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 224 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 225 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 226 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 227 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 228 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 229 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 230 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 231 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 232 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 233 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 234 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 235 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 236 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 237 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 238 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 239 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 240 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 241 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 242 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 243 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 244 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 245 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 246 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 247 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 248 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 249 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 250 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 251 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 252 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 253 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 254 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 255 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 256 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 257 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 258 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 259 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 260 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 261 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 262 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 263 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 264 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 265 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 266 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 267 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 268 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 269 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 270 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 271 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 272 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 273 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 274 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 275 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 276 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 277 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 278 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 279 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 280 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 281 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 282 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 283 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 284 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 285 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 286 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 287 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 288 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 289 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 290 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 291 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 292 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 293 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 294 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 295 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 296 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 297 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 298 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 299 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 300 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 301 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 302 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 303 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 304 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 305 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 306 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 307 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 308 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 309 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 310 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 311 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 312 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 313 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 314 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 315 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 316 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 317 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 318 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 319 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 320 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 321 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 322 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 323 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 324 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 325 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 326 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 327 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 328 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 329 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 330 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 331 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 332 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 333 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 334 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 335 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 336 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 337 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 338 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 339 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 340 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 341 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 342 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 343 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 344 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 345 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 346 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 347 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 348 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 349 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 350 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 351 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 352 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 353 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 354 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 355 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 356 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 357 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 358 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 359 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 360 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 361 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 362 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 363 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 364 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 365 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 366 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 367 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 368 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 369 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 370 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 371 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 372 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 373 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 374 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 375 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 376 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 377 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 378 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 379 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 380 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 381 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 382 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 383 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 384 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 385 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 386 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 387 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 388 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 389 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 390 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 391 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 392 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 393 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 394 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 395 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 396 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 397 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 398 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 399 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 400 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 401 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 402 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 403 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 404 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 405 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 406 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 407 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 408 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 409 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 410 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 411 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 412 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 413 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 414 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 415 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 416 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 417 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 418 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 419 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 420 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 421 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 422 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 423 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 424 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 425 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 426 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 427 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 428 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 429 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 430 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 431 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 432 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 433 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 434 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 435 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 436 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 437 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 438 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 439 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 440 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 441 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 442 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 443 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 444 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 445 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 446 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 447 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 448 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 449 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 450 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 451 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 452 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 453 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 454 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 455 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 456 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 457 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 458 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 459 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 460 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 461 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 462 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 463 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 464 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 465 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 466 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 467 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 468 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 469 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 470 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 471 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 472 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 473 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 474 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 475 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 476 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 477 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 478 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 479 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 480 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 481 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 482 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 483 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 484 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 485 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 486 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 487 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 488 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 489 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 490 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 491 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 492 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 493 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 494 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 495 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 496 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 497 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 498 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 499 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 500 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 501 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 502 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 503 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 504 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 505 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 506 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 507 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 508 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 509 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 510 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 511 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 512 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 513 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 514 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 515 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 516 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 517 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 518 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 519 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 520 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 521 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 522 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 523 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 524 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 525 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 526 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 527 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 528 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 529 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 530 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 531 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 532 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 533 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 534 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 535 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 536 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 537 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 538 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 539 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 540 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 541 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 542 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 543 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 544 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 545 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 546 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 547 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 548 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 549 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 550 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 551 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 552 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 553 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 554 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 555 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 556 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 557 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 558 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 559 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 560 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 561 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 562 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 563 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 564 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 565 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 566 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 567 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 568 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 569 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 570 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 571 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 572 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 573 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 574 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 575 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 576 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 577 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 578 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 579 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 580 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 581 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 582 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 583 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 584 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 585 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 586 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 587 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 588 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 589 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 590 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 591 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 592 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 593 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 594 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 595 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 596 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 597 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 598 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 599 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 600 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 601 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 602 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 603 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 604 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 605 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 606 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 607 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 608 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 609 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 610 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 611 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 612 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 613 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 614 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 615 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 616 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 617 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 618 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 619 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 620 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 621 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 622 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 623 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 624 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 625 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 626 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 627 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 628 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 629 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 630 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 631 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 632 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 633 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 634 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 635 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 636 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 637 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 638 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 639 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 640 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 641 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 642 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 643 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 644 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 645 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 646 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 647 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 648 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 649 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 650 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 651 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 652 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 653 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 654 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 655 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 656 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 657 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 658 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 659 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 660 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 661 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 662 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 663 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 664 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 665 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 666 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 667 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 668 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 669 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 670 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 671 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 672 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 673 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 674 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 675 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 676 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 677 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 678 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 679 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 680 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 681 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 682 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 683 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 684 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 685 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 686 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 687 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 688 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 689 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 690 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 691 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 692 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 693 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 694 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 695 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 696 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 697 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 698 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 699 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 700 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 701 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 702 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 703 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 704 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 705 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 706 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 707 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 708 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 709 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 710 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 711 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 712 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 713 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 714 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 715 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 716 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 717 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 718 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 719 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 720 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 721 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 722 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 723 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 724 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 725 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 726 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 727 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 728 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 729 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 730 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 731 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 732 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 733 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 734 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 735 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 736 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 737 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 738 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 739 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 740 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 741 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 742 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 743 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 744 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 745 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 746 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 747 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 748 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 749 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 750 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 751 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 752 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 753 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 754 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 755 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 756 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 757 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 758 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 759 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 760 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 761 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 762 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 763 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 764 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 765 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 766 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 767 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 768 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 769 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 770 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 771 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 772 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 773 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 774 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 775 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 776 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 777 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 778 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 779 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 780 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 781 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 782 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 783 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 784 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 785 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 786 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 787 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 788 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 789 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 790 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 791 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 792 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 793 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 794 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 795 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 796 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 797 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 798 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 799 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 800 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 801 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 802 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 803 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 804 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 805 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 806 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 807 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 808 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 809 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 810 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 811 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 812 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 813 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 814 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 815 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 816 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 817 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 818 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 819 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 820 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 821 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 822 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 823 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 824 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 825 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 826 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 827 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 828 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 829 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 830 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 831 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 832 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 833 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 834 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 835 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 836 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 837 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 838 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 839 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 840 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 841 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 842 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 843 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 844 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 845 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 846 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 847 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 848 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 849 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 850 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 851 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 852 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 853 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 854 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 855 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 856 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 857 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 858 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 859 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 860 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 861 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 862 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 863 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 864 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 865 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 866 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 867 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 868 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 869 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 870 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 871 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 872 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 873 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 874 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 875 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 876 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 877 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 878 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 879 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 880 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 881 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 882 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 883 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 884 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 885 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 886 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 887 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 888 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 889 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 890 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 891 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 892 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 893 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 894 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 895 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 896 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 897 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 898 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 899 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 900 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 901 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 902 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 903 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 904 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 905 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 906 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 907 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 908 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 909 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 910 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 911 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 912 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 913 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 914 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 915 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 916 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 917 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 918 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 919 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 920 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 921 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 922 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 923 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 924 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 925 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 926 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 927 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 928 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 929 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 930 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 931 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 932 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 933 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 934 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 935 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 936 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 937 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 938 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 939 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 940 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 941 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 942 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 943 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 944 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 945 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 946 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 947 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 948 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 949 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 950 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 951 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 952 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 953 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 954 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 955 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 956 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 957 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 958 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 959 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 960 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 961 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 962 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 963 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 964 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 965 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 966 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 967 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 968 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 969 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 970 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 971 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 972 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 973 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 974 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 975 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 976 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 977 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 978 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 979 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 980 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 981 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 982 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 983 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 984 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 985 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 986 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 987 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 988 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 989 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 990 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 991 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 992 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 993 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 994 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 995 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 996 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 997 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 998 )
-ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK( 999 )
-
-enum { numberedInterceptingCallbacksCount = 1000 };
-static zif_handler g_numberedInterceptingCallback[ numberedInterceptingCallbacksCount ] =
-        {
-                [ 0 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 0 ),
-                [ 1 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 1 ),
-                [ 2 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 2 ),
-                [ 3 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 3 ),
-                [ 4 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 4 ),
-                [ 5 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 5 ),
-                [ 6 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 6 ),
-                [ 7 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 7 ),
-                [ 8 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 8 ),
-                [ 9 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 9 ),
-                [ 10 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 10 ),
-                [ 11 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 11 ),
-                [ 12 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 12 ),
-                [ 13 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 13 ),
-                [ 14 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 14 ),
-                [ 15 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 15 ),
-                [ 16 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 16 ),
-                [ 17 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 17 ),
-                [ 18 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 18 ),
-                [ 19 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 19 ),
-                [ 20 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 20 ),
-                [ 21 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 21 ),
-                [ 22 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 22 ),
-                [ 23 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 23 ),
-                [ 24 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 24 ),
-                [ 25 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 25 ),
-                [ 26 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 26 ),
-                [ 27 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 27 ),
-                [ 28 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 28 ),
-                [ 29 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 29 ),
-                [ 30 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 30 ),
-                [ 31 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 31 ),
-                [ 32 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 32 ),
-                [ 33 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 33 ),
-                [ 34 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 34 ),
-                [ 35 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 35 ),
-                [ 36 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 36 ),
-                [ 37 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 37 ),
-                [ 38 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 38 ),
-                [ 39 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 39 ),
-                [ 40 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 40 ),
-                [ 41 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 41 ),
-                [ 42 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 42 ),
-                [ 43 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 43 ),
-                [ 44 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 44 ),
-                [ 45 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 45 ),
-                [ 46 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 46 ),
-                [ 47 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 47 ),
-                [ 48 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 48 ),
-                [ 49 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 49 ),
-                [ 50 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 50 ),
-                [ 51 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 51 ),
-                [ 52 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 52 ),
-                [ 53 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 53 ),
-                [ 54 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 54 ),
-                [ 55 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 55 ),
-                [ 56 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 56 ),
-                [ 57 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 57 ),
-                [ 58 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 58 ),
-                [ 59 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 59 ),
-                [ 60 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 60 ),
-                [ 61 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 61 ),
-                [ 62 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 62 ),
-                [ 63 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 63 ),
-                [ 64 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 64 ),
-                [ 65 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 65 ),
-                [ 66 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 66 ),
-                [ 67 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 67 ),
-                [ 68 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 68 ),
-                [ 69 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 69 ),
-                [ 70 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 70 ),
-                [ 71 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 71 ),
-                [ 72 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 72 ),
-                [ 73 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 73 ),
-                [ 74 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 74 ),
-                [ 75 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 75 ),
-                [ 76 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 76 ),
-                [ 77 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 77 ),
-                [ 78 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 78 ),
-                [ 79 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 79 ),
-                [ 80 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 80 ),
-                [ 81 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 81 ),
-                [ 82 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 82 ),
-                [ 83 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 83 ),
-                [ 84 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 84 ),
-                [ 85 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 85 ),
-                [ 86 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 86 ),
-                [ 87 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 87 ),
-                [ 88 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 88 ),
-                [ 89 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 89 ),
-                [ 90 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 90 ),
-                [ 91 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 91 ),
-                [ 92 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 92 ),
-                [ 93 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 93 ),
-                [ 94 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 94 ),
-                [ 95 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 95 ),
-                [ 96 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 96 ),
-                [ 97 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 97 ),
-                [ 98 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 98 ),
-                [ 99 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 99 ),
-                [ 100 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 100 ),
-                [ 101 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 101 ),
-                [ 102 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 102 ),
-                [ 103 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 103 ),
-                [ 104 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 104 ),
-                [ 105 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 105 ),
-                [ 106 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 106 ),
-                [ 107 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 107 ),
-                [ 108 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 108 ),
-                [ 109 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 109 ),
-                [ 110 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 110 ),
-                [ 111 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 111 ),
-                [ 112 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 112 ),
-                [ 113 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 113 ),
-                [ 114 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 114 ),
-                [ 115 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 115 ),
-                [ 116 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 116 ),
-                [ 117 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 117 ),
-                [ 118 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 118 ),
-                [ 119 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 119 ),
-                [ 120 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 120 ),
-                [ 121 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 121 ),
-                [ 122 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 122 ),
-                [ 123 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 123 ),
-                [ 124 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 124 ),
-                [ 125 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 125 ),
-                [ 126 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 126 ),
-                [ 127 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 127 ),
-                [ 128 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 128 ),
-                [ 129 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 129 ),
-                [ 130 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 130 ),
-                [ 131 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 131 ),
-                [ 132 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 132 ),
-                [ 133 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 133 ),
-                [ 134 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 134 ),
-                [ 135 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 135 ),
-                [ 136 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 136 ),
-                [ 137 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 137 ),
-                [ 138 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 138 ),
-                [ 139 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 139 ),
-                [ 140 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 140 ),
-                [ 141 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 141 ),
-                [ 142 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 142 ),
-                [ 143 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 143 ),
-                [ 144 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 144 ),
-                [ 145 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 145 ),
-                [ 146 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 146 ),
-                [ 147 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 147 ),
-                [ 148 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 148 ),
-                [ 149 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 149 ),
-                [ 150 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 150 ),
-                [ 151 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 151 ),
-                [ 152 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 152 ),
-                [ 153 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 153 ),
-                [ 154 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 154 ),
-                [ 155 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 155 ),
-                [ 156 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 156 ),
-                [ 157 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 157 ),
-                [ 158 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 158 ),
-                [ 159 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 159 ),
-                [ 160 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 160 ),
-                [ 161 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 161 ),
-                [ 162 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 162 ),
-                [ 163 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 163 ),
-                [ 164 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 164 ),
-                [ 165 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 165 ),
-                [ 166 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 166 ),
-                [ 167 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 167 ),
-                [ 168 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 168 ),
-                [ 169 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 169 ),
-                [ 170 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 170 ),
-                [ 171 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 171 ),
-                [ 172 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 172 ),
-                [ 173 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 173 ),
-                [ 174 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 174 ),
-                [ 175 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 175 ),
-                [ 176 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 176 ),
-                [ 177 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 177 ),
-                [ 178 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 178 ),
-                [ 179 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 179 ),
-                [ 180 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 180 ),
-                [ 181 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 181 ),
-                [ 182 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 182 ),
-                [ 183 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 183 ),
-                [ 184 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 184 ),
-                [ 185 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 185 ),
-                [ 186 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 186 ),
-                [ 187 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 187 ),
-                [ 188 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 188 ),
-                [ 189 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 189 ),
-                [ 190 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 190 ),
-                [ 191 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 191 ),
-                [ 192 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 192 ),
-                [ 193 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 193 ),
-                [ 194 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 194 ),
-                [ 195 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 195 ),
-                [ 196 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 196 ),
-                [ 197 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 197 ),
-                [ 198 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 198 ),
-                [ 199 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 199 ),
-                [ 200 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 200 ),
-                [ 201 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 201 ),
-                [ 202 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 202 ),
-                [ 203 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 203 ),
-                [ 204 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 204 ),
-                [ 205 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 205 ),
-                [ 206 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 206 ),
-                [ 207 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 207 ),
-                [ 208 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 208 ),
-                [ 209 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 209 ),
-                [ 210 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 210 ),
-                [ 211 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 211 ),
-                [ 212 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 212 ),
-                [ 213 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 213 ),
-                [ 214 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 214 ),
-                [ 215 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 215 ),
-                [ 216 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 216 ),
-                [ 217 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 217 ),
-                [ 218 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 218 ),
-                [ 219 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 219 ),
-                [ 220 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 220 ),
-                [ 221 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 221 ),
-                [ 222 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 222 ),
-                [ 223 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 223 ),
-                [ 224 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 224 ),
-                [ 225 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 225 ),
-                [ 226 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 226 ),
-                [ 227 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 227 ),
-                [ 228 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 228 ),
-                [ 229 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 229 ),
-                [ 230 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 230 ),
-                [ 231 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 231 ),
-                [ 232 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 232 ),
-                [ 233 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 233 ),
-                [ 234 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 234 ),
-                [ 235 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 235 ),
-                [ 236 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 236 ),
-                [ 237 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 237 ),
-                [ 238 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 238 ),
-                [ 239 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 239 ),
-                [ 240 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 240 ),
-                [ 241 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 241 ),
-                [ 242 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 242 ),
-                [ 243 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 243 ),
-                [ 244 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 244 ),
-                [ 245 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 245 ),
-                [ 246 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 246 ),
-                [ 247 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 247 ),
-                [ 248 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 248 ),
-                [ 249 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 249 ),
-                [ 250 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 250 ),
-                [ 251 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 251 ),
-                [ 252 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 252 ),
-                [ 253 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 253 ),
-                [ 254 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 254 ),
-                [ 255 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 255 ),
-                [ 256 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 256 ),
-                [ 257 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 257 ),
-                [ 258 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 258 ),
-                [ 259 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 259 ),
-                [ 260 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 260 ),
-                [ 261 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 261 ),
-                [ 262 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 262 ),
-                [ 263 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 263 ),
-                [ 264 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 264 ),
-                [ 265 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 265 ),
-                [ 266 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 266 ),
-                [ 267 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 267 ),
-                [ 268 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 268 ),
-                [ 269 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 269 ),
-                [ 270 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 270 ),
-                [ 271 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 271 ),
-                [ 272 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 272 ),
-                [ 273 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 273 ),
-                [ 274 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 274 ),
-                [ 275 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 275 ),
-                [ 276 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 276 ),
-                [ 277 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 277 ),
-                [ 278 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 278 ),
-                [ 279 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 279 ),
-                [ 280 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 280 ),
-                [ 281 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 281 ),
-                [ 282 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 282 ),
-                [ 283 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 283 ),
-                [ 284 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 284 ),
-                [ 285 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 285 ),
-                [ 286 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 286 ),
-                [ 287 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 287 ),
-                [ 288 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 288 ),
-                [ 289 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 289 ),
-                [ 290 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 290 ),
-                [ 291 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 291 ),
-                [ 292 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 292 ),
-                [ 293 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 293 ),
-                [ 294 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 294 ),
-                [ 295 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 295 ),
-                [ 296 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 296 ),
-                [ 297 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 297 ),
-                [ 298 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 298 ),
-                [ 299 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 299 ),
-                [ 300 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 300 ),
-                [ 301 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 301 ),
-                [ 302 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 302 ),
-                [ 303 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 303 ),
-                [ 304 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 304 ),
-                [ 305 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 305 ),
-                [ 306 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 306 ),
-                [ 307 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 307 ),
-                [ 308 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 308 ),
-                [ 309 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 309 ),
-                [ 310 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 310 ),
-                [ 311 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 311 ),
-                [ 312 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 312 ),
-                [ 313 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 313 ),
-                [ 314 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 314 ),
-                [ 315 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 315 ),
-                [ 316 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 316 ),
-                [ 317 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 317 ),
-                [ 318 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 318 ),
-                [ 319 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 319 ),
-                [ 320 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 320 ),
-                [ 321 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 321 ),
-                [ 322 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 322 ),
-                [ 323 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 323 ),
-                [ 324 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 324 ),
-                [ 325 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 325 ),
-                [ 326 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 326 ),
-                [ 327 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 327 ),
-                [ 328 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 328 ),
-                [ 329 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 329 ),
-                [ 330 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 330 ),
-                [ 331 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 331 ),
-                [ 332 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 332 ),
-                [ 333 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 333 ),
-                [ 334 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 334 ),
-                [ 335 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 335 ),
-                [ 336 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 336 ),
-                [ 337 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 337 ),
-                [ 338 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 338 ),
-                [ 339 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 339 ),
-                [ 340 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 340 ),
-                [ 341 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 341 ),
-                [ 342 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 342 ),
-                [ 343 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 343 ),
-                [ 344 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 344 ),
-                [ 345 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 345 ),
-                [ 346 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 346 ),
-                [ 347 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 347 ),
-                [ 348 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 348 ),
-                [ 349 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 349 ),
-                [ 350 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 350 ),
-                [ 351 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 351 ),
-                [ 352 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 352 ),
-                [ 353 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 353 ),
-                [ 354 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 354 ),
-                [ 355 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 355 ),
-                [ 356 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 356 ),
-                [ 357 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 357 ),
-                [ 358 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 358 ),
-                [ 359 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 359 ),
-                [ 360 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 360 ),
-                [ 361 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 361 ),
-                [ 362 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 362 ),
-                [ 363 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 363 ),
-                [ 364 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 364 ),
-                [ 365 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 365 ),
-                [ 366 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 366 ),
-                [ 367 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 367 ),
-                [ 368 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 368 ),
-                [ 369 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 369 ),
-                [ 370 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 370 ),
-                [ 371 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 371 ),
-                [ 372 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 372 ),
-                [ 373 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 373 ),
-                [ 374 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 374 ),
-                [ 375 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 375 ),
-                [ 376 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 376 ),
-                [ 377 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 377 ),
-                [ 378 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 378 ),
-                [ 379 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 379 ),
-                [ 380 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 380 ),
-                [ 381 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 381 ),
-                [ 382 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 382 ),
-                [ 383 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 383 ),
-                [ 384 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 384 ),
-                [ 385 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 385 ),
-                [ 386 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 386 ),
-                [ 387 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 387 ),
-                [ 388 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 388 ),
-                [ 389 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 389 ),
-                [ 390 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 390 ),
-                [ 391 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 391 ),
-                [ 392 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 392 ),
-                [ 393 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 393 ),
-                [ 394 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 394 ),
-                [ 395 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 395 ),
-                [ 396 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 396 ),
-                [ 397 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 397 ),
-                [ 398 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 398 ),
-                [ 399 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 399 ),
-                [ 400 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 400 ),
-                [ 401 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 401 ),
-                [ 402 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 402 ),
-                [ 403 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 403 ),
-                [ 404 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 404 ),
-                [ 405 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 405 ),
-                [ 406 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 406 ),
-                [ 407 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 407 ),
-                [ 408 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 408 ),
-                [ 409 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 409 ),
-                [ 410 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 410 ),
-                [ 411 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 411 ),
-                [ 412 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 412 ),
-                [ 413 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 413 ),
-                [ 414 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 414 ),
-                [ 415 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 415 ),
-                [ 416 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 416 ),
-                [ 417 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 417 ),
-                [ 418 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 418 ),
-                [ 419 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 419 ),
-                [ 420 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 420 ),
-                [ 421 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 421 ),
-                [ 422 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 422 ),
-                [ 423 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 423 ),
-                [ 424 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 424 ),
-                [ 425 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 425 ),
-                [ 426 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 426 ),
-                [ 427 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 427 ),
-                [ 428 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 428 ),
-                [ 429 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 429 ),
-                [ 430 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 430 ),
-                [ 431 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 431 ),
-                [ 432 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 432 ),
-                [ 433 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 433 ),
-                [ 434 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 434 ),
-                [ 435 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 435 ),
-                [ 436 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 436 ),
-                [ 437 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 437 ),
-                [ 438 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 438 ),
-                [ 439 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 439 ),
-                [ 440 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 440 ),
-                [ 441 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 441 ),
-                [ 442 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 442 ),
-                [ 443 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 443 ),
-                [ 444 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 444 ),
-                [ 445 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 445 ),
-                [ 446 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 446 ),
-                [ 447 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 447 ),
-                [ 448 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 448 ),
-                [ 449 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 449 ),
-                [ 450 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 450 ),
-                [ 451 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 451 ),
-                [ 452 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 452 ),
-                [ 453 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 453 ),
-                [ 454 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 454 ),
-                [ 455 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 455 ),
-                [ 456 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 456 ),
-                [ 457 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 457 ),
-                [ 458 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 458 ),
-                [ 459 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 459 ),
-                [ 460 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 460 ),
-                [ 461 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 461 ),
-                [ 462 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 462 ),
-                [ 463 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 463 ),
-                [ 464 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 464 ),
-                [ 465 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 465 ),
-                [ 466 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 466 ),
-                [ 467 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 467 ),
-                [ 468 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 468 ),
-                [ 469 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 469 ),
-                [ 470 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 470 ),
-                [ 471 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 471 ),
-                [ 472 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 472 ),
-                [ 473 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 473 ),
-                [ 474 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 474 ),
-                [ 475 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 475 ),
-                [ 476 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 476 ),
-                [ 477 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 477 ),
-                [ 478 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 478 ),
-                [ 479 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 479 ),
-                [ 480 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 480 ),
-                [ 481 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 481 ),
-                [ 482 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 482 ),
-                [ 483 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 483 ),
-                [ 484 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 484 ),
-                [ 485 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 485 ),
-                [ 486 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 486 ),
-                [ 487 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 487 ),
-                [ 488 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 488 ),
-                [ 489 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 489 ),
-                [ 490 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 490 ),
-                [ 491 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 491 ),
-                [ 492 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 492 ),
-                [ 493 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 493 ),
-                [ 494 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 494 ),
-                [ 495 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 495 ),
-                [ 496 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 496 ),
-                [ 497 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 497 ),
-                [ 498 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 498 ),
-                [ 499 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 499 ),
-                [ 500 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 500 ),
-                [ 501 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 501 ),
-                [ 502 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 502 ),
-                [ 503 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 503 ),
-                [ 504 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 504 ),
-                [ 505 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 505 ),
-                [ 506 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 506 ),
-                [ 507 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 507 ),
-                [ 508 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 508 ),
-                [ 509 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 509 ),
-                [ 510 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 510 ),
-                [ 511 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 511 ),
-                [ 512 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 512 ),
-                [ 513 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 513 ),
-                [ 514 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 514 ),
-                [ 515 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 515 ),
-                [ 516 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 516 ),
-                [ 517 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 517 ),
-                [ 518 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 518 ),
-                [ 519 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 519 ),
-                [ 520 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 520 ),
-                [ 521 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 521 ),
-                [ 522 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 522 ),
-                [ 523 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 523 ),
-                [ 524 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 524 ),
-                [ 525 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 525 ),
-                [ 526 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 526 ),
-                [ 527 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 527 ),
-                [ 528 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 528 ),
-                [ 529 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 529 ),
-                [ 530 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 530 ),
-                [ 531 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 531 ),
-                [ 532 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 532 ),
-                [ 533 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 533 ),
-                [ 534 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 534 ),
-                [ 535 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 535 ),
-                [ 536 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 536 ),
-                [ 537 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 537 ),
-                [ 538 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 538 ),
-                [ 539 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 539 ),
-                [ 540 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 540 ),
-                [ 541 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 541 ),
-                [ 542 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 542 ),
-                [ 543 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 543 ),
-                [ 544 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 544 ),
-                [ 545 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 545 ),
-                [ 546 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 546 ),
-                [ 547 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 547 ),
-                [ 548 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 548 ),
-                [ 549 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 549 ),
-                [ 550 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 550 ),
-                [ 551 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 551 ),
-                [ 552 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 552 ),
-                [ 553 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 553 ),
-                [ 554 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 554 ),
-                [ 555 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 555 ),
-                [ 556 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 556 ),
-                [ 557 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 557 ),
-                [ 558 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 558 ),
-                [ 559 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 559 ),
-                [ 560 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 560 ),
-                [ 561 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 561 ),
-                [ 562 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 562 ),
-                [ 563 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 563 ),
-                [ 564 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 564 ),
-                [ 565 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 565 ),
-                [ 566 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 566 ),
-                [ 567 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 567 ),
-                [ 568 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 568 ),
-                [ 569 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 569 ),
-                [ 570 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 570 ),
-                [ 571 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 571 ),
-                [ 572 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 572 ),
-                [ 573 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 573 ),
-                [ 574 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 574 ),
-                [ 575 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 575 ),
-                [ 576 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 576 ),
-                [ 577 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 577 ),
-                [ 578 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 578 ),
-                [ 579 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 579 ),
-                [ 580 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 580 ),
-                [ 581 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 581 ),
-                [ 582 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 582 ),
-                [ 583 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 583 ),
-                [ 584 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 584 ),
-                [ 585 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 585 ),
-                [ 586 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 586 ),
-                [ 587 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 587 ),
-                [ 588 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 588 ),
-                [ 589 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 589 ),
-                [ 590 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 590 ),
-                [ 591 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 591 ),
-                [ 592 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 592 ),
-                [ 593 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 593 ),
-                [ 594 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 594 ),
-                [ 595 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 595 ),
-                [ 596 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 596 ),
-                [ 597 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 597 ),
-                [ 598 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 598 ),
-                [ 599 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 599 ),
-                [ 600 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 600 ),
-                [ 601 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 601 ),
-                [ 602 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 602 ),
-                [ 603 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 603 ),
-                [ 604 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 604 ),
-                [ 605 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 605 ),
-                [ 606 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 606 ),
-                [ 607 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 607 ),
-                [ 608 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 608 ),
-                [ 609 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 609 ),
-                [ 610 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 610 ),
-                [ 611 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 611 ),
-                [ 612 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 612 ),
-                [ 613 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 613 ),
-                [ 614 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 614 ),
-                [ 615 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 615 ),
-                [ 616 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 616 ),
-                [ 617 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 617 ),
-                [ 618 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 618 ),
-                [ 619 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 619 ),
-                [ 620 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 620 ),
-                [ 621 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 621 ),
-                [ 622 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 622 ),
-                [ 623 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 623 ),
-                [ 624 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 624 ),
-                [ 625 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 625 ),
-                [ 626 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 626 ),
-                [ 627 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 627 ),
-                [ 628 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 628 ),
-                [ 629 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 629 ),
-                [ 630 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 630 ),
-                [ 631 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 631 ),
-                [ 632 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 632 ),
-                [ 633 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 633 ),
-                [ 634 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 634 ),
-                [ 635 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 635 ),
-                [ 636 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 636 ),
-                [ 637 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 637 ),
-                [ 638 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 638 ),
-                [ 639 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 639 ),
-                [ 640 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 640 ),
-                [ 641 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 641 ),
-                [ 642 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 642 ),
-                [ 643 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 643 ),
-                [ 644 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 644 ),
-                [ 645 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 645 ),
-                [ 646 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 646 ),
-                [ 647 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 647 ),
-                [ 648 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 648 ),
-                [ 649 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 649 ),
-                [ 650 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 650 ),
-                [ 651 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 651 ),
-                [ 652 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 652 ),
-                [ 653 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 653 ),
-                [ 654 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 654 ),
-                [ 655 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 655 ),
-                [ 656 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 656 ),
-                [ 657 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 657 ),
-                [ 658 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 658 ),
-                [ 659 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 659 ),
-                [ 660 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 660 ),
-                [ 661 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 661 ),
-                [ 662 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 662 ),
-                [ 663 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 663 ),
-                [ 664 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 664 ),
-                [ 665 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 665 ),
-                [ 666 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 666 ),
-                [ 667 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 667 ),
-                [ 668 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 668 ),
-                [ 669 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 669 ),
-                [ 670 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 670 ),
-                [ 671 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 671 ),
-                [ 672 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 672 ),
-                [ 673 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 673 ),
-                [ 674 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 674 ),
-                [ 675 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 675 ),
-                [ 676 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 676 ),
-                [ 677 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 677 ),
-                [ 678 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 678 ),
-                [ 679 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 679 ),
-                [ 680 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 680 ),
-                [ 681 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 681 ),
-                [ 682 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 682 ),
-                [ 683 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 683 ),
-                [ 684 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 684 ),
-                [ 685 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 685 ),
-                [ 686 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 686 ),
-                [ 687 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 687 ),
-                [ 688 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 688 ),
-                [ 689 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 689 ),
-                [ 690 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 690 ),
-                [ 691 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 691 ),
-                [ 692 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 692 ),
-                [ 693 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 693 ),
-                [ 694 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 694 ),
-                [ 695 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 695 ),
-                [ 696 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 696 ),
-                [ 697 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 697 ),
-                [ 698 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 698 ),
-                [ 699 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 699 ),
-                [ 700 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 700 ),
-                [ 701 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 701 ),
-                [ 702 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 702 ),
-                [ 703 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 703 ),
-                [ 704 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 704 ),
-                [ 705 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 705 ),
-                [ 706 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 706 ),
-                [ 707 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 707 ),
-                [ 708 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 708 ),
-                [ 709 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 709 ),
-                [ 710 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 710 ),
-                [ 711 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 711 ),
-                [ 712 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 712 ),
-                [ 713 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 713 ),
-                [ 714 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 714 ),
-                [ 715 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 715 ),
-                [ 716 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 716 ),
-                [ 717 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 717 ),
-                [ 718 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 718 ),
-                [ 719 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 719 ),
-                [ 720 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 720 ),
-                [ 721 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 721 ),
-                [ 722 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 722 ),
-                [ 723 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 723 ),
-                [ 724 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 724 ),
-                [ 725 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 725 ),
-                [ 726 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 726 ),
-                [ 727 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 727 ),
-                [ 728 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 728 ),
-                [ 729 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 729 ),
-                [ 730 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 730 ),
-                [ 731 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 731 ),
-                [ 732 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 732 ),
-                [ 733 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 733 ),
-                [ 734 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 734 ),
-                [ 735 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 735 ),
-                [ 736 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 736 ),
-                [ 737 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 737 ),
-                [ 738 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 738 ),
-                [ 739 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 739 ),
-                [ 740 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 740 ),
-                [ 741 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 741 ),
-                [ 742 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 742 ),
-                [ 743 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 743 ),
-                [ 744 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 744 ),
-                [ 745 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 745 ),
-                [ 746 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 746 ),
-                [ 747 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 747 ),
-                [ 748 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 748 ),
-                [ 749 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 749 ),
-                [ 750 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 750 ),
-                [ 751 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 751 ),
-                [ 752 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 752 ),
-                [ 753 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 753 ),
-                [ 754 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 754 ),
-                [ 755 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 755 ),
-                [ 756 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 756 ),
-                [ 757 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 757 ),
-                [ 758 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 758 ),
-                [ 759 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 759 ),
-                [ 760 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 760 ),
-                [ 761 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 761 ),
-                [ 762 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 762 ),
-                [ 763 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 763 ),
-                [ 764 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 764 ),
-                [ 765 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 765 ),
-                [ 766 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 766 ),
-                [ 767 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 767 ),
-                [ 768 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 768 ),
-                [ 769 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 769 ),
-                [ 770 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 770 ),
-                [ 771 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 771 ),
-                [ 772 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 772 ),
-                [ 773 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 773 ),
-                [ 774 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 774 ),
-                [ 775 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 775 ),
-                [ 776 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 776 ),
-                [ 777 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 777 ),
-                [ 778 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 778 ),
-                [ 779 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 779 ),
-                [ 780 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 780 ),
-                [ 781 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 781 ),
-                [ 782 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 782 ),
-                [ 783 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 783 ),
-                [ 784 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 784 ),
-                [ 785 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 785 ),
-                [ 786 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 786 ),
-                [ 787 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 787 ),
-                [ 788 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 788 ),
-                [ 789 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 789 ),
-                [ 790 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 790 ),
-                [ 791 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 791 ),
-                [ 792 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 792 ),
-                [ 793 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 793 ),
-                [ 794 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 794 ),
-                [ 795 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 795 ),
-                [ 796 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 796 ),
-                [ 797 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 797 ),
-                [ 798 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 798 ),
-                [ 799 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 799 ),
-                [ 800 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 800 ),
-                [ 801 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 801 ),
-                [ 802 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 802 ),
-                [ 803 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 803 ),
-                [ 804 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 804 ),
-                [ 805 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 805 ),
-                [ 806 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 806 ),
-                [ 807 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 807 ),
-                [ 808 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 808 ),
-                [ 809 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 809 ),
-                [ 810 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 810 ),
-                [ 811 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 811 ),
-                [ 812 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 812 ),
-                [ 813 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 813 ),
-                [ 814 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 814 ),
-                [ 815 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 815 ),
-                [ 816 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 816 ),
-                [ 817 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 817 ),
-                [ 818 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 818 ),
-                [ 819 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 819 ),
-                [ 820 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 820 ),
-                [ 821 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 821 ),
-                [ 822 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 822 ),
-                [ 823 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 823 ),
-                [ 824 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 824 ),
-                [ 825 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 825 ),
-                [ 826 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 826 ),
-                [ 827 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 827 ),
-                [ 828 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 828 ),
-                [ 829 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 829 ),
-                [ 830 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 830 ),
-                [ 831 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 831 ),
-                [ 832 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 832 ),
-                [ 833 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 833 ),
-                [ 834 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 834 ),
-                [ 835 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 835 ),
-                [ 836 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 836 ),
-                [ 837 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 837 ),
-                [ 838 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 838 ),
-                [ 839 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 839 ),
-                [ 840 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 840 ),
-                [ 841 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 841 ),
-                [ 842 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 842 ),
-                [ 843 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 843 ),
-                [ 844 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 844 ),
-                [ 845 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 845 ),
-                [ 846 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 846 ),
-                [ 847 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 847 ),
-                [ 848 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 848 ),
-                [ 849 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 849 ),
-                [ 850 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 850 ),
-                [ 851 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 851 ),
-                [ 852 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 852 ),
-                [ 853 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 853 ),
-                [ 854 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 854 ),
-                [ 855 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 855 ),
-                [ 856 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 856 ),
-                [ 857 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 857 ),
-                [ 858 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 858 ),
-                [ 859 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 859 ),
-                [ 860 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 860 ),
-                [ 861 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 861 ),
-                [ 862 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 862 ),
-                [ 863 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 863 ),
-                [ 864 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 864 ),
-                [ 865 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 865 ),
-                [ 866 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 866 ),
-                [ 867 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 867 ),
-                [ 868 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 868 ),
-                [ 869 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 869 ),
-                [ 870 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 870 ),
-                [ 871 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 871 ),
-                [ 872 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 872 ),
-                [ 873 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 873 ),
-                [ 874 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 874 ),
-                [ 875 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 875 ),
-                [ 876 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 876 ),
-                [ 877 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 877 ),
-                [ 878 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 878 ),
-                [ 879 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 879 ),
-                [ 880 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 880 ),
-                [ 881 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 881 ),
-                [ 882 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 882 ),
-                [ 883 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 883 ),
-                [ 884 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 884 ),
-                [ 885 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 885 ),
-                [ 886 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 886 ),
-                [ 887 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 887 ),
-                [ 888 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 888 ),
-                [ 889 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 889 ),
-                [ 890 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 890 ),
-                [ 891 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 891 ),
-                [ 892 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 892 ),
-                [ 893 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 893 ),
-                [ 894 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 894 ),
-                [ 895 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 895 ),
-                [ 896 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 896 ),
-                [ 897 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 897 ),
-                [ 898 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 898 ),
-                [ 899 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 899 ),
-                [ 900 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 900 ),
-                [ 901 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 901 ),
-                [ 902 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 902 ),
-                [ 903 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 903 ),
-                [ 904 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 904 ),
-                [ 905 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 905 ),
-                [ 906 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 906 ),
-                [ 907 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 907 ),
-                [ 908 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 908 ),
-                [ 909 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 909 ),
-                [ 910 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 910 ),
-                [ 911 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 911 ),
-                [ 912 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 912 ),
-                [ 913 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 913 ),
-                [ 914 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 914 ),
-                [ 915 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 915 ),
-                [ 916 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 916 ),
-                [ 917 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 917 ),
-                [ 918 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 918 ),
-                [ 919 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 919 ),
-                [ 920 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 920 ),
-                [ 921 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 921 ),
-                [ 922 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 922 ),
-                [ 923 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 923 ),
-                [ 924 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 924 ),
-                [ 925 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 925 ),
-                [ 926 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 926 ),
-                [ 927 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 927 ),
-                [ 928 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 928 ),
-                [ 929 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 929 ),
-                [ 930 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 930 ),
-                [ 931 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 931 ),
-                [ 932 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 932 ),
-                [ 933 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 933 ),
-                [ 934 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 934 ),
-                [ 935 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 935 ),
-                [ 936 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 936 ),
-                [ 937 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 937 ),
-                [ 938 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 938 ),
-                [ 939 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 939 ),
-                [ 940 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 940 ),
-                [ 941 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 941 ),
-                [ 942 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 942 ),
-                [ 943 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 943 ),
-                [ 944 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 944 ),
-                [ 945 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 945 ),
-                [ 946 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 946 ),
-                [ 947 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 947 ),
-                [ 948 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 948 ),
-                [ 949 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 949 ),
-                [ 950 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 950 ),
-                [ 951 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 951 ),
-                [ 952 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 952 ),
-                [ 953 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 953 ),
-                [ 954 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 954 ),
-                [ 955 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 955 ),
-                [ 956 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 956 ),
-                [ 957 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 957 ),
-                [ 958 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 958 ),
-                [ 959 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 959 ),
-                [ 960 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 960 ),
-                [ 961 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 961 ),
-                [ 962 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 962 ),
-                [ 963 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 963 ),
-                [ 964 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 964 ),
-                [ 965 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 965 ),
-                [ 966 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 966 ),
-                [ 967 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 967 ),
-                [ 968 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 968 ),
-                [ 969 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 969 ),
-                [ 970 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 970 ),
-                [ 971 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 971 ),
-                [ 972 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 972 ),
-                [ 973 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 973 ),
-                [ 974 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 974 ),
-                [ 975 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 975 ),
-                [ 976 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 976 ),
-                [ 977 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 977 ),
-                [ 978 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 978 ),
-                [ 979 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 979 ),
-                [ 980 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 980 ),
-                [ 981 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 981 ),
-                [ 982 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 982 ),
-                [ 983 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 983 ),
-                [ 984 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 984 ),
-                [ 985 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 985 ),
-                [ 986 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 986 ),
-                [ 987 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 987 ),
-                [ 988 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 988 ),
-                [ 989 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 989 ),
-                [ 990 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 990 ),
-                [ 991 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 991 ),
-                [ 992 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 992 ),
-                [ 993 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 993 ),
-                [ 994 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 994 ),
-                [ 995 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 995 ),
-                [ 996 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 996 ),
-                [ 997 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 997 ),
-                [ 998 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 998 ),
-                [ 999 ] = ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME( 999 )
-        };
-
-#undef ELASTIC_APM_DEFINE_NUMBERED_INTERCEPTING_CALLBACK
-#undef ELASTIC_APM_NUMBERED_INTERCEPTING_CALLBACK_NAME
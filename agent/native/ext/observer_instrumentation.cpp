@@ -0,0 +1,328 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "observer_instrumentation.h"
+#include <php.h>
+#if PHP_VERSION_ID >= 80000
+#include <zend_observer.h>
+#endif
+#include <string>
+#include <unordered_map>
+#include "ConfigSnapshot.h"
+#include "elastic_apm_API.h"
+#include "fast_path_spans.h"
+#include "lifecycle.h"
+#include "log.h"
+#include "tracer_PHP_part.h"
+#include "util.h"
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_EXT_API
+
+static bool g_isObserverInstrumentationActive = false;
+
+bool isObserverInstrumentationActive()
+{
+    return g_isObserverInstrumentationActive;
+}
+
+bool canObserveInternalFunctions()
+{
+#if PHP_VERSION_ID >= 80200
+    return g_isObserverInstrumentationActive;
+#else
+    // Zend calls observers for internal functions only starting with PHP 8.2
+    return false;
+#endif
+}
+
+#if PHP_VERSION_ID >= 80000
+
+struct ObserverRegistration
+{
+    uint32_t interceptRegistrationId;
+    bool isRegisteredInCurrentRequest;
+};
+
+// Key is "class::function" (or just "function") in lower case - the same form PHP uses for its function tables.
+// Kept across requests - see observerInstrumentationOnRequestShutdown()
+static std::unordered_map<std::string, ObserverRegistration> g_registeredFunctionNameToId;
+// Filled by observer init callback so that begin handler looks up by pointer and not by name.
+// Inherited methods can be copies of zend_function sharing the declared one's run-time cache (and thus its observer handlers)
+// so init callback is not called for them - they are added by begin handler (see findObservedFunctionRegistration()).
+// Values point into g_registeredFunctionNameToId (node based map so the pointers stay valid until the entry is erased)
+static std::unordered_map<const zend_function*, const ObserverRegistration*> g_observedFunctionToId;
+
+static void appendLowerCase( std::string& dst, const zend_string* src )
+{
+    const size_t offset = dst.size();
+    dst.append( ZSTR_VAL( src ), ZSTR_LEN( src ) );
+    zend_str_tolower( dst.data() + offset, ZSTR_LEN( src ) );
+}
+
+// Function and method forms of the same internal function (e.g. mysqli_query and mysqli::query) share the handler
+// but they are separate zend_function-s with separate registrations so the handler cannot be used as the key
+static
+const ObserverRegistration* findObservedFunctionRegistration( zend_function* func )
+{
+    auto observed = g_observedFunctionToId.find( func );
+    if ( observed != g_observedFunctionToId.end() )
+    {
+        return observed->second;
+    }
+
+    // Copy of inherited method keeps the declaring class as its scope
+    if ( func->common.scope == NULL || func->common.function_name == NULL )
+    {
+        return NULL;
+    }
+
+    zend_string* lowerCaseName = zend_string_tolower( func->common.function_name );
+    auto declaredFunc = static_cast< zend_function* >( zend_hash_find_ptr( &func->common.scope->function_table, lowerCaseName ) );
+    zend_string_release( lowerCaseName );
+    if ( declaredFunc == NULL || declaredFunc == func )
+    {
+        return NULL;
+    }
+
+    observed = g_observedFunctionToId.find( declaredFunc );
+    if ( observed == g_observedFunctionToId.end() )
+    {
+        return NULL;
+    }
+
+    // remembered so that the next call of the copy is found directly
+    g_observedFunctionToId.emplace( func, observed->second );
+    return observed->second;
+}
+
+static
+void elasticApmObserverBegin( zend_execute_data* execute_data )
+{
+    const ObserverRegistration* registration = findObservedFunctionRegistration( execute_data->func );
+    if ( registration == NULL || ! registration->isRegisteredInCurrentRequest )
+    {
+        return;
+    }
+
+    // We SHOULD NOT log before resetting state if forked because logging might be using thread synchronization
+    // which might deadlock in forked child
+    if ( elasticApmEnterAgentCode( __FILE__, __LINE__, __FUNCTION__ ) != resultSuccess )
+    {
+        return;
+    }
+
+    const uint32_t interceptRegistrationId = registration->interceptRegistrationId;
+
+    ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY_MSG( "interceptRegistrationId: %u", interceptRegistrationId );
+
+    InterceptedCallInProgress* call = pushInterceptedCallInProgress( execute_data, interceptRegistrationId );
+    if ( call == NULL )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Intercepted calls are nested too deep (maxInterceptedCallsNestingDepth: %u) - call is not instrumented", (unsigned) maxInterceptedCallsNestingDepth );
+        return;
+    }
+
+    if ( isFastPathSpansRegistration( interceptRegistrationId ) )
+    {
+        // PHP part is not called at all - it takes the recorded span later
+        call->fastPathSpanSequenceNumber = fastPathSpanOnCallBegin( interceptRegistrationId, execute_data );
+        return;
+    }
+
+    // calls intercepted in the pre-hook itself are pushed and popped above this frame so it is looked up again afterwards
+    const bool shouldCallPostHook = tracerPhpPartInternalFuncCallPreHook( interceptRegistrationId, execute_data );
+    call = topInterceptedCallInProgress();
+    if ( call != NULL && call->executeData == execute_data )
+    {
+        call->shouldCallPostHook = shouldCallPostHook;
+    }
+}
+
+static
+void elasticApmObserverEnd( zend_execute_data* execute_data, zval* retval )
+{
+    // end handler is called for every observed function - only the ones pushed by begin handler are on the top
+    const InterceptedCallInProgress* call = topInterceptedCallInProgress();
+    if ( call == NULL || call->executeData != execute_data )
+    {
+        return;
+    }
+    const InterceptedCallInProgress callCopy = *call;
+    popInterceptedCallInProgress();
+
+    if ( callCopy.fastPathSpanSequenceNumber != 0 )
+    {
+        fastPathSpanOnCallEnd( callCopy.fastPathSpanSequenceNumber, retval );
+    }
+
+    if ( callCopy.shouldCallPostHook )
+    {
+        const uint32_t interceptRegistrationId = callCopy.interceptRegistrationId;
+        zval retValOrThrown;
+        bool hasExitedByException = ( EG( exception ) != NULL );
+        if ( hasExitedByException )
+        {
+            ZVAL_OBJ( &retValOrThrown, EG( exception ) );
+        }
+        else if ( retval == NULL )
+        {
+            // Zend passes NULL when return value is not used by the caller
+            ZVAL_NULL( &retValOrThrown );
+        }
+        else
+        {
+            ZVAL_COPY_VALUE( &retValOrThrown, retval );
+        }
+        tracerPhpPartInternalFuncCallPostHook( interceptRegistrationId, hasExitedByException, &retValOrThrown );
+    }
+
+    ELASTIC_APM_LOG_TRACE_FUNCTION_EXIT();
+}
+
+static
+zend_observer_fcall_handlers elasticApmObserverInit( zend_execute_data* execute_data )
+{
+    zend_function* func = execute_data->func;
+    if ( g_registeredFunctionNameToId.empty() || func->common.function_name == NULL )
+    {
+        return zend_observer_fcall_handlers{ NULL, NULL };
+    }
+
+    std::string key;
+    if ( func->common.scope != NULL )
+    {
+        appendLowerCase( key, func->common.scope->name );
+        key.append( "::" );
+    }
+    appendLowerCase( key, func->common.function_name );
+
+    auto registered = g_registeredFunctionNameToId.find( key );
+    if ( registered == g_registeredFunctionNameToId.end() )
+    {
+        return zend_observer_fcall_handlers{ NULL, NULL };
+    }
+
+    ELASTIC_APM_LOG_DEBUG( "Observing calls to %s; interceptRegistrationId: %u", key.c_str(), registered->second.interceptRegistrationId );
+    g_observedFunctionToId[ func ] = &( registered->second );
+    return zend_observer_fcall_handlers{ elasticApmObserverBegin, elasticApmObserverEnd };
+}
+
+void observerInstrumentationOnModuleInit( const ConfigSnapshot* config )
+{
+    if ( ! config->observerInstrumentationEnabled )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Observer API based interception is DISABLED because configuration option %s is set to false", ELASTIC_APM_CFG_OPT_NAME_OBSERVER_INSTRUMENTATION_ENABLED );
+        return;
+    }
+
+    zend_observer_fcall_register( elasticApmObserverInit );
+    g_isObserverInstrumentationActive = true;
+    ELASTIC_APM_LOG_DEBUG( "Registered observer for function calls; internal functions can be observed: %s", boolToString( canObserveInternalFunctions() ) );
+}
+
+ResultCode observerInstrumentationInterceptCallsTo( StringView className, StringView functionName, uint32_t newInterceptRegistrationId, uint32_t* interceptRegistrationId )
+{
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "className: `%.*s'; functionName: `%.*s'; newInterceptRegistrationId: %u"
+                                              , (int) className.length, className.begin, (int) functionName.length, functionName.begin, newInterceptRegistrationId );
+    ResultCode resultCode;
+
+    if ( ! g_isObserverInstrumentationActive )
+    {
+        ELASTIC_APM_LOG_ERROR( "Observer API based interception is not active" );
+        ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
+    }
+
+    {
+        std::string key( className.begin, className.length );
+        if ( ! key.empty() )
+        {
+            key.append( "::" );
+        }
+        key.append( functionName.begin, functionName.length );
+        zend_str_tolower( key.data(), key.size() );
+        auto registered = g_registeredFunctionNameToId.find( key );
+        if ( registered == g_registeredFunctionNameToId.end() )
+        {
+            registered = g_registeredFunctionNameToId.emplace( std::move( key ), ObserverRegistration{ newInterceptRegistrationId, false } ).first;
+        }
+        else if ( registered->second.isRegisteredInCurrentRequest )
+        {
+            // The same as with the handler replacing interception the last registration wins
+            registered->second.interceptRegistrationId = newInterceptRegistrationId;
+        }
+        // otherwise it was registered in one of the previous requests and the same ID is given back
+        registered->second.isRegisteredInCurrentRequest = true;
+        *interceptRegistrationId = registered->second.interceptRegistrationId;
+    }
+
+    resultCode = resultSuccess;
+
+    finally:
+    ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT_MSG( "interceptRegistrationId: %u", resultCode == resultSuccess ? *interceptRegistrationId : 0 );
+    return resultCode;
+
+    failure:
+    goto finally;
+}
+
+void observerInstrumentationOnRequestShutdown()
+{
+    // Zend resets its per-function observer cache on each request (run-time cache)
+    // so init callback is called again on the first call in the next request.
+    // Registrations by name are kept - PHP part gets back the same IDs when it registers again.
+    for ( auto& registered : g_registeredFunctionNameToId )
+    {
+        registered.second.isRegisteredInCurrentRequest = false;
+    }
+    // user functions (and copies of inherited methods) may not outlive the request
+    g_observedFunctionToId.clear();
+}
+
+void observerInstrumentationInvalidateRegistrations()
+{
+    g_observedFunctionToId.clear();
+    g_registeredFunctionNameToId.clear();
+}
+
+#else // #if PHP_VERSION_ID >= 80000
+
+void observerInstrumentationOnModuleInit( const ConfigSnapshot* config )
+{
+    ELASTIC_APM_UNUSED( config );
+    ELASTIC_APM_LOG_DEBUG( "Observer API based interception is not available before PHP 8" );
+}
+
+ResultCode observerInstrumentationInterceptCallsTo( StringView className, StringView functionName, uint32_t newInterceptRegistrationId, uint32_t* interceptRegistrationId )
+{
+    ELASTIC_APM_UNUSED( className );
+    ELASTIC_APM_UNUSED( functionName );
+    ELASTIC_APM_UNUSED( interceptRegistrationId );
+    ELASTIC_APM_LOG_ERROR( "Observer API based interception is not available before PHP 8; newInterceptRegistrationId: %u", newInterceptRegistrationId );
+    return resultFailure;
+}
+
+void observerInstrumentationOnRequestShutdown()
+{
+}
+
+void observerInstrumentationInvalidateRegistrations()
+{
+}
+
+#endif // #if PHP_VERSION_ID >= 80000
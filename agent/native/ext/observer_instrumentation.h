@@ -0,0 +1,59 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <zend_types.h>
+#include "ConfigSnapshot_forward_decl.h"
+#include "ResultCode.h"
+#include "StringView.h"
+
+/**
+ * Interception engine built on Zend Observer API (PHP 8+).
+ *
+ * Observer is registered on module init (it is not possible to register it after PHP startup)
+ * and Zend calls our init callback once per function per request - on the function's first call.
+ * The callback returns begin/end handlers only for functions registered for interception
+ * so calls to all the other functions do not pay anything beyond that one lookup.
+ *
+ * User functions are matched by name so they can be registered before the declaring file is even compiled.
+ * Internal functions can be observed only on PHP 8.2+ - on older versions they are intercepted by replacing the handler.
+ *
+ * Since the decision is cached by Zend, registration has to happen before the first call to the function in the request.
+ * Registrations by name are kept across requests in the same worker so functions registered in one of the previous requests
+ * get the handlers even if they are called before PHP part registers them again - the hooks are called only after that.
+ */
+
+void observerInstrumentationOnModuleInit( const ConfigSnapshot* config );
+
+bool isObserverInstrumentationActive();
+
+bool canObserveInternalFunctions();
+
+/**
+ * @param className should be empty for standalone functions. For methods it is the class declaring the method.
+ * @param newInterceptRegistrationId is used unless the function was registered in one of the previous requests
+ *                                   - the ID of the previous registration is given back in that case
+ */
+ResultCode observerInstrumentationInterceptCallsTo( StringView className, StringView functionName, uint32_t newInterceptRegistrationId, uint32_t* interceptRegistrationId );
+
+void observerInstrumentationOnRequestShutdown();
+
+void observerInstrumentationInvalidateRegistrations();
@@ -23,6 +23,8 @@
 #include "elastic_apm_version.h"
 
 #include "AgentGlobals.h"
+#include "InferredSpansSamples.h"
+#include "sample_prof.h"
 
 #include "PhpErrorData.h"
 
@@ -45,6 +47,8 @@ ZEND_TSRMLS_CACHE_EXTERN()
 ZEND_BEGIN_MODULE_GLOBALS(elastic_apm)
     Tracer globalTracer;
     elasticapm::php::AgentGlobals *globals;
+    elasticapm::php::InferredSpansSamples *inferredSpansSamples;
+    elasticapm::php::ContinuousProfiler *continuousProfiler;
     zval lastException;
     std::unique_ptr<elasticapm::php::PhpErrorData> lastErrorData;
     bool captureErrorsUsingNative;
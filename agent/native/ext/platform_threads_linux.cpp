@@ -510,6 +510,12 @@ static void callbackToLogForkBeforeInParent()
     if (ELASTICAPM_G(globals) && ELASTICAPM_G(globals)->periodicTaskExecutor_) {
         ELASTICAPM_G(globals)->periodicTaskExecutor_->prefork();
     }
+    if (ELASTICAPM_G(globals) && ELASTICAPM_G(globals)->samplingTimer_) {
+        ELASTICAPM_G(globals)->samplingTimer_->prefork();
+    }
+    if (ELASTICAPM_G(continuousProfiler)) {
+        ELASTICAPM_G(continuousProfiler)->prefork();
+    }
 }
 
 static void callbackToLogForkAfterInParent()
@@ -518,6 +524,12 @@ static void callbackToLogForkAfterInParent()
     if (ELASTICAPM_G(globals) && ELASTICAPM_G(globals)->periodicTaskExecutor_) {
         ELASTICAPM_G(globals)->periodicTaskExecutor_->postfork(false);
     }
+    if (ELASTICAPM_G(globals) && ELASTICAPM_G(globals)->samplingTimer_) {
+        ELASTICAPM_G(globals)->samplingTimer_->postfork(false);
+    }
+    if (ELASTICAPM_G(continuousProfiler)) {
+        ELASTICAPM_G(continuousProfiler)->postfork(false);
+    }
 }
 
 static void callbackToLogForkAfterInChild()
@@ -526,6 +538,12 @@ static void callbackToLogForkAfterInChild()
     if (ELASTICAPM_G(globals) && ELASTICAPM_G(globals)->periodicTaskExecutor_) {
         ELASTICAPM_G(globals)->periodicTaskExecutor_->postfork(true);
     }
+    if (ELASTICAPM_G(globals) && ELASTICAPM_G(globals)->samplingTimer_) {
+        ELASTICAPM_G(globals)->samplingTimer_->postfork(true);
+    }
+    if (ELASTICAPM_G(continuousProfiler)) {
+        ELASTICAPM_G(continuousProfiler)->postfork(true);
+    }
 }
 
 void registerCallbacksToLogFork()
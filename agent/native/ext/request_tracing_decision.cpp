@@ -0,0 +1,224 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "request_tracing_decision.h"
+#include "ConfigSnapshot.h"
+#include "ConfigManager.h"
+#include "log.h"
+#include "platform.h"
+#include "util_for_PHP.h"
+#include "TraceContext.h"
+#include "WildcardListMatcher.h"
+
+#include <Zend/zend_globals.h>
+#include <Zend/zend_hash.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_LIFECYCLE
+
+StringView requestTracingDecisionNames[ numberOfRequestTracingDecision ] =
+{
+    ELASTIC_APM_ENUM_NAMES_ARRAY_PAIR( requestTracingDecision_left_to_PHP_part ),
+    ELASTIC_APM_ENUM_NAMES_ARRAY_PAIR( requestTracingDecision_ignored ),
+    ELASTIC_APM_ENUM_NAMES_ARRAY_PAIR( requestTracingDecision_not_sampled ),
+    ELASTIC_APM_ENUM_NAMES_ARRAY_PAIR( requestTracingDecision_sampled ),
+};
+
+String requestTracingDecisionToString( RequestTracingDecision value )
+{
+    if ( requestTracingDecision_left_to_PHP_part <= value && value < numberOfRequestTracingDecision )
+    {
+        return requestTracingDecisionNames[ value ].begin;
+    }
+    return "<UNKNOWN RequestTracingDecision>";
+}
+
+// State below is per thread because in ZTS build requests are handled concurrently by threads of the same process
+
+// Parsed transaction_ignore_urls - rebuilt only when the option's value changes
+static thread_local std::optional< elasticapm::php::WildcardListMatcher > g_ignoreUrlsMatcher;
+static thread_local std::string g_ignoreUrlsMatcherSource;
+
+// Seeded in each process (and thread) separately - otherwise forked workers would make the same decisions in lockstep
+static thread_local std::mt19937_64 g_samplingRandom;
+static thread_local pid_t g_samplingRandomSeededForPid = 0;
+
+static
+std::optional< std::string_view > findServerVarString( std::string_view name )
+{
+    zval* server = zend_hash_str_find( &EG( symbol_table ), ZEND_STRL( "_SERVER" ) );
+    if ( server == NULL || Z_TYPE_P( server ) != IS_ARRAY )
+    {
+        return std::nullopt;
+    }
+
+    zval* value = zend_hash_str_find( Z_ARRVAL_P( server ), name.data(), name.size() );
+    if ( value == NULL || Z_TYPE_P( value ) != IS_STRING )
+    {
+        return std::nullopt;
+    }
+    return std::string_view{ Z_STRVAL_P( value ), Z_STRLEN_P( value ) };
+}
+
+/**
+ * PHP part takes the path from REQUEST_URI using parse_url() - only the URIs that certainly have the same path
+ * in both implementations are handled natively (absolute path without scheme, authority and ':').
+ */
+static
+std::optional< std::string_view > extractUrlPath( std::string_view requestUri )
+{
+    if ( ! requestUri.starts_with( '/' ) || requestUri.starts_with( "//" ) )
+    {
+        return std::nullopt;
+    }
+
+    std::string_view path = requestUri.substr( 0, requestUri.find_first_of( "?#" ) );
+    if ( path.find( ':' ) != std::string_view::npos )
+    {
+        return std::nullopt;
+    }
+    return path;
+}
+
+static
+bool isUrlPathIgnored( const ConfigSnapshot* config, std::string_view urlPath )
+{
+    if ( config->transactionIgnoreUrls == NULL )
+    {
+        return false;
+    }
+
+    if ( ! g_ignoreUrlsMatcher || g_ignoreUrlsMatcherSource != config->transactionIgnoreUrls )
+    {
+        g_ignoreUrlsMatcherSource = config->transactionIgnoreUrls;
+        g_ignoreUrlsMatcher.emplace( g_ignoreUrlsMatcherSource );
+    }
+
+    auto matchedIndex = g_ignoreUrlsMatcher->match( urlPath );
+    if ( ! matchedIndex )
+    {
+        return false;
+    }
+
+    ELASTIC_APM_LOG_DEBUG( "URL path `%.*s' matched expression #%zu of " ELASTIC_APM_CFG_OPT_NAME_TRANSACTION_IGNORE_URLS ": `%s'"
+                           , (int)urlPath.size(), urlPath.data(), *matchedIndex, config->transactionIgnoreUrls );
+    return true;
+}
+
+/**
+ * Parsed and adapted the same way as by PHP part (see Config\Snapshot::adaptTransactionSampleRate())
+ * or std::nullopt if the value is not the one PHP part would accept.
+ */
+static
+std::optional< double > parseTransactionSampleRate( String rawValue )
+{
+    if ( rawValue == NULL )
+    {
+        return 1.0;
+    }
+
+    char* end = NULL;
+    errno = 0;
+    double sampleRate = strtod( rawValue, &end );
+    while ( end != NULL && isspace( static_cast< unsigned char >( *end ) ) )
+    {
+        ++end;
+    }
+    if ( end == rawValue || end == NULL || *end != '\0' || errno != 0 || ! ( 0.0 <= sampleRate && sampleRate <= 1.0 ) )
+    {
+        return std::nullopt;
+    }
+
+    if ( sampleRate == 0.0 )
+    {
+        return sampleRate;
+    }
+    return std::max( 0.0001, std::round( sampleRate * 10000 ) / 10000 );
+}
+
+static
+bool makeSamplingDecision( double sampleRate )
+{
+    if ( sampleRate == 0.0 )
+    {
+        return false;
+    }
+    if ( sampleRate == 1.0 )
+    {
+        return true;
+    }
+
+    pid_t currentProcessId = getCurrentProcessId();
+    if ( g_samplingRandomSeededForPid != currentProcessId )
+    {
+        g_samplingRandom.seed( std::random_device{}() );
+        g_samplingRandomSeededForPid = currentProcessId;
+    }
+    return std::uniform_real_distribution< double >( 0.0, 1.0 )( g_samplingRandom ) < sampleRate;
+}
+
+RequestTracingDecision decideRequestTracing( const ConfigSnapshot* config )
+{
+    if ( isPhpRunningAsCliScript() )
+    {
+        return requestTracingDecision_left_to_PHP_part;
+    }
+
+    std::optional< std::string_view > requestUri = findServerVarString( "REQUEST_URI" );
+    if ( ! requestUri )
+    {
+        return requestTracingDecision_left_to_PHP_part;
+    }
+
+    std::optional< std::string_view > urlPath = extractUrlPath( *requestUri );
+    if ( ! urlPath )
+    {
+        return requestTracingDecision_left_to_PHP_part;
+    }
+
+    if ( isUrlPathIgnored( config, *urlPath ) )
+    {
+        return requestTracingDecision_ignored;
+    }
+
+    // invalid traceparent is ignored by PHP part as well - transaction starts a new trace
+    if ( std::optional< std::string_view > traceParent = findServerVarString( "HTTP_TRACEPARENT" ) )
+    {
+        if ( std::optional< bool > isSampled = elasticapm::php::parseTraceParentSampledFlag( *traceParent ) )
+        {
+            return *isSampled ? requestTracingDecision_sampled : requestTracingDecision_not_sampled;
+        }
+    }
+
+    std::optional< double > sampleRate = parseTransactionSampleRate( config->transactionSampleRate );
+    if ( ! sampleRate )
+    {
+        return requestTracingDecision_left_to_PHP_part;
+    }
+    return makeSamplingDecision( *sampleRate ) ? requestTracingDecision_sampled : requestTracingDecision_not_sampled;
+}
@@ -0,0 +1,44 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+#include "ConfigSnapshot_forward_decl.h"
+#include "StringView.h"
+
+/**
+ * Decision made natively on request init whether the request's transaction is ignored (transaction_ignore_urls)
+ * or sampled (traceparent HTTP header, transaction_sample_rate), so that PHP part is not bootstrapped for ignored requests
+ * and is bootstrapped with only what is needed for unsampled ones.
+ * It is made only for HTTP requests - for everything else the decision is left to PHP part.
+ */
+enum RequestTracingDecision
+{
+    requestTracingDecision_left_to_PHP_part,
+    requestTracingDecision_ignored,
+    requestTracingDecision_not_sampled,
+    requestTracingDecision_sampled,
+
+    numberOfRequestTracingDecision
+};
+typedef enum RequestTracingDecision RequestTracingDecision;
+
+RequestTracingDecision decideRequestTracing( const ConfigSnapshot* config );
+
+String requestTracingDecisionToString( RequestTracingDecision value );
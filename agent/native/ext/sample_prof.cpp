@@ -1,227 +1,341 @@
-// #ifdef HAVE_CONFIG_H
-// #include "config.h"
-// #endif
-
-// #include "php.h"
-// #include "php_ini.h"
-// #include "ext/standard/info.h"
-// #include "php_sample_prof.h"
-// #include "zend_exceptions.h"
-// #include "sample_prof_arginfo.h"
-
-// #include <pthread.h>
-
-// #define SAMPLE_PROF_DEFAULT_INTERVAL 1
-
-// /* On 64-bit this will give a 16 * 1MB allocation */
-// #define SAMPLE_PROF_DEFAULT_ALLOC (1 << 20)
-
-// ZEND_DECLARE_MODULE_GLOBALS(sample_prof)
-
-// static inline zend_bool sample_prof_end() {
-//     if (!SAMPLE_PROF_G->enabled) {
-//         return 0;
-//     }
-
-//     pthread_cancel(SAMPLE_PROF_G->thread_id);
-
-//     SAMPLE_PROF_G->enabled = 0;
-//     return 1;
-// }
-
-// static void *sample_prof_handler(void *data) {
-//     zend_sample_prof_globals *g = SAMPLE_PROF_G;
-
-// #ifdef ZTS
-//     volatile zend_executor_globals *eg = TSRMG_BULK(executor_globals_id, zend_executor_globals *);
-// #else
-//     volatile zend_executor_globals *eg = &executor_globals;
-// #endif
-
-//     retry_now:
-//     while (1) {
-//         volatile zend_execute_data *ex = eg->current_execute_data, *start_ex = ex;
-//         zend_function *func;
-//         const zend_op *opline;
-
-//         while (1) {
-//             zend_execute_data *prev;
-
-//             /* We're not executing code right now, try again later */
-//             if (!ex) {
-//                 goto retry_later;
-//             }
-
-//             func = ex->func;
-//             opline = ex->opline;
-//             prev = ex->prev_execute_data;
-
-//             /* current_execute_data changed in the meantime, reload it */
-//             if (eg->current_execute_data != start_ex) {
-//                 goto retry_now;
-//             }
-
-//             if (func && ZEND_USER_CODE(func->type)) {
-//                 break;
-//             }
-
-//             ex = prev;
-//         }
-
-//         if (!opline) {
-//             goto retry_later;
-//         }
-
-//         g->entries[g->entries_num].filename = func->op_array.filename;
-//         g->entries[g->entries_num].lineno = opline->lineno;
-
-//         if (++g->entries_num == g->entries_allocated) {
-//             /* Doing a realloc within a signal handler is unsafe, end profiling */
-//             g->enabled = 0;
-//             break;
-//         }
-
-//         retry_later:
-//         usleep(g->interval_usec);
-//     }
-//     pthread_exit(NULL);
-// }
-
-// static void sample_prof_start(long interval_usec, size_t num_entries_alloc) {
-//     zend_sample_prof_globals *g = SAMPLE_PROF_G;
-
-//     /* Initialize data structures for entries */
-//     if (g->entries) {
-//         efree(g->entries);
-//     }
-
-//     g->interval_usec = interval_usec;
-//     g->entries_allocated = num_entries_alloc;
-//     g->entries_num = 0;
-//     g->entries = safe_emalloc(g->entries_allocated, sizeof(sample_prof_entry), 0);
-
-//     /* Register signal handler */
-//     if (pthread_create(&g->thread_id, NULL, sample_prof_handler, NULL)) {
-//         zend_throw_exception(NULL, "Could not register signal handler", 0);
-//         return;
-//     }
-
-//     g->enabled = 1;
-// }
-
-// PHP_FUNCTION(sample_prof_start) {
-//         zend_long interval_usec = 0;
-//         zend_long num_entries_alloc = 0;
-
-//         if (zend_parse_parameters(ZEND_NUM_ARGS(), "|ll", &interval_usec, &num_entries_alloc) == FAILURE) {
-//             return;
-//         }
-
-//         if (interval_usec < 0) {
-//             zend_throw_exception(NULL, "Number of microseconds can't be negative", 0);
-//             return;
-//         } else if (interval_usec == 0) {
-//             interval_usec = SAMPLE_PROF_DEFAULT_INTERVAL;
-//         }
-
-//         if (num_entries_alloc < 0) {
-//             zend_throw_exception(NULL, "Number of profiling can't be negative", 0);
-//             return;
-//         } else if (num_entries_alloc == 0) {
-//             num_entries_alloc = SAMPLE_PROF_DEFAULT_ALLOC;
-//         }
-
-//         sample_prof_start(interval_usec, num_entries_alloc);
-// }
-
-// PHP_FUNCTION(sample_prof_end) {
-//         if (zend_parse_parameters_none() == FAILURE) {
-//             return;
-//         }
-
-//         RETURN_BOOL(sample_prof_end());
-// }
-
-// PHP_FUNCTION(sample_prof_get_data) {
-//         zend_sample_prof_globals *g = SAMPLE_PROF_G;
-//         size_t entry_num;
-
-//         if (zend_parse_parameters_none() == FAILURE) {
-//             return;
-//         }
-
-//         array_init(return_value);
-
-//         for (entry_num = 0; entry_num < g->entries_num; ++entry_num) {
-//             sample_prof_entry *entry = &g->entries[entry_num];
-//             zend_string *filename = entry->filename;
-//             uint32_t lineno = entry->lineno;
-//             zval *lines, *num;
-
-//             lines = zend_hash_find(Z_ARR_P(return_value), filename);
-//             if (lines == NULL) {
-//                 zval lines_zv;
-//                 array_init(&lines_zv);
-//                 lines = zend_hash_update(Z_ARR_P(return_value), filename, &lines_zv);
-//             }
-
-//             num = zend_hash_index_find(Z_ARR_P(lines), lineno);
-//             if (num == NULL) {
-//                 zval num_zv;
-//                 ZVAL_LONG(&num_zv, 0);
-//                 num = zend_hash_index_update(Z_ARR_P(lines), lineno, &num_zv);
-//             }
-
-//             increment_function(num);
-//         }
-// }
-
-// PHP_RINIT_FUNCTION(sample_prof)
-//         {
-//                 SAMPLE_PROF_G->enabled = 0;
-//         SAMPLE_PROF_G->entries = NULL;
-//         SAMPLE_PROF_G->entries_num = 0;
-
-//         return SUCCESS;
-//         }
-
-// PHP_RSHUTDOWN_FUNCTION(sample_prof)
-//         {
-//                 sample_prof_end();
-//         if (SAMPLE_PROF_G->entries) {
-//             efree(SAMPLE_PROF_G->entries);
-//         }
-
-//         return SUCCESS;
-//         }
-
-// PHP_MINFO_FUNCTION(sample_prof)
-//         {
-//                 php_info_print_table_start();
-//         php_info_print_table_header(2, "sample_prof support", "enabled");
-//         php_info_print_table_end();
-//         }
-
-// const zend_function_entry sample_prof_functions[] = {
-//         PHP_FE(sample_prof_start, arginfo_sample_prof_start)
-//         PHP_FE(sample_prof_end, arginfo_sample_prof_end)
-//         PHP_FE(sample_prof_get_data, arginfo_sample_prof_get_data)
-//         PHP_FE_END
-// };
-
-// zend_module_entry sample_prof_module_entry = {
-//         STANDARD_MODULE_HEADER,
-//         "sample_prof",
-//         sample_prof_functions,
-//         NULL,
-//         NULL,
-//         PHP_RINIT(sample_prof),
-//         PHP_RSHUTDOWN(sample_prof),
-//         PHP_MINFO(sample_prof),
-//         PHP_SAMPLE_PROF_VERSION,
-//         PHP_MODULE_GLOBALS(sample_prof),
-//         NULL,
-//         NULL,
-//         NULL,
-//         STANDARD_MODULE_PROPERTIES_EX
-// };
+#include "sample_prof.h"
+
+#include "ConfigManager.h"
+#include "ConfigSnapshot.h"
+#include "CommonUtils.h"
+#include "log.h"
+#include "time_util.h"
+
+#include <Zend/zend_globals.h>
+#include <Zend/zend_globals_macros.h>
+#include <curl/curl.h>
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+
+#define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_EXT_INFRA
+
+namespace elasticapm::php {
+
+static int64_t toNanoseconds(std::chrono::nanoseconds duration) {
+    return static_cast<int64_t>(duration.count());
+}
+
+static std::chrono::milliseconds parseDurationOption(String optionName, String value, std::chrono::milliseconds defaultValue) {
+    if (value == nullptr) {
+        return defaultValue;
+    }
+    try {
+        return elasticapm::utils::convertDurationWithUnit(value);
+    } catch (std::invalid_argument const &e) {
+        ELASTIC_APM_LOG_ERROR("%s '%s': '%s' - using default %zums", optionName, e.what(), value, static_cast<size_t>(defaultValue.count()));
+    }
+    return defaultValue;
+}
+
+static size_t discardResponse([[maybe_unused]] char *data, size_t size, size_t count, [[maybe_unused]] void *userData) {
+    return size * count;
+}
+
+// libcurl calls it at least once per second even when the transfer is stalled, so prefork waits at most that long
+static int abortTransferIfRequested(void *abortRequested, [[maybe_unused]] curl_off_t dlTotal, [[maybe_unused]] curl_off_t dlNow, [[maybe_unused]] curl_off_t ulTotal, [[maybe_unused]] curl_off_t ulNow) {
+    return static_cast<std::atomic<bool> *>(abortRequested)->load() ? 1 : 0;
+}
+
+ContinuousProfiler::ContinuousProfiler(InferredSpans::interruptFunc_t interrupt) : functionNames_(maxFramesPerStack) {
+    frames_.reserve(maxFramesPerStack);
+    sampler_ = std::make_shared<InferredSpans>(std::move(interrupt), [this]([[maybe_unused]] InferredSpans::time_point_t requestTime, [[maybe_unused]] InferredSpans::time_point_t now) {
+        captureSample(EG(current_execute_data));
+    });
+    sampler_->setPeriodicTaskDriven(false);
+}
+
+ContinuousProfiler::~ContinuousProfiler() {
+    stopSendingThread();
+}
+
+void ContinuousProfiler::onRequestInit(const ConfigSnapshot *config) {
+    enabled_ = config->profilingContinuousEnabled;
+    if (!enabled_) {
+        sampler_->setPeriodicTaskDriven(false);
+        return;
+    }
+
+    exportDir_ = config->profilingContinuousExportDir ? config->profilingContinuousExportDir : "";
+    exportUrl_ = config->profilingContinuousExportUrl ? config->profilingContinuousExportUrl : "";
+    if (exportDir_.empty() && exportUrl_.empty()) {
+        ELASTIC_APM_LOG_WARNING("Continuous profiling is enabled but neither " ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_EXPORT_DIR " nor " ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_EXPORT_URL " is set - profiler is disabled");
+        enabled_ = false;
+        sampler_->setPeriodicTaskDriven(false);
+        return;
+    }
+
+    samplingInterval_ = parseDurationOption(ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_SAMPLING_INTERVAL, config->profilingContinuousSamplingInterval, std::chrono::milliseconds{10});
+    if (samplingInterval_.count() <= 0) {
+        samplingInterval_ = std::chrono::milliseconds{10};
+        ELASTIC_APM_LOG_DEBUG("continuous profiler sampling interval too low, forced to default %zums", static_cast<size_t>(samplingInterval_.count()));
+    }
+    exportInterval_ = parseDurationOption(ELASTIC_APM_CFG_OPT_NAME_PROFILING_CONTINUOUS_EXPORT_INTERVAL, config->profilingContinuousExportInterval, std::chrono::milliseconds{60000});
+    exportTimeoutMs_ = config->serverTimeout.valueInUnits == 0 ? 0 : static_cast<long>(durationToMilliseconds(config->serverTimeout));
+    verifyServerCert_ = config->verifyServerCert;
+
+    sampler_->setInterval(samplingInterval_);
+    sampler_->reset();
+    sampler_->setPeriodicTaskDriven(true);
+}
+
+void ContinuousProfiler::onRequestShutdown() {
+    if (!enabled_) {
+        return;
+    }
+
+    if (exportInterval_.count() <= 0 || clock_t::now() - lastExportTime_ >= exportInterval_) {
+        exportProfile();
+    }
+}
+
+void ContinuousProfiler::flush() {
+    if (profile_.getSamplesCount() != 0) {
+        exportProfile();
+    }
+    stopSendingThread();
+}
+
+void ContinuousProfiler::prefork() {
+    // joining the sending thread must not wait for the HTTP round trip (up to export timeout) - transfer in progress is aborted
+    // and its profile is put back to the queue
+    abortSending_ = true;
+    stopSendingThread();
+    abortSending_ = false;
+}
+
+void ContinuousProfiler::postfork(bool child) {
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    if (!profileToSend_) {
+        return;
+    }
+    if (child) {
+        // profile aggregated by parent is sent by parent
+        profileToSend_.reset();
+        return;
+    }
+    startSendingThread();
+}
+
+void ContinuousProfiler::captureSample(zend_execute_data *executeData) {
+    if (!enabled_) {
+        return;
+    }
+
+    frames_.clear();
+    for (zend_execute_data *ex = executeData; ex && frames_.size() < maxFramesPerStack; ex = ex->prev_execute_data) {
+        zend_function *func = ex->func;
+        if (!func) {
+            continue;
+        }
+
+        std::string &name = functionNames_[frames_.size()];
+        name.clear();
+        if (func->common.scope) {
+            name.append(ZSTR_VAL(func->common.scope->name), ZSTR_LEN(func->common.scope->name));
+            name.append("::");
+        }
+        if (func->common.function_name) {
+            name.append(ZSTR_VAL(func->common.function_name), ZSTR_LEN(func->common.function_name));
+        } else {
+            name.append(ZEND_USER_CODE(func->type) ? "{main}" : "{internal}");
+        }
+
+        PprofProfile::frame_t frame{name, {}, 0};
+        if (ZEND_USER_CODE(func->type) && func->op_array.filename) {
+            frame.file = {ZSTR_VAL(func->op_array.filename), ZSTR_LEN(func->op_array.filename)};
+            frame.line = ex->opline ? ex->opline->lineno : 0;
+        }
+        frames_.push_back(frame);
+    }
+
+    if (frames_.empty()) {
+        return;
+    }
+
+    try {
+        profile_.addSample(frames_, toNanoseconds(samplingInterval_));
+    } catch (std::exception const &e) {
+        ELASTIC_APM_LOG_ERROR("Failed to add continuous profiler sample: '%s'", e.what());
+    }
+}
+
+void ContinuousProfiler::exportProfile() {
+    auto now = std::chrono::system_clock::now();
+
+    if (profile_.getSamplesCount() != 0) {
+        try {
+            std::string serialized = profile_.serialize(toNanoseconds(profileStartTime_.time_since_epoch()), toNanoseconds(now - profileStartTime_), toNanoseconds(samplingInterval_));
+
+            ELASTIC_APM_LOG_DEBUG("exporting continuous profile: %" PRIu64 " samples, %zu distinct stacks, %" PRIu64 " samples dropped, %zu bytes",
+                profile_.getSamplesCount(), profile_.getStacksCount(), profile_.getDroppedSamplesCount(), serialized.size());
+
+            if (!exportDir_.empty()) {
+                writeToDirectory(serialized, now);
+            }
+            if (!exportUrl_.empty()) {
+                queueForSending(std::move(serialized));
+            }
+        } catch (std::exception const &e) {
+            ELASTIC_APM_LOG_ERROR("Failed to export continuous profile: '%s'", e.what());
+        }
+    }
+
+    profile_.clear();
+    profileStartTime_ = now;
+    lastExportTime_ = clock_t::now();
+}
+
+bool ContinuousProfiler::writeToDirectory(std::string const &profile, std::chrono::system_clock::time_point now) {
+    long long timestampMs = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    std::string path = exportDir_ + "/elastic-apm-php-" + std::to_string(getpid()) + "-" + std::to_string(timestampMs) + ".pprof";
+    std::string tmpPath = path + ".tmp";
+
+    // written to temporary file first so that collectors watching the directory never see partially written profile
+    FILE *file = fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        ELASTIC_APM_LOG_ERROR("Failed to open '%s' for writing continuous profile; errno: %d", tmpPath.c_str(), errno);
+        return false;
+    }
+
+    bool written = fwrite(profile.data(), 1, profile.size(), file) == profile.size();
+    written = (fclose(file) == 0) && written;
+    if (!written || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        ELASTIC_APM_LOG_ERROR("Failed to write continuous profile to '%s'; errno: %d", path.c_str(), errno);
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    ELASTIC_APM_LOG_DEBUG("continuous profile written to '%s'", path.c_str());
+    return true;
+}
+
+void ContinuousProfiler::queueForSending(std::string profile) {
+    std::unique_lock<std::mutex> lock(sendMutex_);
+    if (profileToSend_) {
+        ELASTIC_APM_LOG_WARNING("previous continuous profile is still waiting to be sent to '%s' - it is dropped", profileToSend_->url.c_str());
+    }
+    profileToSend_ = profileToSend_t{std::move(profile), exportUrl_, exportTimeoutMs_, verifyServerCert_};
+    if (!startSendingThread()) {
+        return;
+    }
+    lock.unlock();
+    sendCondition_.notify_all();
+}
+
+// sendMutex_ has to be locked by caller
+bool ContinuousProfiler::startSendingThread() {
+    if (sendingThread_.joinable()) {
+        return true;
+    }
+    try {
+        sendingThread_ = std::thread([this]() { sendingWork(); });
+    } catch (std::system_error const &e) {
+        ELASTIC_APM_LOG_ERROR("Failed to start continuous profile sending thread: '%s' - profile is dropped", e.what());
+        profileToSend_.reset();
+        return false;
+    }
+    return true;
+}
+
+void ContinuousProfiler::stopSendingThread() {
+    {
+        std::lock_guard<std::mutex> lock(sendMutex_);
+        sendingThreadStopping_ = true;
+    }
+    sendCondition_.notify_all();
+    try {
+        if (sendingThread_.joinable()) {
+            sendingThread_.join();
+        }
+    } catch (std::system_error const &) {
+    }
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    sendingThreadStopping_ = false;
+}
+
+void ContinuousProfiler::sendingWork() {
+    std::unique_lock<std::mutex> lock(sendMutex_);
+    for (;;) {
+        sendCondition_.wait(lock, [this]() { return profileToSend_.has_value() || sendingThreadStopping_; });
+        // queued profile is sent even when stopping so that it is not lost on shutdown - but not when stopping before fork
+        if (!profileToSend_ || abortSending_) {
+            return;
+        }
+        profileToSend_t toSend = std::move(*profileToSend_);
+        profileToSend_.reset();
+
+        lock.unlock();
+        bool sent = sendToUrl(toSend);
+        lock.lock();
+
+        // aborted transfer is retried after fork unless newer profile was queued in the meantime
+        if (!sent && abortSending_ && !profileToSend_) {
+            profileToSend_ = std::move(toSend);
+        }
+    }
+}
+
+bool ContinuousProfiler::sendToUrl(profileToSend_t const &toSend) {
+    CURL *curl = curl_easy_init();
+    if (!curl) {
+        ELASTIC_APM_LOG_ERROR("curl_easy_init() returned NULL - continuous profile is not sent");
+        return false;
+    }
+
+    struct curl_slist *headers = curl_slist_append(nullptr, "Content-Type: application/octet-stream");
+
+    curl_easy_setopt(curl, CURLOPT_URL, toSend.url.c_str());
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, toSend.profile.data());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(toSend.profile.size()));
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discardResponse);
+    // libcurl must not use signals for timeouts as they would be delivered to an arbitrary thread of the process
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, abortTransferIfRequested);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &abortSending_);
+    if (toSend.timeoutMs > 0) {
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, toSend.timeoutMs);
+    }
+    if (!toSend.verifyServerCert) {
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    }
+
+    CURLcode result = curl_easy_perform(curl);
+    long responseCode = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+
+    if (result == CURLE_ABORTED_BY_CALLBACK) {
+        ELASTIC_APM_LOG_DEBUG("sending continuous profile to '%s' aborted before fork", toSend.url.c_str());
+        return false;
+    }
+    if (result != CURLE_OK) {
+        ELASTIC_APM_LOG_ERROR("Failed to send continuous profile to '%s': %s (%d)", toSend.url.c_str(), curl_easy_strerror(result), static_cast<int>(result));
+        return false;
+    }
+    if (responseCode >= 300) {
+        ELASTIC_APM_LOG_ERROR("Failed to send continuous profile to '%s': HTTP status %ld", toSend.url.c_str(), responseCode);
+        return false;
+    }
+
+    ELASTIC_APM_LOG_DEBUG("continuous profile sent to '%s'", toSend.url.c_str());
+    return true;
+}
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "ConfigSnapshot_forward_decl.h"
+#include "ForkableInterface.h"
+#include "InferredSpans.h"
+#include "PprofProfile.h"
+
+#include <Zend/zend_compile.h>
+#include <Zend/zend_types.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace elasticapm::php {
+
+/**
+ * Continuous sampling profiler.
+ *
+ * Samples are triggered the same way as inferred spans ones - Zend VM interrupt is requested periodically
+ * and the stack is walked by the thread executing PHP code when VM handles the interrupt, so the frames are always consistent
+ * (walking current_execute_data from another thread races with the VM).
+ * Stacks are aggregated in native memory with interned frames and exported as pprof profile
+ * either at the end of each request or once per export interval.
+ * Profiles are sent to export URL by a background thread so that request shutdown does not wait for the HTTP round trip.
+ */
+class ContinuousProfiler : public ForkableInterface {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    static constexpr std::size_t maxStacks = 16 * 1024;
+    static constexpr std::size_t maxFramesPerStack = 128;
+
+    explicit ContinuousProfiler(InferredSpans::interruptFunc_t interrupt);
+
+    ~ContinuousProfiler();
+
+    ContinuousProfiler(const ContinuousProfiler &) = delete;
+    ContinuousProfiler &operator=(const ContinuousProfiler &) = delete;
+
+    std::shared_ptr<InferredSpans> const &getSampler() const {
+        return sampler_;
+    }
+
+    bool isEnabled() const {
+        return enabled_;
+    }
+
+    std::chrono::milliseconds getSamplingInterval() const {
+        return samplingInterval_;
+    }
+
+    void onRequestInit(const ConfigSnapshot *config);
+
+    // Exports aggregated profile if export interval elapsed
+    void onRequestShutdown();
+
+    // Exports whatever was aggregated so far and waits until it is sent
+    // (used on module shutdown so short lived processes do not lose samples)
+    void flush();
+
+    // Sending thread is stopped before fork - transfer in progress is aborted and retried by parent after fork
+    void prefork() final;
+    void postfork(bool child) final;
+
+private:
+    // Export settings are copied with the profile as configuration can change before the sending thread picks it up
+    struct profileToSend_t {
+        std::string profile;
+        std::string url;
+        long timeoutMs;
+        bool verifyServerCert;
+    };
+
+    void captureSample(zend_execute_data *executeData);
+    void exportProfile();
+    bool writeToDirectory(std::string const &profile, std::chrono::system_clock::time_point now);
+    void queueForSending(std::string profile);
+    bool startSendingThread();
+    void stopSendingThread();
+    void sendingWork();
+    bool sendToUrl(profileToSend_t const &toSend);
+
+    std::shared_ptr<InferredSpans> sampler_;
+    PprofProfile profile_{maxStacks, maxFramesPerStack};
+
+    // frame names are built in reused buffers so that capturing a sample does not allocate once buffers are warmed up
+    std::vector<std::string> functionNames_;
+    std::vector<PprofProfile::frame_t> frames_;
+
+    bool enabled_ = false;
+    std::chrono::milliseconds samplingInterval_{10};
+    std::chrono::milliseconds exportInterval_{60000};
+    std::string exportDir_;
+    std::string exportUrl_;
+    long exportTimeoutMs_ = 0;
+    bool verifyServerCert_ = true;
+
+    std::chrono::system_clock::time_point profileStartTime_ = std::chrono::system_clock::now();
+    clock_t::time_point lastExportTime_ = clock_t::now();
+
+    // only the latest profile waits for sending - the one not picked up by the sending thread yet is replaced
+    std::mutex sendMutex_;
+    std::condition_variable sendCondition_;
+    std::optional<profileToSend_t> profileToSend_;
+    bool sendingThreadStopping_ = false;
+    // checked by libcurl progress callback so that prefork does not wait for the transfer in progress
+    std::atomic<bool> abortSending_ = false;
+    std::thread sendingThread_;
+};
+
+}
@@ -35,12 +35,15 @@
 #define ELASTIC_APM_PHP_PART_EMPTY_METHOD_FUNC ELASTIC_APM_PHP_PART_FUNC_PREFIX "emptyMethod"
 #define ELASTIC_APM_PHP_PART_AST_INSTRUMENTATION_PRE_HOOK_FUNC ELASTIC_APM_PHP_PART_FUNC_PREFIX "astInstrumentationPreHook"
 #define ELASTIC_APM_PHP_PART_AST_INSTRUMENTATION_DIRECT_CALL_FUNC ELASTIC_APM_PHP_PART_FUNC_PREFIX "astInstrumentationDirectCall"
+// Key in the class table - lower case and without the leading backslash
+#define ELASTIC_APM_PHP_PART_FACADE_CLASS_TABLE_KEY "elastic\\apm\\impl\\autoinstrument\\phppartfacade"
 
 enum TracerPhpPartState
 {
     tracerPhpPartState_before_bootstrap,
     tracerPhpPartState_after_bootstrap,
     tracerPhpPartState_after_shutdown,
+    tracerPhpPartState_bootstrap_skipped,
     tracerPhpPartState_failed,
 
     numberOfTracerPhpPartState
@@ -52,6 +55,7 @@ StringView tracerPhpPartStateNames[ numberOfTracerPhpPartState ] =
     ELASTIC_APM_ENUM_NAMES_ARRAY_PAIR( tracerPhpPartState_before_bootstrap ),
     ELASTIC_APM_ENUM_NAMES_ARRAY_PAIR( tracerPhpPartState_after_bootstrap ),
     ELASTIC_APM_ENUM_NAMES_ARRAY_PAIR( tracerPhpPartState_after_shutdown ),
+    ELASTIC_APM_ENUM_NAMES_ARRAY_PAIR( tracerPhpPartState_bootstrap_skipped ),
     ELASTIC_APM_ENUM_NAMES_ARRAY_PAIR( tracerPhpPartState_failed ),
 };
 
@@ -79,6 +83,11 @@ bool canInvokeTracerPhpPart() {
     return g_tracerPhpPartState == tracerPhpPartState_after_bootstrap;
 }
 
+bool isTracerPhpPartBootstrapSkipped()
+{
+    return g_tracerPhpPartState == tracerPhpPartState_bootstrap_skipped;
+}
+
 // returns true if state was changed or false it was same before
 bool switchTracerPhpPartStateToFailed( String reason, String dbgCalledFromFunc )
 {
@@ -87,6 +96,13 @@ bool switchTracerPhpPartStateToFailed( String reason, String dbgCalledFromFunc )
         return false;
     }
 
+    // calls from instrumented code are expected when the bootstrap was skipped - they are just not forwarded to PHP part
+    if ( g_tracerPhpPartState == tracerPhpPartState_bootstrap_skipped )
+    {
+        ELASTIC_APM_LOG_TRACE( "Not switching tracer PHP part state to failed because bootstrap was skipped; reason: %s, called from %s", reason, dbgCalledFromFunc );
+        return false;
+    }
+
     ELASTIC_APM_LOG_ERROR( "Switching tracer PHP part state to failed; reason: %s, current state: %s, called from %s"
                            , reason, tracerPhpPartStateToString( g_tracerPhpPartState ), dbgCalledFromFunc );
 
@@ -94,19 +110,31 @@ bool switchTracerPhpPartStateToFailed( String reason, String dbgCalledFromFunc )
     return true;
 }
 
-ResultCode bootstrapTracerPhpPart( const ConfigSnapshot* config, const TimePoint* requestInitStartTime )
+/**
+ * Before any code of the request runs the class table contains only persistent classes
+ * so agent's classes can be found there only if they were loaded by opcache.preload script (see agent/php/preload.php).
+ */
+static
+bool isTracerPhpPartPreloaded()
+{
+    return CG( class_table ) != NULL && zend_hash_str_exists( CG( class_table ), ZEND_STRL( ELASTIC_APM_PHP_PART_FACADE_CLASS_TABLE_KEY ) );
+}
+
+ResultCode bootstrapTracerPhpPart( const ConfigSnapshot* config, const TimePoint* requestInitStartTime, RequestTracingDecision tracingDecision )
 {
     ResultCode resultCode;
     bool shouldRevertLoadingAgentPhpCode = false;
     bool bootstrapTracerPhpPartRetVal;
-    zval bootstrapTracerPhpPartArgs[2];
+    zval bootstrapTracerPhpPartArgs[3];
     ZVAL_UNDEF( &bootstrapTracerPhpPartArgs[0] );
     ZVAL_UNDEF( &bootstrapTracerPhpPartArgs[1] );
+    ZVAL_UNDEF( &bootstrapTracerPhpPartArgs[2] );
 
     char txtOutStreamBuf[ELASTIC_APM_TEXT_OUTPUT_STREAM_ON_STACK_BUFFER_SIZE];
     TextOutputStream txtOutStream = ELASTIC_APM_TEXT_OUTPUT_STREAM_FROM_STATIC_BUFFER( txtOutStreamBuf );
-    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "config->bootstrapPhpPartFile: %s, g_tracerPhpPartState: %s"
-                                              , streamUserString( config->bootstrapPhpPartFile, &txtOutStream ), tracerPhpPartStateToString( g_tracerPhpPartState ) );
+    ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY_MSG( "config->bootstrapPhpPartFile: %s, g_tracerPhpPartState: %s, tracingDecision: %s"
+                                              , streamUserString( config->bootstrapPhpPartFile, &txtOutStream ), tracerPhpPartStateToString( g_tracerPhpPartState )
+                                              , requestTracingDecisionToString( tracingDecision ) );
     textOutputStreamRewind( &txtOutStream );
 
     if ( g_tracerPhpPartState != tracerPhpPartState_before_bootstrap )
@@ -126,10 +154,34 @@ ResultCode bootstrapTracerPhpPart( const ConfigSnapshot* config, const TimePoint
     elasticApmBeforeLoadingAgentPhpCode();
     shouldRevertLoadingAgentPhpCode = true;
 
-    ELASTIC_APM_CALL_IF_FAILED_GOTO( loadPhpFile( config->bootstrapPhpPartFile ) );
+    if ( isTracerPhpPartPreloaded() )
+    {
+        // bootstrap file would try to declare the already preloaded classes again
+        ELASTIC_APM_LOG_DEBUG( "Tracer PHP part is preloaded - skipping loading %s", config->bootstrapPhpPartFile );
+    }
+    else
+    {
+        ELASTIC_APM_CALL_IF_FAILED_GOTO( loadPhpFile( config->bootstrapPhpPartFile ) );
+    }
+
+    if ( tracingDecision == requestTracingDecision_ignored )
+    {
+        ELASTIC_APM_LOG_DEBUG( "Request is ignored - skipping bootstrap of tracer PHP part" );
+        g_tracerPhpPartState = tracerPhpPartState_bootstrap_skipped;
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+    }
 
     ZVAL_LONG(&bootstrapTracerPhpPartArgs[0], getGlobalTracer()->logger.maxEnabledLevel);
     ZVAL_DOUBLE(&bootstrapTracerPhpPartArgs[1], (double)timePointToEpochMicroseconds(requestInitStartTime));
+    // PHP part uses the sampling decision made by the extension instead of making its own one
+    if ( tracingDecision == requestTracingDecision_sampled || tracingDecision == requestTracingDecision_not_sampled )
+    {
+        ZVAL_BOOL( &bootstrapTracerPhpPartArgs[2], tracingDecision == requestTracingDecision_sampled );
+    }
+    else
+    {
+        ZVAL_NULL( &bootstrapTracerPhpPartArgs[2] );
+    }
 
     ELASTIC_APM_CALL_IF_FAILED_GOTO( callPhpFunctionRetBool(
             ELASTIC_APM_STRING_LITERAL_TO_VIEW( ELASTIC_APM_PHP_PART_BOOTSTRAP_FUNC )
@@ -148,6 +200,7 @@ ResultCode bootstrapTracerPhpPart( const ConfigSnapshot* config, const TimePoint
     finally:
     zval_dtor( &bootstrapTracerPhpPartArgs[0] ); // long is not refcounted - would not do anything
     zval_dtor( &bootstrapTracerPhpPartArgs[0] ); // double is not refcounted - would not do anything
+    zval_dtor( &bootstrapTracerPhpPartArgs[2] ); // bool/null is not refcounted - would not do anything
     if ( shouldRevertLoadingAgentPhpCode )
     {
         elasticApmAfterLoadingAgentPhpCode();
@@ -160,11 +213,31 @@ ResultCode bootstrapTracerPhpPart( const ConfigSnapshot* config, const TimePoint
     goto finally;
 }
 
-void shutdownTracerPhpPart()
+static
+void buildMemoryStatsArg( const PhpMemoryStats* onInit, const PhpMemoryStats* onShutdown, zval* dst )
+{
+    array_init( dst );
+    add_assoc_long( dst, "memory_usage_delta", (zend_long)( onShutdown->memoryUsage ) - (zend_long)( onInit->memoryUsage ) );
+    add_assoc_long( dst, "memory_usage", (zend_long)( onShutdown->memoryUsage ) );
+    add_assoc_long( dst, "peak_memory_usage", (zend_long)( onShutdown->peakMemoryUsage ) );
+    add_assoc_long( dst, "real_peak_memory_usage", (zend_long)( onShutdown->realPeakMemoryUsage ) );
+    add_assoc_long( dst, "gc_runs", (zend_long)( onShutdown->gcRuns ) - (zend_long)( onInit->gcRuns ) );
+    add_assoc_long( dst, "gc_collected", (zend_long)( onShutdown->gcCollected ) - (zend_long)( onInit->gcCollected ) );
+}
+
+void shutdownTracerPhpPart( const PhpMemoryStats* memoryStatsOnInit, const PhpMemoryStats* memoryStatsOnShutdown )
 {
     ELASTIC_APM_LOG_DEBUG_FUNCTION_ENTRY();
 
     ResultCode resultCode;
+    zval memoryStatsArg;
+    ZVAL_UNDEF( &memoryStatsArg );
+    bool shouldPassMemoryStats = ( memoryStatsOnInit != NULL ) && ( memoryStatsOnShutdown != NULL );
+
+    if ( g_tracerPhpPartState == tracerPhpPartState_bootstrap_skipped )
+    {
+        ELASTIC_APM_SET_RESULT_CODE_TO_SUCCESS_AND_GOTO_FINALLY();
+    }
 
     if ( g_tracerPhpPartState != tracerPhpPartState_after_bootstrap )
     {
@@ -172,15 +245,21 @@ void shutdownTracerPhpPart()
         ELASTIC_APM_SET_RESULT_CODE_AND_GOTO_FAILURE();
     }
 
+    if ( shouldPassMemoryStats )
+    {
+        buildMemoryStatsArg( memoryStatsOnInit, memoryStatsOnShutdown, &memoryStatsArg );
+    }
+
     ELASTIC_APM_CALL_IF_FAILED_GOTO( callPhpFunctionRetVoid(
             ELASTIC_APM_STRING_LITERAL_TO_VIEW( ELASTIC_APM_PHP_PART_SHUTDOWN_FUNC )
-            , /* argsCount */ 0
-            , /* args */ NULL ) );
+            , /* argsCount */ shouldPassMemoryStats ? 1 : 0
+            , /* args */ shouldPassMemoryStats ? &memoryStatsArg : NULL ) );
 
     g_tracerPhpPartState = tracerPhpPartState_after_shutdown;
     resultCode = resultSuccess;
 
     finally:
+    zval_dtor( &memoryStatsArg );
     ELASTIC_APM_LOG_DEBUG_RESULT_CODE_FUNCTION_EXIT();
     // We ignore errors because we want the monitored application to continue working
     // even if APM encountered an issue that prevent it from working
@@ -192,7 +271,7 @@ void shutdownTracerPhpPart()
     goto finally;
 }
 
-static uint32_t g_maxInterceptedCallArgsCount = 100;
+static const uint32_t g_maxInterceptedCallArgsCount = maxInterceptedCallCapturedArgsCount;
 
 bool tracerPhpPartInternalFuncCallPreHook( uint32_t interceptRegistrationId, zend_execute_data* execute_data )
 {
@@ -229,7 +308,8 @@ bool tracerPhpPartInternalFuncCallPreHook( uint32_t interceptRegistrationId, zen
     }
 
     uint32_t interceptedCallArgsCount;
-    getArgsFromZendExecuteData( execute_data, g_maxInterceptedCallArgsCount, &( phpPartArgs[ 2 ] ), &interceptedCallArgsCount );
+    // arguments the registration did not ask for are neither copied nor passed to PHP part
+    getArgsFromZendExecuteData( execute_data, getInterceptedCallMaxCapturedArgsCount( interceptRegistrationId ), &( phpPartArgs[ 2 ] ), &interceptedCallArgsCount );
     ELASTIC_APM_CALL_IF_FAILED_GOTO(
             callPhpFunctionRetZval(
                     ELASTIC_APM_STRING_LITERAL_TO_VIEW( ELASTIC_APM_PHP_PART_INTERNAL_FUNC_CALL_PRE_HOOK_FUNC )
@@ -259,10 +339,10 @@ bool tracerPhpPartInternalFuncCallPreHook( uint32_t interceptRegistrationId, zen
     goto finally;
 }
 
-void tracerPhpPartInternalFuncCallPostHook( uint32_t dbgInterceptRegistrationId, zval* interceptedCallRetValOrThrown )
+void tracerPhpPartInternalFuncCallPostHook( uint32_t dbgInterceptRegistrationId, bool hasExitedByException, zval* interceptedCallRetValOrThrown )
 {
-    ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY_MSG( "dbgInterceptRegistrationId: %u; interceptedCallRetValOrThrown type: %u"
-                                              , dbgInterceptRegistrationId, Z_TYPE_P( interceptedCallRetValOrThrown ) );
+    ELASTIC_APM_LOG_TRACE_FUNCTION_ENTRY_MSG( "dbgInterceptRegistrationId: %u; hasExitedByException: %s; interceptedCallRetValOrThrown type: %u"
+                                              , dbgInterceptRegistrationId, boolToString( hasExitedByException ), Z_TYPE_P( interceptedCallRetValOrThrown ) );
 
     ResultCode resultCode;
     zval phpPartArgs[ 2 ];
@@ -279,7 +359,7 @@ void tracerPhpPartInternalFuncCallPostHook( uint32_t dbgInterceptRegistrationId,
 
 
     // The first argument to PHP part's interceptedCallPostHook() is $hasExitedByException (bool)
-    ZVAL_FALSE( &( phpPartArgs[ 0 ] ) );
+    ZVAL_BOOL( &( phpPartArgs[ 0 ] ), hasExitedByException );
 
     // The second argument to PHP part's interceptedCallPreHook() is $returnValueOrThrown (mixed|Throwable)
     phpPartArgs[ 1 ] = *interceptedCallRetValOrThrown;
@@ -407,12 +487,12 @@ void tracerPhpPartOnRequestInitSetInitialTracerState() {
     g_tracerPhpPartState = tracerPhpPartState_before_bootstrap;
 }
 
-ResultCode tracerPhpPartOnRequestInit( const ConfigSnapshot* config, const TimePoint* requestInitStartTime )
+ResultCode tracerPhpPartOnRequestInit( const ConfigSnapshot* config, const TimePoint* requestInitStartTime, RequestTracingDecision tracingDecision )
 {
-    return bootstrapTracerPhpPart( config, requestInitStartTime );
+    return bootstrapTracerPhpPart( config, requestInitStartTime, tracingDecision );
 }
 
-void tracerPhpPartOnRequestShutdown()
+void tracerPhpPartOnRequestShutdown( const PhpMemoryStats* memoryStatsOnInit, const PhpMemoryStats* memoryStatsOnShutdown )
 {
-    shutdownTracerPhpPart();
+    shutdownTracerPhpPart( memoryStatsOnInit, memoryStatsOnShutdown );
 }
@@ -22,13 +22,35 @@
 #include <zend_types.h>
 #include "ResultCode.h"
 #include "ConfigSnapshot_forward_decl.h"
+#include "request_tracing_decision.h"
 #include "time_util.h"
 
-ResultCode tracerPhpPartOnRequestInit( const ConfigSnapshot* config, const TimePoint* requestInitStartTime );
-void tracerPhpPartOnRequestShutdown();
+struct PhpMemoryStats
+{
+    size_t memoryUsage;
+    size_t peakMemoryUsage;
+    size_t realPeakMemoryUsage;
+    uint32_t gcRuns;
+    uint32_t gcCollected;
+};
+typedef struct PhpMemoryStats PhpMemoryStats;
+
+/**
+ * PHP part is not bootstrapped for ignored requests - only the bootstrap file is loaded so that the public API classes can be autoloaded
+ * and the calls from instrumented code to PHP part are skipped until the end of the request.
+ */
+ResultCode tracerPhpPartOnRequestInit( const ConfigSnapshot* config, const TimePoint* requestInitStartTime, RequestTracingDecision tracingDecision );
+/**
+ * True for the request the extension decided to ignore - PHP part uses noop tracer instead of building one lazily
+ */
+bool isTracerPhpPartBootstrapSkipped();
+/**
+ * @param memoryStatsOnInit and memoryStatsOnShutdown are either both NULL or both non-NULL
+ */
+void tracerPhpPartOnRequestShutdown( const PhpMemoryStats* memoryStatsOnInit, const PhpMemoryStats* memoryStatsOnShutdown );
 
 bool tracerPhpPartInternalFuncCallPreHook( uint32_t interceptRegistrationId, zend_execute_data* execute_data );
-void tracerPhpPartInternalFuncCallPostHook( uint32_t dbgInterceptRegistrationId, zval* interceptedCallRetValOrThrown );
+void tracerPhpPartInternalFuncCallPostHook( uint32_t dbgInterceptRegistrationId, bool hasExitedByException, zval* interceptedCallRetValOrThrown );
 
 void tracerPhpPartInterceptedCallEmptyMethod();
 
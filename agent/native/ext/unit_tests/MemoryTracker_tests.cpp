@@ -20,6 +20,11 @@
 #include "cmocka_wrapped_for_unit_tests.h"
 #include "unit_test_util.h"
 #include "elastic_apm_alloc.h"
+#include "mock_alloc.h"
+#include "mock_log_custom_sink.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
 
 #if ( ELASTIC_APM_MEMORY_TRACKING_ENABLED_01 != 0 )
 
@@ -102,12 +107,299 @@ void when_disabled_size_arg_to_free_should_not_be_evaluated( void** testFixtureS
     goto finally;
 }
 
+static
+void sampled_allocation_should_be_tracked_until_freed( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    ResultCode resultCode;
+    char* dummyStr = NULL;
+    MemoryTracker* memTracker = getGlobalMemoryTracker();
+
+    // With mean sampling interval of 1 byte the distance to the next sample is always much less than 123 bytes
+    reconfigureMemoryTrackerSampling( memTracker, /* newSamplingIntervalInBytes */ 1 );
+    ELASTIC_APM_CMOCKA_ASSERT( isMemoryTrackerSamplingEnabled( memTracker ) );
+    const size_t sampledLiveBlocksCountBefore = memTracker->sampledLiveBlocksCount;
+
+    ELASTIC_APM_EMALLOC_STRING_IF_FAILED_GOTO( 123, dummyStr );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker->sampledLiveBlocksCount, sampledLiveBlocksCountBefore + 1 );
+
+    resultCode = resultSuccess;
+
+    finally:
+    ELASTIC_APM_EFREE_STRING_SIZE_AND_SET_TO_NULL( 123, dummyStr );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker->sampledLiveBlocksCount, sampledLiveBlocksCountBefore );
+
+    reconfigureMemoryTrackerSampling( memTracker, /* newSamplingIntervalInBytes */ 0 );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isMemoryTrackerSamplingEnabled( memTracker ) );
+
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( resultCode );
+    return;
+
+    failure:
+    goto finally;
+}
+
+static
+void sampled_profile_should_be_reset_when_sampling_is_disabled( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    ResultCode resultCode;
+    char* dummyStr = NULL;
+    MemoryTracker* memTracker = getGlobalMemoryTracker();
+
+    reconfigureMemoryTrackerSampling( memTracker, /* newSamplingIntervalInBytes */ 1 );
+    ELASTIC_APM_EMALLOC_STRING_IF_FAILED_GOTO( 123, dummyStr );
+    ELASTIC_APM_CMOCKA_ASSERT( memTracker->sampledLiveBlocksCount != 0 );
+
+    reconfigureMemoryTrackerSampling( memTracker, /* newSamplingIntervalInBytes */ 0 );
+    ELASTIC_APM_CMOCKA_ASSERT( ! isMemoryTrackerSamplingEnabled( memTracker ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker->sampledLiveBlocksCount, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT( memTracker->sampledProfile == NULL );
+
+    // Block sampled before sampling was disabled is freed while it is disabled
+    ELASTIC_APM_EFREE_STRING_SIZE_AND_SET_TO_NULL( 123, dummyStr );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker->sampledLiveBlocksCount, 0 );
+
+    // Sampling enabled again starts with an empty profile
+    reconfigureMemoryTrackerSampling( memTracker, /* newSamplingIntervalInBytes */ 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker->sampledLiveBlocksCount, 0 );
+
+    resultCode = resultSuccess;
+
+    finally:
+    ELASTIC_APM_EFREE_STRING_SIZE_AND_SET_TO_NULL( 123, dummyStr );
+    reconfigureMemoryTrackerSampling( memTracker, /* newSamplingIntervalInBytes */ 0 );
+
+    ELASTIC_APM_CMOCKA_CALL_ASSERT_RESULT_SUCCESS( resultCode );
+    return;
+
+    failure:
+    goto finally;
+}
+
+static const size_t dummyBlockSize = 8;
+
+static
+void* dummyTrackedAlloc(
+        MemoryTracker* memTracker,
+        UInt blockNumber,
+        void* const* stackTraceAddresses,
+        size_t stackTraceAddressesCount )
+{
+    const size_t actuallyRequestedSize = memoryTrackerCalcSizeToAlloc( memTracker, dummyBlockSize );
+    ELASTIC_APM_CMOCKA_ASSERT( actuallyRequestedSize > dummyBlockSize );
+    char* block = (char*)malloc( actuallyRequestedSize );
+    ELASTIC_APM_CMOCKA_ASSERT_VALID_PTR( block );
+
+    // Block content is "block#NN" (without terminating '\0')
+    char content[ dummyBlockSize + 1 ];
+    snprintf( content, sizeof( content ), "block#%02u", blockNumber );
+    memcpy( block, content, dummyBlockSize );
+
+    memoryTrackerAfterAlloc(
+            memTracker,
+            block,
+            dummyBlockSize,
+            /* isPersistent */ false,
+            actuallyRequestedSize,
+            ELASTIC_APM_STRING_LITERAL_TO_VIEW( "dummy_dir/dummy_file.cpp" ),
+            /* lineNumber */ 1000 + blockNumber,
+            /* isString */ true,
+            stackTraceAddresses,
+            stackTraceAddressesCount );
+    return block;
+}
+
+static
+void dummyTrackedFree( MemoryTracker* memTracker, void* block, size_t originallyRequestedSize )
+{
+    size_t possibleActuallyRequestedSize = 0;
+    memoryTrackerBeforeFree( memTracker, block, originallyRequestedSize, /* isPersistent */ false, &possibleActuallyRequestedSize );
+    if ( block != NULL )
+    {
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( possibleActuallyRequestedSize, memoryTrackerCalcSizeToAlloc( memTracker, originallyRequestedSize ) );
+    }
+    free( block );
+}
+
+static
+void tracked_blocks_index_alloc_free_round_trip( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    MemoryTracker memTracker;
+    constructMemoryTracker( &memTracker );
+
+    // More blocks than the index initial capacity so the index has to grow while blocks are added
+    enum { numberOfBlocks = 200 };
+    void* blocks[ numberOfBlocks ];
+    ELASTIC_APM_FOR_EACH_INDEX( i, numberOfBlocks )
+    {
+        blocks[ i ] = dummyTrackedAlloc( &memTracker, (UInt)i, /* stackTraceAddresses */ NULL, /* stackTraceAddressesCount */ 0 );
+        ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.allocatedRequestScopedBlocks.count, i + 1 );
+    }
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.allocatedRequestScoped, numberOfBlocks * dummyBlockSize );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.allocatedPersistentBlocks.count, 0 );
+
+    // Free of a pointer that is not tracked (NULL) should not affect the index
+    dummyTrackedFree( &memTracker, /* block */ NULL, /* originallyRequestedSize */ 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.allocatedRequestScopedBlocks.count, numberOfBlocks );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.allocatedRequestScoped, numberOfBlocks * dummyBlockSize );
+
+    // Free in an order different from the allocation order to exercise removal from the middle of probe sequences
+    size_t freedCount = 0;
+    for ( size_t step = 3 ; step != 0 ; --step )
+    {
+        for ( size_t i = step - 1 ; i < numberOfBlocks ; i += 3 )
+        {
+            dummyTrackedFree( &memTracker, blocks[ i ], dummyBlockSize );
+            blocks[ i ] = NULL;
+            ++freedCount;
+            ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.allocatedRequestScopedBlocks.count, numberOfBlocks - freedCount );
+            ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.allocatedRequestScoped, ( numberOfBlocks - freedCount ) * dummyBlockSize );
+        }
+    }
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( freedCount, numberOfBlocks );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.allocatedRequestScopedBlocks.count, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.allocatedRequestScoped, 0 );
+
+    // Index should be usable again after it became empty
+    void* block = dummyTrackedAlloc( &memTracker, /* blockNumber */ 0, /* stackTraceAddresses */ NULL, /* stackTraceAddressesCount */ 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.allocatedRequestScopedBlocks.count, 1 );
+    dummyTrackedFree( &memTracker, block, dummyBlockSize );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.allocatedRequestScopedBlocks.count, 0 );
+
+    memoryTrackerRequestShutdown( &memTracker );
+    destructMemoryTracker( &memTracker );
+}
+
+static
+void identical_stack_traces_should_share_one_interned_entry( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    MemoryTracker memTracker;
+    constructMemoryTracker( &memTracker );
+
+    // Addresses are never resolved to symbols unless a leak is reported
+    void* stackTraceA[] = { (void*)0x1000, (void*)0x2000, (void*)0x3000 };
+    void* stackTraceACopy[] = { (void*)0x1000, (void*)0x2000, (void*)0x3000 };
+    void* stackTraceB[] = { (void*)0x1000, (void*)0x2000, (void*)0x4000 };
+    // The same addresses but shorter stack trace should not be considered identical
+    void* stackTraceAPrefix[] = { (void*)0x1000, (void*)0x2000 };
+
+    void* block1 = dummyTrackedAlloc( &memTracker, /* blockNumber */ 1, stackTraceA, ELASTIC_APM_STATIC_ARRAY_SIZE( stackTraceA ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.stackTraces.count, 1 );
+    void* block2 = dummyTrackedAlloc( &memTracker, /* blockNumber */ 2, stackTraceACopy, ELASTIC_APM_STATIC_ARRAY_SIZE( stackTraceACopy ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.stackTraces.count, 1 );
+    void* block3 = dummyTrackedAlloc( &memTracker, /* blockNumber */ 3, stackTraceB, ELASTIC_APM_STATIC_ARRAY_SIZE( stackTraceB ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.stackTraces.count, 2 );
+    void* block4 = dummyTrackedAlloc( &memTracker, /* blockNumber */ 4, stackTraceAPrefix, ELASTIC_APM_STATIC_ARRAY_SIZE( stackTraceAPrefix ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.stackTraces.count, 3 );
+    // Blocks without captured stack trace do not add interned entries
+    void* block5 = dummyTrackedAlloc( &memTracker, /* blockNumber */ 5, /* stackTraceAddresses */ NULL, /* stackTraceAddressesCount */ 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.stackTraces.count, 3 );
+
+    // Interned entry is kept as long as at least one of the blocks sharing it is alive
+    dummyTrackedFree( &memTracker, block1, dummyBlockSize );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.stackTraces.count, 3 );
+    dummyTrackedFree( &memTracker, block2, dummyBlockSize );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.stackTraces.count, 2 );
+
+    // Entry released by the last block is interned again when the same stack trace is captured again
+    void* block6 = dummyTrackedAlloc( &memTracker, /* blockNumber */ 6, stackTraceA, ELASTIC_APM_STATIC_ARRAY_SIZE( stackTraceA ) );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.stackTraces.count, 3 );
+
+    dummyTrackedFree( &memTracker, block3, dummyBlockSize );
+    dummyTrackedFree( &memTracker, block4, dummyBlockSize );
+    dummyTrackedFree( &memTracker, block5, dummyBlockSize );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.stackTraces.count, 1 );
+    dummyTrackedFree( &memTracker, block6, dummyBlockSize );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.stackTraces.count, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.allocatedRequestScopedBlocks.count, 0 );
+
+    memoryTrackerRequestShutdown( &memTracker );
+    destructMemoryTracker( &memTracker );
+}
+
+static
+bool isLogStatementFound( const std::string& expectedText )
+{
+    ELASTIC_APM_FOR_EACH_INDEX( i, getGlobalMockLogCustomSink().size() )
+    {
+        if ( getGlobalMockLogCustomSink().get( i ).find( expectedText ) != std::string::npos ) return true;
+    }
+    return false;
+}
+
+static
+void leak_report_should_list_oldest_not_freed_allocations_in_allocation_order( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    MemoryTracker memTracker;
+    constructMemoryTracker( &memTracker );
+
+    enum { numberOfBlocks = 13 };
+    void* blocks[ numberOfBlocks ];
+    ELASTIC_APM_FOR_EACH_INDEX( i, numberOfBlocks )
+    {
+        blocks[ i ] = dummyTrackedAlloc( &memTracker, (UInt)i, /* stackTraceAddresses */ NULL, /* stackTraceAddressesCount */ 0 );
+    }
+    dummyTrackedFree( &memTracker, blocks[ 0 ], dummyBlockSize );
+    blocks[ 0 ] = NULL;
+    dummyTrackedFree( &memTracker, blocks[ 5 ], dummyBlockSize );
+    blocks[ 5 ] = NULL;
+
+    setIsMemoryLeakExpectedDuringUnitTests( true );
+    getGlobalMockLogCustomSink().clear();
+    memoryTrackerRequestShutdown( &memTracker );
+    setIsMemoryLeakExpectedDuringUnitTests( false );
+
+    // 2 summary statements + (at most) 10 reported allocations
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( getGlobalMockLogCustomSink().size(), 2 + 10 );
+    ELASTIC_APM_CMOCKA_ASSERT( isLogStatementFound(
+            "Memory leak detected! On request shutdown amount of allocated request scoped memory should be 0, instead it is 88" ) );
+    ELASTIC_APM_CMOCKA_ASSERT( isLogStatementFound( "Number of allocations not freed: 11. Following are the first 10 not freed allocation(s)" ) );
+
+    // The oldest not freed allocations are reported in the order they were allocated
+    const UInt expectedReportedBlocks[] = { 1, 2, 3, 4, 6, 7, 8, 9, 10, 11 };
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( expectedReportedBlocks ) )
+    {
+        char expectedText[ 1000 ];
+        snprintf( expectedText, sizeof( expectedText )
+                  , "Allocation #%u (out of 11): Source location: dummy_file.cpp:%u. Originally requested allocation size: 8."
+                    " Content: `block#%02u'.\n"
+                    "\t+-> Allocation call stack trace:\n\t\t<STACK TRACE IS NOT CAPTURED>"
+                  , (UInt)( i + 1 ), 1000 + expectedReportedBlocks[ i ], expectedReportedBlocks[ i ] );
+        ELASTIC_APM_CMOCKA_ASSERT( getGlobalMockLogCustomSink().get( 2 + i ).find( expectedText ) != std::string::npos );
+    }
+    ELASTIC_APM_CMOCKA_ASSERT( ! isLogStatementFound( "block#12" ) );
+    getGlobalMockLogCustomSink().clear();
+
+    ELASTIC_APM_FOR_EACH_INDEX( i, numberOfBlocks )
+    {
+        if ( blocks[ i ] != NULL ) dummyTrackedFree( &memTracker, blocks[ i ], dummyBlockSize );
+    }
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( memTracker.allocatedRequestScoped, 0 );
+    memoryTrackerRequestShutdown( &memTracker );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( getGlobalMockLogCustomSink().size(), 0 );
+    destructMemoryTracker( &memTracker );
+}
+
 int run_MemoryTracker_tests()
 {
     const struct CMUnitTest tests [] =
     {
         ELASTIC_APM_CMOCKA_UNIT_TEST( when_enabled_size_arg_to_free_should_be_evaluated_only_once ),
         ELASTIC_APM_CMOCKA_UNIT_TEST( when_disabled_size_arg_to_free_should_not_be_evaluated ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( sampled_allocation_should_be_tracked_until_freed ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( sampled_profile_should_be_reset_when_sampling_is_disabled ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( tracked_blocks_index_alloc_free_round_trip ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( identical_stack_traces_should_share_one_interned_entry ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( leak_report_should_list_oldest_not_freed_allocations_in_allocation_order ),
     };
 
     return cmocka_run_group_tests( tests, NULL, NULL );
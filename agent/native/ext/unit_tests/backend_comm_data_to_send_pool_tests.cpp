@@ -0,0 +1,191 @@
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "backend_comm_data_to_send_pool.h"
+#include "cmocka_wrapped_for_unit_tests.h"
+#include "unit_test_util.h"
+#include <string>
+
+static
+StringBuffer acquireBuffer( DataToSendPool* pool, size_t contentLength )
+{
+    std::string content( contentLength, 'x' );
+    StringBuffer strBuf = ELASTIC_APM_EMPTY_STRING_BUFFER;
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( acquireDataToSendPoolBuffer( pool, makeStringView( content.data(), content.size() ), /* out */ &strBuf ), resultSuccess );
+    ELASTIC_APM_CMOCKA_ASSERT_VALID_PTR( strBuf.begin );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( strBuf.size, contentLength + 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_STRING_VIEW_EQUAL( makeStringView( strBuf.begin, contentLength ), makeStringView( content.data(), content.size() ) );
+    return strBuf;
+}
+
+static
+size_t sumFreeBuffersCount( const DataToSendPool* pool )
+{
+    size_t result = 0;
+    ELASTIC_APM_FOR_EACH_INDEX( sizeClass, ELASTIC_APM_DATA_TO_SEND_POOL_NUMBER_OF_BUFFER_SIZE_CLASSES )
+    {
+        result += pool->freeBuffersCount[ sizeClass ];
+    }
+    return result;
+}
+
+static
+void buffer_is_reused_within_size_class( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    DataToSendPool pool;
+    initDataToSendPool( &pool );
+
+    // 100 + 1 and 120 + 1 are both in 128 bytes size class
+    StringBuffer strBuf = acquireBuffer( &pool, 100 );
+    const char* const firstBuffer = strBuf.begin;
+    releaseDataToSendPoolBuffer( &pool, /* in,out */ &strBuf );
+    ELASTIC_APM_CMOCKA_ASSERT_NULL_PTR( strBuf.begin );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.freeBuffersTotalSize, 128 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( sumFreeBuffersCount( &pool ), 1 );
+
+    strBuf = acquireBuffer( &pool, 120 );
+    ELASTIC_APM_CMOCKA_ASSERT( strBuf.begin == firstBuffer );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.freeBuffersTotalSize, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( sumFreeBuffersCount( &pool ), 0 );
+
+    // 200 + 1 is in the next size class so the free buffer (if any) is not used for it
+    StringBuffer otherSizeClassStrBuf = acquireBuffer( &pool, 200 );
+    ELASTIC_APM_CMOCKA_ASSERT( otherSizeClassStrBuf.begin != firstBuffer );
+
+    releaseDataToSendPoolBuffer( &pool, /* in,out */ &strBuf );
+    releaseDataToSendPoolBuffer( &pool, /* in,out */ &otherSizeClassStrBuf );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.freeBuffersTotalSize, 128 + 256 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.buffersInUseCount, 0 );
+
+    destructDataToSendPool( &pool );
+}
+
+static
+void oversize_buffer_is_not_retained( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    DataToSendPool pool;
+    initDataToSendPool( &pool );
+
+    const size_t largestPooledBufferSize = ELASTIC_APM_DATA_TO_SEND_POOL_MIN_BUFFER_SIZE << ( ELASTIC_APM_DATA_TO_SEND_POOL_NUMBER_OF_BUFFER_SIZE_CLASSES - 1 );
+    // + 1 for terminating '\0' makes it larger than the largest size class
+    StringBuffer strBuf = acquireBuffer( &pool, largestPooledBufferSize );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.buffersInUseCount, 1 );
+    releaseDataToSendPoolBuffer( &pool, /* in,out */ &strBuf );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.buffersInUseCount, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.freeBuffersTotalSize, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( sumFreeBuffersCount( &pool ), 0 );
+
+    // Buffer that fits a size class is not retained either if it would exceed the cap on retained bytes
+    const size_t halfCapSizeClassContentLength = ELASTIC_APM_DATA_TO_SEND_POOL_MAX_RETAINED_BUFFERS_TOTAL_SIZE / 2 - 1;
+    StringBuffer strBufs[ 3 ];
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( strBufs ) )
+    {
+        strBufs[ i ] = acquireBuffer( &pool, halfCapSizeClassContentLength );
+    }
+    ELASTIC_APM_FOR_EACH_INDEX( i, ELASTIC_APM_STATIC_ARRAY_SIZE( strBufs ) )
+    {
+        releaseDataToSendPoolBuffer( &pool, /* in,out */ &( strBufs[ i ] ) );
+        ELASTIC_APM_CMOCKA_ASSERT_INT_LESS_THAN_OR_EQUAL( pool.freeBuffersTotalSize, ELASTIC_APM_DATA_TO_SEND_POOL_MAX_RETAINED_BUFFERS_TOTAL_SIZE );
+    }
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.freeBuffersTotalSize, ELASTIC_APM_DATA_TO_SEND_POOL_MAX_RETAINED_BUFFERS_TOTAL_SIZE );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( sumFreeBuffersCount( &pool ), 2 );
+
+    destructDataToSendPool( &pool );
+}
+
+static
+void trim_retains_at_most_high_water_mark_and_frees_larger_buffers_first( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    DataToSendPool pool;
+    initDataToSendPool( &pool );
+
+    // 2 buffers in use at the same time: 128 and 1024 bytes size classes
+    StringBuffer smallStrBuf = acquireBuffer( &pool, 100 );
+    StringBuffer largeStrBuf = acquireBuffer( &pool, 1000 );
+    releaseDataToSendPoolBuffer( &pool, /* in,out */ &smallStrBuf );
+    releaseDataToSendPoolBuffer( &pool, /* in,out */ &largeStrBuf );
+    trimDataToSendPool( &pool );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( sumFreeBuffersCount( &pool ), 2 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.freeBuffersTotalSize, 128 + 1024 );
+
+    // only 1 buffer in use since the previous trim so the larger free buffer is freed
+    smallStrBuf = acquireBuffer( &pool, 100 );
+    releaseDataToSendPoolBuffer( &pool, /* in,out */ &smallStrBuf );
+    trimDataToSendPool( &pool );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( sumFreeBuffersCount( &pool ), 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.freeBuffersTotalSize, 128 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_LESS_THAN_OR_EQUAL( pool.freeBuffersTotalSize, ELASTIC_APM_DATA_TO_SEND_POOL_MAX_RETAINED_BUFFERS_TOTAL_SIZE );
+
+    // nothing in use since the previous trim
+    trimDataToSendPool( &pool );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( sumFreeBuffersCount( &pool ), 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.freeBuffersTotalSize, 0 );
+
+    destructDataToSendPool( &pool );
+}
+
+static
+void node_is_reused_and_its_buffers_are_released( void** testFixtureState )
+{
+    ELASTIC_APM_UNUSED( testFixtureState );
+
+    DataToSendPool pool;
+    initDataToSendPool( &pool );
+
+    DataToSendNode* node = NULL;
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( acquireDataToSendPoolNode( &pool, /* out */ &node ), resultSuccess );
+    ELASTIC_APM_CMOCKA_ASSERT_VALID_PTR( node );
+    DataToSendNode* const firstNode = node;
+    node->serializedEvents = acquireBuffer( &pool, 100 );
+    node->userAgentHttpHeader = acquireBuffer( &pool, 10 );
+
+    releaseDataToSendPoolNode( &pool, &node );
+    ELASTIC_APM_CMOCKA_ASSERT_NULL_PTR( node );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.nodesInUseCount, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.freeNodesCount, 1 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( pool.buffersInUseCount, 0 );
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( sumFreeBuffersCount( &pool ), 2 );
+
+    ELASTIC_APM_CMOCKA_ASSERT_INT_EQUAL( acquireDataToSendPoolNode( &pool, /* out */ &node ), resultSuccess );
+    ELASTIC_APM_CMOCKA_ASSERT( node == firstNode );
+    ELASTIC_APM_CMOCKA_ASSERT_NULL_PTR( node->serializedEvents.begin );
+    ELASTIC_APM_CMOCKA_ASSERT_NULL_PTR( node->userAgentHttpHeader.begin );
+    releaseDataToSendPoolNode( &pool, &node );
+
+    destructDataToSendPool( &pool );
+}
+
+int run_backend_comm_data_to_send_pool_tests()
+{
+    const struct CMUnitTest tests [] =
+    {
+        ELASTIC_APM_CMOCKA_UNIT_TEST( buffer_is_reused_within_size_class ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( oversize_buffer_is_not_retained ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( trim_retains_at_most_high_water_mark_and_frees_larger_buffers_first ),
+        ELASTIC_APM_CMOCKA_UNIT_TEST( node_is_reused_and_its_buffers_are_released ),
+    };
+
+    return cmocka_run_group_tests( tests, NULL, NULL );
+}
@@ -19,6 +19,7 @@
 
 #include "default_test_fixture.h"
 #include "Tracer.h"
+#include "mock_alloc.h"
 #include "mock_assert.h"
 #include "mock_log_custom_sink.h"
 #include "mock_clock.h"
@@ -38,6 +39,8 @@ int perTestDefaultSetup( void** testFixtureState )
 
     getGlobalMockLogCustomSink() = {};
 
+    setIsMemoryLeakExpectedDuringUnitTests( false );
+
     initMockPhpIni();
 
     constructTracer( getGlobalTracer() );
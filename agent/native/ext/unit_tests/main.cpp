@@ -30,7 +30,6 @@
 #   endif
 #   include <windows.h>
 #endif
-#include "gen_numbered_intercepting_callbacks_src.h"
 
 void printInfo(int argc, const char **argv);
 
@@ -51,6 +50,7 @@ int run_iterateOverCStackTrace_tests();
 int run_ResultCode_tests( int argc, const char* argv[] );
 // int run_parse_value_with_units_tests();
 int run_backend_comm_backoff_tests();
+int run_backend_comm_data_to_send_pool_tests();
 
 int main( int argc, const char* argv[] )
 {
@@ -74,8 +74,7 @@ int main( int argc, const char* argv[] )
     failedTestsCount += run_ResultCode_tests(argc, argv);
     // failedTestsCount += run_parse_value_with_units_tests();
     failedTestsCount += run_backend_comm_backoff_tests();
-
-    // gen_numbered_intercepting_callbacks_src( 1000 );
+    failedTestsCount += run_backend_comm_data_to_send_pool_tests();
 
     return failedTestsCount;
 }
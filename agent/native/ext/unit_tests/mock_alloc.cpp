@@ -22,6 +22,7 @@
 #include "basic_macros.h"
 #include "unit_test_util.h"
 #include "mock_log_custom_sink.h"
+#include "mock_alloc.h"
 
 #define ELASTIC_APM_CURRENT_LOG_CATEGORY ELASTIC_APM_LOG_CATEGORY_C_EXT_UNIT_TESTS
 
@@ -47,12 +48,21 @@ void productionCodePeFree( void* allocatedBlock, bool isPersistent )
 }
 ELASTIC_APM_SUPPRESS_UNUSED( productionCodePeFree );
 
+static bool g_isMemoryLeakExpected = false;
+
+void setIsMemoryLeakExpectedDuringUnitTests( bool isExpected )
+{
+    g_isMemoryLeakExpected = isExpected;
+}
+
 /**
  * onMemoryLeakDuringUnitTests is used in "MemoryTracker.c"
  * via ELASTIC_APM_ON_MEMORY_LEAK_CUSTOM_FUNC defined in unit tests' CMakeLists.txt
  */
 void onMemoryLeakDuringUnitTests()
 {
+    if ( g_isMemoryLeakExpected ) return;
+
     ELASTIC_APM_FORCE_LOG_CRITICAL( "The last test will be considered FAILED because of the detected memory leak." );
     ELASTIC_APM_CMOCKA_FAIL();
 }
@@ -178,15 +178,35 @@ ResultCode loadPhpFile( const char* phpFilePath )
 void getArgsFromZendExecuteData( zend_execute_data* execute_data, size_t dstArraySize, zval dstArray[], uint32_t* argsCount )
 {
     *argsCount = ZEND_CALL_NUM_ARGS( execute_data );
-    ZEND_PARSE_PARAMETERS_START( /* min_num_args: */ 0, /* max_num_args: */ ( (int) dstArraySize ) )
-    Z_PARAM_OPTIONAL
+    if ( execute_data->func != NULL && ZEND_USER_CODE( execute_data->func->type ) )
+    {
+        // Frame of user function (called from Observer API handlers):
+        // declared parameters are the first CVs and extra arguments are moved by Zend after all CVs and temporaries
+        const zend_op_array* opArray = &( execute_data->func->op_array );
+        if ( *argsCount > dstArraySize )
+        {
+            *argsCount = (uint32_t)dstArraySize;
+        }
+        ELASTIC_APM_FOR_EACH_INDEX( i, *argsCount )
+        {
+            dstArray[ i ] = ( i < opArray->num_args )
+                    ? *ZEND_CALL_ARG( execute_data, i + 1 )
+                    : *ZEND_CALL_VAR_NUM( execute_data, opArray->last_var + opArray->T + ( i - opArray->num_args ) );
+        }
+        return;
+    }
+
+    // Frame of internal function: all the arguments are consecutive.
+    // Only the first dstArraySize are copied (shallow - without incrementing reference count)
+    // so the rest of arguments are not touched at all.
+    if ( *argsCount > dstArraySize )
+    {
+        *argsCount = (uint32_t)dstArraySize;
+    }
     ELASTIC_APM_FOR_EACH_INDEX( i, *argsCount )
     {
-        zval* pArgAsZval;
-        Z_PARAM_ZVAL( pArgAsZval )
-        dstArray[ i ] = *pArgAsZval;
+        dstArray[ i ] = *ZEND_CALL_ARG( execute_data, i + 1 );
     }
-    ZEND_PARSE_PARAMETERS_END();
 }
 
 typedef void (* ConsumeZvalFunc)( void* ctx, const zval* pZval );
@@ -322,7 +342,27 @@ bool isScriptRestricedByOpcacheAPI() {
     return false;
 }
 
-bool detectOpcacheRestartPending() {
+static uint64_t getOpcacheRestartsCount(zval *status) {
+    zval *statistics = zend_hash_str_find(Z_ARRVAL_P(status), ZEND_STRL("opcache_statistics"));
+    if (!statistics || Z_TYPE_P(statistics) != IS_ARRAY) {
+        return 0;
+    }
+
+    static const char *const restartsCountKeys[] = {"oom_restarts", "hash_restarts", "manual_restarts"};
+    uint64_t restartsCount = 0;
+    for (const char *key : restartsCountKeys) {
+        zval *count = zend_hash_str_find(Z_ARRVAL_P(statistics), key, strlen(key));
+        if (count && Z_TYPE_P(count) == IS_LONG) {
+            restartsCount += static_cast<uint64_t>(Z_LVAL_P(count));
+        }
+    }
+    return restartsCount;
+}
+
+bool detectOpcacheRestartPending(uint64_t *restartsCount) {
+    if (restartsCount) {
+        *restartsCount = 0;
+    }
     if (!isOpcacheEnabled()) {
         return false;
     }
@@ -352,6 +392,10 @@ bool detectOpcacheRestartPending() {
         return false;
     }
 
+    if (restartsCount) {
+        *restartsCount = getOpcacheRestartsCount(&rv);
+    }
+
 	zval *restartPending = zend_hash_str_find(Z_ARRVAL(rv), ZEND_STRL("restart_pending"));
     if (restartPending && Z_TYPE_P(restartPending) == IS_TRUE) {
         zval_ptr_dtor(&rv);
@@ -88,7 +88,8 @@ void getArgsFromZendExecuteData( zend_execute_data *execute_data, size_t dstArra
 bool isPhpRunningAsCliScript();
 bool detectOpcachePreload();
 bool isScriptRestricedByOpcacheAPI();
-bool detectOpcacheRestartPending();
+// restartsCount (optional) gets the number of opcache restarts (out of memory, hash overflow and manual ones) so far
+bool detectOpcacheRestartPending( uint64_t* restartsCount = nullptr );
 void enableAccessToServerGlobal();
 
 #define ELASTIC_APM_ZEND_ADD_ASSOC( map, key, valueType, value ) ELASTIC_APM_PP_CONCAT( ELASTIC_APM_PP_CONCAT( add_assoc_, valueType ), _ex)( (map), (key), sizeof( key ) - 1, (value) )
@@ -4,6 +4,7 @@
 #include "PeriodicTaskExecutor.h"
 #include "PhpBridgeInterface.h"
 #include "PhpSapi.h"
+#include "SamplingTimer.h"
 #include "SharedMemoryState.h"
 #include <memory>
 
@@ -24,6 +25,10 @@ public:
     std::unique_ptr<PeriodicTaskExecutor> periodicTaskExecutor_;
     std::shared_ptr<InferredSpans> inferredSpans_;
     std::shared_ptr<SharedMemoryState> sharedMemory_;
+    std::unique_ptr<SamplingTimer> samplingTimer_; // created on first request that selects timer driven sampling
+    // Executor and samplers are per thread in ZTS build so task ids are kept along with them
+    PeriodicTaskExecutor::taskId_t inferredSpansTaskId_ = 0;
+    PeriodicTaskExecutor::taskId_t continuousProfilerTaskId_ = 0;
 };
 
     
@@ -0,0 +1,102 @@
+#include "AstInstrumentationRule.h"
+
+namespace elasticapm::php {
+
+namespace {
+
+enum ruleField_t {
+    fileSuffixField,
+    namespaceField,
+    classField,
+    functionField,
+    capturedArgIndicesField,
+    spanTypeField,
+
+    numberOfFields
+};
+
+std::string_view trimWhiteSpace(std::string_view str) {
+    constexpr std::string_view whiteSpace = " \t\r\n";
+    std::size_t begin = str.find_first_not_of(whiteSpace);
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    return str.substr(begin, str.find_last_not_of(whiteSpace) - begin + 1);
+}
+
+std::vector<std::string_view> splitAndTrim(std::string_view str, char separator) {
+    std::vector<std::string_view> parts;
+    while (true) {
+        std::size_t separatorPos = str.find(separator);
+        parts.push_back(trimWhiteSpace(str.substr(0, separatorPos)));
+        if (separatorPos == std::string_view::npos) {
+            return parts;
+        }
+        str.remove_prefix(separatorPos + 1);
+    }
+}
+
+bool parseCapturedArgIndices(std::string_view indicesField, std::vector<bool> &capturedArgs) {
+    for (std::string_view indexAsString : splitAndTrim(indicesField, ',')) {
+        // empty list and trailing comma are allowed
+        if (indexAsString.empty()) {
+            continue;
+        }
+        std::size_t index = 0;
+        for (char c : indexAsString) {
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            index = index * 10 + static_cast<std::size_t>(c - '0');
+            if (index > AstInstrumentationRule::maxCapturedArgIndex) {
+                return false;
+            }
+        }
+        if (capturedArgs.size() <= index) {
+            capturedArgs.resize(index + 1, false);
+        }
+        capturedArgs[index] = true;
+    }
+    return true;
+}
+
+std::nullopt_t setError(std::string *error, std::string message) {
+    if (error) {
+        *error = std::move(message);
+    }
+    return std::nullopt;
+}
+
+}
+
+std::optional<AstInstrumentationRule> parseAstInstrumentationRule(std::string_view ruleAsString, std::string *error) {
+    std::vector<std::string_view> fields = splitAndTrim(ruleAsString, '|');
+    if (fields.size() != numberOfFields) {
+        return setError(error, "Expected " + std::to_string(numberOfFields) + " fields but found " + std::to_string(fields.size()));
+    }
+
+    AstInstrumentationRule rule;
+    rule.fileSuffix = fields[fileSuffixField];
+    std::string_view nameSpace = fields[namespaceField];
+    if (!nameSpace.empty() && nameSpace.front() == '\\') {
+        nameSpace.remove_prefix(1);
+    }
+    rule.nameSpace = nameSpace;
+    rule.className = fields[classField];
+    rule.functionName = fields[functionField];
+    rule.spanType = fields[spanTypeField].empty() ? std::string_view("app") : fields[spanTypeField];
+
+    if (rule.fileSuffix.empty()) {
+        return setError(error, "File path suffix is required");
+    }
+    if (rule.functionName.empty()) {
+        return setError(error, "Method/function name is required");
+    }
+    if (!parseCapturedArgIndices(fields[capturedArgIndicesField], rule.capturedArgs)) {
+        return setError(error, "Captured arg indices should be comma separated integers not greater than " + std::to_string(AstInstrumentationRule::maxCapturedArgIndex));
+    }
+
+    return rule;
+}
+
+}
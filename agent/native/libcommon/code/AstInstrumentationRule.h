@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace elasticapm::php {
+
+/**
+ * Declarative rule for compile time (AST) instrumentation - see agent/native/ext/AST_instrumentation_rules.h for the format.
+ * Parsing is kept independent of Zend so that it can be tested on its own.
+ */
+struct AstInstrumentationRule {
+    // Functions with more parameters than that are not instrumented with captured args
+    // because captured arg indices are expected to be small
+    static constexpr std::size_t maxCapturedArgIndex = 63;
+
+    std::string fileSuffix;
+    // without leading backslash - the same as namespace name in AST
+    std::string nameSpace;
+    // empty for standalone function
+    std::string className;
+    std::string functionName;
+    std::string spanType;
+    // true at parameter index if the argument is captured - size is the minimal number of parameters the function has to have
+    std::vector<bool> capturedArgs;
+};
+
+// Returns std::nullopt for malformed rule - error (if not null) is set to the reason
+std::optional<AstInstrumentationRule> parseAstInstrumentationRule(std::string_view ruleAsString, std::string *error = nullptr);
+
+// Calls onRule for each non-empty ';' separated part of rulesConfig (surrounding white space is trimmed)
+template <typename OnRuleFunc>
+void forEachAstInstrumentationRule(std::string_view rulesConfig, OnRuleFunc onRule) {
+    constexpr std::string_view whiteSpace = " \t\r\n";
+    while (true) {
+        std::size_t separatorPos = rulesConfig.find(';');
+        std::string_view rule = rulesConfig.substr(0, separatorPos);
+        std::size_t begin = rule.find_first_not_of(whiteSpace);
+        if (begin != std::string_view::npos) {
+            onRule(rule.substr(begin, rule.find_last_not_of(whiteSpace) - begin + 1));
+        }
+        if (separatorPos == std::string_view::npos) {
+            return;
+        }
+        rulesConfig.remove_prefix(separatorPos + 1);
+    }
+}
+
+}
@@ -1,13 +1,23 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <mutex>
 
 namespace elasticapm::php {
 
-
+/**
+ * Sampling state of a single PHP thread - instance lives in module globals so in ZTS build every request thread has its own
+ * and interrupt function requests VM interrupt only for that thread.
+ * Interrupt may be requested from the periodic task thread or signal handler, backtrace is attached by the PHP thread itself.
+ *
+ * Time spent attaching backtraces is measured. With overhead budget set, the interval is raised above the configured one
+ * so that the average cost of a sample divided by the interval stays within the budget - cost varies with stack depth
+ * so it is adapted per worker at the end of each request.
+ */
 class InferredSpans {
 public:
     
@@ -24,26 +34,27 @@ public:
             return;
         }
 
-        std::unique_lock lock(mutex_);
-        time_point_t requestInterruptTime = lastInterruptRequestTick_;
-
         if (checkAndResetInterruptFlag()) {
-            lock.unlock();
+            time_point_t requestInterruptTime{time_point_t::duration{lastInterruptRequestTick_.load()}};
             phpSideBacktracePending_ = true;
-            attachInferredSpansOnPhp_(requestInterruptTime, std::chrono::time_point_cast<std::chrono::milliseconds>(clock_t::now()));
+            auto startTime = clock_t::now();
+            attachInferredSpansOnPhp_(requestInterruptTime, std::chrono::time_point_cast<std::chrono::milliseconds>(startTime));
+            samplingTime_ += clock_t::now() - startTime;
+            samplesCount_++;
             phpSideBacktracePending_ = false;
         }
     }
 
     void tryRequestInterrupt(time_point_t now) {
-        if (interruptedRequested_.load()) {
+        if (!periodicTaskDriven_.load() || interruptedRequested_.load()) {
             return; // it was requested to interrupt in previous interval
         }
 
         std::unique_lock lock(mutex_);
 
-        if (now > lastInterruptRequestTick_ + samplingInterval_) {
-            lastInterruptRequestTick_ = now;
+        // scheduler runs the task exactly at the interval so deadline itself has to pass the check
+        if (now >= time_point_t{time_point_t::duration{lastInterruptRequestTick_.load()}} + samplingInterval_) {
+            lastInterruptRequestTick_ = now.time_since_epoch().count();
 
             interruptedRequested_ = true;
             lock.unlock();
@@ -51,15 +62,96 @@ public:
         }
     }
 
+    // Used when sampling is driven by timer signal - interval is kept by the timer itself.
+    // It does not lock nor allocate so it can be called from signal handler
+    void requestInterruptFromSignalHandler() {
+        if (interruptedRequested_.load()) {
+            return;
+        }
+
+        lastInterruptRequestTick_ = std::chrono::time_point_cast<std::chrono::milliseconds>(clock_t::now()).time_since_epoch().count();
+        interruptedRequested_ = true;
+        interrupt_();
+    }
+
 
+    // Other samplers of the same thread (e.g. continuous profiler) request VM interrupt the same way
+    interruptFunc_t const &getInterruptFunction() const {
+        return interrupt_;
+    }
+
+    // Periodic task thread is shared by all the samplers - the ones that are disabled or driven by timer ignore its ticks
+    void setPeriodicTaskDriven(bool periodicTaskDriven) {
+        periodicTaskDriven_ = periodicTaskDriven;
+    }
+
+    // Sets configured interval - effective one may be longer if overhead budget is set
     void setInterval(std::chrono::milliseconds interval) {
         std::lock_guard lock(mutex_);
-        samplingInterval_ = interval;
+        configuredInterval_ = interval;
+        samplingInterval_ = std::max(configuredInterval_, adaptedInterval_);
+    }
+
+    std::chrono::milliseconds getInterval() {
+        std::lock_guard lock(mutex_);
+        return samplingInterval_;
     }
 
+    /**
+     * @param budget share of time sampling may take (0.01 for 1%), 0 disables adaptation
+     * @param maxInterval upper bound of the adapted interval
+     */
+    void setOverheadBudget(double budget, std::chrono::milliseconds maxInterval) {
+        std::lock_guard lock(mutex_);
+        overheadBudget_ = budget;
+        maxInterval_ = maxInterval;
+        if (overheadBudget_ <= 0) {
+            adaptedInterval_ = std::chrono::milliseconds{0};
+            averageSampleCost_ = 0;
+        }
+        samplingInterval_ = std::max(configuredInterval_, adaptedInterval_);
+    }
+
+    // Resets interrupt request time and the per request accounting
     void reset() {
         std::lock_guard lock(mutex_);
-        lastInterruptRequestTick_ = std::chrono::time_point_cast<time_point_t::duration>(clock_t::now());
+        auto now = clock_t::now();
+        lastInterruptRequestTick_ = std::chrono::time_point_cast<time_point_t::duration>(now).time_since_epoch().count();
+        requestStartTime_ = now;
+        samplingTime_ = clock_t::duration{0};
+        samplesCount_ = 0;
+    }
+
+    // Time spent attaching backtraces since reset()
+    std::chrono::nanoseconds getSamplingTime() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(samplingTime_);
+    }
+
+    uint64_t getSamplesCount() const {
+        return samplesCount_;
+    }
+
+    // Share of time since reset() spent attaching backtraces
+    double getOverhead(clock_t::time_point now) const {
+        auto elapsed = now - requestStartTime_;
+        return elapsed.count() > 0 ? static_cast<double>(samplingTime_.count()) / static_cast<double>(elapsed.count()) : 0;
+    }
+
+    // Adapts interval to the cost of samples taken since reset() - to be called at the end of request
+    void adaptInterval() {
+        std::lock_guard lock(mutex_);
+        if (overheadBudget_ <= 0 || samplesCount_ == 0) {
+            return;
+        }
+
+        // smoothed so that single request with unusually deep stacks does not throw the interval off
+        double sampleCost = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(samplingTime_).count()) / static_cast<double>(samplesCount_);
+        averageSampleCost_ = averageSampleCost_ == 0 ? sampleCost : averageSampleCost_ * (1 - costSmoothingFactor) + sampleCost * costSmoothingFactor;
+
+        double requiredIntervalMs = averageSampleCost_ / overheadBudget_ / 1'000'000;
+        auto requiredInterval = std::chrono::milliseconds{static_cast<std::chrono::milliseconds::rep>(std::min(requiredIntervalMs, static_cast<double>(maxInterval_.count())) + 0.5)};
+        adaptedInterval_ = std::min(requiredInterval, maxInterval_);
+        samplingInterval_ = std::max(configuredInterval_, adaptedInterval_);
     }
 
 private:
@@ -69,8 +161,20 @@ private:
     }
 
     std::atomic_bool interruptedRequested_ = false;
+    std::atomic_bool periodicTaskDriven_ = true;
+    static constexpr double costSmoothingFactor = 0.3;
+
     std::chrono::milliseconds samplingInterval_ = std::chrono::milliseconds(20);
-    time_point_t lastInterruptRequestTick_ = std::chrono::time_point_cast<time_point_t::duration>(clock_t::now());
+    std::chrono::milliseconds configuredInterval_ = std::chrono::milliseconds(20);
+    std::chrono::milliseconds adaptedInterval_ = std::chrono::milliseconds(0);
+    std::chrono::milliseconds maxInterval_ = std::chrono::milliseconds(0);
+    double overheadBudget_ = 0;
+    double averageSampleCost_ = 0; // in nanoseconds
+    // accessed only by PHP thread
+    clock_t::time_point requestStartTime_ = clock_t::now();
+    clock_t::duration samplingTime_{0};
+    uint64_t samplesCount_ = 0;
+    std::atomic<time_point_t::rep> lastInterruptRequestTick_ = std::chrono::time_point_cast<time_point_t::duration>(clock_t::now()).time_since_epoch().count();
     std::mutex mutex_;
     interruptFunc_t interrupt_;
     attachInferredSpansOnPhp_t attachInferredSpansOnPhp_;
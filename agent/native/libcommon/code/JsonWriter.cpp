@@ -0,0 +1,211 @@
+#include "JsonWriter.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+
+namespace elasticapm::php {
+
+namespace {
+
+constexpr char hexDigits[] = "0123456789abcdef";
+constexpr uint32_t invalidUtf8Replacement = 0xfffd;
+// the same as php_gcvt() uses when serialize_precision is -1
+constexpr int maxDigitsBeforeExponentialFormat = 17;
+
+bool isUtf8Lead(unsigned char c) {
+    return c < 0x80 || (c >= 0xc2 && c <= 0xf4);
+}
+
+bool isUtf8Trail(unsigned char c) {
+    return c >= 0x80 && c <= 0xbf;
+}
+
+/**
+ * Decodes UTF-8 sequence starting at pos (which is not ASCII).
+ * On invalid sequence returns false and sets length to the number of bytes to skip -
+ * the same way as php_next_utf8_char() which json_encode uses.
+ */
+bool decodeUtf8(std::string_view str, std::size_t pos, uint32_t &codePoint, std::size_t &length) {
+    auto byteAt = [str, pos](std::size_t offset) -> unsigned char { return static_cast<unsigned char>(str[pos + offset]); };
+    auto invalid = [&length](std::size_t bytesToSkip) {
+        length = bytesToSkip;
+        return false;
+    };
+    std::size_t available = str.size() - pos;
+    unsigned char c = byteAt(0);
+
+    if (c < 0xc2) {
+        return invalid(1);
+    }
+    if (c < 0xe0) {
+        if (available < 2) {
+            return invalid(1);
+        }
+        if (!isUtf8Trail(byteAt(1))) {
+            return invalid(isUtf8Lead(byteAt(1)) ? 1 : 2);
+        }
+        codePoint = ((c & 0x1fu) << 6) | (byteAt(1) & 0x3fu);
+        length = 2;
+        return true;
+    }
+    if (c < 0xf0) {
+        if (available < 3 || !isUtf8Trail(byteAt(1)) || !isUtf8Trail(byteAt(2))) {
+            if (available < 2 || isUtf8Lead(byteAt(1))) {
+                return invalid(1);
+            }
+            return invalid((available < 3 || isUtf8Lead(byteAt(2))) ? 2 : 3);
+        }
+        codePoint = ((c & 0x0fu) << 12) | ((byteAt(1) & 0x3fu) << 6) | (byteAt(2) & 0x3fu);
+        if (codePoint < 0x800 || (codePoint >= 0xd800 && codePoint <= 0xdfff)) {
+            return invalid(3);
+        }
+        length = 3;
+        return true;
+    }
+    if (c < 0xf5) {
+        if (available < 4 || !isUtf8Trail(byteAt(1)) || !isUtf8Trail(byteAt(2)) || !isUtf8Trail(byteAt(3))) {
+            if (available < 2 || isUtf8Lead(byteAt(1))) {
+                return invalid(1);
+            }
+            if (available < 3 || isUtf8Lead(byteAt(2))) {
+                return invalid(2);
+            }
+            return invalid((available < 4 || isUtf8Lead(byteAt(3))) ? 3 : 4);
+        }
+        codePoint = ((c & 0x07u) << 18) | ((byteAt(1) & 0x3fu) << 12) | ((byteAt(2) & 0x3fu) << 6) | (byteAt(3) & 0x3fu);
+        if (codePoint < 0x10000 || codePoint > 0x10ffff) {
+            return invalid(4);
+        }
+        length = 4;
+        return true;
+    }
+    return invalid(1);
+}
+
+}
+
+void JsonWriter::appendInt(int64_t value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    buffer_.append(buf, result.ptr);
+}
+
+bool JsonWriter::appendDouble(double value) {
+    if (!std::isfinite(value)) {
+        return false;
+    }
+
+    // shortest representation that round-trips - the same digits as zend_dtoa() in mode 0
+    char scientific[32];
+    auto result = std::to_chars(scientific, scientific + sizeof(scientific), value, std::chars_format::scientific);
+    std::string_view formatted(scientific, static_cast<std::size_t>(result.ptr - scientific));
+
+    if (formatted.front() == '-') {
+        buffer_.push_back('-');
+        formatted.remove_prefix(1);
+    }
+    auto exponentPos = formatted.find('e');
+    std::string digits;
+    for (char c : formatted.substr(0, exponentPos)) {
+        if (c != '.') {
+            digits.push_back(c);
+        }
+    }
+    int exponent = std::atoi(std::string(formatted.substr(exponentPos + 1)).c_str());
+
+    // layout below follows php_gcvt() - decimalPointPos is the number of digits before decimal point
+    int decimalPointPos = exponent + 1;
+    if (decimalPointPos < -3 || decimalPointPos > maxDigitsBeforeExponentialFormat) {
+        buffer_.push_back(digits[0]);
+        buffer_.push_back('.');
+        buffer_.append(digits.size() > 1 ? std::string_view(digits).substr(1) : std::string_view("0"));
+        buffer_.push_back('e');
+        buffer_.push_back(exponent < 0 ? '-' : '+');
+        appendInt(std::abs(exponent));
+    } else if (decimalPointPos <= 0) {
+        buffer_.append("0.");
+        buffer_.append(static_cast<std::size_t>(-decimalPointPos), '0');
+        buffer_.append(digits);
+    } else {
+        auto integerDigits = static_cast<std::size_t>(decimalPointPos);
+        if (digits.size() <= integerDigits) {
+            buffer_.append(digits);
+            buffer_.append(integerDigits - digits.size(), '0');
+        } else {
+            buffer_.append(digits, 0, integerDigits);
+            buffer_.push_back('.');
+            buffer_.append(digits, integerDigits);
+        }
+    }
+    return true;
+}
+
+void JsonWriter::appendString(std::string_view value) {
+    buffer_.reserve(buffer_.size() + value.size() + 2);
+    buffer_.push_back('"');
+
+    std::size_t pos = 0;
+    while (pos < value.size()) {
+        auto c = static_cast<unsigned char>(value[pos]);
+        if (c >= 0x80) {
+            uint32_t codePoint = 0;
+            std::size_t length = 0;
+            if (!decodeUtf8(value, pos, codePoint, length)) {
+                codePoint = invalidUtf8Replacement;
+            }
+            pos += length;
+            if (codePoint >= 0x10000) {
+                codePoint -= 0x10000;
+                appendUnicodeEscape(0xd800 | (codePoint >> 10));
+                appendUnicodeEscape(0xdc00 | (codePoint & 0x3ff));
+            } else {
+                appendUnicodeEscape(codePoint);
+            }
+            continue;
+        }
+
+        ++pos;
+        switch (c) {
+            case '"':
+                buffer_.append("\\\"");
+                break;
+            case '\\':
+                buffer_.append("\\\\");
+                break;
+            case '/':
+                buffer_.append("\\/");
+                break;
+            case '\b':
+                buffer_.append("\\b");
+                break;
+            case '\f':
+                buffer_.append("\\f");
+                break;
+            case '\n':
+                buffer_.append("\\n");
+                break;
+            case '\r':
+                buffer_.append("\\r");
+                break;
+            case '\t':
+                buffer_.append("\\t");
+                break;
+            default:
+                if (c < 0x20) {
+                    appendUnicodeEscape(c);
+                } else {
+                    buffer_.push_back(static_cast<char>(c));
+                }
+        }
+    }
+
+    buffer_.push_back('"');
+}
+
+void JsonWriter::appendUnicodeEscape(uint32_t codeUnit) {
+    char escaped[] = {'\\', 'u', hexDigits[(codeUnit >> 12) & 0xf], hexDigits[(codeUnit >> 8) & 0xf], hexDigits[(codeUnit >> 4) & 0xf], hexDigits[codeUnit & 0xf]};
+    buffer_.append(escaped, sizeof(escaped));
+}
+
+}
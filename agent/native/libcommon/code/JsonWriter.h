@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace elasticapm::php {
+
+/**
+ * Appends JSON values to a buffer - structure (braces, commas, keys) is written by the caller.
+ *
+ * Output is the same as PHP part's JsonUtil::encode() (json_encode with JSON_INVALID_UTF8_SUBSTITUTE) produces:
+ * '/' is escaped, non-ASCII characters are written as \uXXXX, invalid UTF-8 sequences are replaced by \ufffd
+ * and doubles are written in the shortest form that round-trips (serialize_precision = -1).
+ */
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string &buffer) : buffer_(buffer) {
+    }
+
+    void appendRaw(std::string_view text) {
+        buffer_.append(text);
+    }
+
+    void appendRaw(char c) {
+        buffer_.push_back(c);
+    }
+
+    void appendNull() {
+        buffer_.append("null");
+    }
+
+    void appendBool(bool value) {
+        buffer_.append(value ? "true" : "false");
+    }
+
+    void appendInt(int64_t value);
+
+    // Returns false for NaN and infinity - they cannot be represented in JSON
+    bool appendDouble(double value);
+
+    void appendString(std::string_view value);
+
+private:
+    void appendUnicodeEscape(uint32_t codeUnit);
+
+    std::string &buffer_;
+};
+
+}
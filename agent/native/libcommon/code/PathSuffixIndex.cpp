@@ -0,0 +1,54 @@
+#include "PathSuffixIndex.h"
+
+namespace elasticapm::php {
+
+void PathSuffixIndex::add(std::string_view pathSuffix, value_t value) {
+    nodeIndex_t node = 0;
+    for (auto it = pathSuffix.rbegin(); it != pathSuffix.rend(); ++it) {
+        auto child = findChild(node, *it);
+        if (!child) {
+            child = static_cast<nodeIndex_t>(nodes_.size());
+            nodes_[node].children.emplace_back(*it, *child);
+            nodes_.emplace_back();
+        }
+        node = *child;
+    }
+
+    if (!nodes_[node].value) {
+        ++suffixesCount_;
+    }
+    nodes_[node].value = value;
+}
+
+std::optional<PathSuffixIndex::value_t> PathSuffixIndex::findLongestSuffix(std::string_view path) const {
+    nodeIndex_t node = 0;
+    std::optional<value_t> found = nodes_[node].value;
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        auto child = findChild(node, *it);
+        if (!child) {
+            break;
+        }
+        node = *child;
+        if (nodes_[node].value) {
+            found = nodes_[node].value;
+        }
+    }
+    return found;
+}
+
+void PathSuffixIndex::clear() {
+    nodes_.clear();
+    nodes_.emplace_back(); // root - empty suffix
+    suffixesCount_ = 0;
+}
+
+std::optional<PathSuffixIndex::nodeIndex_t> PathSuffixIndex::findChild(nodeIndex_t node, char c) const {
+    for (auto const &[childChar, childIndex] : nodes_[node].children) {
+        if (childChar == c) {
+            return childIndex;
+        }
+    }
+    return std::nullopt;
+}
+
+}
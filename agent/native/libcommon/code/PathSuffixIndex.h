@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace elasticapm::php {
+
+/**
+ * Finds which of the registered suffixes a file path ends with.
+ *
+ * Suffixes are stored reversed in a trie so that the lookup walks the path backwards once -
+ * the cost is bounded by the length of the longest registered suffix and does not depend on the number of suffixes.
+ * It is meant to be built once (e.g. on module init) and queried for each compiled file.
+ */
+class PathSuffixIndex {
+public:
+    using value_t = std::size_t;
+
+    PathSuffixIndex() {
+        clear();
+    }
+
+    // Adding the same suffix again replaces its value
+    void add(std::string_view pathSuffix, value_t value);
+
+    // Returns value of the longest registered suffix that path ends with
+    std::optional<value_t> findLongestSuffix(std::string_view path) const;
+
+    void clear();
+
+    bool empty() const {
+        return suffixesCount_ == 0;
+    }
+
+    std::size_t size() const {
+        return suffixesCount_;
+    }
+
+private:
+    using nodeIndex_t = uint32_t;
+
+    struct node_t {
+        // there are only a few distinct characters at each position of the registered suffixes so linear search is the fastest
+        std::vector<std::pair<char, nodeIndex_t>> children;
+        std::optional<value_t> value;
+    };
+
+    std::optional<nodeIndex_t> findChild(nodeIndex_t node, char c) const;
+
+    std::vector<node_t> nodes_;
+    std::size_t suffixesCount_ = 0;
+};
+
+}
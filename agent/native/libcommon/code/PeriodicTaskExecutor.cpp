@@ -0,0 +1,221 @@
+#include "PeriodicTaskExecutor.h"
+
+#include <algorithm>
+
+namespace elasticapm::php {
+
+PeriodicTaskExecutor::PeriodicTaskExecutor(std::vector<task_t> periodicTasks, worker_init_t workerInit) : currentTick_(toTick(clock_t::now())), workerInit_(std::move(workerInit)) {
+    for (auto &task : periodicTasks) {
+        constructorTasks_.push_back(addPeriodicTask(std::move(task), std::chrono::milliseconds{20}));
+    }
+    thread_ = std::thread(getThreadWorkerFunction());
+}
+
+PeriodicTaskExecutor::taskId_t PeriodicTaskExecutor::addPeriodicTask(task_t task, std::chrono::milliseconds interval, std::chrono::milliseconds jitter) {
+    return addTask(std::move(task), interval, jitter, false);
+}
+
+PeriodicTaskExecutor::taskId_t PeriodicTaskExecutor::addOneShotTask(task_t task, std::chrono::milliseconds delay) {
+    return addTask(std::move(task), delay, std::chrono::milliseconds{0}, true);
+}
+
+PeriodicTaskExecutor::taskId_t PeriodicTaskExecutor::addTask(task_t task, std::chrono::milliseconds interval, std::chrono::milliseconds jitter, bool oneShot) {
+    taskId_t taskId;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        taskId = nextTaskId_++;
+        auto &entry = tasks_.emplace(taskId, taskEntry_t{std::make_shared<const task_t>(std::move(task)), interval, jitter, oneShot, true, 0, 0, 0, {}}).first->second;
+        schedule(taskId, entry, toTick(clock_t::now()) + interval.count() / tickDuration.count());
+    }
+    pauseCondition_.notify_all();
+    return taskId;
+}
+
+bool PeriodicTaskExecutor::removeTask(taskId_t taskId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // entries left in the wheel are dropped when their slot is visited
+    return tasks_.erase(taskId) != 0;
+}
+
+bool PeriodicTaskExecutor::setTaskInterval(taskId_t taskId, std::chrono::milliseconds interval) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = tasks_.find(taskId);
+        if (found == tasks_.end()) {
+            return false;
+        }
+        found->second.interval = interval;
+        if (found->second.enabled) {
+            schedule(taskId, found->second, toTick(clock_t::now()) + interval.count() / tickDuration.count());
+        }
+    }
+    pauseCondition_.notify_all();
+    return true;
+}
+
+bool PeriodicTaskExecutor::setTaskEnabled(taskId_t taskId, bool enabled) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = tasks_.find(taskId);
+        if (found == tasks_.end()) {
+            return false;
+        }
+        auto &entry = found->second;
+        if (entry.enabled == enabled) {
+            return true;
+        }
+        entry.enabled = enabled;
+        if (enabled) {
+            schedule(taskId, entry, toTick(clock_t::now()) + entry.interval.count() / tickDuration.count());
+        } else {
+            entry.generation++; // invalidates pending deadline
+        }
+    }
+    pauseCondition_.notify_all();
+    return true;
+}
+
+std::optional<PeriodicTaskExecutor::taskStats_t> PeriodicTaskExecutor::getTaskStats(taskId_t taskId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = tasks_.find(taskId);
+    if (found == tasks_.end()) {
+        return std::nullopt;
+    }
+    return found->second.stats;
+}
+
+void PeriodicTaskExecutor::setInterval(std::chrono::milliseconds interval) {
+    std::vector<taskId_t> constructorTasks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        constructorTasks = constructorTasks_;
+    }
+    for (auto taskId : constructorTasks) {
+        setTaskInterval(taskId, interval);
+    }
+}
+
+void PeriodicTaskExecutor::schedule(taskId_t taskId, taskEntry_t &entry, tick_t nominalDeadline) {
+    entry.nominalDeadline = nominalDeadline;
+    tick_t deadline = nominalDeadline;
+    if (entry.jitter.count() > 0) {
+        deadline += std::uniform_int_distribution<tick_t>(0, entry.jitter.count() / tickDuration.count())(random_);
+    }
+    // slots behind the cursor are visited only in the next revolution
+    entry.deadline = std::max(deadline, currentTick_);
+    entry.generation++;
+    wheel_[static_cast<std::size_t>(entry.deadline) % wheelSlotsCount].push_back({taskId, entry.generation});
+    scheduleChanged_ = true;
+}
+
+bool PeriodicTaskExecutor::isCurrent(slotEntry_t const &slotEntry) const {
+    auto found = tasks_.find(slotEntry.taskId);
+    return found != tasks_.end() && found->second.generation == slotEntry.generation && found->second.enabled;
+}
+
+std::optional<PeriodicTaskExecutor::tick_t> PeriodicTaskExecutor::findNextDeadline() const {
+    for (std::size_t offset = 0; offset < wheelSlotsCount; ++offset) {
+        tick_t tick = currentTick_ + static_cast<tick_t>(offset);
+        for (auto const &slotEntry : wheel_[static_cast<std::size_t>(tick) % wheelSlotsCount]) {
+            if (isCurrent(slotEntry) && tasks_.find(slotEntry.taskId)->second.deadline <= tick) {
+                return tick;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+void PeriodicTaskExecutor::collectDueTasks(tick_t now, std::vector<taskId_t> &dueTasks) {
+    if (now < currentTick_) {
+        return;
+    }
+
+    // after long sleep (e.g. while suspended) every slot is visited just once
+    tick_t ticksToVisit = std::min<tick_t>(now - currentTick_ + 1, static_cast<tick_t>(wheelSlotsCount));
+    for (tick_t offset = 0; offset < ticksToVisit; ++offset) {
+        auto &slot = wheel_[static_cast<std::size_t>(currentTick_ + offset) % wheelSlotsCount];
+        std::erase_if(slot, [this, now, &dueTasks](slotEntry_t const &slotEntry) {
+            if (!isCurrent(slotEntry)) {
+                return true;
+            }
+            if (tasks_.find(slotEntry.taskId)->second.deadline > now) {
+                return false; // due in one of the next revolutions
+            }
+            dueTasks.push_back(slotEntry.taskId);
+            return true;
+        });
+    }
+    currentTick_ = now + 1;
+}
+
+void PeriodicTaskExecutor::work() {
+    if (workerInit_) {
+        workerInit_();
+    }
+
+    std::vector<taskId_t> dueTasks;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (working_) {
+        pauseCondition_.wait(lock, [this]() -> bool {
+            return resumed_ || !working_;
+        });
+
+        if (!working_) {
+            break;
+        }
+
+        scheduleChanged_ = false;
+        auto nextDeadline = findNextDeadline();
+        // nothing due within one wheel revolution - wake up when the cursor gets to the tasks scheduled further
+        clock_t::time_point wakeUpTime = clock_t::time_point{tickDuration * (nextDeadline ? *nextDeadline : currentTick_ + static_cast<tick_t>(wheelSlotsCount))};
+        if (pauseCondition_.wait_until(lock, wakeUpTime, [this]() -> bool { return !working_ || !resumed_ || scheduleChanged_; })) {
+            continue;
+        }
+
+        dueTasks.clear();
+        collectDueTasks(toTick(clock_t::now()), dueTasks);
+
+        for (auto taskId : dueTasks) {
+            auto found = tasks_.find(taskId);
+            if (found == tasks_.end()) {
+                continue;
+            }
+            auto task = found->second.task;
+            auto generation = found->second.generation;
+
+            lock.unlock();
+            auto startTime = clock_t::now();
+            (*task)(std::chrono::time_point_cast<std::chrono::milliseconds>(startTime));
+            auto endTime = clock_t::now();
+            lock.lock();
+
+            found = tasks_.find(taskId); // task could be removed while it was running
+            if (found == tasks_.end()) {
+                continue;
+            }
+            auto &entry = found->second;
+            auto runtime = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime);
+            entry.stats.runsCount++;
+            entry.stats.totalRuntime += runtime;
+            entry.stats.lastRuntime = runtime;
+            entry.stats.maxRuntime = std::max(entry.stats.maxRuntime, runtime);
+
+            if (entry.oneShot) {
+                tasks_.erase(found);
+                continue;
+            }
+
+            if (entry.generation != generation) {
+                continue; // rescheduled or disabled by setTaskInterval/setTaskEnabled while running
+            }
+
+            // keep the rate steady - next deadline is derived from the previous one unless it was missed
+            tick_t intervalTicks = std::max<tick_t>(entry.interval.count() / tickDuration.count(), 1);
+            tick_t endTick = toTick(endTime);
+            tick_t nextDeadline = entry.nominalDeadline + intervalTicks;
+            schedule(taskId, entry, nextDeadline > endTick ? nextDeadline : endTick + intervalTicks);
+        }
+    }
+}
+
+}
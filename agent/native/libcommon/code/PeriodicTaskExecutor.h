@@ -2,15 +2,34 @@
 
 #include "ForkableInterface.h"
 
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
-#include <stop_token>
+#include <mutex>
+#include <optional>
+#include <memory>
+#include <random>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace elasticapm::php {
 
+/**
+ * Runs tasks on a single background thread, each with its own interval.
+ *
+ * Tasks are kept in a hashed timer wheel - scheduling and cancelling are O(1) and the thread sleeps until the nearest deadline
+ * instead of waking up at a fixed interval shared by all tasks.
+ * Periodic tasks can have jitter (random delay added to each deadline) so that the same work in forked workers does not run in lockstep,
+ * one-shot tasks are removed after they run.
+ * Time spent in each task is accounted and can be read with getTaskStats().
+ *
+ * Tasks are run without the lock held so they may add/remove tasks. Missed deadlines (e.g. while suspended) are not caught up -
+ * task is run once and rescheduled relative to the current time.
+ */
 class PeriodicTaskExecutor : public ForkableInterface {
 private:
     auto getThreadWorkerFunction() {
@@ -23,9 +42,23 @@ public:
 
     using task_t = std::function<void(time_point_t)>;
     using worker_init_t = std::function<void()>;
+    using taskId_t = uint32_t;
 
-    PeriodicTaskExecutor(std::vector<task_t> periodicTasks, worker_init_t workerInit = {}) : periodicTasks_(periodicTasks), workerInit_(std::move(workerInit)),  thread_(getThreadWorkerFunction()) {
-    }
+    // Width of a wheel slot - it is also the scheduling resolution
+    static constexpr std::chrono::milliseconds tickDuration{1};
+    static constexpr std::size_t wheelSlotsCount = 512;
+
+    struct taskStats_t {
+        uint64_t runsCount = 0;
+        std::chrono::nanoseconds totalRuntime{0};
+        std::chrono::nanoseconds maxRuntime{0};
+        std::chrono::nanoseconds lastRuntime{0};
+    };
+
+    /**
+     * @param periodicTasks tasks sharing interval set by setInterval() (20ms by default)
+     */
+    PeriodicTaskExecutor(std::vector<task_t> periodicTasks, worker_init_t workerInit = {});
 
     ~PeriodicTaskExecutor() {
         shutdown();
@@ -37,29 +70,21 @@ public:
         }
     }
 
-    void work() {
-        if (workerInit_) {
-            workerInit_();
-        }
+    taskId_t addPeriodicTask(task_t task, std::chrono::milliseconds interval, std::chrono::milliseconds jitter = std::chrono::milliseconds{0});
+    taskId_t addOneShotTask(task_t task, std::chrono::milliseconds delay);
 
-        std::unique_lock<std::mutex> lock(mutex_);
-        while(working_) {
-            pauseCondition_.wait(lock, [this]() -> bool {
-                return resumed_ || !working_;
-            });
+    // Returns false if task was not found (it could already finish if it was one-shot task)
+    bool removeTask(taskId_t taskId);
 
-            if (!working_) {
-                break;
-            }
+    // New interval is applied from now on - next run is rescheduled to now + interval
+    bool setTaskInterval(taskId_t taskId, std::chrono::milliseconds interval);
 
-            lock.unlock();
-            std::this_thread::sleep_for(sleepInterval_);
-            for (auto const &task : periodicTasks_) {
-                task(std::chrono::time_point_cast<std::chrono::milliseconds>(clock_t::now()));
-            }
-            lock.lock();
-        }
-    }
+    // Disabled task keeps its registration and stats but is not run until enabled again
+    bool setTaskEnabled(taskId_t taskId, bool enabled);
+
+    std::optional<taskStats_t> getTaskStats(taskId_t taskId);
+
+    void work();
 
     void prefork() final {
         shutdown();
@@ -68,12 +93,15 @@ public:
         }
     }
 
-    void postfork([[maybe_unused]] bool child) final {
+    void postfork(bool child) final {
+        std::unique_lock<std::mutex> lock(mutex_);
         working_ = true;
-
-        mutex_.lock();
+        if (child) {
+            // otherwise all the forked workers would draw the same jitter
+            random_.seed(std::random_device{}());
+        }
         thread_ = std::thread(getThreadWorkerFunction());
-        mutex_.unlock();
+        lock.unlock();
         pauseCondition_.notify_all();
     }
 
@@ -92,9 +120,8 @@ public:
         pauseCondition_.notify_all();
     }
 
-    void setInterval(std::chrono::milliseconds interval) {
-        sleepInterval_ = interval;
-    }
+    // Sets interval of the tasks passed to constructor
+    void setInterval(std::chrono::milliseconds interval);
 
 private:
    PeriodicTaskExecutor(const PeriodicTaskExecutor&) = delete;
@@ -108,10 +135,47 @@ private:
         pauseCondition_.notify_all();
    }
 
+    using tick_t = int64_t;
+
+    struct taskEntry_t {
+        // shared so that worker can run the task without the lock held while the task is being removed
+        std::shared_ptr<const task_t> task;
+        std::chrono::milliseconds interval;
+        std::chrono::milliseconds jitter;
+        bool oneShot;
+        bool enabled = true;
+        // incremented on each (re)schedule - wheel slots may still hold references to previous deadlines
+        uint32_t generation = 0;
+        tick_t nominalDeadline = 0; // without jitter
+        tick_t deadline = 0;
+        taskStats_t stats;
+    };
+
+    struct slotEntry_t {
+        taskId_t taskId;
+        uint32_t generation;
+    };
+
+    static tick_t toTick(clock_t::time_point timePoint) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(timePoint.time_since_epoch()).count() / tickDuration.count();
+    }
+
+    taskId_t addTask(task_t task, std::chrono::milliseconds interval, std::chrono::milliseconds jitter, bool oneShot);
+    // functions below must be called with mutex_ held
+    void schedule(taskId_t taskId, taskEntry_t &entry, tick_t nominalDeadline);
+    bool isCurrent(slotEntry_t const &slotEntry) const;
+    std::optional<tick_t> findNextDeadline() const;
+    void collectDueTasks(tick_t now, std::vector<taskId_t> &dueTasks);
+
 private:
+    std::array<std::vector<slotEntry_t>, wheelSlotsCount> wheel_;
+    std::unordered_map<taskId_t, taskEntry_t> tasks_;
+    std::vector<taskId_t> constructorTasks_;
+    taskId_t nextTaskId_ = 1;
+    tick_t currentTick_;
+    std::minstd_rand random_{std::random_device{}()};
+    bool scheduleChanged_ = false;
 
-    std::chrono::milliseconds sleepInterval_ = std::chrono::milliseconds(20);
-    std::vector<task_t> periodicTasks_;
     worker_init_t workerInit_;
     std::mutex mutex_;
     std::thread thread_;
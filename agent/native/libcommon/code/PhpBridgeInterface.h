@@ -1,6 +1,5 @@
 #pragma once
 
-#include <chrono>
 #include <string>
 #include <vector>
 
@@ -17,7 +16,8 @@ public:
 
     virtual ~PhpBridgeInterface() = default;
 
-    virtual bool callInferredSpans(std::chrono::milliseconds duration) const = 0;
+    // Lets PHP part consume stack samples buffered natively
+    virtual bool callInferredSpans() const = 0;
     virtual std::vector<phpExtensionInfo_t> getExtensionList() const = 0;
     virtual std::string getPhpInfo() const = 0;
 
@@ -0,0 +1,218 @@
+#include "PprofProfile.h"
+
+namespace elasticapm::php {
+
+namespace {
+
+// Minimal protobuf writer - covers only the wire types used by profile.proto
+enum wireType_t : uint64_t {
+    wireTypeVarint = 0,
+    wireTypeLengthDelimited = 2
+};
+
+void writeVarint(std::string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void writeTag(std::string &out, uint64_t field, wireType_t wireType) {
+    writeVarint(out, (field << 3) | wireType);
+}
+
+void writeInt(std::string &out, uint64_t field, int64_t value) {
+    if (value == 0) {
+        return; // default value is not serialized
+    }
+    writeTag(out, field, wireTypeVarint);
+    writeVarint(out, static_cast<uint64_t>(value));
+}
+
+void writeBytes(std::string &out, uint64_t field, std::string_view value) {
+    writeTag(out, field, wireTypeLengthDelimited);
+    writeVarint(out, value.size());
+    out.append(value);
+}
+
+template <typename T>
+void writePacked(std::string &out, uint64_t field, std::span<const T> values) {
+    std::string packed;
+    for (auto value : values) {
+        writeVarint(packed, static_cast<uint64_t>(value));
+    }
+    writeBytes(out, field, packed);
+}
+
+std::string buildValueType(uint64_t typeId, uint64_t unitId) {
+    std::string valueType;
+    writeInt(valueType, 1, typeId);
+    writeInt(valueType, 2, unitId);
+    return valueType;
+}
+
+}
+
+bool PprofProfile::addSample(std::span<const frame_t> frames, int64_t wallNanos) {
+    if (frames.size() > maxFramesPerStack_) {
+        frames = frames.first(maxFramesPerStack_);
+    }
+
+    // once the stacks limit is reached only already known stacks can be counted,
+    // so frames are looked up without interning to keep dropped samples from growing the tables
+    bool isStacksLimitReached = stacks_.size() >= maxStacks_;
+    stackScratch_.clear();
+    for (auto const &frame : frames) {
+        if (!isStacksLimitReached) {
+            stackScratch_.push_back(internLocation(internFunction(frame.function, frame.file), frame.line));
+            continue;
+        }
+        auto locationId = findLocation(frame);
+        if (!locationId) {
+            ++droppedSamplesCount_;
+            return false;
+        }
+        stackScratch_.push_back(*locationId);
+    }
+
+    auto stack = stacks_.find(stackScratch_);
+    if (stack == stacks_.end()) {
+        if (stacks_.size() >= maxStacks_) {
+            ++droppedSamplesCount_;
+            return false;
+        }
+        stack = stacks_.emplace(stackScratch_, stackValues_t{0, 0}).first;
+    }
+
+    stack->second.count++;
+    stack->second.wallNanos += wallNanos;
+    ++samplesCount_;
+    return true;
+}
+
+std::string PprofProfile::serialize(int64_t timeNanos, int64_t durationNanos, int64_t periodNanos) const {
+    // string ids used by header are looked up without interning so that serialize does not modify the profile
+    auto findStringId = [this](std::string_view str) -> uint64_t {
+        auto found = stringIds_.find(str);
+        return found == stringIds_.end() ? 0 : found->second;
+    };
+
+    std::string out;
+
+    writeBytes(out, 1, buildValueType(findStringId("samples"), findStringId("count")));
+    writeBytes(out, 1, buildValueType(findStringId("wall"), findStringId("nanoseconds")));
+
+    for (auto const &[locationIds, values] : stacks_) {
+        std::string sample;
+        writePacked<uint64_t>(sample, 1, locationIds);
+        int64_t sampleValues[] = {values.count, values.wallNanos};
+        writePacked<int64_t>(sample, 2, sampleValues);
+        writeBytes(out, 2, sample);
+    }
+
+    for (std::size_t index = 0; index < locations_.size(); ++index) {
+        std::string line;
+        writeInt(line, 1, locations_[index].first);
+        writeInt(line, 2, locations_[index].second);
+
+        std::string location;
+        writeInt(location, 1, index + 1);
+        writeBytes(location, 4, line);
+        writeBytes(out, 4, location);
+    }
+
+    for (std::size_t index = 0; index < functions_.size(); ++index) {
+        std::string function;
+        writeInt(function, 1, index + 1);
+        writeInt(function, 2, functions_[index].first);
+        writeInt(function, 3, functions_[index].first);
+        writeInt(function, 4, functions_[index].second);
+        writeBytes(out, 5, function);
+    }
+
+    for (auto const *str : strings_) {
+        writeBytes(out, 6, *str);
+    }
+
+    writeInt(out, 9, timeNanos);
+    writeInt(out, 10, durationNanos);
+    writeBytes(out, 11, buildValueType(findStringId("wall"), findStringId("nanoseconds")));
+    writeInt(out, 12, periodNanos);
+    writeInt(out, 14, findStringId("wall")); // default_sample_type
+
+    return out;
+}
+
+void PprofProfile::clear() {
+    stringIds_.clear();
+    strings_.clear();
+    functionIds_.clear();
+    functions_.clear();
+    locationIds_.clear();
+    locations_.clear();
+    stacks_.clear();
+    samplesCount_ = 0;
+    droppedSamplesCount_ = 0;
+
+    internString("");
+    for (auto str : {"samples", "count", "wall", "nanoseconds"}) {
+        internString(str);
+    }
+}
+
+uint64_t PprofProfile::internString(std::string_view str) {
+    auto found = stringIds_.find(str);
+    if (found != stringIds_.end()) {
+        return found->second;
+    }
+
+    auto inserted = stringIds_.emplace(std::string(str), strings_.size()).first;
+    strings_.push_back(&inserted->first);
+    return inserted->second;
+}
+
+uint64_t PprofProfile::internFunction(std::string_view name, std::string_view file) {
+    std::pair<uint64_t, uint64_t> key{internString(name), internString(file)};
+    auto found = functionIds_.find(key);
+    if (found != functionIds_.end()) {
+        return found->second;
+    }
+
+    functions_.push_back(key);
+    functionIds_.emplace(key, functions_.size());
+    return functions_.size();
+}
+
+uint64_t PprofProfile::internLocation(uint64_t functionId, int64_t line) {
+    std::pair<uint64_t, int64_t> key{functionId, line};
+    auto found = locationIds_.find(key);
+    if (found != locationIds_.end()) {
+        return found->second;
+    }
+
+    locations_.push_back(key);
+    locationIds_.emplace(key, locations_.size());
+    return locations_.size();
+}
+
+std::optional<uint64_t> PprofProfile::findLocation(frame_t const &frame) const {
+    auto name = stringIds_.find(frame.function);
+    auto file = stringIds_.find(frame.file);
+    if (name == stringIds_.end() || file == stringIds_.end()) {
+        return std::nullopt;
+    }
+
+    auto function = functionIds_.find({name->second, file->second});
+    if (function == functionIds_.end()) {
+        return std::nullopt;
+    }
+
+    auto location = locationIds_.find({function->second, frame.line});
+    if (location == locationIds_.end()) {
+        return std::nullopt;
+    }
+    return location->second;
+}
+
+}
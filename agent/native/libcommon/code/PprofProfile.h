@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace elasticapm::php {
+
+/**
+ * Aggregates stack samples and encodes them as pprof profile (https://github.com/google/pprof/blob/main/proto/profile.proto).
+ * Strings, functions and locations are interned so that repeated stacks cost only a counter update.
+ * Profile is written as uncompressed protobuf which is accepted by pprof tooling as is.
+ * It is not thread safe - it is expected to be used by the thread which executes PHP code only.
+ */
+class PprofProfile {
+public:
+    struct frame_t {
+        std::string_view function;
+        std::string_view file;
+        int64_t line;
+    };
+
+    PprofProfile(std::size_t maxStacks, std::size_t maxFramesPerStack) : maxStacks_(maxStacks), maxFramesPerStack_(maxFramesPerStack) {
+        clear();
+    }
+
+    PprofProfile(const PprofProfile &) = delete;
+    PprofProfile &operator=(const PprofProfile &) = delete;
+
+    /**
+     * @param frames innermost frame first. When there are more than maxFramesPerStack frames the outermost ones are dropped.
+     * @return false if sample was dropped because limit of distinct stacks was reached
+     */
+    bool addSample(std::span<const frame_t> frames, int64_t wallNanos);
+
+    /**
+     * @param timeNanos time of collection start (UTC) in nanoseconds since epoch
+     */
+    std::string serialize(int64_t timeNanos, int64_t durationNanos, int64_t periodNanos) const;
+
+    void clear();
+
+    std::size_t getStacksCount() const {
+        return stacks_.size();
+    }
+
+    uint64_t getSamplesCount() const {
+        return samplesCount_;
+    }
+
+    uint64_t getDroppedSamplesCount() const {
+        return droppedSamplesCount_;
+    }
+
+    std::size_t getStringsCount() const {
+        return strings_.size();
+    }
+
+private:
+    struct transparentStringHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view str) const {
+            return std::hash<std::string_view>{}(str);
+        }
+    };
+
+    struct idPairHash {
+        template <typename First, typename Second>
+        std::size_t operator()(std::pair<First, Second> const &pair) const {
+            return std::hash<First>{}(pair.first) * 31 + std::hash<Second>{}(pair.second);
+        }
+    };
+
+    struct stackHash {
+        std::size_t operator()(std::vector<uint64_t> const &stack) const {
+            std::size_t hash = stack.size();
+            for (auto id : stack) {
+                hash ^= std::hash<uint64_t>{}(id) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+            }
+            return hash;
+        }
+    };
+
+    struct stackValues_t {
+        int64_t count;
+        int64_t wallNanos;
+    };
+
+    uint64_t internString(std::string_view str);
+    uint64_t internFunction(std::string_view name, std::string_view file);
+    uint64_t internLocation(uint64_t functionId, int64_t line);
+    std::optional<uint64_t> findLocation(frame_t const &frame) const;
+
+    std::size_t maxStacks_;
+    std::size_t maxFramesPerStack_;
+
+    // function and location ids are 1-based indexes to vectors below (0 is reserved by pprof format)
+    // string ids are 0-based indexes as string_table[0] has to be an empty string
+    std::unordered_map<std::string, uint64_t, transparentStringHash, std::equal_to<>> stringIds_;
+    std::vector<std::string const *> strings_;
+    std::unordered_map<std::pair<uint64_t, uint64_t>, uint64_t, idPairHash> functionIds_;
+    std::vector<std::pair<uint64_t, uint64_t>> functions_; // name, file
+    std::unordered_map<std::pair<uint64_t, int64_t>, uint64_t, idPairHash> locationIds_;
+    std::vector<std::pair<uint64_t, int64_t>> locations_; // function id, line
+    std::unordered_map<std::vector<uint64_t>, stackValues_t, stackHash> stacks_;
+    std::vector<uint64_t> stackScratch_;
+    uint64_t samplesCount_ = 0;
+    uint64_t droppedSamplesCount_ = 0;
+};
+
+}
@@ -0,0 +1,128 @@
+#include "SamplingTimer.h"
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace elasticapm::php {
+
+// Signal is delivered to the thread that armed the timer so each thread keeps its own handler
+static thread_local SamplingTimer::handler_t currentThreadHandler = nullptr;
+static thread_local void *currentThreadHandlerContext = nullptr;
+
+// Signal disposition is process wide - it is shared by all the timers (one per thread in ZTS build) using the same signal
+static std::mutex handlerInstallationMutex;
+static size_t handlerInstallationsCount = 0;
+static struct sigaction previousAction = {};
+
+SamplingTimer::~SamplingTimer() {
+    stop();
+    deleteTimer();
+    uninstallHandler();
+}
+
+void SamplingTimer::signalHandler([[maybe_unused]] int signalNumber, [[maybe_unused]] siginfo_t *info, [[maybe_unused]] void *ucontext) {
+    int savedErrno = errno;
+    if (currentThreadHandler) {
+        currentThreadHandler(currentThreadHandlerContext);
+    }
+    errno = savedErrno;
+}
+
+bool SamplingTimer::installHandler() {
+    if (handlerInstalled_) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(handlerInstallationMutex);
+    if (handlerInstallationsCount != 0) {
+        ++handlerInstallationsCount;
+        handlerInstalled_ = true;
+        return true;
+    }
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_sigaction = &SamplingTimer::signalHandler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    if (sigaction(signalNumber_, &action, &previousAction) != 0) {
+        return false;
+    }
+    ++handlerInstallationsCount;
+    handlerInstalled_ = true;
+    return true;
+}
+
+void SamplingTimer::uninstallHandler() {
+    if (!handlerInstalled_) {
+        return;
+    }
+    handlerInstalled_ = false;
+
+    std::lock_guard<std::mutex> lock(handlerInstallationMutex);
+    if (--handlerInstallationsCount == 0) {
+        sigaction(signalNumber_, &previousAction, nullptr);
+    }
+}
+
+void SamplingTimer::deleteTimer() {
+    if (!timerCreated_) {
+        return;
+    }
+    timer_delete(timerId_);
+    timerCreated_ = false;
+}
+
+bool SamplingTimer::start(std::chrono::milliseconds interval) {
+    if (interval.count() <= 0) {
+        return false;
+    }
+
+    // thread_local variables are touched here, before the timer is armed, so that signal handler does not trigger their lazy allocation
+    currentThreadHandler = handler_;
+    currentThreadHandlerContext = context_;
+
+    if (!installHandler()) {
+        return false;
+    }
+
+    if (!timerCreated_) {
+        struct sigevent event;
+        std::memset(&event, 0, sizeof(event));
+        event.sigev_notify = SIGEV_THREAD_ID;
+        event.sigev_signo = signalNumber_;
+        event.sigev_notify_thread_id = static_cast<pid_t>(syscall(SYS_gettid));
+
+        if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timerId_) != 0) {
+            return false;
+        }
+        timerCreated_ = true;
+    }
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = interval.count() / 1000;
+    spec.it_interval.tv_nsec = (interval.count() % 1000) * 1000000;
+    spec.it_value = spec.it_interval;
+
+    return timer_settime(timerId_, 0, &spec, nullptr) == 0;
+}
+
+void SamplingTimer::stop() {
+    if (!timerCreated_) {
+        return;
+    }
+
+    struct itimerspec spec;
+    std::memset(&spec, 0, sizeof(spec));
+    timer_settime(timerId_, 0, &spec, nullptr);
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ForkableInterface.h"
+
+#include <chrono>
+#include <signal.h>
+#include <time.h>
+
+namespace elasticapm::php {
+
+/**
+ * POSIX interval timer measuring CPU time of the thread which armed it (CLOCK_THREAD_CPUTIME_ID) and delivering signal to that thread.
+ * Handler is called in signal handler context so it must be async-signal-safe.
+ *
+ * The timer advances only while the thread is on CPU so the signal never interrupts blocking calls (sleep, stream_select, ...)
+ * that would not be restarted after it - wall clock timer is not supported for that reason.
+ */
+class SamplingTimer : public ForkableInterface {
+public:
+    using handler_t = void (*)(void *context);
+
+    SamplingTimer(int signalNumber, handler_t handler, void *context) : signalNumber_(signalNumber), handler_(handler), context_(context) {
+    }
+
+    ~SamplingTimer();
+
+    bool start(std::chrono::milliseconds interval);
+    void stop();
+
+    void prefork() final {
+    }
+
+    // Timers are not inherited by child process (signal disposition is)
+    void postfork(bool child) final {
+        if (child) {
+            timerCreated_ = false;
+        }
+    }
+
+private:
+    SamplingTimer(const SamplingTimer&) = delete;
+    SamplingTimer& operator=(const SamplingTimer&) = delete;
+
+    bool installHandler();
+    void uninstallHandler();
+    void deleteTimer();
+
+    static void signalHandler(int signalNumber, siginfo_t *info, void *ucontext);
+
+    int signalNumber_;
+    handler_t handler_;
+    void *context_;
+    timer_t timerId_ = {};
+    bool timerCreated_ = false;
+    bool handlerInstalled_ = false;
+};
+
+}
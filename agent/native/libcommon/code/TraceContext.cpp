@@ -0,0 +1,83 @@
+#include "TraceContext.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+namespace elasticapm::php {
+
+namespace {
+
+constexpr std::string_view whitespaces{" \t\n\r\v\0", 6};
+constexpr std::string_view supportedFormatVersion = "00";
+constexpr std::size_t traceIdSizeInBytes = 16;
+constexpr std::size_t parentIdSizeInBytes = 8;
+constexpr unsigned sampledFlag = 0b00000001;
+
+bool isHexDigit(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+unsigned hexDigitValue(char c) {
+    return static_cast<unsigned>(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+}
+
+bool isValidHexNumber(std::string_view str, std::size_t expectedSizeInBytes) {
+    return str.size() == expectedSizeInBytes * 2 && std::all_of(str.begin(), str.end(), isHexDigit);
+}
+
+bool isAllZeros(std::string_view str) {
+    return std::all_of(str.begin(), str.end(), [](char c) { return c == '0'; });
+}
+
+}
+
+std::optional<bool> parseTraceParentSampledFlag(std::string_view headerValue) {
+    // 00-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-01
+    // version-traceId-parentId-flags
+    auto begin = headerValue.find_first_not_of(whitespaces);
+    if (begin == std::string_view::npos) {
+        return std::nullopt;
+    }
+    headerValue = headerValue.substr(begin, headerValue.find_last_not_of(whitespaces) - begin + 1);
+
+    // future versions can append more parts after a dash - they are kept unsplit in the last element
+    constexpr std::size_t expectedPartsCount = 4;
+    std::array<std::string_view, expectedPartsCount + 1> parts;
+    std::size_t partsCount = 0;
+    for (;;) {
+        auto separatorPos = headerValue.find('-');
+        if (partsCount == parts.size() - 1 || separatorPos == std::string_view::npos) {
+            parts[partsCount++] = headerValue;
+            break;
+        }
+        parts[partsCount++] = headerValue.substr(0, separatorPos);
+        headerValue.remove_prefix(separatorPos + 1);
+    }
+    if (partsCount < expectedPartsCount) {
+        return std::nullopt;
+    }
+
+    std::string_view version = parts[0];
+    if (!isValidHexNumber(version, 1) || (hexDigitValue(version[0]) == 0xF && hexDigitValue(version[1]) == 0xF)) {
+        return std::nullopt; // version ff is forbidden
+    }
+    if (version == supportedFormatVersion && partsCount != expectedPartsCount) {
+        return std::nullopt;
+    }
+
+    if (!isValidHexNumber(parts[1], traceIdSizeInBytes) || isAllZeros(parts[1])) {
+        return std::nullopt;
+    }
+    if (!isValidHexNumber(parts[2], parentIdSizeInBytes) || isAllZeros(parts[2])) {
+        return std::nullopt;
+    }
+
+    std::string_view flags = parts[3];
+    if (!isValidHexNumber(flags, 1)) {
+        return std::nullopt;
+    }
+    return ((hexDigitValue(flags[0]) << 4 | hexDigitValue(flags[1])) & sampledFlag) != 0;
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+namespace elasticapm::php {
+
+/**
+ * Returns sampled flag of W3C traceparent HTTP header or std::nullopt if the header is not valid.
+ *
+ * Validation follows PHP part's HttpDistributedTracing::parseTraceParentHeader()
+ * so that the extension and PHP part agree on whether the transaction continues the incoming trace.
+ *
+ * @link https://www.w3.org/TR/trace-context/#traceparent-header
+ */
+std::optional<bool> parseTraceParentSampledFlag(std::string_view headerValue);
+
+}
@@ -0,0 +1,133 @@
+#include "WildcardListMatcher.h"
+
+#include <algorithm>
+
+namespace elasticapm::php {
+
+namespace {
+
+constexpr std::string_view caseSensitivePrefix = "(?-i)";
+constexpr char wildcard = '*';
+// the same characters as PHP's trim() strips by default
+constexpr std::string_view whitespaces = " \t\n\r\v";
+
+std::string_view trim(std::string_view str) {
+    auto isWhitespace = [](char c) { return c == '\0' || whitespaces.find(c) != std::string_view::npos; };
+    while (!str.empty() && isWhitespace(str.front())) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && isWhitespace(str.back())) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+char toLowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool areEqual(std::string_view str1, std::string_view str2, bool isCaseSensitive) {
+    if (isCaseSensitive) {
+        return str1 == str2;
+    }
+    return std::equal(str1.begin(), str1.end(), str2.begin(), str2.end(), [](char c1, char c2) { return toLowerAscii(c1) == toLowerAscii(c2); });
+}
+
+std::size_t findSubString(std::string_view haystack, std::string_view needle, std::size_t offset, bool isCaseSensitive) {
+    if (isCaseSensitive) {
+        return haystack.find(needle, offset);
+    }
+    if (offset > haystack.size() || haystack.size() - offset < needle.size()) {
+        return std::string_view::npos;
+    }
+    for (std::size_t pos = offset; pos + needle.size() <= haystack.size(); ++pos) {
+        if (areEqual(haystack.substr(pos, needle.size()), needle, false)) {
+            return pos;
+        }
+    }
+    return std::string_view::npos;
+}
+
+}
+
+WildcardListMatcher::WildcardListMatcher(std::string_view wildcardExprs) {
+    for (;;) {
+        auto separatorPos = wildcardExprs.find(',');
+        matchers_.push_back(parseExpr(trim(wildcardExprs.substr(0, separatorPos))));
+        if (separatorPos == std::string_view::npos) {
+            break;
+        }
+        wildcardExprs.remove_prefix(separatorPos + 1);
+    }
+}
+
+std::optional<std::size_t> WildcardListMatcher::match(std::string_view text) const {
+    for (std::size_t i = 0; i < matchers_.size(); ++i) {
+        if (matchExpr(matchers_[i], text)) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+WildcardListMatcher::matcher_t WildcardListMatcher::parseExpr(std::string_view expr) {
+    matcher_t matcher;
+    matcher.isCaseSensitive = expr.starts_with(caseSensitivePrefix);
+    if (matcher.isCaseSensitive) {
+        expr.remove_prefix(caseSensitivePrefix.size());
+    }
+
+    bool lastPartWasWildcard = false;
+    while (!expr.empty()) {
+        if (expr.front() == wildcard) {
+            lastPartWasWildcard = true;
+            if (matcher.literalParts.empty()) {
+                matcher.startsWithWildcard = true;
+            }
+            expr.remove_prefix(1);
+            continue;
+        }
+
+        lastPartWasWildcard = false;
+        auto literalPart = expr.substr(0, expr.find(wildcard));
+        matcher.literalParts.emplace_back(literalPart);
+        expr.remove_prefix(literalPart.size());
+    }
+    matcher.endsWithWildcard = lastPartWasWildcard;
+    return matcher;
+}
+
+bool WildcardListMatcher::matchExpr(matcher_t const &matcher, std::string_view text) {
+    auto const &parts = matcher.literalParts;
+    if (!matcher.startsWithWildcard && parts.empty() && !text.empty()) {
+        return false;
+    }
+
+    bool allowAnyPrefix = matcher.startsWithWildcard;
+    std::size_t textPos = 0;
+    std::size_t partsToCheckInLoop = parts.size();
+    if (partsToCheckInLoop > 0 && !matcher.endsWithWildcard) {
+        --partsToCheckInLoop;
+    }
+    for (std::size_t i = 0; i < partsToCheckInLoop; ++i) {
+        auto matchPos = findSubString(text, parts[i], textPos, matcher.isCaseSensitive);
+        if (matchPos == std::string_view::npos || (!allowAnyPrefix && matchPos != textPos)) {
+            return false;
+        }
+        // the same as PHP part - continues right after the expected position even if the part was found further
+        textPos += parts[i].size();
+        allowAnyPrefix = true;
+    }
+
+    if (partsToCheckInLoop < parts.size()) {
+        std::string_view lastPart = parts.back();
+        if (!matcher.startsWithWildcard && parts.size() == 1) {
+            return areEqual(lastPart, text, matcher.isCaseSensitive);
+        }
+        return lastPart.size() <= text.size() && areEqual(lastPart, text.substr(text.size() - lastPart.size()), matcher.isCaseSensitive);
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace elasticapm::php {
+
+/**
+ * Matches text against comma separated list of wildcard expressions (e.g. transaction_ignore_urls configuration option).
+ *
+ * It follows PHP part's WildcardListMatcher so that the decision made natively is the same as the one PHP part would make:
+ * '*' matches any sequence of characters (including an empty one), elements of the list are trimmed
+ * and matching is case insensitive unless the expression starts with "(?-i)".
+ */
+class WildcardListMatcher {
+public:
+    explicit WildcardListMatcher(std::string_view wildcardExprs);
+
+    // Returns index of the first expression in the list that matches the text
+    std::optional<std::size_t> match(std::string_view text) const;
+
+    std::size_t size() const {
+        return matchers_.size();
+    }
+
+private:
+    struct matcher_t {
+        bool isCaseSensitive = false;
+        bool startsWithWildcard = false;
+        bool endsWithWildcard = false;
+        std::vector<std::string> literalParts;
+    };
+
+    static matcher_t parseExpr(std::string_view expr);
+    static bool matchExpr(matcher_t const &matcher, std::string_view text);
+
+    std::vector<matcher_t> matchers_;
+};
+
+}
@@ -0,0 +1,117 @@
+#include "AstInstrumentationRule.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace elasticapm::php {
+
+namespace {
+
+std::vector<std::string> splitRules(std::string_view rulesConfig) {
+    std::vector<std::string> rules;
+    forEachAstInstrumentationRule(rulesConfig, [&](std::string_view rule) { rules.emplace_back(rule); });
+    return rules;
+}
+
+std::optional<std::vector<bool>> parseCapturedArgs(std::string_view indices) {
+    auto rule = parseAstInstrumentationRule("file.php|||func|" + std::string(indices) + "|app");
+    if (!rule) {
+        return std::nullopt;
+    }
+    return rule->capturedArgs;
+}
+
+}
+
+TEST(AstInstrumentationRuleTest, ParsesMethodRule) {
+    auto rule = parseAstInstrumentationRule("src/Kernel/HttpKernel.php|App\\Kernel|HttpKernel|handle|0|app");
+    ASSERT_TRUE(rule);
+    EXPECT_EQ(rule->fileSuffix, "src/Kernel/HttpKernel.php");
+    EXPECT_EQ(rule->nameSpace, "App\\Kernel");
+    EXPECT_EQ(rule->className, "HttpKernel");
+    EXPECT_EQ(rule->functionName, "handle");
+    EXPECT_EQ(rule->capturedArgs, std::vector<bool>({true}));
+    EXPECT_EQ(rule->spanType, "app");
+}
+
+TEST(AstInstrumentationRuleTest, ParsesStandaloneFunctionRuleWithEmptyFields) {
+    auto rule = parseAstInstrumentationRule("lib/helpers.php|||render_view||");
+    ASSERT_TRUE(rule);
+    EXPECT_EQ(rule->fileSuffix, "lib/helpers.php");
+    EXPECT_EQ(rule->nameSpace, "");
+    EXPECT_EQ(rule->className, "");
+    EXPECT_EQ(rule->functionName, "render_view");
+    EXPECT_TRUE(rule->capturedArgs.empty());
+    // span type defaults to app
+    EXPECT_EQ(rule->spanType, "app");
+}
+
+TEST(AstInstrumentationRuleTest, TrimsFieldsAndLeadingNamespaceBackslash) {
+    auto rule = parseAstInstrumentationRule(" a.php | \\App\\Util |  | format\t| 1 , 0 | template ");
+    ASSERT_TRUE(rule);
+    EXPECT_EQ(rule->fileSuffix, "a.php");
+    EXPECT_EQ(rule->nameSpace, "App\\Util");
+    EXPECT_EQ(rule->className, "");
+    EXPECT_EQ(rule->functionName, "format");
+    EXPECT_EQ(rule->capturedArgs, std::vector<bool>({true, true}));
+    EXPECT_EQ(rule->spanType, "template");
+}
+
+TEST(AstInstrumentationRuleTest, ParsesCapturedArgIndices) {
+    EXPECT_EQ(parseCapturedArgs(""), std::vector<bool>());
+    EXPECT_EQ(parseCapturedArgs("0"), std::vector<bool>({true}));
+    EXPECT_EQ(parseCapturedArgs("2"), std::vector<bool>({false, false, true}));
+    EXPECT_EQ(parseCapturedArgs("3,1"), std::vector<bool>({false, true, false, true}));
+    // duplicates, empty entries and trailing comma are tolerated
+    EXPECT_EQ(parseCapturedArgs("1,1,,"), std::vector<bool>({false, true}));
+    EXPECT_EQ(parseCapturedArgs("007"), std::vector<bool>({false, false, false, false, false, false, false, true}));
+    EXPECT_EQ(parseCapturedArgs("63")->size(), AstInstrumentationRule::maxCapturedArgIndex + 1);
+
+    EXPECT_EQ(parseCapturedArgs("64"), std::nullopt);
+    EXPECT_EQ(parseCapturedArgs("99999999999999999999999"), std::nullopt);
+    EXPECT_EQ(parseCapturedArgs("-1"), std::nullopt);
+    EXPECT_EQ(parseCapturedArgs("1;2"), std::nullopt);
+    EXPECT_EQ(parseCapturedArgs("a"), std::nullopt);
+    EXPECT_EQ(parseCapturedArgs("1 2"), std::nullopt);
+}
+
+TEST(AstInstrumentationRuleTest, RejectsMalformedRules) {
+    std::string error;
+
+    EXPECT_EQ(parseAstInstrumentationRule("", &error), std::nullopt);
+    EXPECT_EQ(error, "Expected 6 fields but found 1");
+    EXPECT_EQ(parseAstInstrumentationRule("a.php|||func|0", &error), std::nullopt);
+    EXPECT_EQ(error, "Expected 6 fields but found 5");
+    EXPECT_EQ(parseAstInstrumentationRule("a.php|||func|0|app|extra", &error), std::nullopt);
+    EXPECT_EQ(error, "Expected 6 fields but found 7");
+
+    EXPECT_EQ(parseAstInstrumentationRule("|App|Cls|func|0|app", &error), std::nullopt);
+    EXPECT_EQ(error, "File path suffix is required");
+    EXPECT_EQ(parseAstInstrumentationRule("a.php|App|Cls| |0|app", &error), std::nullopt);
+    EXPECT_EQ(error, "Method/function name is required");
+    EXPECT_EQ(parseAstInstrumentationRule("a.php|App|Cls|func|x|app", &error), std::nullopt);
+    EXPECT_EQ(error, "Captured arg indices should be comma separated integers not greater than 63");
+
+    // error is optional
+    EXPECT_EQ(parseAstInstrumentationRule("a.php"), std::nullopt);
+}
+
+TEST(AstInstrumentationRuleTest, SplitsRulesConfig) {
+    EXPECT_EQ(splitRules(""), std::vector<std::string>());
+    EXPECT_EQ(splitRules(" ; ;\n"), std::vector<std::string>());
+    EXPECT_EQ(splitRules("a.php|||f||"), std::vector<std::string>({"a.php|||f||"}));
+    EXPECT_EQ(splitRules(" a.php|||f|| ;\n\tb.php||C|m|0|db; "), std::vector<std::string>({"a.php|||f||", "b.php||C|m|0|db"}));
+
+    // one malformed rule does not affect the others
+    std::vector<std::string> validFunctions;
+    forEachAstInstrumentationRule("a.php|||f1||;broken;b.php|||f2|x|;c.php|||f3|1|", [&](std::string_view ruleAsString) {
+        if (auto rule = parseAstInstrumentationRule(ruleAsString)) {
+            validFunctions.push_back(rule->functionName);
+        }
+    });
+    EXPECT_EQ(validFunctions, std::vector<std::string>({"f1", "f3"}));
+}
+
+}
@@ -65,6 +65,18 @@ TEST_F(InferredSpansTest, TryInterruptOnlyOnce) {
     inferredSpans_.tryRequestInterrupt(std::chrono::time_point_cast<std::chrono::milliseconds>(InferredSpans::clock_t::now()));
 }
 
+TEST_F(InferredSpansTest, DontInterruptWhenNotPeriodicTaskDriven) {
+    inferredSpans_.setInterval(1ms);
+    inferredSpans_.setPeriodicTaskDriven(false);
+    std::this_thread::sleep_for(2ms);
+
+    EXPECT_CALL(interruptFuncMock_, interruptFunction()).Times(::testing::Exactly(0));
+    inferredSpans_.tryRequestInterrupt(std::chrono::time_point_cast<std::chrono::milliseconds>(InferredSpans::clock_t::now()));
+
+    EXPECT_CALL(attachInferredSpansFuncMock_, attachInferredSpansOnPhp(::testing::_, ::testing::_)).Times(::testing::Exactly(0));
+    inferredSpans_.attachBacktraceIfInterrupted();
+}
+
 TEST_F(InferredSpansTest, DontInterruptBeforeInterval) {
     inferredSpans_.setInterval(1ms);
     std::this_thread::sleep_for(2ms);
@@ -112,6 +124,72 @@ TEST_F(InferredSpansTest, DontInterruptAfterIntervalIfSpansNotAttachedYet) {
     inferredSpans_.tryRequestInterrupt(std::chrono::time_point_cast<std::chrono::milliseconds>(InferredSpans::clock_t::now()));
 }
 
+TEST_F(InferredSpansTest, InterruptFromSignalHandlerOnlyOnceUntilAttached) {
+    ::testing::InSequence s;
+    EXPECT_CALL(interruptFuncMock_, interruptFunction()).Times(::testing::Exactly(1));
+    inferredSpans_.requestInterruptFromSignalHandler();
+    inferredSpans_.requestInterruptFromSignalHandler();
+
+    EXPECT_CALL(attachInferredSpansFuncMock_, attachInferredSpansOnPhp(::testing::_, ::testing::_)).Times(::testing::Exactly(1));
+    inferredSpans_.attachBacktraceIfInterrupted();
 
+    EXPECT_CALL(interruptFuncMock_, interruptFunction()).Times(::testing::Exactly(1));
+    inferredSpans_.requestInterruptFromSignalHandler();
 }
 
+TEST_F(InferredSpansTest, AdaptsIntervalToOverheadBudget) {
+    inferredSpans_.setInterval(1ms);
+    inferredSpans_.setOverheadBudget(/* budget */ 0.01, /* maxInterval */ 10s);
+    inferredSpans_.reset();
+
+    EXPECT_CALL(interruptFuncMock_, interruptFunction()).Times(::testing::Exactly(2));
+    EXPECT_CALL(attachInferredSpansFuncMock_, attachInferredSpansOnPhp(::testing::_, ::testing::_)).Times(::testing::Exactly(2)).WillRepeatedly([](auto, auto) {
+        std::this_thread::sleep_for(2ms);
+    });
+    for (int i = 0; i < 2; ++i) {
+        inferredSpans_.requestInterruptFromSignalHandler();
+        inferredSpans_.attachBacktraceIfInterrupted();
+    }
+
+    EXPECT_EQ(inferredSpans_.getSamplesCount(), 2u);
+    EXPECT_GE(inferredSpans_.getSamplingTime(), 4ms);
+    EXPECT_GT(inferredSpans_.getOverhead(InferredSpans::clock_t::now()), 0);
+
+    // sample costs at least 2ms so it takes at least 200ms interval to stay within 1%
+    inferredSpans_.adaptInterval();
+    EXPECT_GE(inferredSpans_.getInterval(), 200ms);
+    EXPECT_LE(inferredSpans_.getInterval(), 10s);
+
+    inferredSpans_.reset();
+    EXPECT_EQ(inferredSpans_.getSamplesCount(), 0u);
+    EXPECT_GE(inferredSpans_.getInterval(), 200ms);
+
+    inferredSpans_.setOverheadBudget(/* budget */ 0, /* maxInterval */ 10s);
+    EXPECT_EQ(inferredSpans_.getInterval(), 1ms);
+}
+
+TEST_F(InferredSpansTest, AdaptedIntervalIsBoundedByMaxAndConfiguredInterval) {
+    inferredSpans_.setInterval(50ms);
+    inferredSpans_.setOverheadBudget(/* budget */ 0.0001, /* maxInterval */ 100ms);
+    inferredSpans_.reset();
+
+    EXPECT_CALL(interruptFuncMock_, interruptFunction()).Times(::testing::Exactly(1));
+    EXPECT_CALL(attachInferredSpansFuncMock_, attachInferredSpansOnPhp(::testing::_, ::testing::_)).Times(::testing::Exactly(1)).WillOnce([](auto, auto) {
+        std::this_thread::sleep_for(1ms);
+    });
+    inferredSpans_.requestInterruptFromSignalHandler();
+    inferredSpans_.attachBacktraceIfInterrupted();
+
+    inferredSpans_.adaptInterval();
+    EXPECT_EQ(inferredSpans_.getInterval(), 100ms);
+
+    // without samples there is nothing to adapt to
+    inferredSpans_.reset();
+    inferredSpans_.adaptInterval();
+    EXPECT_EQ(inferredSpans_.getInterval(), 100ms);
+
+    inferredSpans_.setInterval(500ms);
+    EXPECT_EQ(inferredSpans_.getInterval(), 500ms);
+}
+
+}
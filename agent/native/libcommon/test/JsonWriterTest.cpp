@@ -0,0 +1,69 @@
+#include "JsonWriter.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+
+namespace elasticapm::php {
+
+namespace {
+
+std::string toJsonString(std::string_view value) {
+    std::string buffer;
+    JsonWriter(buffer).appendString(value);
+    return buffer;
+}
+
+std::string toJsonDouble(double value) {
+    std::string buffer;
+    EXPECT_TRUE(JsonWriter(buffer).appendDouble(value));
+    return buffer;
+}
+
+}
+
+TEST(JsonWriterTest, EscapesStringsAsJsonEncode) {
+    EXPECT_EQ(toJsonString(""), R"("")");
+    EXPECT_EQ(toJsonString("GET /users?id=1"), R"("GET \/users?id=1")");
+    EXPECT_EQ(toJsonString("\"quoted\" \\ \b\f\n\r\t"), R"("\"quoted\" \\ \b\f\n\r\t")");
+    EXPECT_EQ(toJsonString(std::string_view("\x00\x1f\x7f", 3)), "\"\\u0000\\u001f\x7f\"");
+    EXPECT_EQ(toJsonString("caf\xc3\xa9 \xe2\x82\xac"), R"("caf\u00e9 \u20ac")");
+    EXPECT_EQ(toJsonString("\xf0\x9f\x98\x80"), R"("\ud83d\ude00")");
+}
+
+TEST(JsonWriterTest, SubstitutesInvalidUtf8) {
+    EXPECT_EQ(toJsonString("a\xff" "b"), R"("a\ufffdb")");
+    // overlong encoding of '/'
+    EXPECT_EQ(toJsonString("\xc0\xaf"), R"("\ufffd\ufffd")");
+    // truncated sequence followed by ASCII
+    EXPECT_EQ(toJsonString("\xe2\x82" "a"), R"("\ufffda")");
+    EXPECT_EQ(toJsonString("\xe2\x82"), R"("\ufffd")");
+    // encoded surrogate
+    EXPECT_EQ(toJsonString("\xed\xa0\x80"), R"("\ufffd")");
+}
+
+TEST(JsonWriterTest, FormatsNumbersAsJsonEncode) {
+    std::string buffer;
+    JsonWriter writer(buffer);
+    writer.appendInt(std::numeric_limits<int64_t>::min());
+    EXPECT_EQ(buffer, "-9223372036854775808");
+
+    EXPECT_EQ(toJsonDouble(0.0), "0");
+    EXPECT_EQ(toJsonDouble(-0.0), "-0");
+    EXPECT_EQ(toJsonDouble(1.0), "1");
+    EXPECT_EQ(toJsonDouble(0.1), "0.1");
+    EXPECT_EQ(toJsonDouble(-1.5), "-1.5");
+    EXPECT_EQ(toJsonDouble(123.456), "123.456");
+    EXPECT_EQ(toJsonDouble(0.0001), "0.0001");
+    EXPECT_EQ(toJsonDouble(0.00001), "1.0e-5");
+    EXPECT_EQ(toJsonDouble(1e16), "10000000000000000");
+    EXPECT_EQ(toJsonDouble(1e17), "1.0e+17");
+    EXPECT_EQ(toJsonDouble(1.5e300), "1.5e+300");
+    EXPECT_EQ(toJsonDouble(1712345678.123456), "1712345678.123456");
+
+    EXPECT_FALSE(writer.appendDouble(std::nan("")));
+    EXPECT_FALSE(writer.appendDouble(std::numeric_limits<double>::infinity()));
+}
+
+}
@@ -0,0 +1,57 @@
+#include "PathSuffixIndex.h"
+
+#include <gtest/gtest.h>
+
+namespace elasticapm::php {
+
+TEST(PathSuffixIndexTest, FindsRegisteredSuffix) {
+    PathSuffixIndex index;
+    EXPECT_TRUE(index.empty());
+    EXPECT_EQ(index.findLongestSuffix("/var/www/wp-includes/plugin.php"), std::nullopt);
+
+    index.add("wp-includes/plugin.php", 0);
+    index.add("wp-includes/class-wp-hook.php", 1);
+    index.add("wp-includes/theme.php", 2);
+    EXPECT_EQ(index.size(), 3u);
+
+    EXPECT_EQ(index.findLongestSuffix("/var/www/wp-includes/plugin.php"), 0u);
+    EXPECT_EQ(index.findLongestSuffix("/var/www/wp-includes/class-wp-hook.php"), 1u);
+    EXPECT_EQ(index.findLongestSuffix("wp-includes/theme.php"), 2u);
+
+    EXPECT_EQ(index.findLongestSuffix("/var/www/wp-content/plugin.php"), std::nullopt);
+    EXPECT_EQ(index.findLongestSuffix("/var/www/wp-includes/plugin.php.bak"), std::nullopt);
+    EXPECT_EQ(index.findLongestSuffix("includes/plugin.php"), std::nullopt);
+    EXPECT_EQ(index.findLongestSuffix(""), std::nullopt);
+}
+
+TEST(PathSuffixIndexTest, MatchesPlainStringSuffix) {
+    PathSuffixIndex index;
+    index.add("Kernel.php", 7);
+
+    // the same semantics as plain string suffix check - suffix does not have to start at directory separator
+    EXPECT_EQ(index.findLongestSuffix("/app/src/HttpKernel.php"), 7u);
+    EXPECT_EQ(index.findLongestSuffix("/app/src/Kernel.php"), 7u);
+}
+
+TEST(PathSuffixIndexTest, PrefersLongestSuffix) {
+    PathSuffixIndex index;
+    index.add("Kernel.php", 1);
+    index.add("src/Kernel.php", 2);
+
+    EXPECT_EQ(index.findLongestSuffix("/app/src/Kernel.php"), 2u);
+    EXPECT_EQ(index.findLongestSuffix("/app/lib/Kernel.php"), 1u);
+}
+
+TEST(PathSuffixIndexTest, ReplacesValueAndClears) {
+    PathSuffixIndex index;
+    index.add("a/b.php", 1);
+    index.add("a/b.php", 2);
+    EXPECT_EQ(index.size(), 1u);
+    EXPECT_EQ(index.findLongestSuffix("/x/a/b.php"), 2u);
+
+    index.clear();
+    EXPECT_TRUE(index.empty());
+    EXPECT_EQ(index.findLongestSuffix("/x/a/b.php"), std::nullopt);
+}
+
+}
@@ -90,5 +90,95 @@ TEST(PeriodicTaskExecutorTest, simpleRun) {
 
 
 
+TEST(PeriodicTaskExecutorTest, independentIntervals) {
+    std::atomic_int fastCounter = 0;
+    std::atomic_int slowCounter = 0;
+
+    {
+        PeriodicTaskExecutor periodicTaskExecutor_{{}};
+        periodicTaskExecutor_.addPeriodicTask([&fastCounter](PeriodicTaskExecutor::time_point_t) { fastCounter++; }, 10ms);
+        periodicTaskExecutor_.addPeriodicTask([&slowCounter](PeriodicTaskExecutor::time_point_t) { slowCounter++; }, 50ms);
+        periodicTaskExecutor_.resumePeriodicTasks();
+        std::this_thread::sleep_for(125ms);
+    }
+
+    // should be 12 and 2 in ideal world - lower bounds are loose because the thread can be starved on a loaded machine
+    ASSERT_GE(fastCounter.load(), 6);
+    ASSERT_LE(fastCounter.load(), 13);
+    ASSERT_GE(slowCounter.load(), 1);
+    ASSERT_LE(slowCounter.load(), 3);
+    ASSERT_GT(fastCounter.load(), slowCounter.load());
+}
+
+TEST(PeriodicTaskExecutorTest, oneShotTaskRunsOnce) {
+    std::atomic_int counter = 0;
+    PeriodicTaskExecutor periodicTaskExecutor_{{}};
+    periodicTaskExecutor_.resumePeriodicTasks();
+
+    auto taskId = periodicTaskExecutor_.addOneShotTask([&counter](PeriodicTaskExecutor::time_point_t) { counter++; }, 10ms);
+    std::this_thread::sleep_for(60ms);
+
+    ASSERT_EQ(counter.load(), 1);
+    ASSERT_FALSE(periodicTaskExecutor_.getTaskStats(taskId).has_value());
+    ASSERT_FALSE(periodicTaskExecutor_.removeTask(taskId));
+}
+
+TEST(PeriodicTaskExecutorTest, removedAndDisabledTasksDoNotRun) {
+    std::atomic_int removedCounter = 0;
+    std::atomic_int disabledCounter = 0;
+    PeriodicTaskExecutor periodicTaskExecutor_{{}};
+    auto removedTaskId = periodicTaskExecutor_.addPeriodicTask([&removedCounter](PeriodicTaskExecutor::time_point_t) { removedCounter++; }, 10ms);
+    auto disabledTaskId = periodicTaskExecutor_.addPeriodicTask([&disabledCounter](PeriodicTaskExecutor::time_point_t) { disabledCounter++; }, 10ms);
+
+    ASSERT_TRUE(periodicTaskExecutor_.removeTask(removedTaskId));
+    ASSERT_TRUE(periodicTaskExecutor_.setTaskEnabled(disabledTaskId, false));
+    periodicTaskExecutor_.resumePeriodicTasks();
+    std::this_thread::sleep_for(50ms);
+
+    ASSERT_EQ(removedCounter.load(), 0);
+    ASSERT_EQ(disabledCounter.load(), 0);
+
+    ASSERT_TRUE(periodicTaskExecutor_.setTaskEnabled(disabledTaskId, true));
+    std::this_thread::sleep_for(35ms);
+    ASSERT_GE(disabledCounter.load(), 2);
+}
+
+TEST(PeriodicTaskExecutorTest, accountsTaskRuntime) {
+    PeriodicTaskExecutor periodicTaskExecutor_{{}};
+    auto taskId = periodicTaskExecutor_.addPeriodicTask([](PeriodicTaskExecutor::time_point_t) { std::this_thread::sleep_for(2ms); }, 10ms);
+    periodicTaskExecutor_.resumePeriodicTasks();
+    std::this_thread::sleep_for(55ms);
+
+    auto stats = periodicTaskExecutor_.getTaskStats(taskId);
+    ASSERT_TRUE(stats.has_value());
+    ASSERT_GE(stats->runsCount, 3u);
+    ASSERT_GE(stats->totalRuntime, stats->runsCount * 2ms);
+    ASSERT_GE(stats->maxRuntime, 2ms);
+    ASSERT_GE(stats->lastRuntime, 2ms);
 }
 
+TEST(PeriodicTaskExecutorTest, jitterDelaysRunsWithinBounds) {
+    std::mutex mutex;
+    std::vector<PeriodicTaskExecutor::time_point_t> runTimes;
+
+    PeriodicTaskExecutor periodicTaskExecutor_{{}};
+    auto start = std::chrono::time_point_cast<std::chrono::milliseconds>(PeriodicTaskExecutor::clock_t::now());
+    periodicTaskExecutor_.addPeriodicTask([&](PeriodicTaskExecutor::time_point_t now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        runTimes.push_back(now);
+    }, 20ms, 10ms);
+    periodicTaskExecutor_.resumePeriodicTasks();
+    std::this_thread::sleep_for(105ms);
+    periodicTaskExecutor_.suspendPeriodicTasks();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_GE(runTimes.size(), 3u);
+    for (std::size_t index = 0; index < runTimes.size(); ++index) {
+        // nominal deadlines stay on the 20ms grid - jitter only delays each of them
+        auto nominal = start + 20ms * (index + 1);
+        ASSERT_GE(runTimes[index], nominal);
+        ASSERT_LE(runTimes[index], nominal + 10ms + 8ms); // 8ms of scheduling slack
+    }
+}
+
+}
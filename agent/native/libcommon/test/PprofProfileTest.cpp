@@ -0,0 +1,176 @@
+#include "PprofProfile.h"
+
+#include <gtest/gtest.h>
+#include <map>
+
+namespace elasticapm::php {
+
+namespace {
+
+// Decodes single level of protobuf message - varint fields as numbers, length delimited ones as raw bytes
+struct decodedMessage_t {
+    std::multimap<uint64_t, uint64_t> varints;
+    std::multimap<uint64_t, std::string> bytes;
+};
+
+uint64_t readVarint(std::string_view &in) {
+    uint64_t value = 0;
+    for (int shift = 0; !in.empty(); shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(in.front());
+        in.remove_prefix(1);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    return value;
+}
+
+decodedMessage_t decode(std::string_view in) {
+    decodedMessage_t message;
+    while (!in.empty()) {
+        uint64_t tag = readVarint(in);
+        if ((tag & 7) == 0) {
+            message.varints.emplace(tag >> 3, readVarint(in));
+        } else {
+            uint64_t length = readVarint(in);
+            message.bytes.emplace(tag >> 3, std::string(in.substr(0, length)));
+            in.remove_prefix(length);
+        }
+    }
+    return message;
+}
+
+std::vector<uint64_t> decodePacked(std::string_view in) {
+    std::vector<uint64_t> values;
+    while (!in.empty()) {
+        values.push_back(readVarint(in));
+    }
+    return values;
+}
+
+template <typename T>
+std::vector<T> getAll(std::multimap<uint64_t, T> const &fields, uint64_t field) {
+    std::vector<T> values;
+    auto [begin, end] = fields.equal_range(field);
+    for (auto it = begin; it != end; ++it) {
+        values.push_back(it->second);
+    }
+    return values;
+}
+
+}
+
+TEST(PprofProfileTest, AggregatesSameStacks) {
+    PprofProfile profile(/* maxStacks */ 10, /* maxFramesPerStack */ 10);
+
+    PprofProfile::frame_t stackA[] = {{"Foo::bar", "/app/Foo.php", 10}, {"main", "/app/index.php", 3}};
+    PprofProfile::frame_t stackB[] = {{"Foo::baz", "/app/Foo.php", 20}, {"main", "/app/index.php", 3}};
+
+    EXPECT_TRUE(profile.addSample(stackA, 1000));
+    EXPECT_TRUE(profile.addSample(stackA, 1000));
+    EXPECT_TRUE(profile.addSample(stackB, 1000));
+
+    EXPECT_EQ(profile.getStacksCount(), 2u);
+    EXPECT_EQ(profile.getSamplesCount(), 3u);
+    EXPECT_EQ(profile.getDroppedSamplesCount(), 0u);
+}
+
+TEST(PprofProfileTest, DropsSamplesAboveStacksLimit) {
+    PprofProfile profile(/* maxStacks */ 1, /* maxFramesPerStack */ 10);
+
+    PprofProfile::frame_t stackA[] = {{"a", "/a.php", 1}};
+    PprofProfile::frame_t stackB[] = {{"b", "/b.php", 1}};
+
+    EXPECT_TRUE(profile.addSample(stackA, 1));
+    EXPECT_FALSE(profile.addSample(stackB, 1));
+    EXPECT_TRUE(profile.addSample(stackA, 1));
+
+    EXPECT_EQ(profile.getStacksCount(), 1u);
+    EXPECT_EQ(profile.getSamplesCount(), 2u);
+    EXPECT_EQ(profile.getDroppedSamplesCount(), 1u);
+
+    profile.clear();
+    EXPECT_EQ(profile.getStacksCount(), 0u);
+    EXPECT_EQ(profile.getDroppedSamplesCount(), 0u);
+    EXPECT_TRUE(profile.addSample(stackB, 1));
+}
+
+TEST(PprofProfileTest, DroppedSamplesDoNotGrowStringTable) {
+    PprofProfile profile(/* maxStacks */ 1, /* maxFramesPerStack */ 10);
+
+    PprofProfile::frame_t stackA[] = {{"a", "/a.php", 1}};
+    PprofProfile::frame_t sameFunctionOtherLine[] = {{"a", "/a.php", 2}};
+    PprofProfile::frame_t stackB[] = {{"b", "/b.php", 1}, {"a", "/a.php", 1}};
+
+    EXPECT_TRUE(profile.addSample(stackA, 1));
+    auto stringsCount = profile.getStringsCount();
+
+    EXPECT_FALSE(profile.addSample(sameFunctionOtherLine, 1));
+    EXPECT_FALSE(profile.addSample(stackB, 1));
+    EXPECT_TRUE(profile.addSample(stackA, 1));
+
+    EXPECT_EQ(profile.getStringsCount(), stringsCount);
+    EXPECT_EQ(profile.getSamplesCount(), 2u);
+    EXPECT_EQ(profile.getDroppedSamplesCount(), 2u);
+}
+
+TEST(PprofProfileTest, KeepsInnermostFramesOfDeepStack) {
+    PprofProfile profile(/* maxStacks */ 10, /* maxFramesPerStack */ 2);
+
+    PprofProfile::frame_t deep[] = {{"leaf", "/f.php", 3}, {"middle", "/f.php", 2}, {"root", "/f.php", 1}};
+    PprofProfile::frame_t truncated[] = {{"leaf", "/f.php", 3}, {"middle", "/f.php", 2}};
+
+    profile.addSample(deep, 1);
+    profile.addSample(truncated, 1);
+    EXPECT_EQ(profile.getStacksCount(), 1u);
+}
+
+TEST(PprofProfileTest, SerializesProfile) {
+    PprofProfile profile(/* maxStacks */ 10, /* maxFramesPerStack */ 10);
+
+    PprofProfile::frame_t stack[] = {{"Foo::bar", "/app/Foo.php", 10}, {"main", "/app/index.php", 3}};
+    profile.addSample(stack, 10'000'000);
+    profile.addSample(stack, 10'000'000);
+
+    auto profileMessage = decode(profile.serialize(/* timeNanos */ 123, /* durationNanos */ 456, /* periodNanos */ 10'000'000));
+
+    auto strings = getAll(profileMessage.bytes, 6);
+    ASSERT_FALSE(strings.empty());
+    EXPECT_EQ(strings[0], "");
+
+    auto stringAt = [&strings](uint64_t id) { return id < strings.size() ? strings[id] : std::string{"<invalid>"}; };
+
+    auto sampleTypes = getAll(profileMessage.bytes, 1);
+    ASSERT_EQ(sampleTypes.size(), 2u);
+    auto wallType = decode(sampleTypes[1]);
+    EXPECT_EQ(stringAt(wallType.varints.find(1)->second), "wall");
+    EXPECT_EQ(stringAt(wallType.varints.find(2)->second), "nanoseconds");
+
+    auto samples = getAll(profileMessage.bytes, 2);
+    ASSERT_EQ(samples.size(), 1u);
+    auto sample = decode(samples[0]);
+    auto locationIds = decodePacked(sample.bytes.find(1)->second);
+    EXPECT_EQ(decodePacked(sample.bytes.find(2)->second), (std::vector<uint64_t>{2, 20'000'000}));
+    ASSERT_EQ(locationIds.size(), 2u);
+
+    auto locations = getAll(profileMessage.bytes, 4);
+    auto functions = getAll(profileMessage.bytes, 5);
+    ASSERT_EQ(locations.size(), 2u);
+    ASSERT_EQ(functions.size(), 2u);
+
+    // leaf location resolves to Foo::bar at /app/Foo.php:10
+    auto leafLocation = decode(locations[locationIds[0] - 1]);
+    EXPECT_EQ(leafLocation.varints.find(1)->second, locationIds[0]);
+    auto leafLine = decode(leafLocation.bytes.find(4)->second);
+    EXPECT_EQ(leafLine.varints.find(2)->second, 10u);
+    auto leafFunction = decode(functions[leafLine.varints.find(1)->second - 1]);
+    EXPECT_EQ(stringAt(leafFunction.varints.find(2)->second), "Foo::bar");
+    EXPECT_EQ(stringAt(leafFunction.varints.find(4)->second), "/app/Foo.php");
+
+    EXPECT_EQ(profileMessage.varints.find(9)->second, 123u);
+    EXPECT_EQ(profileMessage.varints.find(10)->second, 456u);
+    EXPECT_EQ(profileMessage.varints.find(12)->second, 10'000'000u);
+}
+
+}
@@ -0,0 +1,47 @@
+#include "SamplingTimer.h"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace elasticapm::php {
+
+static void countSignal(void *context) {
+    static_cast<std::atomic_int *>(context)->fetch_add(1);
+}
+
+static void busyLoop(std::chrono::milliseconds duration) {
+    auto end = std::chrono::steady_clock::now() + duration;
+    volatile uint64_t counter = 0;
+    while (std::chrono::steady_clock::now() < end) {
+        counter = counter + 1;
+    }
+}
+
+TEST(SamplingTimerTest, ThreadCpuTimeClockTicksOnlyOnCpu) {
+    std::atomic_int ticks = 0;
+    SamplingTimer timer(SIGRTMIN + 1, countSignal, &ticks);
+
+    ASSERT_TRUE(timer.start(5ms));
+    std::this_thread::sleep_for(50ms);
+    EXPECT_LE(ticks.load(), 1);
+
+    busyLoop(100ms);
+    timer.stop();
+    int ticksWhenStopped = ticks.load();
+    EXPECT_GT(ticksWhenStopped, 5);
+
+    busyLoop(30ms);
+    EXPECT_LE(ticks.load(), ticksWhenStopped + 1);
+}
+
+TEST(SamplingTimerTest, ZeroIntervalIsRejected) {
+    std::atomic_int ticks = 0;
+    SamplingTimer timer(SIGRTMIN + 1, countSignal, &ticks);
+
+    EXPECT_FALSE(timer.start(0ms));
+}
+
+}
@@ -0,0 +1,30 @@
+#include "TraceContext.h"
+
+#include <gtest/gtest.h>
+
+namespace elasticapm::php {
+
+TEST(TraceContextTest, ParsesSampledFlag) {
+    EXPECT_EQ(parseTraceParentSampledFlag("00-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-01"), true);
+    EXPECT_EQ(parseTraceParentSampledFlag("00-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-00"), false);
+    EXPECT_EQ(parseTraceParentSampledFlag("  00-0AF7651916CD43DD8448EB211C80319C-B9C7C989F97918E1-03 "), true);
+    EXPECT_EQ(parseTraceParentSampledFlag("00-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-02"), false);
+}
+
+TEST(TraceContextTest, AllowsMorePartsInFutureVersions) {
+    EXPECT_EQ(parseTraceParentSampledFlag("01-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-01-whatever"), true);
+    EXPECT_EQ(parseTraceParentSampledFlag("00-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-01-whatever"), std::nullopt);
+}
+
+TEST(TraceContextTest, RejectsInvalidHeaders) {
+    EXPECT_EQ(parseTraceParentSampledFlag(""), std::nullopt);
+    EXPECT_EQ(parseTraceParentSampledFlag("00-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1"), std::nullopt);
+    EXPECT_EQ(parseTraceParentSampledFlag("ff-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-01"), std::nullopt);
+    EXPECT_EQ(parseTraceParentSampledFlag("0-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-01"), std::nullopt);
+    EXPECT_EQ(parseTraceParentSampledFlag("00-00000000000000000000000000000000-b9c7c989f97918e1-01"), std::nullopt);
+    EXPECT_EQ(parseTraceParentSampledFlag("00-0af7651916cd43dd8448eb211c80319c-0000000000000000-01"), std::nullopt);
+    EXPECT_EQ(parseTraceParentSampledFlag("00-0af7651916cd43dd8448eb211c80319x-b9c7c989f97918e1-01"), std::nullopt);
+    EXPECT_EQ(parseTraceParentSampledFlag("00-0af7651916cd43dd8448eb211c80319c-b9c7c989f97918e1-1"), std::nullopt);
+}
+
+}
@@ -0,0 +1,44 @@
+#include "WildcardListMatcher.h"
+
+#include <gtest/gtest.h>
+
+namespace elasticapm::php {
+
+TEST(WildcardListMatcherTest, MatchesWildcardExpressions) {
+    WildcardListMatcher matcher("/health, *.css ,/static/*, /api/*/status*");
+    EXPECT_EQ(matcher.size(), 4u);
+
+    EXPECT_EQ(matcher.match("/health"), 0u);
+    EXPECT_EQ(matcher.match("/healthz"), std::nullopt);
+    EXPECT_EQ(matcher.match("/assets/site.css"), 1u);
+    EXPECT_EQ(matcher.match("/static/"), 2u);
+    EXPECT_EQ(matcher.match("/static/img/logo.png"), 2u);
+    EXPECT_EQ(matcher.match("/api/v1/status"), 3u);
+    EXPECT_EQ(matcher.match("/api/v1/statuses"), 3u);
+    EXPECT_EQ(matcher.match("/api/v1/users"), std::nullopt);
+}
+
+TEST(WildcardListMatcherTest, IsCaseInsensitiveByDefault) {
+    WildcardListMatcher matcher("/Health*,(?-i)/Ping");
+
+    EXPECT_EQ(matcher.match("/HEALTH/live"), 0u);
+    EXPECT_EQ(matcher.match("/Ping"), 1u);
+    EXPECT_EQ(matcher.match("/ping"), std::nullopt);
+}
+
+TEST(WildcardListMatcherTest, HandlesEmptyAndWildcardOnlyExpressions) {
+    WildcardListMatcher empty("");
+    EXPECT_EQ(empty.size(), 1u);
+    EXPECT_EQ(empty.match(""), 0u);
+    EXPECT_EQ(empty.match("/"), std::nullopt);
+
+    WildcardListMatcher any("*");
+    EXPECT_EQ(any.match(""), 0u);
+    EXPECT_EQ(any.match("/anything"), 0u);
+
+    WildcardListMatcher infix("*/admin/*");
+    EXPECT_EQ(infix.match("/site/admin/users"), 0u);
+    EXPECT_EQ(infix.match("/site/administrator"), std::nullopt);
+}
+
+}
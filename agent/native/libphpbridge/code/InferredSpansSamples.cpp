@@ -0,0 +1,223 @@
+/*
+ * Copyright Elasticsearch B.V. and/or licensed to Elasticsearch B.V. under one
+ * or more contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "InferredSpansSamples.h"
+
+#include <Zend/zend_API.h>
+#include <Zend/zend_string.h>
+
+#include <algorithm>
+
+namespace elasticapm::php {
+
+static std::size_t buildIndexSize(std::size_t maxInternedFrames) {
+    // power of two at least twice the capacity keeps probe sequences short
+    std::size_t size = 16;
+    while (size < maxInternedFrames * 2) {
+        size <<= 1;
+    }
+    return size;
+}
+
+InferredSpansSamples::InferredSpansSamples(std::size_t maxSamples, std::size_t maxFrames, std::size_t maxFramesPerSample, std::size_t maxInternedFrames) : samples_(maxSamples), frameIds_(maxFrames), internedFrames_(maxInternedFrames), internedFramesIndex_(buildIndexSize(maxInternedFrames)), maxFramesPerSample_(maxFramesPerSample) {
+}
+
+InferredSpansSamples::~InferredSpansSamples() {
+    clear();
+}
+
+static zend_string *addRefIfNotNull(zend_string *str) {
+    if (str) {
+        zend_string_addref(str);
+    }
+    return str;
+}
+
+static void releaseIfNotNull(zend_string *str) {
+    if (str) {
+        zend_string_release(str);
+    }
+}
+
+// Strings are compared by identity - frames of the same function reference the same zend_string instances
+static std::size_t hashFrame(zend_string *file, uint32_t line, zend_string *className, zend_string *function, bool isStaticMethod) {
+    uint64_t hash = reinterpret_cast<uintptr_t>(function);
+    hash = hash * 31 + reinterpret_cast<uintptr_t>(className);
+    hash = hash * 31 + reinterpret_cast<uintptr_t>(file);
+    hash = hash * 31 + line;
+    hash = hash * 2 + (isStaticMethod ? 1 : 0);
+    return static_cast<std::size_t>((hash * 0x9e3779b97f4a7c15ULL) >> 32);
+}
+
+uint32_t InferredSpansSamples::internFrame(zend_execute_data *executeData, zend_function *func) {
+    zend_string *function = func->common.function_name;
+    zend_string *className = func->common.scope ? func->common.scope->name : nullptr;
+    bool isStaticMethod = func->common.scope && (func->common.fn_flags & ZEND_ACC_STATIC);
+    zend_string *file = nullptr;
+    uint32_t line = 0;
+    if (ZEND_USER_CODE(func->type)) {
+        file = func->op_array.filename;
+        line = executeData->opline ? executeData->opline->lineno : 0;
+    }
+
+    std::size_t mask = internedFramesIndex_.size() - 1;
+    for (std::size_t slot = hashFrame(file, line, className, function, isStaticMethod) & mask;; slot = (slot + 1) & mask) {
+        uint32_t entry = internedFramesIndex_[slot];
+        if (entry == 0) {
+            // capture checked there is room for all the frames of the sample
+            uint32_t id = static_cast<uint32_t>(internedFramesCount_++);
+            frame_t &frame = internedFrames_[id];
+            frame.file = addRefIfNotNull(file);
+            frame.line = line;
+            frame.className = addRefIfNotNull(className);
+            frame.function = addRefIfNotNull(function);
+            frame.isStaticMethod = isStaticMethod;
+            internedFramesIndex_[slot] = id + 1;
+            return id;
+        }
+
+        frame_t const &frame = internedFrames_[entry - 1];
+        if (frame.function == function && frame.className == className && frame.file == file && frame.line == line && frame.isStaticMethod == isStaticMethod) {
+            return entry - 1;
+        }
+    }
+}
+
+bool InferredSpansSamples::capture(zend_execute_data *executeData, time_point_t sampleTime) {
+    std::size_t depth = 0;
+    for (zend_execute_data *ex = executeData; ex; ex = ex->prev_execute_data) {
+        if (ex->func) {
+            ++depth;
+        }
+    }
+
+    if (depth == 0) {
+        return true;
+    }
+
+    // Inferred spans builder matches frames starting from the outermost one so when the stack is too deep the innermost frames are dropped
+    std::size_t framesToSkip = depth > maxFramesPerSample_ ? depth - maxFramesPerSample_ : 0;
+    std::size_t framesToCapture = depth - framesToSkip;
+
+    if (samplesCount_ == samples_.size() || frameIdsCount_ + framesToCapture > frameIds_.size() || internedFramesCount_ + framesToCapture > internedFrames_.size()) {
+        return false;
+    }
+
+    sample_t &sample = samples_[samplesCount_];
+    sample.time = sampleTime;
+    sample.firstFrameIndex = frameIdsCount_;
+    sample.framesCount = framesToCapture;
+
+    for (zend_execute_data *ex = executeData; ex; ex = ex->prev_execute_data) {
+        zend_function *func = ex->func;
+        if (!func) {
+            continue;
+        }
+        if (framesToSkip > 0) {
+            --framesToSkip;
+            continue;
+        }
+
+        frameIds_[frameIdsCount_++] = internFrame(ex, func);
+    }
+
+    ++samplesCount_;
+    return true;
+}
+
+static void addStringOrNull(zval *array, zend_string *str) {
+    if (str) {
+        add_next_index_str(array, zend_string_copy(str));
+    } else {
+        add_next_index_null(array);
+    }
+}
+
+void InferredSpansSamples::take(zval *returnValue, time_point_t now) {
+    array_init_size(returnValue, 3);
+    add_next_index_long(returnValue, static_cast<zend_long>(internedFramesSentCount_));
+
+    zval newCompactFrames;
+    array_init_size(&newCompactFrames, (internedFramesCount_ - internedFramesSentCount_) * compactFrameSize);
+    for (std::size_t frameIndex = internedFramesSentCount_; frameIndex < internedFramesCount_; ++frameIndex) {
+        frame_t const &frame = internedFrames_[frameIndex];
+        addStringOrNull(&newCompactFrames, frame.file);
+        if (frame.file) {
+            add_next_index_long(&newCompactFrames, frame.line);
+        } else {
+            add_next_index_null(&newCompactFrames);
+        }
+        addStringOrNull(&newCompactFrames, frame.className);
+        addStringOrNull(&newCompactFrames, frame.function);
+        if (frame.className) {
+            add_next_index_bool(&newCompactFrames, frame.isStaticMethod);
+        } else {
+            add_next_index_null(&newCompactFrames);
+        }
+    }
+    add_next_index_zval(returnValue, &newCompactFrames);
+
+    zval samples;
+    array_init_size(&samples, samplesCount_);
+    for (std::size_t sampleIndex = 0; sampleIndex < samplesCount_; ++sampleIndex) {
+        sample_t const &sample = samples_[sampleIndex];
+
+        zval sampleFrameIds;
+        array_init_size(&sampleFrameIds, sample.framesCount);
+        for (std::size_t index = sample.firstFrameIndex; index < sample.firstFrameIndex + sample.framesCount; ++index) {
+            add_next_index_long(&sampleFrameIds, frameIds_[index]);
+        }
+
+        zval sampleAsArray;
+        array_init_size(&sampleAsArray, 2);
+        add_next_index_long(&sampleAsArray, (now - sample.time).count());
+        add_next_index_zval(&sampleAsArray, &sampleFrameIds);
+        add_next_index_zval(&samples, &sampleAsArray);
+    }
+    add_next_index_zval(returnValue, &samples);
+
+    samplesCount_ = 0;
+    frameIdsCount_ = 0;
+    internedFramesSentCount_ = internedFramesCount_;
+
+    // Table is reset once it is half full so there is always room for the sample which could not be captured before PHP part consumed the buffer
+    if (internedFramesCount_ * 2 >= internedFrames_.size()) {
+        clearInternedFrames();
+    }
+}
+
+void InferredSpansSamples::clearInternedFrames() {
+    for (std::size_t frameIndex = 0; frameIndex < internedFramesCount_; ++frameIndex) {
+        frame_t &frame = internedFrames_[frameIndex];
+        releaseIfNotNull(frame.file);
+        releaseIfNotNull(frame.className);
+        releaseIfNotNull(frame.function);
+    }
+    std::fill(internedFramesIndex_.begin(), internedFramesIndex_.end(), 0);
+    internedFramesCount_ = 0;
+    internedFramesSentCount_ = 0;
+}
+
+void InferredSpansSamples::clear() {
+    samplesCount_ = 0;
+    frameIdsCount_ = 0;
+    clearInternedFrames();
+}
+
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright Elasticsearch B.V. and/or licensed to Elasticsearch B.V. under one
+ * or more contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#pragma once
+
+#include <Zend/zend_compile.h>
+#include <Zend/zend_types.h>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace elasticapm::php {
+
+/**
+ * Stack samples for inferred spans captured natively by walking zend_execute_data chain.
+ * Frames are interned in per-request table as (file, line, class, function, is static method) tuples
+ * and samples are stored as arrays of frame ids so that consecutive samples sharing most frames
+ * cost only an integer per frame and PHP part can compare them without looking at strings.
+ * All the storage is allocated up front so capturing a sample does not allocate memory.
+ * Strings referenced by frames are request scoped so the buffer has to be cleared before request ends.
+ */
+class InferredSpansSamples {
+public:
+    using time_point_t = std::chrono::time_point<std::chrono::steady_clock, std::chrono::milliseconds>;
+
+    // Number of values per frame in the flat array returned to PHP part - file, line, class, function, is static method
+    static constexpr std::size_t compactFrameSize = 5;
+
+    InferredSpansSamples(std::size_t maxSamples, std::size_t maxFrames, std::size_t maxFramesPerSample, std::size_t maxInternedFrames);
+    ~InferredSpansSamples();
+
+    InferredSpansSamples(const InferredSpansSamples &) = delete;
+    InferredSpansSamples &operator=(const InferredSpansSamples &) = delete;
+
+    /**
+     * @return false if there is not enough room left for the sample
+     */
+    bool capture(zend_execute_data *executeData, time_point_t sampleTime);
+
+    /**
+     * Moves all the buffered samples to returnValue as
+     * [id of the first new frame, flat array of frames interned since the previous call, list of [duration since sample was taken in milliseconds, list of frame ids]]
+     * Id of the first new frame equal to 0 means that the table was reset and the frames sent previously are no longer referenced.
+     */
+    void take(zval *returnValue, time_point_t now);
+
+    void clear();
+
+    std::size_t getSamplesCount() const {
+        return samplesCount_;
+    }
+
+    std::size_t getInternedFramesCount() const {
+        return internedFramesCount_;
+    }
+
+private:
+    struct frame_t {
+        zend_string *file;
+        zend_string *className;
+        zend_string *function;
+        uint32_t line;
+        bool isStaticMethod;
+    };
+
+    struct sample_t {
+        time_point_t time;
+        std::size_t firstFrameIndex;
+        std::size_t framesCount;
+    };
+
+    uint32_t internFrame(zend_execute_data *executeData, zend_function *func);
+    void clearInternedFrames();
+
+    std::vector<sample_t> samples_;
+    std::vector<uint32_t> frameIds_;
+    std::vector<frame_t> internedFrames_;
+    // open addressing hash table of (interned frame index + 1), 0 marks an empty slot
+    std::vector<uint32_t> internedFramesIndex_;
+    std::size_t maxFramesPerSample_;
+    std::size_t samplesCount_ = 0;
+    std::size_t frameIdsCount_ = 0;
+    std::size_t internedFramesCount_ = 0;
+    std::size_t internedFramesSentCount_ = 0;
+};
+
+}
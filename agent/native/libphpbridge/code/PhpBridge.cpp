@@ -68,7 +68,7 @@ bool isObjectOfClass(zval *object, std::string_view className) {
 
 }
 
-bool PhpBridge::callInferredSpans(std::chrono::milliseconds duration) const {
+bool PhpBridge::callInferredSpans() const {
     auto phpPartFacadeClass = findClassEntry("elastic\\apm\\impl\\autoinstrument\\phppartfacade"sv);
     if (!phpPartFacadeClass) {
         return false;
@@ -95,10 +95,7 @@ bool PhpBridge::callInferredSpans(std::chrono::milliseconds duration) const {
     }
 
     AutoZval rv;
-    AutoZval params;
-    ZVAL_LONG(&params[0], duration.count());
-
-    return callMethod(inferredSpansManager, "handleAutomaticCapturing"sv, params.data(), params.size(), rv.get());
+    return callMethod(inferredSpansManager, "handleAutomaticCapturing"sv, nullptr, 0, rv.get());
 }
 
 std::string_view PhpBridge::getPhpSapiName() const {
@@ -11,7 +11,7 @@ namespace elasticapm::php {
 class PhpBridge : public PhpBridgeInterface {
 public:
 
-    bool callInferredSpans(std::chrono::milliseconds duration) const final;
+    bool callInferredSpans() const final;
 
     std::vector<phpExtensionInfo_t> getExtensionList() const final;
     std::string getPhpInfo() const final;
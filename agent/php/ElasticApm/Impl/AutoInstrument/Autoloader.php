@@ -37,8 +37,8 @@ final class Autoloader
     /** @var int */
     private static $autoloadFqClassNamePrefixLength;
 
-    /** @var string */
-    private static $elasticApmSrcDir;
+    /** @var ?string */
+    private static $elasticApmSrcDir = null;
 
     public static function register(): void
     {
@@ -48,6 +48,15 @@ final class Autoloader
         spl_autoload_register([__CLASS__, 'autoloadCodeForClass']);
     }
 
+    /**
+     * Static properties of preloaded classes are reset on each request so it returns false
+     * on the first use in a request if agent's classes are preloaded (see preload.php)
+     */
+    public static function isRegistered(): bool
+    {
+        return self::$elasticApmSrcDir !== null;
+    }
+
     private static function shouldAutoloadCodeForClass(string $fqClassName): bool
     {
         // does the class use the namespace prefix?
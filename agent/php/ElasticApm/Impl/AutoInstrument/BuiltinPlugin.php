@@ -35,8 +35,19 @@ final class BuiltinPlugin extends PluginBase
     /** @var ?WordPressAutoInstrumentation */
     private $wordPressAutoInstrumentationIfEnabled;
 
-    public function __construct(Tracer $tracer)
+    /**
+     * @param Tracer $tracer
+     * @param bool   $onlyTraceContextPropagation true for unsampled transaction
+     *                                            - spans would not be recorded but outgoing HTTP requests still carry trace context
+     */
+    public function __construct(Tracer $tracer, bool $onlyTraceContextPropagation = false)
     {
+        if ($onlyTraceContextPropagation) {
+            parent::__construct($tracer, [new CurlAutoInstrumentation($tracer)]);
+            $this->wordPressAutoInstrumentationIfEnabled = null;
+            return;
+        }
+
         $wordPressAutoInstrumentation = new WordPressAutoInstrumentation($tracer);
         parent::__construct(
             $tracer,
@@ -80,15 +80,16 @@ final class CurlAutoInstrumentation extends AutoInstrumentationBase
             return;
         }
 
-        $this->registerDelegatingToHandleTracker($ctx, 'curl_init', self::CURL_INIT_ID);
-        $this->registerDelegatingToHandleTracker($ctx, 'curl_setopt', self::CURL_SETOPT_ID);
-        $this->registerDelegatingToHandleTracker($ctx, 'curl_setopt_array', self::CURL_SETOPT_ARRAY_ID);
-        $this->registerDelegatingToHandleTracker($ctx, 'curl_copy_handle', self::CURL_COPY_HANDLE_ID);
-        $this->registerDelegatingToHandleTracker($ctx, 'curl_exec', self::CURL_EXEC_ID);
-        $this->registerDelegatingToHandleTracker($ctx, 'curl_close', self::CURL_CLOSE_ID);
+        // Hooks look only at the handle (and the option with its value for curl_setopt*)
+        $this->registerDelegatingToHandleTracker($ctx, 'curl_init', self::CURL_INIT_ID, /* maxCapturedArgsCount */ 1);
+        $this->registerDelegatingToHandleTracker($ctx, 'curl_setopt', self::CURL_SETOPT_ID, /* maxCapturedArgsCount */ 3);
+        $this->registerDelegatingToHandleTracker($ctx, 'curl_setopt_array', self::CURL_SETOPT_ARRAY_ID, /* maxCapturedArgsCount */ 2);
+        $this->registerDelegatingToHandleTracker($ctx, 'curl_copy_handle', self::CURL_COPY_HANDLE_ID, /* maxCapturedArgsCount */ 1);
+        $this->registerDelegatingToHandleTracker($ctx, 'curl_exec', self::CURL_EXEC_ID, /* maxCapturedArgsCount */ 1);
+        $this->registerDelegatingToHandleTracker($ctx, 'curl_close', self::CURL_CLOSE_ID, /* maxCapturedArgsCount */ 1);
     }
 
-    public function registerDelegatingToHandleTracker(RegistrationContextInterface $ctx, string $funcName, int $funcId): void
+    public function registerDelegatingToHandleTracker(RegistrationContextInterface $ctx, string $funcName, int $funcId, int $maxCapturedArgsCount = -1): void
     {
         $ctx->interceptCallsToInternalFunction(
             $funcName,
@@ -99,7 +100,8 @@ final class CurlAutoInstrumentation extends AutoInstrumentationBase
              */
             function (array $interceptedCallArgs) use ($funcName, $funcId): ?callable {
                 return $this->preHook($funcName, $funcId, $interceptedCallArgs);
-            }
+            },
+            $maxCapturedArgsCount
         );
     }
 
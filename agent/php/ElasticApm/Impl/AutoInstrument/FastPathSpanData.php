@@ -0,0 +1,59 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+declare(strict_types=1);
+
+namespace Elastic\Apm\Impl\AutoInstrument;
+
+use Throwable;
+
+/**
+ * Call timed by the extension for registration made with one of RegistrationContextInterface::intercept...AsFastPathSpan()
+ *
+ * Code in this file is part of implementation internals and thus it is not covered by the backward compatibility.
+ *
+ * @internal
+ */
+final class FastPathSpanData
+{
+    /** @var ?object Object the call was made on (or connection passed as the first argument to procedural style API) */
+    public $thisObj = null;
+
+    /** @var ?string */
+    public $statement = null;
+
+    /** @var float Start time in microseconds since epoch */
+    public $timestamp;
+
+    /** @var float In milliseconds */
+    public $duration;
+
+    /** @var ?Throwable */
+    public $thrown = null;
+
+    /** @var bool */
+    public $hasReturnedFalse = false;
+
+    public function hasFailed(): bool
+    {
+        return $this->thrown !== null || $this->hasReturnedFalse;
+    }
+}
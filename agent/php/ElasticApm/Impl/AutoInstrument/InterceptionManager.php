@@ -23,9 +23,12 @@ declare(strict_types=1);
 
 namespace Elastic\Apm\Impl\AutoInstrument;
 
+use Elastic\Apm\Impl\AutoInstrument\Util\AutoInstrumentationUtil;
+use Elastic\Apm\Impl\ExecutionSegment;
 use Elastic\Apm\Impl\Log\LogCategory;
 use Elastic\Apm\Impl\Log\Logger;
 use Elastic\Apm\Impl\Tracer;
+use Elastic\Apm\Impl\Transaction;
 use Elastic\Apm\Impl\Util\ArrayUtil;
 use Elastic\Apm\Impl\Util\ClassNameUtil;
 use Elastic\Apm\Impl\Util\DbgUtil;
@@ -47,28 +50,37 @@ final class InterceptionManager
     /** @var BuiltinPlugin */
     private $builtinPlugin;
 
-    /** @var int|null */
-    private $interceptedCallInProgressRegistrationId = null;
-
-    /** @var Registration|null */
-    private $interceptedCallInProgressRegistration = null;
-
     /**
-     * @var null|callable(int, bool, mixed): void
+     * Intercepted calls waiting for their post hook - calls can be nested (for example PDO call inside curl callback)
+     * and the extension calls post hooks in the reverse order
+     *
+     * @var array<array{int, Registration, callable(int, bool, mixed): void}>
      */
-    private $interceptedCallInProgressPreHookRetVal = null;
+    private $interceptedCallsInProgress = [];
 
-    public function __construct(Tracer $tracer)
+    public function __construct(Tracer $tracer, bool $onlyTraceContextPropagation = false)
     {
         $this->logger = $tracer->loggerFactory()
                                ->loggerForClass(LogCategory::INTERCEPTION, __NAMESPACE__, __CLASS__, __FILE__);
 
-        $this->loadPlugins($tracer);
+        $this->loadPlugins($tracer, $onlyTraceContextPropagation);
+
+        if ($this->hasFastPathSpanRegistrations()) {
+            $tracer->onNewCurrentTransactionHasBegun->add(
+                function (Transaction $transaction): void {
+                    $this->startFastPathSpansForTransaction($transaction);
+                }
+            );
+            $currentTransaction = $tracer->getCurrentTransaction();
+            if ($currentTransaction instanceof Transaction) {
+                $this->startFastPathSpansForTransaction($currentTransaction);
+            }
+        }
     }
 
-    private function loadPlugins(Tracer $tracer): void
+    private function loadPlugins(Tracer $tracer, bool $onlyTraceContextPropagation): void
     {
-        $this->builtinPlugin = new BuiltinPlugin($tracer);
+        $this->builtinPlugin = new BuiltinPlugin($tracer, $onlyTraceContextPropagation);
         $registerCtx = new RegistrationContext();
         $registerCtx->dbgCurrentPluginIndex = 0;
         $registerCtx->dbgCurrentPluginDesc = $this->builtinPlugin->getDescription();
@@ -76,6 +88,137 @@ final class InterceptionManager
         $this->interceptedCallRegistrations = $registerCtx->interceptedCallRegistrations;
     }
 
+    /**
+     * Registrations made after the plugins were loaded (for example by application code of component tests)
+     *
+     * @param string                                       $dbgDesc
+     * @param callable(RegistrationContextInterface): void $registerCallback
+     */
+    public function registerAdditional(string $dbgDesc, callable $registerCallback): void
+    {
+        $registerCtx = new RegistrationContext();
+        $registerCtx->interceptedCallRegistrations = [];
+        $registerCtx->dbgCurrentPluginIndex = 1;
+        $registerCtx->dbgCurrentPluginDesc = $dbgDesc;
+        $registerCallback($registerCtx);
+        // The extension gives back the ID of the existing registration for a function that is already registered
+        foreach ($registerCtx->interceptedCallRegistrations as $interceptRegistrationId => $registration) {
+            $this->interceptedCallRegistrations[$interceptRegistrationId] = $registration;
+        }
+    }
+
+    private function hasFastPathSpanRegistrations(): bool
+    {
+        foreach ($this->interceptedCallRegistrations as $registration) {
+            if ($registration->fastPathSpanBuilder !== null) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    private function startFastPathSpansForTransaction(Transaction $transaction): void
+    {
+        // Spans left from the previous transaction (for example if it was discarded) do not belong to this one
+        self::takeFastPathSpansFromExtension();
+
+        // Calls made while there is no sampled transaction are not recorded at all
+        if (!$transaction->isSampled()) {
+            self::setFastPathSpansRecording(false);
+            return;
+        }
+
+        $transaction->onCurrentExecutionSegmentAboutToChange->add(
+            function (ExecutionSegment $currentExecutionSegment) use ($transaction): void {
+                $this->buildFastPathSpans($transaction, $currentExecutionSegment);
+            }
+        );
+        $transaction->onAboutToEnd->add(
+            function (): void {
+                self::setFastPathSpansRecording(false);
+            }
+        );
+        self::setFastPathSpansRecording(true);
+    }
+
+    private static function setFastPathSpansRecording(bool $isRecording): void
+    {
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        \elastic_apm_set_fast_path_spans_recording($isRecording);
+    }
+
+    /**
+     * @return array{int, array<array{int, ?object, ?string, float, float, ?Throwable, bool}>}
+     */
+    private static function takeFastPathSpansFromExtension(): array
+    {
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @var mixed $taken
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $taken = \elastic_apm_take_fast_path_spans();
+        if (!is_array($taken) || count($taken) !== 2) {
+            return [0, []];
+        }
+        /** @var array{int, array<array{int, ?object, ?string, float, float, ?Throwable, bool}>} $taken */
+        return $taken;
+    }
+
+    /**
+     * Spans for the calls recorded by the extension since the previous time are children of the segment
+     * that is still current - it is called before a new current span begins or the current segment ends
+     */
+    private function buildFastPathSpans(Transaction $transaction, ExecutionSegment $parent): void
+    {
+        [$droppedCount, $spans] = self::takeFastPathSpansFromExtension();
+        if ($droppedCount !== 0) {
+            ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
+            && $loggerProxy->log('Some calls were not recorded because extension\'s buffer for fast path spans was full', ['droppedCount' => $droppedCount]);
+        }
+
+        foreach ($spans as [$interceptRegistrationId, $thisObj, $statement, $timestamp, $duration, $thrown, $hasReturnedFalse]) {
+            // Span that would be dropped because of transaction_max_spans is not built just to be thrown away
+            // unless the call has thrown - the error is reported even if the span is dropped
+            if ($thrown === null && $transaction->hasReachedMaxSpans()) {
+                ++$droppedCount;
+                continue;
+            }
+
+            $interceptRegistration = ArrayUtil::getValueIfKeyExistsElse($interceptRegistrationId, $this->interceptedCallRegistrations, null);
+            if ($interceptRegistration === null || $interceptRegistration->fastPathSpanBuilder === null) {
+                ($loggerProxy = $this->logger->ifErrorLevelEnabled(__LINE__, __FUNCTION__))
+                && $loggerProxy->log('There is no fast path span registration with the given interceptRegistrationId', compact('interceptRegistrationId'));
+                continue;
+            }
+
+            $data = new FastPathSpanData();
+            $data->thisObj = $thisObj;
+            $data->statement = $statement;
+            $data->timestamp = $timestamp;
+            $data->duration = $duration;
+            $data->thrown = $thrown;
+            $data->hasReturnedFalse = $hasReturnedFalse;
+            try {
+                ($interceptRegistration->fastPathSpanBuilder)($parent, $data);
+            } catch (Throwable $throwable) {
+                ($loggerProxy = $this->logger->ifErrorLevelEnabled(__LINE__, __FUNCTION__))
+                && $loggerProxy->logThrowable($throwable, 'Fast path span builder has thrown', compact('interceptRegistration'));
+            }
+        }
+
+        // Calls the extension did not record and the ones not built above are reported as dropped spans (span_count.dropped)
+        $transaction->addDroppedSpansCount($droppedCount);
+    }
+
     /**
      * @param int     $interceptRegistrationId
      * @param ?object $thisObj
@@ -123,9 +266,7 @@ final class InterceptionManager
 
         $shouldCallPostHook = ($preHookRetVal !== null);
         if ($shouldCallPostHook) {
-            $this->interceptedCallInProgressRegistrationId = $interceptRegistrationId;
-            $this->interceptedCallInProgressRegistration = $interceptRegistration;
-            $this->interceptedCallInProgressPreHookRetVal = $preHookRetVal;
+            $this->interceptedCallsInProgress[] = [$interceptRegistrationId, $interceptRegistration, $preHookRetVal];
         }
 
         $loggerProxyTrace && $loggerProxyTrace->log(__LINE__, 'preHook completed successfully', ['shouldCallPostHook' => $shouldCallPostHook]);
@@ -143,26 +284,27 @@ final class InterceptionManager
         bool $hasExitedByException,
         $returnValueOrThrown
     ): void {
+        $interceptedCallInProgress = array_pop(/* ref */ $this->interceptedCallsInProgress);
+        if ($interceptedCallInProgress === null) {
+            ($loggerProxy = $this->logger->ifErrorLevelEnabled(__LINE__, __FUNCTION__))
+            && $loggerProxy->log('There is no intercepted call in progress');
+            return;
+        }
+        [$interceptRegistrationId, $interceptRegistration, $preHookRetVal] = $interceptedCallInProgress;
+
         $localLogger = $this->logger->inherit()->addAllContext(
             [
-                'interceptRegistrationId' => $this->interceptedCallInProgressRegistrationId,
-                'interceptRegistration'   => $this->interceptedCallInProgressRegistration,
+                'interceptRegistrationId'  => $interceptRegistrationId,
+                'interceptRegistration'    => $interceptRegistration,
+                'nested calls in progress' => count($this->interceptedCallsInProgress),
             ]
         );
         $loggerProxyTrace = $localLogger->ifTraceLevelEnabledNoLine(__FUNCTION__);
         $loggerProxyTrace && $loggerProxyTrace->log(__LINE__, 'Entered');
 
-        if ($this->interceptedCallInProgressRegistrationId === null) {
-            ($loggerProxy = $this->logger->ifErrorLevelEnabled(__LINE__, __FUNCTION__))
-            && $loggerProxy->log('There is no intercepted call in progress');
-            return;
-        }
-        assert($this->interceptedCallInProgressRegistration !== null);
-        assert($this->interceptedCallInProgressPreHookRetVal !== null);
-
         $loggerProxyTrace && $loggerProxyTrace->log(__LINE__, 'Calling postHook...');
         try {
-            ($this->interceptedCallInProgressPreHookRetVal)(
+            ($preHookRetVal)(
                 $numberOfStackFramesToSkip + 1,
                 $hasExitedByException,
                 $returnValueOrThrown
@@ -172,9 +314,6 @@ final class InterceptionManager
             ($loggerProxy = $localLogger->ifErrorLevelEnabled(__LINE__, __FUNCTION__))
             && $loggerProxy->logThrowable($throwable, 'postHook has thrown');
         }
-
-        $this->interceptedCallInProgressRegistrationId = null;
-        $this->interceptedCallInProgressPreHookRetVal = null;
     }
 
     public function astInstrumentationDirectCall(string $method): void
@@ -212,16 +351,31 @@ final class InterceptionManager
      * @param ?string $instrumentedClassFullName
      * @param string  $instrumentedFunction
      * @param mixed[] $capturedArgs
+     * @param ?string $ruleSpanType
      *
      * @return null|callable(?Throwable $thrown, mixed $returnValue): void
      */
-    public function astInstrumentationPreHook(?string $instrumentedClassFullName, string $instrumentedFunction, array $capturedArgs): ?callable
-    {
+    public function astInstrumentationPreHook(
+        ?string $instrumentedClassFullName,
+        string $instrumentedFunction,
+        array $capturedArgs,
+        ?string $ruleSpanType = null
+    ): ?callable {
         $localLogger = $this->logger->inherit()->addAllContext(['instrumentedClassFullName' => $instrumentedClassFullName]);
 
         $loggerProxyTrace = $localLogger->ifTraceLevelEnabledNoLine(__FUNCTION__);
         $loggerProxyTrace && $loggerProxyTrace->log(__LINE__, 'Entered');
 
+        if ($ruleSpanType !== null) {
+            try {
+                return $this->astInstrumentationRulePreHook($instrumentedClassFullName, $instrumentedFunction, $capturedArgs, $ruleSpanType);
+            } catch (Throwable $throwable) {
+                ($loggerProxy = $localLogger->ifErrorLevelEnabled(__LINE__, __FUNCTION__))
+                && $loggerProxy->logThrowable($throwable, 'astInstrumentationRulePreHook has thrown');
+                return null;
+            }
+        }
+
         $wordPressAutoInstrumIfEnabled = $this->builtinPlugin->getWordPressAutoInstrumentationIfEnabled();
         if ($wordPressAutoInstrumIfEnabled === null) {
             static $loggedOnce = false;
@@ -248,4 +402,46 @@ final class InterceptionManager
             return null;
         }
     }
+
+    /**
+     * Pre-hook for functions instrumented by ast_instrumentation_rules (see src/ext/AST_instrumentation_rules.h).
+     * Captured args are keyed by parameter index.
+     *
+     * @param ?string $instrumentedClassFullName
+     * @param string  $instrumentedFunction
+     * @param mixed[] $capturedArgs
+     * @param string  $spanType
+     *
+     * @return null|callable(?Throwable $thrown, mixed $returnValue): void
+     */
+    private function astInstrumentationRulePreHook(
+        ?string $instrumentedClassFullName,
+        string $instrumentedFunction,
+        array $capturedArgs,
+        string $spanType
+    ): ?callable {
+        $span = AutoInstrumentationUtil::beginCurrentSpan(
+            AutoInstrumentationUtil::buildSpanNameFromCall($instrumentedClassFullName, $instrumentedFunction),
+            $spanType
+        );
+        if ($span->isNoop()) {
+            return null;
+        }
+
+        foreach ($capturedArgs as $argIndex => $argValue) {
+            if ($argValue === null || is_scalar($argValue)) {
+                $span->context()->setLabel('arg_' . $argIndex, $argValue);
+            }
+        }
+
+        /**
+         * Return value is not available to the post-hook because instrumented function's body is wrapped in place
+         *
+         * @param ?Throwable $thrown
+         * @param mixed      $returnValue
+         */
+        return function (?Throwable $thrown, $returnValue) use ($span): void {
+            AutoInstrumentationUtil::endSpan(/* numberOfStackFramesToSkip */ 1, $span, $thrown !== null, $thrown ?? $returnValue);
+        };
+    }
 }
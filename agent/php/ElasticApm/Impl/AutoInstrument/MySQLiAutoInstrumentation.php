@@ -25,6 +25,7 @@ declare(strict_types=1);
 
 namespace Elastic\Apm\Impl\AutoInstrument;
 
+use Elastic\Apm\ExecutionSegmentInterface;
 use Elastic\Apm\Impl\AutoInstrument\Util\AutoInstrumentationUtil;
 use Elastic\Apm\Impl\AutoInstrument\Util\DbAutoInstrumentationUtil;
 use Elastic\Apm\Impl\AutoInstrument\Util\MapPerWeakObject;
@@ -340,6 +341,10 @@ final class MySQLiAutoInstrumentation extends AutoInstrumentationBase
         string $methodName,
         bool $isFirstArgStatement
     ): void {
+        if ($this->interceptCallsAsFastPathSpanTo($ctx, self::MYSQLI_CLASS_NAME, $methodName, $isFirstArgStatement)) {
+            return;
+        }
+
         $preHook = function (
             ?string $className,
             string $funcName,
@@ -567,6 +572,53 @@ final class MySQLiAutoInstrumentation extends AutoInstrumentationBase
         );
     }
 
+    /**
+     * Registers both procedural style function (where the connection is the first argument) and the method
+     */
+    private function interceptCallsAsFastPathSpanTo(
+        RegistrationContextInterface $ctx,
+        string $className,
+        string $methodName,
+        bool $isFirstArgStatement
+    ): bool {
+        $funcName = self::buildFuncName($className, $methodName);
+        if (
+            !$ctx->interceptCallsToInternalFunctionAsFastPathSpan(
+                $funcName,
+                $isFirstArgStatement ? 1 : -1 /* <- statementArgIndex */,
+                $this->buildFastPathSpanBuilder(null /* <- className */, $funcName)
+            )
+        ) {
+            return false;
+        }
+
+        $ctx->interceptCallsToInternalMethodAsFastPathSpan(
+            $className,
+            $methodName,
+            $isFirstArgStatement ? 0 : -1 /* <- statementArgIndex */,
+            $this->buildFastPathSpanBuilder($className, $methodName)
+        );
+        return true;
+    }
+
+    /**
+     * @return callable(ExecutionSegmentInterface, FastPathSpanData): void
+     */
+    private function buildFastPathSpanBuilder(?string $className, string $funcName): callable
+    {
+        return function (ExecutionSegmentInterface $parent, FastPathSpanData $data) use ($className, $funcName): void {
+            /** @var ?string $dbName */
+            $dbName = ($data->thisObj !== null)
+                ? $this->mapPerObject->getOr(
+                    $data->thisObj,
+                    DbAutoInstrumentationUtil::PER_OBJECT_KEY_DB_NAME,
+                    null /* <- defaultValue */
+                )
+                : null;
+            DbAutoInstrumentationUtil::buildDbSpanFromFastPath($parent, $data, $className, $funcName, self::DB_TYPE, $dbName);
+        };
+    }
+
     private static function beginSpan(
         ?string $className,
         string $funcName,
@@ -25,6 +25,7 @@ declare(strict_types=1);
 
 namespace Elastic\Apm\Impl\AutoInstrument;
 
+use Elastic\Apm\ExecutionSegmentInterface;
 use Elastic\Apm\Impl\AutoInstrument\Util\AutoInstrumentationUtil;
 use Elastic\Apm\Impl\AutoInstrument\Util\DbAutoInstrumentationUtil;
 use Elastic\Apm\Impl\AutoInstrument\Util\DbConnectionStringParser;
@@ -154,12 +155,17 @@ final class PDOAutoInstrumentation extends AutoInstrumentationBase
                 }
                 $this->mapPerObject->setMultiple($interceptedCallThis, $mapToStoreForPdoObj);
                 return null; // no post-hook
-            }
+            },
+            1 /* <- maxCapturedArgsCount - only DSN is used */
         );
     }
 
     private function interceptPDOMethodToSpan(RegistrationContextInterface $ctx, string $methodName, bool $isFirstArgStatement): void
     {
+        if ($this->interceptPDOMethodAsFastPathSpan($ctx, $methodName, $isFirstArgStatement)) {
+            return;
+        }
+
         $ctx->interceptCallsToInternalMethod(
             self::PDO_CLASS_NAME,
             $methodName,
@@ -188,6 +194,27 @@ final class PDOAutoInstrumentation extends AutoInstrumentationBase
                 /** @var ?string $dbName */
                 $dbName = $this->mapPerObject->getOr($interceptedCallThis, DbAutoInstrumentationUtil::PER_OBJECT_KEY_DB_NAME, /* defaultValue */ null);
                 return AutoInstrumentationUtil::createInternalFuncPostHookFromEndSpan(DbAutoInstrumentationUtil::beginDbSpan(self::PDO_CLASS_NAME, $methodName, $dbType, $dbName, $statement));
+            },
+            $isFirstArgStatement ? 1 : 0 /* <- maxCapturedArgsCount */
+        );
+    }
+
+    private function interceptPDOMethodAsFastPathSpan(RegistrationContextInterface $ctx, string $methodName, bool $isFirstArgStatement): bool
+    {
+        return $ctx->interceptCallsToInternalMethodAsFastPathSpan(
+            self::PDO_CLASS_NAME,
+            $methodName,
+            $isFirstArgStatement ? 0 : -1 /* <- statementArgIndex */,
+            function (ExecutionSegmentInterface $parent, FastPathSpanData $data) use ($methodName): void {
+                /** @var string $dbType */
+                $dbType = Constants::SPAN_SUBTYPE_UNKNOWN;
+                /** @var ?string $dbName */
+                $dbName = null;
+                if ($data->thisObj instanceof PDO) {
+                    $dbType = $this->mapPerObject->getOr($data->thisObj, DbAutoInstrumentationUtil::PER_OBJECT_KEY_DB_TYPE, /* defaultValue */ Constants::SPAN_SUBTYPE_UNKNOWN);
+                    $dbName = $this->mapPerObject->getOr($data->thisObj, DbAutoInstrumentationUtil::PER_OBJECT_KEY_DB_NAME, /* defaultValue */ null);
+                }
+                DbAutoInstrumentationUtil::buildDbSpanFromFastPath($parent, $data, self::PDO_CLASS_NAME, $methodName, $dbType, $dbName);
             }
         );
     }
@@ -263,7 +290,8 @@ final class PDOAutoInstrumentation extends AutoInstrumentationBase
 
                     $this->mapPerObject->setMultiple($returnValueOrThrown, $keyValueMapPerObjectToPropagate);
                 };
-            }
+            },
+            0 /* <- maxCapturedArgsCount */
         );
     }
 
@@ -321,7 +349,8 @@ final class PDOAutoInstrumentation extends AutoInstrumentationBase
                         $statement
                     )
                 );
-            }
+            },
+            0 /* <- maxCapturedArgsCount - bound parameters are not used */
         );
     }
 }
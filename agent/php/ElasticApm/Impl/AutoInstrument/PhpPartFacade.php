@@ -25,6 +25,7 @@ namespace Elastic\Apm\Impl\AutoInstrument;
 
 use Closure;
 use Elastic\Apm\Impl\GlobalTracerHolder;
+use Elastic\Apm\Impl\SrcRootDir;
 use Elastic\Apm\Impl\Log\LoggableToString;
 use Elastic\Apm\Impl\Tracer;
 use Elastic\Apm\Impl\Util\ArrayUtil;
@@ -61,7 +62,7 @@ final class PhpPartFacade
     /** @var InterceptionManager|null */
     private $interceptionManager = null;
 
-    private function __construct(float $requestInitStartTime)
+    private function __construct(float $requestInitStartTime, ?bool $isSampledDecidedByExtension)
     {
         if (!ElasticApmExtensionUtil::isLoaded()) {
             throw new RuntimeException(ElasticApmExtensionUtil::EXTENSION_NAME . ' extension is not loaded');
@@ -77,8 +78,12 @@ final class PhpPartFacade
             return;
         }
 
-        $this->transactionForExtensionRequest = new TransactionForExtensionRequest($tracer, $requestInitStartTime);
-        $this->interceptionManager = new InterceptionManager($tracer);
+        $this->transactionForExtensionRequest
+            = new TransactionForExtensionRequest($tracer, $requestInitStartTime, $isSampledDecidedByExtension);
+        // Only the instrumentations propagating trace context are needed for the request the extension decided not to sample
+        $onlyTraceContextPropagation = $isSampledDecidedByExtension === false
+                                       && !$this->transactionForExtensionRequest->isTransactionForRequestSampled();
+        $this->interceptionManager = new InterceptionManager($tracer, $onlyTraceContextPropagation);
     }
 
     /**
@@ -88,11 +93,21 @@ final class PhpPartFacade
      *
      * @param int   $maxEnabledLogLevel
      * @param float $requestInitStartTime
+     * @param ?bool $isSampledDecidedByExtension null if the extension left sampling decision to PHP part
      *
      * @return bool
      */
-    public static function bootstrap(int $maxEnabledLogLevel, float $requestInitStartTime): bool
-    {
+    public static function bootstrap(
+        int $maxEnabledLogLevel,
+        float $requestInitStartTime,
+        ?bool $isSampledDecidedByExtension = null
+    ): bool {
+        if (!Autoloader::isRegistered()) {
+            // Agent's classes are preloaded (see preload.php) so the extension did not load bootstrap_php_part.php
+            SrcRootDir::$fullPath = dirname(__DIR__, 3);
+            Autoloader::register();
+        }
+
         BootstrapStageLogger::configure($maxEnabledLogLevel);
         BootstrapStageLogger::logDebug(
             'Starting bootstrap sequence...' . " maxEnabledLogLevel: $maxEnabledLogLevel",
@@ -111,7 +126,7 @@ final class PhpPartFacade
         }
 
         try {
-            self::$singletonInstance = new self($requestInitStartTime);
+            self::$singletonInstance = new self($requestInitStartTime, $isSampledDecidedByExtension);
         } catch (Throwable $throwable) {
             BootstrapStageLogger::logCriticalThrowable(
                 $throwable,
@@ -138,6 +153,25 @@ final class PhpPartFacade
         return self::$singletonInstance;
     }
 
+    /**
+     * Intercepts calls in addition to the ones intercepted by the built-in plugin
+     * (for example by application code of component tests)
+     *
+     * @param string                                       $dbgDesc
+     * @param callable(RegistrationContextInterface): void $registerCallback
+     *
+     * @return bool false if calls cannot be intercepted (for example because bootstrap sequence failed)
+     */
+    public static function registerAdditionalInterceptions(string $dbgDesc, callable $registerCallback): bool
+    {
+        if (self::$singletonInstance === null || self::$singletonInstance->interceptionManager === null) {
+            return false;
+        }
+
+        self::$singletonInstance->interceptionManager->registerAdditional($dbgDesc, $registerCallback);
+        return true;
+    }
+
     /**
      * Called by elastic_apm extension
      *
@@ -478,14 +512,16 @@ final class PhpPartFacade
     /**
      * Called by elastic_apm extension
      *
+     * @param ?array<string, int> $memoryStats Passed only when capture_memory_stats is enabled
+     *
      * @noinspection PhpUnused
      */
-    public static function shutdown(): void
+    public static function shutdown(?array $memoryStats = null): void
     {
         self::callWithTransactionForExtensionRequest(
             __FUNCTION__,
-            function (TransactionForExtensionRequest $transactionForExtensionRequest): void {
-                $transactionForExtensionRequest->onShutdown();
+            function (TransactionForExtensionRequest $transactionForExtensionRequest) use ($memoryStats): void {
+                $transactionForExtensionRequest->onShutdown($memoryStats);
             }
         );
 
@@ -528,20 +564,25 @@ final class PhpPartFacade
 
     /**
      * Calls to this method are inserted by AST instrumentation.
-     * See src/ext/WordPress_instrumentation.c
+     * See src/ext/WordPress_instrumentation.c and src/ext/AST_instrumentation_rules.cpp
      *
      * @noinspection PhpUnused
      *
      * @param ?string $instrumentedClassFullName
      * @param string  $instrumentedFunction
      * @param mixed[] $capturedArgs
+     * @param ?string $ruleSpanType Passed only for functions instrumented by ast_instrumentation_rules
      *
      * @return null|callable(?Throwable $thrown, mixed $returnValue): void
      */
-    public static function astInstrumentationPreHook(?string $instrumentedClassFullName, string $instrumentedFunction, array $capturedArgs): ?callable
-    {
+    public static function astInstrumentationPreHook(
+        ?string $instrumentedClassFullName,
+        string $instrumentedFunction,
+        array $capturedArgs,
+        ?string $ruleSpanType = null
+    ): ?callable {
         return (($interceptionManager = self::singletonInstance()->interceptionManager) !== null)
-            ? $interceptionManager->astInstrumentationPreHook($instrumentedClassFullName, $instrumentedFunction, $capturedArgs)
+            ? $interceptionManager->astInstrumentationPreHook($instrumentedClassFullName, $instrumentedFunction, $capturedArgs, $ruleSpanType)
             : null;
     }
 
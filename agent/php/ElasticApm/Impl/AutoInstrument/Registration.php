@@ -25,6 +25,7 @@ declare(strict_types=1);
 
 namespace Elastic\Apm\Impl\AutoInstrument;
 
+use Elastic\Apm\ExecutionSegmentInterface;
 use Elastic\Apm\Impl\Log\LoggableInterface;
 use Elastic\Apm\Impl\Log\LogStreamInterface;
 
@@ -41,6 +42,13 @@ final class Registration implements LoggableInterface
      */
     public $preHook;
 
+    /**
+     * Set only for registrations of fast path spans - the extension does not call preHook for them
+     *
+     * @var null|callable(ExecutionSegmentInterface, FastPathSpanData): void
+     */
+    public $fastPathSpanBuilder = null;
+
     /** @var int */
     private $dbgPluginIndex;
 
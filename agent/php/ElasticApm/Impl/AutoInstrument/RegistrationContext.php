@@ -23,6 +23,8 @@ declare(strict_types=1);
 
 namespace Elastic\Apm\Impl\AutoInstrument;
 
+use Elastic\Apm\ExecutionSegmentInterface;
+
 /**
  * Code in this file is part of implementation internals and thus it is not covered by the backward compatibility.
  *
@@ -42,7 +44,8 @@ final class RegistrationContext implements RegistrationContextInterface
     public function interceptCallsToInternalMethod(
         string $className,
         string $methodName,
-        callable $preHook
+        callable $preHook,
+        int $maxCapturedArgsCount = -1
     ): void {
         /**
          * elastic_apm_* functions are provided by the elastic_apm extension
@@ -54,7 +57,8 @@ final class RegistrationContext implements RegistrationContextInterface
             // PHP internals store classes, methods and functions in a hashtable
             // where key is a name converted to lower case
             strtolower($className),
-            strtolower($methodName)
+            strtolower($methodName),
+            $maxCapturedArgsCount
         );
         if ($interceptRegistrationId >= 0) {
             $this->interceptedCallRegistrations[$interceptRegistrationId] = new Registration(
@@ -68,7 +72,8 @@ final class RegistrationContext implements RegistrationContextInterface
 
     public function interceptCallsToInternalFunction(
         string $functionName,
-        callable $preHook
+        callable $preHook,
+        int $maxCapturedArgsCount = -1
     ): void {
         /**
          * elastic_apm_* functions are provided by the elastic_apm extension
@@ -78,7 +83,7 @@ final class RegistrationContext implements RegistrationContextInterface
          */
         // PHP internals store classes, methods and functions in a hashtable
         // where key is a name converted to lower case
-        $interceptRegistrationId = \elastic_apm_intercept_calls_to_internal_function(strtolower($functionName));
+        $interceptRegistrationId = \elastic_apm_intercept_calls_to_internal_function(strtolower($functionName), $maxCapturedArgsCount);
         if ($interceptRegistrationId >= 0) {
             $this->interceptedCallRegistrations[$interceptRegistrationId] = new Registration(
                 $this->dbgCurrentPluginIndex,
@@ -93,4 +98,140 @@ final class RegistrationContext implements RegistrationContextInterface
             );
         }
     }
+
+    public function interceptCallsToInternalMethodAsFastPathSpan(
+        string $className,
+        string $methodName,
+        int $statementArgIndex,
+        callable $spanBuilder
+    ): bool {
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $interceptRegistrationId = \elastic_apm_intercept_calls_to_internal_method_as_fast_path_span(
+            strtolower($className),
+            strtolower($methodName),
+            $statementArgIndex
+        );
+        if ($interceptRegistrationId < 0) {
+            return false;
+        }
+
+        $this->addFastPathSpanRegistration($interceptRegistrationId, $className . '::' . $methodName, $spanBuilder);
+        return true;
+    }
+
+    public function interceptCallsToInternalFunctionAsFastPathSpan(
+        string $functionName,
+        int $statementArgIndex,
+        callable $spanBuilder
+    ): bool {
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $interceptRegistrationId = \elastic_apm_intercept_calls_to_internal_function_as_fast_path_span(
+            strtolower($functionName),
+            $statementArgIndex
+        );
+        if ($interceptRegistrationId < 0) {
+            return false;
+        }
+
+        $this->addFastPathSpanRegistration($interceptRegistrationId, $functionName, $spanBuilder);
+        return true;
+    }
+
+    /**
+     * @param int                                                      $interceptRegistrationId
+     * @param string                                                   $dbgInterceptedCallDesc
+     * @param callable(ExecutionSegmentInterface, FastPathSpanData): void $spanBuilder
+     */
+    private function addFastPathSpanRegistration(int $interceptRegistrationId, string $dbgInterceptedCallDesc, callable $spanBuilder): void
+    {
+        $registration = new Registration(
+            $this->dbgCurrentPluginIndex,
+            $this->dbgCurrentPluginDesc,
+            $dbgInterceptedCallDesc,
+            /**
+             * The extension does not call pre-hook for fast path spans
+             *
+             * @param ?object $interceptedCallThis
+             * @param mixed[] $interceptedCallArgs
+             */
+            function (
+                /** @noinspection PhpUnusedParameterInspection */ ?object $interceptedCallThis,
+                /** @noinspection PhpUnusedParameterInspection */ array $interceptedCallArgs
+            ): ?callable {
+                return null;
+            }
+        );
+        $registration->fastPathSpanBuilder = $spanBuilder;
+        $this->interceptedCallRegistrations[$interceptRegistrationId] = $registration;
+    }
+
+    public function interceptCallsToUserMethod(
+        string $className,
+        string $methodName,
+        callable $preHook,
+        int $maxCapturedArgsCount = -1
+    ): bool {
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $interceptRegistrationId = \elastic_apm_intercept_calls_to_user_method(
+            strtolower($className),
+            strtolower($methodName),
+            $maxCapturedArgsCount
+        );
+        if ($interceptRegistrationId < 0) {
+            return false;
+        }
+
+        $this->interceptedCallRegistrations[$interceptRegistrationId] = new Registration(
+            $this->dbgCurrentPluginIndex,
+            $this->dbgCurrentPluginDesc,
+            $className . '::' . $methodName /* <- dbgInterceptedCallDesc */,
+            $preHook
+        );
+        return true;
+    }
+
+    public function interceptCallsToUserFunction(
+        string $functionName,
+        callable $preHook,
+        int $maxCapturedArgsCount = -1
+    ): bool {
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $interceptRegistrationId = \elastic_apm_intercept_calls_to_user_function(strtolower($functionName), $maxCapturedArgsCount);
+        if ($interceptRegistrationId < 0) {
+            return false;
+        }
+
+        $this->interceptedCallRegistrations[$interceptRegistrationId] = new Registration(
+            $this->dbgCurrentPluginIndex,
+            $this->dbgCurrentPluginDesc,
+            $functionName /* <- dbgInterceptedCallDesc */,
+            function (
+                ?object $interceptedCallThis,
+                array $interceptedCallArgs
+            ) use ($preHook): ?callable {
+                return $preHook($interceptedCallArgs);
+            }
+        );
+        return true;
+    }
 }
@@ -23,25 +23,104 @@ declare(strict_types=1);
 
 namespace Elastic\Apm\Impl\AutoInstrument;
 
+use Elastic\Apm\ExecutionSegmentInterface;
+
 interface RegistrationContextInterface
 {
     /**
      * @param string                                $className
      * @param string                                $methodName
      * @param callable(?object, mixed[]): ?callable $preHook
+     * @param int                                   $maxCapturedArgsCount $preHook gets only the first $maxCapturedArgsCount
+     *                                                                    arguments of the intercepted call (all of them if negative)
      */
     public function interceptCallsToInternalMethod(
         string $className,
         string $methodName,
-        callable $preHook
+        callable $preHook,
+        int $maxCapturedArgsCount = -1
     ): void;
 
     /**
      * @param string                       $functionName
      * @param callable(mixed[]): ?callable $preHook
+     * @param int                          $maxCapturedArgsCount $preHook gets only the first $maxCapturedArgsCount
+     *                                                           arguments of the intercepted call (all of them if negative)
      */
     public function interceptCallsToInternalFunction(
         string $functionName,
-        callable $preHook
+        callable $preHook,
+        int $maxCapturedArgsCount = -1
     ): void;
+
+    /**
+     * Calls are timed by the extension without calling any PHP code - instead of pre/post hooks
+     * $spanBuilder is called later (when the current span changes or the transaction ends)
+     * and only for calls made while a sampled transaction was in progress.
+     * $spanBuilder gets the execution segment that was current during the call as the parent for the new span.
+     *
+     * @param string                                                   $className
+     * @param string                                                   $methodName
+     * @param int                                                      $statementArgIndex -1 if there is no statement argument
+     * @param callable(ExecutionSegmentInterface, FastPathSpanData): void $spanBuilder
+     *
+     * @return bool false if fast path spans are disabled - interceptCallsToInternalMethod() should be used then
+     */
+    public function interceptCallsToInternalMethodAsFastPathSpan(
+        string $className,
+        string $methodName,
+        int $statementArgIndex,
+        callable $spanBuilder
+    ): bool;
+
+    /**
+     * @param string                                                   $functionName
+     * @param int                                                      $statementArgIndex -1 if there is no statement argument
+     * @param callable(ExecutionSegmentInterface, FastPathSpanData): void $spanBuilder
+     *
+     * @return bool false if fast path spans are disabled - interceptCallsToInternalFunction() should be used then
+     *
+     * @see interceptCallsToInternalMethodAsFastPathSpan
+     */
+    public function interceptCallsToInternalFunctionAsFastPathSpan(
+        string $functionName,
+        int $statementArgIndex,
+        callable $spanBuilder
+    ): bool;
+
+    /**
+     * Supported only when the extension uses Zend Observer API (PHP 8+).
+     * The class does not have to be loaded at the time of registration
+     * but it has to be the class declaring the method.
+     *
+     * @param string                                $className
+     * @param string                                $methodName
+     * @param callable(?object, mixed[]): ?callable $preHook
+     * @param int                                   $maxCapturedArgsCount $preHook gets only the first $maxCapturedArgsCount
+     *                                                                    arguments of the intercepted call (all of them if negative)
+     *
+     * @return bool false if intercepting calls to user code is not supported
+     */
+    public function interceptCallsToUserMethod(
+        string $className,
+        string $methodName,
+        callable $preHook,
+        int $maxCapturedArgsCount = -1
+    ): bool;
+
+    /**
+     * Supported only when the extension uses Zend Observer API (PHP 8+).
+     *
+     * @param string                       $functionName
+     * @param callable(mixed[]): ?callable $preHook
+     * @param int                          $maxCapturedArgsCount $preHook gets only the first $maxCapturedArgsCount
+     *                                                           arguments of the intercepted call (all of them if negative)
+     *
+     * @return bool false if intercepting calls to user code is not supported
+     */
+    public function interceptCallsToUserFunction(
+        string $functionName,
+        callable $preHook,
+        int $maxCapturedArgsCount = -1
+    ): bool;
 }
@@ -35,6 +35,7 @@ use Elastic\Apm\Impl\Log\Logger;
 use Elastic\Apm\Impl\Span;
 use Elastic\Apm\Impl\Tracer;
 use Elastic\Apm\Impl\Transaction;
+use Elastic\Apm\Impl\TransactionBuilder;
 use Elastic\Apm\Impl\Util\ArrayUtil;
 use Elastic\Apm\Impl\Util\DbgUtil;
 use Elastic\Apm\Impl\Util\TextUtil;
@@ -86,12 +87,12 @@ final class TransactionForExtensionRequest
     /** @var ?InferredSpansManager  */
     private $inferredSpansManager = null;
 
-    public function __construct(Tracer $tracer, float $requestInitStartTime)
+    public function __construct(Tracer $tracer, float $requestInitStartTime, ?bool $isSampledDecidedByExtension = null)
     {
         $this->tracer = $tracer;
         $this->logger = $tracer->loggerFactory()->loggerForClass(LogCategory::AUTO_INSTRUMENTATION, __NAMESPACE__, __CLASS__, __FILE__);
 
-        $this->transactionForRequest = $this->beginTransaction($requestInitStartTime);
+        $this->transactionForRequest = $this->beginTransaction($requestInitStartTime, $isSampledDecidedByExtension);
         if ($this->transactionForRequest instanceof Transaction && $this->transactionForRequest->isSampled()) {
             $this->inferredSpansManager = new InferredSpansManager($tracer);
         }
@@ -159,7 +160,12 @@ final class TransactionForExtensionRequest
         return $this->tracer->getConfig();
     }
 
-    private function beginTransaction(float $requestInitStartTime): ?TransactionInterface
+    public function isTransactionForRequestSampled(): bool
+    {
+        return $this->transactionForRequest instanceof Transaction && $this->transactionForRequest->isSampled();
+    }
+
+    private function beginTransaction(float $requestInitStartTime, ?bool $isSampledDecidedByExtension): ?TransactionInterface
     {
         if (!self::isCliScript()) {
             if (!$this->discoverHttpRequestData()) {
@@ -173,11 +179,12 @@ final class TransactionForExtensionRequest
         $distributedTracingHeaderExtractor = function (string $headerName) use ($distributedTracingHeaders): ?string {
             return ArrayUtil::getValueIfKeyExistsElse($headerName, $distributedTracingHeaders, null);
         };
-        $tx = $this->tracer->newTransaction($name, $type)
-                           ->asCurrent()
-                           ->timestamp($timestamp)
-                           ->distributedTracingHeaderExtractor($distributedTracingHeaderExtractor)
-                           ->begin();
+        $txBuilder = new TransactionBuilder($this->tracer, $name, $type);
+        $txBuilder->isSampledDecidedByExtension = $isSampledDecidedByExtension;
+        $tx = $txBuilder->asCurrent()
+                        ->timestamp($timestamp)
+                        ->distributedTracingHeaderExtractor($distributedTracingHeaderExtractor)
+                        ->begin();
         if (!self::isCliScript() && !$tx->isNoop()) {
             $this->setTxPropsBasedOnHttpRequestData($tx);
         }
@@ -364,6 +371,19 @@ final class TransactionForExtensionRequest
         }
     }
 
+    /**
+     * Memory and GC counters are captured by the extension on request init and shutdown.
+     * They are attached as numeric labels so that they can be aggregated per transaction name.
+     *
+     * @param array<string, int> $memoryStats
+     */
+    private static function addMemoryStatsLabels(TransactionInterface $tx, array $memoryStats): void
+    {
+        foreach ($memoryStats as $statName => $statValue) {
+            $tx->context()->setLabel('php_' . $statName, $statValue);
+        }
+    }
+
     private function logGcStatus(): void
     {
         if (!function_exists('gc_status')) {
@@ -460,7 +480,10 @@ final class TransactionForExtensionRequest
         throw $thrown;
     }
 
-    public function onShutdown(): void
+    /**
+     * @param ?array<string, int> $memoryStats
+     */
+    public function onShutdown(?array $memoryStats = null): void
     {
         ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
         && $loggerProxy->log('Entered');
@@ -480,6 +503,10 @@ final class TransactionForExtensionRequest
             $this->beforeHttpEnd($tx);
         }
 
+        if ($memoryStats !== null) {
+            self::addMemoryStatsLabels($tx, $memoryStats);
+        }
+
         $tx->end();
 
         if ($this->tracer->getConfig()->devInternal()->gcCollectCyclesAfterEveryTransaction()) {
@@ -25,6 +25,7 @@ namespace Elastic\Apm\Impl\AutoInstrument\Util;
 
 use Closure;
 use Elastic\Apm\ElasticApm;
+use Elastic\Apm\ExecutionSegmentInterface;
 use Elastic\Apm\Impl\Log\LogCategory;
 use Elastic\Apm\Impl\Log\Logger;
 use Elastic\Apm\Impl\Log\LoggerFactory;
@@ -77,6 +78,28 @@ final class AutoInstrumentationUtil
         return $span;
     }
 
+    /**
+     * Begins span for a call that has already ended - so the span is not current
+     * and its stack trace captured on end would not be the call's one
+     */
+    public static function beginChildSpanForEndedCall(
+        ExecutionSegmentInterface $parent,
+        string $name,
+        string $type,
+        ?string $subtype,
+        ?string $action,
+        float $timestamp
+    ): SpanInterface {
+        $span = $parent->beginChildSpan($name, $type, $subtype, $action, $timestamp);
+
+        self::processNewSpan($span);
+        if ($span instanceof Span) {
+            $span->disableStackTraceCapture();
+        }
+
+        return $span;
+    }
+
     /**
      * @param string   $name
      * @param string   $type
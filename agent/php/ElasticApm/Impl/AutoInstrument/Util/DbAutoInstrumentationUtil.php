@@ -23,6 +23,8 @@ declare(strict_types=1);
 
 namespace Elastic\Apm\Impl\AutoInstrument\Util;
 
+use Elastic\Apm\ExecutionSegmentInterface;
+use Elastic\Apm\Impl\AutoInstrument\FastPathSpanData;
 use Elastic\Apm\Impl\Constants;
 use Elastic\Apm\Impl\Span;
 use Elastic\Apm\Impl\Util\StaticClassTrait;
@@ -58,6 +60,45 @@ final class DbAutoInstrumentationUtil
         return $span;
     }
 
+    /**
+     * Builds span for a DB call timed by the extension (see RegistrationContextInterface::interceptCallsToInternalMethodAsFastPathSpan())
+     */
+    public static function buildDbSpanFromFastPath(
+        ExecutionSegmentInterface $parent,
+        FastPathSpanData $data,
+        ?string $className,
+        string $funcName,
+        string $dbType,
+        ?string $dbName
+    ): void {
+        $span = AutoInstrumentationUtil::beginChildSpanForEndedCall(
+            $parent,
+            $data->statement ?? AutoInstrumentationUtil::buildSpanNameFromCall($className, $funcName),
+            Constants::SPAN_TYPE_DB,
+            $dbType /* <- subtype */,
+            Constants::SPAN_ACTION_QUERY,
+            $data->timestamp
+        );
+        if ($span->isNoop()) {
+            return;
+        }
+
+        // Span dropped because of transaction_max_spans is still ended so that it is counted but its context is not needed
+        if (!($span instanceof Span) || $span->shouldBeSentToApmServer()) {
+            $span->context()->db()->setStatement($data->statement);
+            self::setServiceForDbSpan($span, $dbType, $dbName);
+            if ($data->hasFailed()) {
+                $span->setOutcome(Constants::OUTCOME_FAILURE);
+            }
+        }
+
+        if ($data->thrown !== null) {
+            $span->createErrorFromThrowable($data->thrown);
+        }
+
+        $span->end($data->duration);
+    }
+
     public static function setServiceForDbSpan(SpanInterface $span, string $dbType, ?string $dbName): void
     {
         $destinationServiceResource = $dbType;
@@ -35,6 +35,7 @@ use Elastic\Apm\Impl\Log\LoggerFactory;
 use Elastic\Apm\Impl\Metadata;
 use Elastic\Apm\Impl\MetricSet;
 use Elastic\Apm\Impl\Transaction;
+use Elastic\Apm\Impl\Util\ArrayUtil;
 
 /**
  * Code in this file is part of implementation internals and thus it is not covered by the backward compatibility.
@@ -92,6 +93,7 @@ final class EventSender implements EventSinkInterface
         Metadata $metadata,
         array $spans,
         array $errors,
+        array $metricSets,
         ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction,
         ?Transaction $transaction
     ): void {
@@ -102,44 +104,6 @@ final class EventSender implements EventSinkInterface
             );
         }
 
-        $serializedMetadata = '{"metadata":';
-        $serializedMetadata .= SerializationUtil::serializeAsJson($metadata);
-        $serializedMetadata .= "}";
-
-        $serializedEvents = $serializedMetadata;
-
-        foreach ($spans as $span) {
-            $serializedEvents .= "\n";
-            $serializedEvents .= '{"span":';
-            $serializedEvents .= SerializationUtil::serializeAsJson($span);
-            $serializedEvents .= '}';
-        }
-
-        foreach ($errors as $error) {
-            $serializedEvents .= "\n";
-            $serializedEvents .= '{"error":';
-            $serializedEvents .= SerializationUtil::serializeAsJson($error);
-            $serializedEvents .= '}';
-        }
-
-        if ($breakdownMetricsPerTransaction !== null) {
-            $breakdownMetricsPerTransaction->forEachMetricSet(
-                function (MetricSet $metricSet) use (&$serializedEvents) {
-                    $serializedEvents .= "\n";
-                    $serializedEvents .= '{"metricset":';
-                    $serializedEvents .= SerializationUtil::serializeAsJson($metricSet);
-                    $serializedEvents .= '}';
-                }
-            );
-        }
-
-        if ($transaction !== null) {
-            $serializedEvents .= "\n";
-            $serializedEvents .= '{"transaction":';
-            $serializedEvents .= SerializationUtil::serializeAsJson($transaction);
-            $serializedEvents .= "}";
-        }
-
         if ($this->config->devInternal()->dropEventsBeforeSendCCode()) {
             ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
             && $loggerProxy->log(
@@ -147,23 +111,57 @@ final class EventSender implements EventSinkInterface
                 . OptionNames::DEV_INTERNAL . ' sub-option ' . DevInternalSubOptionNames::DROP_EVENTS_BEFORE_SEND_C_CODE
                 . ' is set'
             );
-        } else {
-            ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
-            && $loggerProxy->log(
-                'Calling elastic_apm_send_to_server...',
-                [
-                    'userAgentHttpHeader'      => $this->userAgentHttpHeader,
-                    'strlen(serializedEvents)' => strlen($serializedEvents),
-                ]
+            return;
+        }
+
+        $allMetricSets = $metricSets;
+        if ($breakdownMetricsPerTransaction !== null) {
+            $breakdownMetricsPerTransaction->forEachMetricSet(
+                function (MetricSet $metricSet) use (&$allMetricSets) {
+                    $allMetricSets[] = $metricSet;
+                }
             );
+        }
 
-            /**
-             * elastic_apm_* functions are provided by the elastic_apm extension
-             *
-             * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
-             * @phpstan-ignore-next-line
-             */
-            \elastic_apm_send_to_server($this->userAgentHttpHeader, $serializedEvents);
+        // Span sends are batched: spans ended before their transaction are kept (already serialized) by the extension
+        // and sent together with it
+        $shouldOnlyBuffer = ($transaction === null) && ArrayUtil::isEmpty($errors) && ArrayUtil::isEmpty($allMetricSets);
+        $nativeFunctionName = $shouldOnlyBuffer ? 'elastic_apm_buffer_events' : 'elastic_apm_send_events_to_server';
+
+        ($loggerProxy = $this->logger->ifTraceLevelEnabled(__LINE__, __FUNCTION__))
+        && $loggerProxy->log(
+            'Calling ' . $nativeFunctionName . '...',
+            [
+                'userAgentHttpHeader'  => $this->userAgentHttpHeader,
+                'count(spans)'         => count($spans),
+                'count(errors)'        => count($errors),
+                'count(metricSets)'    => count($allMetricSets),
+                'transaction !== null' => $transaction !== null,
+            ]
+        );
+
+        /**
+         * Events are serialized as NDJSON by the extension directly into the buffer that is sent to APM Server
+         * (using events' jsonSerialize() the same way json_encode would)
+         *
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $isSuccess = $shouldOnlyBuffer
+            ? \elastic_apm_buffer_events($this->userAgentHttpHeader, $metadata, $spans, $errors, $allMetricSets, $transaction)
+            : \elastic_apm_send_events_to_server(
+                $this->userAgentHttpHeader,
+                $metadata,
+                $spans,
+                $errors,
+                $allMetricSets,
+                $transaction
+            );
+        if (!$isSuccess) {
+            ($loggerProxy = $this->logger->ifErrorLevelEnabled(__LINE__, __FUNCTION__))
+            && $loggerProxy->log($nativeFunctionName . ' failed');
         }
     }
 }
@@ -36,6 +36,7 @@ interface EventSinkInterface
      * @param Metadata                        $metadata
      * @param SpanToSendInterface[]           $spans
      * @param Error[]                         $errors
+     * @param MetricSet[]                     $metricSets
      * @param ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction
      * @param ?Transaction                    $transaction
      */
@@ -43,6 +44,7 @@ interface EventSinkInterface
         Metadata $metadata,
         array $spans,
         array $errors,
+        array $metricSets,
         ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction,
         ?Transaction $transaction
     ): void;
@@ -23,6 +23,7 @@ declare(strict_types=1);
 
 namespace Elastic\Apm\Impl;
 
+use Elastic\Apm\Impl\Util\ElasticApmExtensionUtil;
 use Elastic\Apm\Impl\Util\StaticClassTrait;
 
 /**
@@ -45,7 +46,10 @@ final class GlobalTracerHolder
     public static function getValue(): TracerInterface
     {
         if (self::$singletonInstance === null) {
-            self::$singletonInstance = TracerBuilder::startNew()->build();
+            // Public API used by the request the extension decided to ignore should not build a full tracer
+            self::$singletonInstance = ElasticApmExtensionUtil::isRequestIgnored()
+                ? NoopTracer::singletonInstance()
+                : TracerBuilder::startNew()->build();
         }
         return self::$singletonInstance;
     }
@@ -99,6 +99,11 @@ final class InferredSpanFrame implements SpanToSendInterface, LoggableInterface
      */
     public function canBeExtendedWith(ClassicFormatStackTraceFrame $stackFrame): bool
     {
+        // Frames converted from the table of interned frames are shared so identity check is enough for most of them
+        if ($this->stackFrame === $stackFrame) {
+            return true;
+        }
+
         return $this->stackFrame->class === $stackFrame->class
                && $this->stackFrame->function === $stackFrame->function
                && $this->stackFrame->file === $stackFrame->file;
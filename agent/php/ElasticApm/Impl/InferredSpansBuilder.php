@@ -125,9 +125,11 @@ final class InferredSpansBuilder implements LoggableInterface
                 && $openParentFrame !== null
                 && $openParentFrame->stackFrame->line !== $newStackTraceParentFrame->line
             ) {
-                // We need to capture stack trace we update line below
-                $frameCopy = clone $openParentFrame->stackFrame;
+                // We need to capture stack trace before we update line below.
+                // Open frame gets its own instance because the original one might be shared with the table of interned frames.
+                $frameCopy = $openParentFrame->stackFrame;
                 $frameCopyIndex = $i - 1;
+                $openParentFrame->stackFrame = clone $frameCopy;
                 $openParentFrame->stackFrame->line = $newStackTraceParentFrame->line;
                 ($loggerProxy = $this->logger->ifTraceLevelEnabled(__LINE__, __FUNCTION__))
                 && $loggerProxy->log(
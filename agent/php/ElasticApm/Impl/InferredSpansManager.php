@@ -31,6 +31,8 @@ use Elastic\Apm\Impl\Log\LoggableTrait;
 use Elastic\Apm\Impl\Log\Logger;
 use Elastic\Apm\Impl\Log\LogStreamInterface;
 use Elastic\Apm\Impl\Util\Assert;
+use Elastic\Apm\Impl\Util\ClassicFormatStackTraceFrame;
+use Elastic\Apm\Impl\Util\StackTraceUtil;
 
 /**
  * Code in this file is part of implementation internals and thus it is not covered by the backward compatibility.
@@ -41,6 +43,11 @@ final class InferredSpansManager implements LoggableInterface
 {
     use LoggableTrait;
 
+    public const SAMPLING_INTERVAL_SAMPLE_KEY = 'agent.inferred_spans.sampling_interval.ms';
+    public const SAMPLES_COUNT_SAMPLE_KEY = 'agent.inferred_spans.samples.count';
+    public const SAMPLING_TIME_SAMPLE_KEY = 'agent.inferred_spans.sampling_time.us';
+    public const OVERHEAD_SAMPLE_KEY = 'agent.inferred_spans.overhead.ratio';
+
     private const STATE_SHUTDOWN = 'shutdown';
     private const STATE_WAITING_FOR_NO_SPANS = 'waiting_for_no_spans';
     private const STATE_WAITING_FOR_NEW_TRANSACTION = 'waiting_for_no_spans';
@@ -70,6 +77,12 @@ final class InferredSpansManager implements LoggableInterface
     /** @var null|Closure(?Span): void */
     private $onCurrentSpanChangedCallback = null;
 
+    /** @var array<int, ClassicFormatStackTraceFrame> Frames interned by the extension for the current request indexed by frame ID */
+    private $nativeInternedFrames = [];
+
+    /** @var ?int[] Frame IDs of the last native sample passed to the current builder */
+    private $lastNativeSampleFrameIds = null;
+
     public function __construct(Tracer $tracer)
     {
         $this->tracer = $tracer;
@@ -120,21 +133,68 @@ final class InferredSpansManager implements LoggableInterface
         return true;
     }
 
-    public function handleAutomaticCapturing(int $duration): void
+    /**
+     * Called by elastic_apm extension when its buffer of stack samples is full
+     */
+    public function handleAutomaticCapturing(): void
     {
         ($loggerProxy = $this->logger->ifTraceLevelEnabled(__LINE__, __FUNCTION__))
         && $loggerProxy->log('Entered');
 
-        if (!$this->isShutdown() && $this->builder !== null) {
-            $stackTrace = $this->builder->captureStackTrace(/* offset */ 1);
+        $this->consumeNativeSamples();
+
+        ($loggerProxy = $this->logger->ifTraceLevelEnabled(__LINE__, __FUNCTION__))
+        && $loggerProxy->log('Exiting');
+    }
+
+    /**
+     * Stack samples are captured by the extension and buffered natively.
+     * Frames are interned by the extension and each sample is a list of frame IDs,
+     * frames interned since the previous call are appended to the table kept by this manager.
+     * Samples taken while there is no builder (for example while there is a span in progress) are dropped.
+     */
+    private function consumeNativeSamples(): void
+    {
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @var mixed $taken
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $taken = \elastic_apm_take_inferred_spans_samples();
+        if (!is_array($taken) || count($taken) !== 3) {
+            return;
+        }
+        /** @var array{int, array<?scalar>, array<array{int, int[]}>} $taken */
+
+        // The table has to be kept in sync with the extension even when the samples are dropped
+        $frameId = $taken[0];
+        if ($frameId === 0) {
+            $this->nativeInternedFrames = [];
+            $this->lastNativeSampleFrameIds = null;
+        }
+        foreach (StackTraceUtil::convertCompactToClassicFormat($taken[1]) as $frame) {
+            $this->nativeInternedFrames[$frameId++] = $frame;
+        }
+
+        if ($this->isShutdown() || $this->builder === null) {
+            return;
+        }
 
+        foreach ($taken[2] as $sample) {
+            // Sample identical to the previous one extends all the open frames so it cannot change anything
+            if ($sample[1] === $this->lastNativeSampleFrameIds) {
+                continue;
+            }
+            $this->lastNativeSampleFrameIds = $sample[1];
+
+            $stackTrace = $this->tracer->stackTraceUtil()->convertInternedToClassicFormatExcludeElasticApm($sample[1], $this->nativeInternedFrames);
             if (count($stackTrace) > 0) {
-                $this->builder->addStackTrace($stackTrace, $duration);
+                $this->builder->addStackTrace($stackTrace, $sample[0]);
             }
         }
-
-        ($loggerProxy = $this->logger->ifTraceLevelEnabled(__LINE__, __FUNCTION__))
-        && $loggerProxy->log('Exiting');
     }
 
     private function flushAndPause(): void
@@ -146,9 +206,12 @@ final class InferredSpansManager implements LoggableInterface
             return;
         }
 
+        $this->consumeNativeSamples();
+
         if ($this->builder !== null) {
             $this->builder->close();
             $this->builder = null;
+            $this->lastNativeSampleFrameIds = null;
         }
     }
 
@@ -235,6 +298,7 @@ final class InferredSpansManager implements LoggableInterface
         );
 
         $this->flushAndPause();
+        $this->addSamplingMetrics($transaction);
 
         ($assertProxy = Assert::ifEnabled())
         && $assertProxy->that($this->onCurrentTransactionAboutToEndCallback !== null)
@@ -254,6 +318,35 @@ final class InferredSpansManager implements LoggableInterface
         $this->state = self::STATE_WAITING_FOR_NEW_TRANSACTION;
     }
 
+    /**
+     * Effective sampling interval (it may be raised by the extension to stay within overhead budget)
+     * and the cost of sampling measured by the extension are sent as agent metrics along with the transaction
+     */
+    private function addSamplingMetrics(Transaction $transaction): void
+    {
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @var mixed $stats
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $stats = \elastic_apm_get_inferred_spans_stats();
+        if (!is_array($stats) || count($stats) !== 4) {
+            return;
+        }
+        /** @var array{int, int, int, float} $stats */
+
+        $metricSet = new MetricSet();
+        $metricSet->timestamp = $this->tracer->getClock()->getSystemClockCurrentTime();
+        $metricSet->setSample(self::SAMPLING_INTERVAL_SAMPLE_KEY, $stats[0]);
+        $metricSet->setSample(self::SAMPLES_COUNT_SAMPLE_KEY, $stats[1]);
+        $metricSet->setSample(self::SAMPLING_TIME_SAMPLE_KEY, $stats[2]);
+        $metricSet->setSample(self::OVERHEAD_SAMPLE_KEY, $stats[3]);
+        $transaction->addMetricSetToSend($metricSet);
+    }
+
     private function onCurrentSpanChanged(?Span $span): void
     {
         ($loggerProxy = $this->logger->ifTraceLevelEnabled(__LINE__, __FUNCTION__))
@@ -268,6 +361,8 @@ final class InferredSpansManager implements LoggableInterface
                 return;
             }
 
+            // drop samples taken while the span was in progress
+            $this->consumeNativeSamples();
             $this->builder = new InferredSpansBuilder($this->tracer);
             $this->state = self::STATE_RUNNING;
             return;
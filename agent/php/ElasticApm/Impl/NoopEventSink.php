@@ -40,6 +40,7 @@ final class NoopEventSink implements EventSinkInterface
         Metadata $metadata,
         array $spans,
         array $errors,
+        array $metricSets,
         ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction,
         ?Transaction $transaction
     ): void {
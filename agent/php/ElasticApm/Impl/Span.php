@@ -79,6 +79,9 @@ final class Span extends ExecutionSegment implements SpanInterface, SpanToSendIn
     /** @var bool */
     private $isCompressible = false;
 
+    /** @var bool Span built after the call has ended (for example from fast path span) has no meaningful stack trace on end */
+    private $isStackTraceCaptureEnabled = true;
+
     /** @var ?SpanComposite */
     public $composite = null;
 
@@ -205,6 +208,11 @@ final class Span extends ExecutionSegment implements SpanInterface, SpanToSendIn
         $this->isCompressible = $isCompressible;
     }
 
+    public function disableStackTraceCapture(): void
+    {
+        $this->isStackTraceCaptureEnabled = false;
+    }
+
     /** @inheritDoc */
     public function getDistributedTracingDataInternal(): ?DistributedTracingDataInternal
     {
@@ -474,6 +482,10 @@ final class Span extends ExecutionSegment implements SpanInterface, SpanToSendIn
      */
     public function endSpanEx(int $numberOfStackFramesToSkip, ?float $duration = null): void
     {
+        if (!$this->hasEnded() && $this->containingTransaction->getCurrentSpan() === $this) {
+            $this->containingTransaction->onCurrentExecutionSegmentAboutToChange->callCallbacks($this);
+        }
+
         if (!$this->endExecutionSegment($duration)) {
             return;
         }
@@ -481,7 +493,7 @@ final class Span extends ExecutionSegment implements SpanInterface, SpanToSendIn
         $this->onAboutToEnd->callCallbacks($this);
 
         if ($this->shouldBeSentToApmServer()) {
-            if ($this->containingTransaction->shouldCollectStackTraceForSpanDuration($this->duration)) {
+            if ($this->isStackTraceCaptureEnabled && $this->containingTransaction->shouldCollectStackTraceForSpanDuration($this->duration)) {
                 $this->stackTrace = $this->containingTransaction->captureApmFormatStackTrace($numberOfStackFramesToSkip + 1);
             }
             $this->prepareForSerialization();
@@ -470,10 +470,11 @@ final class Tracer implements TracerInterface, LoggableInterface
     /**
      * @param SpanToSendInterface[]           $spans
      * @param Error[]                         $errors
+     * @param MetricSet[]                     $metricSets
      * @param ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction
      * @param ?Transaction                    $transaction
      */
-    private function sendEventsToApmServer(array $spans, array $errors, ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction, ?Transaction $transaction): void
+    private function sendEventsToApmServer(array $spans, array $errors, array $metricSets, ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction, ?Transaction $transaction): void
     {
         if ($this->config->devInternal()->dropEventAfterEnd()) {
             ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
@@ -493,6 +494,7 @@ final class Tracer implements TracerInterface, LoggableInterface
             $this->cachedMetadata,
             $spans,
             $errors,
+            $metricSets,
             $breakdownMetricsPerTransaction,
             $transaction
         );
@@ -503,6 +505,7 @@ final class Tracer implements TracerInterface, LoggableInterface
         self::sendEventsToApmServer(
             [$span] /* <- spans */,
             [] /* <- errors */,
+            [] /* <- metricSets */,
             null /* <- breakdownMetricsPerTransaction */,
             null /* <- transaction */
         );
@@ -513,18 +516,26 @@ final class Tracer implements TracerInterface, LoggableInterface
         self::sendEventsToApmServer(
             [] /* <- spans */,
             [$error],
+            [] /* <- metricSets */,
             null /* <- breakdownMetricsPerTransaction */,
             null /* <- transaction */
         );
     }
 
+    /**
+     * @param MetricSet[]                     $metricSets
+     * @param ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction
+     * @param Transaction                     $transaction
+     */
     public function sendTransactionToApmServer(
+        array $metricSets,
         ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction,
         Transaction $transaction
     ): void {
         self::sendEventsToApmServer(
             [] /* <- spans */,
             [] /* <- errors */,
+            $metricSets,
             $breakdownMetricsPerTransaction,
             $transaction
         );
@@ -84,6 +84,9 @@ final class Transaction extends ExecutionSegment implements TransactionInterface
     /** @var ?BreakdownMetricsPerTransaction */
     private $breakdownMetricsPerTransaction = null;
 
+    /** @var MetricSet[] Agent metrics sent along with this transaction */
+    private $metricSetsToSend = [];
+
     /** @var ?string */
     private $outgoingTraceState;
 
@@ -93,6 +96,14 @@ final class Transaction extends ExecutionSegment implements TransactionInterface
     /** @var ObserverSet<?Span> */
     public $onCurrentSpanChanged;
 
+    /**
+     * Called with the current execution segment before a new current span begins
+     * or before the current execution segment ends (while it still can have children)
+     *
+     * @var ObserverSet<ExecutionSegment>
+     */
+    public $onCurrentExecutionSegmentAboutToChange;
+
     /** @var ?bool */
     private $cachedIsSpanCompressionEnabled = null;
 
@@ -114,7 +125,7 @@ final class Transaction extends ExecutionSegment implements TransactionInterface
         if ($distributedTracingData === null) {
             $traceId = IdGenerator::generateId(Constants::TRACE_ID_SIZE_IN_BYTES);
             $sampleRate = $this->tracer->getConfig()->transactionSampleRate();
-            $isSampled = self::makeSamplingDecision($sampleRate);
+            $isSampled = $builder->isSampledDecidedByExtension ?? self::makeSamplingDecision($sampleRate);
             /**
              * @link https://github.com/elastic/apm/blob/main/specs/agents/tracing-sampling.md#non-sampled-transactions
              * For non-sampled transactions set the transaction attributes sampled: false and sample_rate: 0
@@ -147,6 +158,7 @@ final class Transaction extends ExecutionSegment implements TransactionInterface
         $this->isSampled = $isSampled;
 
         $this->onCurrentSpanChanged = new ObserverSet();
+        $this->onCurrentExecutionSegmentAboutToChange = new ObserverSet();
         $this->onAboutToEnd = new ObserverSet();
 
         ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
@@ -306,22 +318,42 @@ final class Transaction extends ExecutionSegment implements TransactionInterface
         return $this->currentSpan ?? $this;
     }
 
+    public function hasReachedMaxSpans(): bool
+    {
+        return $this->startedSpansCount >= $this->config->transactionMaxSpans();
+    }
+
     public function tryToAllocateStartedSpan(): bool
     {
-        if ($this->startedSpansCount < $this->config->transactionMaxSpans()) {
+        if (!$this->hasReachedMaxSpans()) {
             ++$this->startedSpansCount;
             return true;
         }
 
-        ++$this->droppedSpansCount;
-        if ($this->droppedSpansCount === 1) {
+        $this->addDroppedSpansCount(1);
+        return false;
+    }
+
+    /**
+     * Spans can be dropped without being begun at all
+     * (for example calls not recorded by the extension or not turned into spans because of transaction_max_spans)
+     * - they are only counted
+     */
+    public function addDroppedSpansCount(int $count): void
+    {
+        if ($count <= 0) {
+            return;
+        }
+
+        $isFirstDropped = ($this->droppedSpansCount === 0);
+        $this->droppedSpansCount += $count;
+        if ($isFirstDropped) {
             ($loggerProxy = $this->logger->ifDebugLevelEnabled(__LINE__, __FUNCTION__))
             && $loggerProxy->log(
-                'Starting to drop spans because of ' . OptionNames::TRANSACTION_MAX_SPANS . ' config',
+                'Starting to drop spans',
                 [OptionNames::TRANSACTION_MAX_SPANS . ' config' => $this->config->transactionMaxSpans()]
             );
         }
-        return false;
     }
 
     public function beginSpan(
@@ -405,6 +437,7 @@ final class Transaction extends ExecutionSegment implements TransactionInterface
         ?string $action = null,
         ?float $timestamp = null
     ): SpanInterface {
+        $this->onCurrentExecutionSegmentAboutToChange->callCallbacks($this->currentSpan ?? $this);
         $newCurrentSpan = $this->beginSpan(
             $this->currentSpan ?? $this /* <- parentExecutionSegment */,
             $name,
@@ -515,6 +548,10 @@ final class Transaction extends ExecutionSegment implements TransactionInterface
     /** @inheritDoc */
     public function end(?float $duration = null): void
     {
+        if (!$this->hasEnded()) {
+            $this->onCurrentExecutionSegmentAboutToChange->callCallbacks($this->currentSpan ?? $this);
+        }
+
         if (!$this->endExecutionSegment($duration)) {
             return;
         }
@@ -523,13 +560,21 @@ final class Transaction extends ExecutionSegment implements TransactionInterface
 
         $this->prepareForSerialization();
 
-        $this->tracer->sendTransactionToApmServer($this->breakdownMetricsPerTransaction, $this);
+        $this->tracer->sendTransactionToApmServer($this->metricSetsToSend, $this->breakdownMetricsPerTransaction, $this);
 
         if ($this->tracer->getCurrentTransaction() === $this) {
             $this->tracer->resetCurrentTransaction();
         }
     }
 
+    /**
+     * Metric set added before the transaction ends (for example by onAboutToEnd callback) is sent along with it
+     */
+    public function addMetricSetToSend(MetricSet $metricSet): void
+    {
+        $this->metricSetsToSend[] = $metricSet;
+    }
+
     public function addSpanSelfTime(string $spanType, ?string $spanSubtype, float $spanSelfTimeInMicroseconds): void
     {
         if ($this->beforeMutating() || !$this->tracer->isRecording()) {
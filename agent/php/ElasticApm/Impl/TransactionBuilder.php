@@ -55,6 +55,13 @@ final class TransactionBuilder implements TransactionBuilderInterface
     /** @var ?string */
     public $serializedDistTracingData = null;
 
+    /**
+     * Used instead of making sampling decision for transaction that does not continue incoming trace
+     *
+     * @var ?bool
+     */
+    public $isSampledDecidedByExtension = null;
+
     public function __construct(Tracer $tracer, string $name, string $type)
     {
         $this->tracer = $tracer;
@@ -56,4 +56,23 @@ final class ElasticApmExtensionUtil
          */
         return \elastic_apm_is_enabled();
     }
+
+    /**
+     * The extension decides on request init whether the request is ignored (transaction_ignore_urls)
+     * and in that case it does not bootstrap PHP part
+     */
+    public static function isRequestIgnored(): bool
+    {
+        if (!self::isLoaded()) {
+            return false;
+        }
+
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        return \elastic_apm_is_request_ignored();
+    }
 }
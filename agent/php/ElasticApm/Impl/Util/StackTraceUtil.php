@@ -50,6 +50,8 @@ final class StackTraceUtil
     public const FILE_NAME_NOT_AVAILABLE_SUBSTITUTE = 'FILE NAME N/A';
     public const LINE_NUMBER_NOT_AVAILABLE_SUBSTITUTE = 0;
 
+    public const COMPACT_FRAME_SIZE = 5;
+
     private const ELASTIC_APM_FQ_NAME_PREFIX = 'Elastic\\Apm\\';
     private const ELASTIC_APM_INTERNAL_FUNCTION_NAME_PREFIX = 'elastic_apm_';
 
@@ -150,6 +152,68 @@ final class StackTraceUtil
         );
     }
 
+    /**
+     * Converts frames captured by the extension where each frame is represented by
+     * COMPACT_FRAME_SIZE consecutive values: file, line, class, function, is static method
+     *
+     * @param array<?scalar> $compactFrames
+     *
+     * @return ClassicFormatStackTraceFrame[]
+     */
+    public static function convertCompactToClassicFormat(array $compactFrames): array
+    {
+        $classicFormatFrames = [];
+        $compactFramesCount = count($compactFrames);
+        for ($i = 0; $i + self::COMPACT_FRAME_SIZE <= $compactFramesCount; $i += self::COMPACT_FRAME_SIZE) {
+            /** @var ?string $file */
+            $file = $compactFrames[$i];
+            /** @var ?int $line */
+            $line = $compactFrames[$i + 1];
+            /** @var ?string $class */
+            $class = $compactFrames[$i + 2];
+            /** @var ?string $function */
+            $function = $compactFrames[$i + 3];
+            /** @var ?bool $isStaticMethod */
+            $isStaticMethod = $compactFrames[$i + 4];
+            $classicFormatFrames[] = new ClassicFormatStackTraceFrame($file, $line, $class, $isStaticMethod, $function);
+        }
+
+        return $classicFormatFrames;
+    }
+
+    /**
+     * @param array<?scalar> $compactFrames
+     *
+     * @return ClassicFormatStackTraceFrame[]
+     *
+     * @see convertCompactToClassicFormat
+     */
+    public function convertCompactToClassicFormatExcludeElasticApm(array $compactFrames): array
+    {
+        return $this->excludeCodeToHide(self::convertCompactToClassicFormat($compactFrames), /* maxNumberOfFrames */ null);
+    }
+
+    /**
+     * Converts frames captured by the extension as ids in the table of interned frames.
+     * Returned frames are the instances from the table (not copies) so they should not be modified.
+     *
+     * @param int[]                                   $frameIds
+     * @param array<int, ClassicFormatStackTraceFrame> $internedFrames
+     *
+     * @return ClassicFormatStackTraceFrame[]
+     */
+    public function convertInternedToClassicFormatExcludeElasticApm(array $frameIds, array $internedFrames): array
+    {
+        $allClassicFormatFrames = [];
+        foreach ($frameIds as $frameId) {
+            if (array_key_exists($frameId, $internedFrames)) {
+                $allClassicFormatFrames[] = $internedFrames[$frameId];
+            }
+        }
+
+        return $this->excludeCodeToHide($allClassicFormatFrames, /* maxNumberOfFrames */ null);
+    }
+
     /**
      * @param array<array<mixed>> $phpFormatFrames
      * @param int                 $offset
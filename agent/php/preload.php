@@ -0,0 +1,76 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Loads all the classes of the agent's PHP part so that they are preloaded by opcache.
+ *
+ * Use it either directly as opcache.preload script
+ *
+ *      opcache.preload=<agent install dir>/src/preload.php
+ *
+ * or require it from the application's own preload script.
+ *
+ * When the agent's classes are preloaded the extension does not load elastic_apm.bootstrap_php_part_file
+ * on each request and the classes do not have to be autoloaded.
+ */
+
+declare(strict_types=1);
+
+use Elastic\Apm\Impl\AutoInstrument\Autoloader;
+use Elastic\Apm\Impl\AutoInstrument\BootstrapStageLogger;
+use Elastic\Apm\Impl\Log\Level;
+use Elastic\Apm\Impl\SrcRootDir;
+
+require __DIR__ . '/ElasticApm/Impl/SrcRootDir.php';
+SrcRootDir::$fullPath = __DIR__;
+
+require __DIR__ . '/ElasticApm/Impl/AutoInstrument/BootstrapStageLogger.php';
+require __DIR__ . '/ElasticApm/Impl/AutoInstrument/Autoloader.php';
+Autoloader::register();
+BootstrapStageLogger::configure(Level::WARNING);
+
+/** @var iterable<SplFileInfo> $srcFiles */
+$srcFiles = new RecursiveIteratorIterator(
+    new RecursiveDirectoryIterator(__DIR__ . DIRECTORY_SEPARATOR . 'ElasticApm', FilesystemIterator::SKIP_DOTS)
+);
+foreach ($srcFiles as $srcFile) {
+    // only files named after the class they declare - files like bootstrap_php_part.php have side effects
+    if (preg_match('/^[A-Z]\w*\.php$/', $srcFile->getFilename()) !== 1) {
+        continue;
+    }
+
+    $relativePath = substr($srcFile->getPathname(), strlen(__DIR__ . DIRECTORY_SEPARATOR), -strlen('.php'));
+    $fqClassName = 'Elastic\\Apm\\'
+        . substr(str_replace(DIRECTORY_SEPARATOR, '\\', $relativePath), strlen('ElasticApm\\'));
+    try {
+        // the autoloader loads the class together with its parents, interfaces and traits
+        if (!class_exists($fqClassName) && !interface_exists($fqClassName) && !trait_exists($fqClassName)) {
+            BootstrapStageLogger::logWarning("Nothing was declared by `$srcFile'", __LINE__, __FUNCTION__);
+        }
+    } catch (Throwable $throwable) {
+        BootstrapStageLogger::logCriticalThrowable(
+            $throwable,
+            "Failed to preload `$fqClassName'",
+            __LINE__,
+            __FUNCTION__
+        );
+    }
+}
@@ -0,0 +1,43 @@
+<?php
+
+/** @noinspection PhpIllegalPsrClassPathInspection */
+
+declare(strict_types=1);
+
+namespace ElasticApmTestsMockSrc\AstInstrumentationRules;
+
+use Generator;
+use RuntimeException;
+
+class MockRenderer
+{
+    /**
+     * @param string               $template
+     * @param int                  $count
+     * @param array<string, mixed> $context
+     *
+     * @return string
+     */
+    public function render(string $template, int $count, array $context): string
+    {
+        // Variables added by the instrumentation must not collide with the function's own ones
+        $elasticApmPostHook = null;
+        $postHook = null;
+        return str_repeat($template, $count) . '|' . count($context);
+    }
+}
+
+function mockHelperThatThrows(string $message): void
+{
+    throw new RuntimeException($message);
+}
+
+/**
+ * @return Generator<int>
+ */
+function mockGenerator(int $count): Generator
+{
+    for ($i = 0; $i < $count; ++$i) {
+        yield $i;
+    }
+}
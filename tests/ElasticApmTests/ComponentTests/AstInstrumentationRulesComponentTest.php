@@ -0,0 +1,159 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+
+declare(strict_types=1);
+
+namespace ElasticApmTests\ComponentTests;
+
+use Elastic\Apm\ElasticApm;
+use Elastic\Apm\Impl\AutoInstrument\Util\AutoInstrumentationUtil;
+use Elastic\Apm\Impl\Config\OptionNames;
+use ElasticApmTests\ComponentTests\Util\AgentConfigSourceKind;
+use ElasticApmTests\ComponentTests\Util\AppCodeHostParams;
+use ElasticApmTests\ComponentTests\Util\AppCodeTarget;
+use ElasticApmTests\ComponentTests\Util\ComponentTestCaseBase;
+use ElasticApmTests\ComponentTests\Util\ExpectedEventCounts;
+use ElasticApmTests\Util\AssertMessageStack;
+use Generator;
+use RuntimeException;
+
+/**
+ * Functions in mock_src/rule_instrumented_code.php are instrumented only by ast_instrumentation_rules -
+ * their bodies are wrapped at compile time with the pre-hook and try/catch/finally calling the post-hook.
+ *
+ * @group smoke
+ * @group does_not_require_external_services
+ */
+final class AstInstrumentationRulesComponentTest extends ComponentTestCaseBase
+{
+    private const MOCK_SRC_FILE_PATH_SUFFIX = 'AstInstrumentationRules/mock_src/rule_instrumented_code.php';
+    private const MOCK_NAMESPACE = 'ElasticApmTestsMockSrc\\AstInstrumentationRules';
+    private const MOCK_CLASS_SHORT_NAME = 'MockRenderer';
+    private const MOCK_METHOD_NAME = 'render';
+    private const MOCK_THROWING_FUNCTION_SHORT_NAME = 'mockHelperThatThrows';
+    private const MOCK_GENERATOR_FUNCTION_SHORT_NAME = 'mockGenerator';
+    private const MOCK_TEMPLATE_SPAN_TYPE = 'template';
+
+    private const TEMPLATE_ARG = 'ab';
+    private const COUNT_ARG = 3;
+    private const THROWN_MESSAGE = 'Exception thrown by rule instrumented function';
+
+    /**
+     * Tests in this class specifiy expected spans individually
+     * so Span Compression feature should be disabled.
+     *
+     * @inheritDoc
+     */
+    protected function isSpanCompressionCompatible(): bool
+    {
+        return false;
+    }
+
+    private static function buildRulesOptionValue(): string
+    {
+        return self::MOCK_SRC_FILE_PATH_SUFFIX . '|' . self::MOCK_NAMESPACE . '|' . self::MOCK_CLASS_SHORT_NAME . '|' . self::MOCK_METHOD_NAME
+               . '|0,1,2|' . self::MOCK_TEMPLATE_SPAN_TYPE
+               . ';'
+               // Empty span type falls back to "app"
+               . self::MOCK_SRC_FILE_PATH_SUFFIX . '|' . self::MOCK_NAMESPACE . '||' . self::MOCK_THROWING_FUNCTION_SHORT_NAME . '|0|'
+               . ';'
+               // Generator functions are not instrumented even if there is a rule for them
+               . self::MOCK_SRC_FILE_PATH_SUFFIX . '|' . self::MOCK_NAMESPACE . '||' . self::MOCK_GENERATOR_FUNCTION_SHORT_NAME . '|0|app';
+    }
+
+    public static function appCodeForTestRuleInstrumentedFunctions(): void
+    {
+        require_once __DIR__ . DIRECTORY_SEPARATOR . 'AstInstrumentationRules' . DIRECTORY_SEPARATOR . 'mock_src' . DIRECTORY_SEPARATOR . 'rule_instrumented_code.php';
+
+        $className = self::MOCK_NAMESPACE . '\\' . self::MOCK_CLASS_SHORT_NAME;
+        $renderer = new $className();
+        $renderResult = $renderer->{self::MOCK_METHOD_NAME}(self::TEMPLATE_ARG, self::COUNT_ARG, ['key' => 'value']);
+        // Wrapping the body must not change what the function returns
+        self::assertSame(str_repeat(self::TEMPLATE_ARG, self::COUNT_ARG) . '|1', $renderResult);
+
+        $throwingFunction = self::MOCK_NAMESPACE . '\\' . self::MOCK_THROWING_FUNCTION_SHORT_NAME;
+        self::assertTrue(is_callable($throwingFunction));
+        $caught = null;
+        try {
+            $throwingFunction(self::THROWN_MESSAGE);
+        } catch (RuntimeException $ex) {
+            $caught = $ex;
+        }
+        // The exception has to be rethrown by the injected try/catch/finally
+        self::assertNotNull($caught);
+        self::assertSame(self::THROWN_MESSAGE, $caught->getMessage());
+
+        $generatorFunction = self::MOCK_NAMESPACE . '\\' . self::MOCK_GENERATOR_FUNCTION_SHORT_NAME;
+        self::assertTrue(is_callable($generatorFunction));
+        $generator = $generatorFunction(self::COUNT_ARG);
+        self::assertInstanceOf(Generator::class, $generator);
+        self::assertSame(range(0, self::COUNT_ARG - 1), iterator_to_array($generator));
+
+        ElasticApm::getCurrentTransaction()->context()->setLabel('app_code_completed', true);
+    }
+
+    public function testRuleInstrumentedFunctions(): void
+    {
+        $testCaseHandle = $this->getTestCaseHandle();
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams): void {
+                self::disableTimingDependentFeatures($appCodeParams);
+                $appCodeParams->setAgentOption(OptionNames::AST_PROCESS_ENABLED, true);
+                // Rules are parsed on module init and the value contains INI special characters so it is passed as environment variable
+                $appCodeParams->setAgentOption('ast_instrumentation_rules', self::buildRulesOptionValue(), AgentConfigSourceKind::envVars());
+            }
+        );
+        $appCodeHost->sendRequest(AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestRuleInstrumentedFunctions']));
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent((new ExpectedEventCounts())->transactions(1)->spans(2)->errors(1));
+
+        AssertMessageStack::newScope(/* out */ $dbgCtx, ['dataFromAgent' => $dataFromAgent]);
+        $tx = $dataFromAgent->singleTransaction();
+        self::assertTrue(self::getLabel($tx, 'app_code_completed'));
+
+        $renderSpan = $dataFromAgent->singleSpanByName(
+            AutoInstrumentationUtil::buildSpanNameFromCall(self::MOCK_NAMESPACE . '\\' . self::MOCK_CLASS_SHORT_NAME, self::MOCK_METHOD_NAME)
+        );
+        self::assertSame(self::MOCK_TEMPLATE_SPAN_TYPE, $renderSpan->type);
+        self::assertSame($tx->id, $renderSpan->parentId);
+        self::assertSame(self::TEMPLATE_ARG, self::getLabel($renderSpan, 'arg_0'));
+        self::assertSame(self::COUNT_ARG, self::getLabel($renderSpan, 'arg_1'));
+        // Only null and scalar captured args are set as labels
+        self::assertArrayNotHasKey('arg_2', self::getLabels($renderSpan));
+
+        $throwingSpan = $dataFromAgent->singleSpanByName(
+            AutoInstrumentationUtil::buildSpanNameFromCall(/* className */ null, self::MOCK_NAMESPACE . '\\' . self::MOCK_THROWING_FUNCTION_SHORT_NAME)
+        );
+        self::assertSame('app', $throwingSpan->type);
+        self::assertSame($tx->id, $throwingSpan->parentId);
+        self::assertSame(self::THROWN_MESSAGE, self::getLabel($throwingSpan, 'arg_0'));
+
+        self::assertEmpty(
+            $dataFromAgent->findSpansByName(
+                AutoInstrumentationUtil::buildSpanNameFromCall(/* className */ null, self::MOCK_NAMESPACE . '\\' . self::MOCK_GENERATOR_FUNCTION_SHORT_NAME)
+            )
+        );
+
+        // Post-hook gets the thrown exception and reports it as error of the span
+        $err = $dataFromAgent->singleError();
+        self::assertSame($throwingSpan->id, $err->parentId);
+        self::assertNotNull($err->exception);
+        self::assertSame(self::THROWN_MESSAGE, $err->exception->message);
+    }
+}
@@ -0,0 +1,149 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+declare(strict_types=1);
+
+namespace ElasticApmTests\ComponentTests;
+
+use Elastic\Apm\ElasticApm;
+use ElasticApmTests\ComponentTests\Util\AppCodeHostParams;
+use ElasticApmTests\ComponentTests\Util\AppCodeRequestParams;
+use ElasticApmTests\ComponentTests\Util\AppCodeTarget;
+use ElasticApmTests\ComponentTests\Util\ComponentTestCaseBase;
+use ElasticApmTests\ComponentTests\Util\ExpectedEventCounts;
+use ElasticApmTests\ComponentTests\Util\IntakeApiRequestDeserializer;
+use ElasticApmTests\Util\AssertMessageStack;
+use ElasticApmTests\Util\MixedMap;
+
+/**
+ * Spans ended before their transaction are buffered by the extension
+ * and sent in the same intake API request as the transaction (see agent/native/ext/events_buffer.h)
+ *
+ * @group smoke
+ * @group does_not_require_external_services
+ */
+final class EventsBufferComponentTest extends ComponentTestCaseBase
+{
+    private const SPANS_COUNT_KEY = 'spans_count';
+
+    /**
+     * Span compression would keep the last span until its transaction ends - tests in this class need each span sent as it ends
+     *
+     * @inheritDoc
+     */
+    protected function isSpanCompressionCompatible(): bool
+    {
+        return false;
+    }
+
+    private static function beginEndSpans(int $spansCount): void
+    {
+        for ($i = 0; $i < $spansCount; ++$i) {
+            ElasticApm::getCurrentTransaction()->captureCurrentSpan(
+                'span_' . $i,
+                'test_span_type',
+                function (): void {
+                }
+            );
+        }
+    }
+
+    public static function appCodeForTestSpansSentInSameIntakeRequestAsTransaction(MixedMap $appCodeArgs): void
+    {
+        self::beginEndSpans($appCodeArgs->getInt(self::SPANS_COUNT_KEY));
+    }
+
+    public function testSpansSentInSameIntakeRequestAsTransaction(): void
+    {
+        $spansCount = 5;
+        $testCaseHandle = $this->getTestCaseHandle();
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams): void {
+                self::disableTimingDependentFeatures($appCodeParams);
+            }
+        );
+        $appCodeHost->sendRequest(
+            AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestSpansSentInSameIntakeRequestAsTransaction']),
+            function (AppCodeRequestParams $appCodeRequestParams) use ($spansCount): void {
+                $appCodeRequestParams->setAppCodeArgs([self::SPANS_COUNT_KEY => $spansCount]);
+            }
+        );
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent((new ExpectedEventCounts())->transactions(1)->spans($spansCount));
+        $tx = $dataFromAgent->singleTransaction();
+
+        $intakeApiRequests = $dataFromAgent->getAllIntakeApiRequests();
+        AssertMessageStack::newScope(/* out */ $dbgCtx, ['intakeApiRequests' => $intakeApiRequests]);
+        $requestsWithEventsCount = 0;
+        foreach ($intakeApiRequests as $intakeApiRequest) {
+            $dataFromRequest = IntakeApiRequestDeserializer::deserialize($intakeApiRequest);
+            if (count($dataFromRequest->idToSpan) === 0 && count($dataFromRequest->idToTransaction) === 0) {
+                continue;
+            }
+            ++$requestsWithEventsCount;
+            // All the spans and their transaction are in one payload with one metadata line
+            self::assertSame([$tx->id], array_keys($dataFromRequest->idToTransaction));
+            self::assertCount($spansCount, $dataFromRequest->idToSpan);
+            self::assertCount(1, $dataFromRequest->metadatas);
+            foreach ($dataFromRequest->idToSpan as $span) {
+                self::assertSame($tx->id, $span->transactionId);
+            }
+        }
+        self::assertSame(1, $requestsWithEventsCount);
+    }
+
+    public static function appCodeForTestSpansFlushedOnShutdownWhenTransactionNotSent(MixedMap $appCodeArgs): void
+    {
+        self::beginEndSpans($appCodeArgs->getInt(self::SPANS_COUNT_KEY));
+        // Spans are already buffered by the extension but the transaction is never sent
+        // so only request shutdown flushes them
+        ElasticApm::getCurrentTransaction()->discard();
+    }
+
+    public function testSpansFlushedOnShutdownWhenTransactionNotSent(): void
+    {
+        $spansCount = 3;
+        $testCaseHandle = $this->getTestCaseHandle();
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams): void {
+                self::disableTimingDependentFeatures($appCodeParams);
+            }
+        );
+        $appCodeHost->sendRequest(
+            AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestSpansFlushedOnShutdownWhenTransactionNotSent']),
+            function (AppCodeRequestParams $appCodeRequestParams) use ($spansCount): void {
+                $appCodeRequestParams->setAppCodeArgs([self::SPANS_COUNT_KEY => $spansCount]);
+            }
+        );
+        // Spans without their transaction do not pass the usual trace validation
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent(
+            (new ExpectedEventCounts())->transactions(0)->spans($spansCount),
+            /* shouldValidate: */ false
+        );
+        self::assertCount(0, $dataFromAgent->idToTransaction);
+        self::assertCount($spansCount, $dataFromAgent->idToSpan);
+        $spanNames = [];
+        foreach ($dataFromAgent->idToSpan as $span) {
+            $spanNames[] = $span->name;
+        }
+        sort(/* ref */ $spanNames);
+        self::assertSame(['span_0', 'span_1', 'span_2'], $spanNames);
+    }
+}
@@ -0,0 +1,212 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+declare(strict_types=1);
+
+namespace ElasticApmTests\ComponentTests;
+
+use Elastic\Apm\ElasticApm;
+use Elastic\Apm\Impl\BreakdownMetrics\PerTransaction as BreakdownMetricsPerTransaction;
+use Elastic\Apm\Impl\EventSinkInterface;
+use Elastic\Apm\Impl\Metadata;
+use Elastic\Apm\Impl\MetricSet;
+use Elastic\Apm\Impl\Transaction;
+use Elastic\Apm\Impl\TracerBuilder;
+use Elastic\Apm\Impl\Util\JsonUtil;
+use ElasticApmTests\ComponentTests\Util\AppCodeHostParams;
+use ElasticApmTests\ComponentTests\Util\AppCodeTarget;
+use ElasticApmTests\ComponentTests\Util\ComponentTestCaseBase;
+use ElasticApmTests\ComponentTests\Util\ExpectedEventCounts;
+use ElasticApmTests\Util\DummyExceptionForTests;
+use stdClass;
+
+/**
+ * Payload serialized by the extension (elastic_apm_serialize_events) has to be byte for byte the same
+ * as the one PHP part used to build with JsonUtil::encode for each event
+ *
+ * @group smoke
+ * @group does_not_require_external_services
+ */
+final class EventsSerializationComponentTest extends ComponentTestCaseBase
+{
+    private const EVENTS_COUNT_LABEL_KEY = 'compared_events_count';
+
+    /**
+     * @param array<mixed> $events
+     */
+    private static function serializeLinesWithJsonEncode(string $eventKind, array $events): string
+    {
+        $result = '';
+        foreach ($events as $event) {
+            $result .= '{"' . $eventKind . '":' . JsonUtil::encode($event) . '}' . "\n";
+        }
+        return $result;
+    }
+
+    /**
+     * @param array<mixed> $spans
+     * @param array<mixed> $errors
+     * @param array<mixed> $metricSets
+     */
+    private static function assertNativeSerializationSameAsJsonEncode(object $metadata, array $spans, array $errors, array $metricSets, ?object $transaction): void
+    {
+        $expected = '{"metadata":' . JsonUtil::encode($metadata) . '}' . "\n"
+                    . self::serializeLinesWithJsonEncode('span', $spans)
+                    . self::serializeLinesWithJsonEncode('error', $errors)
+                    . self::serializeLinesWithJsonEncode('metricset', $metricSets)
+                    . ($transaction === null ? '' : self::serializeLinesWithJsonEncode('transaction', [$transaction]));
+
+        /**
+         * elastic_apm_* functions are provided by the elastic_apm extension
+         *
+         * @noinspection PhpFullyQualifiedNameUsageInspection, PhpUndefinedFunctionInspection
+         * @phpstan-ignore-next-line
+         */
+        $actual = \elastic_apm_serialize_events($metadata, $spans, $errors, $metricSets, $transaction);
+        self::assertSame($expected, $actual);
+    }
+
+    public static function appCodeForTestRealEventsSerializedTheSameAsByJsonEncode(): void
+    {
+        $eventSink = new class implements EventSinkInterface {
+            /** @var ?Metadata */
+            public $metadata = null;
+            /** @var array<mixed> */
+            public $spans = [];
+            /** @var array<mixed> */
+            public $errors = [];
+            /** @var MetricSet[] */
+            public $metricSets = [];
+            /** @var ?Transaction */
+            public $transaction = null;
+
+            public function consume(
+                Metadata $metadata,
+                array $spans,
+                array $errors,
+                array $metricSets,
+                ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction,
+                ?Transaction $transaction
+            ): void {
+                $this->metadata = $metadata;
+                $this->spans = array_merge($this->spans, $spans);
+                $this->errors = array_merge($this->errors, $errors);
+                $this->metricSets = array_merge($this->metricSets, $metricSets);
+                if ($breakdownMetricsPerTransaction !== null) {
+                    $breakdownMetricsPerTransaction->forEachMetricSet(
+                        function (MetricSet $metricSet): void {
+                            $this->metricSets[] = $metricSet;
+                        }
+                    );
+                }
+                if ($transaction !== null) {
+                    $this->transaction = $transaction;
+                }
+            }
+        };
+
+        $tracer = TracerBuilder::startNew()->withEventSink($eventSink)->build();
+        self::assertFalse($tracer->isNoop());
+
+        $tx = $tracer->beginTransaction('GET /users/{id}', 'request');
+        $tx->context()->setLabel('string_label', "caf\u{e9} \u{1F600} \"quoted\" \\ / \n\t invalid UTF-8: \xff");
+        $tx->context()->setLabel('float_label', 0.1);
+        $tx->context()->setLabel('small_float_label', 0.00001);
+        $tx->context()->setLabel('int_label', PHP_INT_MIN);
+        $tx->context()->setLabel('bool_label', false);
+        $tx->context()->setLabel('null_label', null);
+
+        $span = $tx->beginChildSpan('SELECT * FROM users WHERE id = ?', 'db', 'mysql', 'query');
+        $span->context()->db()->setStatement('SELECT * FROM users WHERE id = ?');
+        $span->context()->setLabel('rows', 1);
+        $childSpan = $span->beginChildSpan('child span', 'app');
+        $childSpan->end();
+        $span->end();
+
+        $tx->createErrorFromThrowable(new DummyExceptionForTests('Dummy exception message / with "quotes"'));
+        $tx->end();
+
+        self::assertNotNull($eventSink->metadata);
+        self::assertNotNull($eventSink->transaction);
+        self::assertCount(2, $eventSink->spans);
+        self::assertCount(1, $eventSink->errors);
+
+        // Each kind of event separately and then all of them in one payload
+        self::assertNativeSerializationSameAsJsonEncode($eventSink->metadata, $eventSink->spans, [], [], null);
+        self::assertNativeSerializationSameAsJsonEncode($eventSink->metadata, [], $eventSink->errors, [], null);
+        self::assertNativeSerializationSameAsJsonEncode($eventSink->metadata, [], [], $eventSink->metricSets, null);
+        self::assertNativeSerializationSameAsJsonEncode($eventSink->metadata, [], [], [], $eventSink->transaction);
+        self::assertNativeSerializationSameAsJsonEncode($eventSink->metadata, $eventSink->spans, $eventSink->errors, $eventSink->metricSets, $eventSink->transaction);
+
+        ElasticApm::getCurrentTransaction()->context()->setLabel(
+            self::EVENTS_COUNT_LABEL_KEY,
+            count($eventSink->spans) + count($eventSink->errors) + count($eventSink->metricSets) + 1
+        );
+    }
+
+    public function testRealEventsSerializedTheSameAsByJsonEncode(): void
+    {
+        $testCaseHandle = $this->getTestCaseHandle();
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams): void {
+                self::disableTimingDependentFeatures($appCodeParams);
+            }
+        );
+        $appCodeHost->sendRequest(AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestRealEventsSerializedTheSameAsByJsonEncode']));
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent((new ExpectedEventCounts())->transactions(1));
+        $compared = self::getLabel($dataFromAgent->singleTransaction(), self::EVENTS_COUNT_LABEL_KEY);
+        self::assertIsInt($compared);
+        self::assertGreaterThanOrEqual(4, $compared);
+    }
+
+    public static function appCodeForTestUndefinedPropertiesAreSkipped(): void
+    {
+        // Object without jsonSerialize() is written as its public properties -
+        // declared property which was unset is IS_UNDEF in the properties table and json_encode skips it
+        $withUnsetProperty = new class {
+            /** @var int */
+            public $kept = 1;
+            /** @var int */
+            public $removed = 2;
+            /** @var int */
+            protected $notPublic = 3;
+        };
+        unset($withUnsetProperty->removed);
+
+        $dynamic = new stdClass();
+        $dynamic->nested = $withUnsetProperty;
+        $dynamic->list = [1, 2.5, 'a/b'];
+        $dynamic->map = [1 => 'one', 'two' => 2];
+
+        self::assertNativeSerializationSameAsJsonEncode($dynamic, [$withUnsetProperty], [], [], null);
+
+        ElasticApm::getCurrentTransaction()->context()->setLabel(self::EVENTS_COUNT_LABEL_KEY, 1);
+    }
+
+    public function testUndefinedPropertiesAreSkipped(): void
+    {
+        $testCaseHandle = $this->getTestCaseHandle();
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost();
+        $appCodeHost->sendRequest(AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestUndefinedPropertiesAreSkipped']));
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent((new ExpectedEventCounts())->transactions(1));
+        self::assertSame(1, self::getLabel($dataFromAgent->singleTransaction(), self::EVENTS_COUNT_LABEL_KEY));
+    }
+}
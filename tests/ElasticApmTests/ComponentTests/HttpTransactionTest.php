@@ -27,6 +27,7 @@ use Elastic\Apm\ElasticApm;
 use Elastic\Apm\Impl\Config\OptionNames;
 use Elastic\Apm\Impl\Constants;
 use Elastic\Apm\Impl\Util\UrlParts;
+use Elastic\Apm\TransactionInterface;
 use ElasticApmTests\ComponentTests\Util\AppCodeHostParams;
 use ElasticApmTests\ComponentTests\Util\AppCodeRequestParams;
 use ElasticApmTests\ComponentTests\Util\AppCodeTarget;
@@ -432,10 +433,12 @@ final class HttpTransactionTest extends ComponentTestCaseBase
         self::assertSame($expectedShouldBeIgnored, ElasticApm::getCurrentTransaction()->isNoop());
 
         if ($expectedShouldBeIgnored) {
+            // public API is backed by noop tracer for the request ignored by the extension
             ElasticApm::captureTransaction(
                 self::IGNORED_TX_REPLACEMENT_NAME,
                 self::IGNORED_TX_REPLACEMENT_TYPE,
-                function () {
+                function (TransactionInterface $tx): void {
+                    self::assertTrue($tx->isNoop());
                 }
             );
         }
@@ -464,28 +467,36 @@ final class HttpTransactionTest extends ComponentTestCaseBase
                 $appCodeParams->setAgentOption(OptionNames::TRANSACTION_IGNORE_URLS, $transactionIgnoreUrlsConfigVal);
             }
         );
-        $appCodeHost->sendRequest(
-            AppCodeTarget::asRouted([__CLASS__, 'appCodeTransactionIgnoreUrlsConfig']),
-            function (AppCodeRequestParams $appCodeRequestParams) use ($urlParts, $expectedShouldBeIgnored): void {
-                $appCodeRequestParams->setAppCodeArgs(['expectedShouldBeIgnored' => $expectedShouldBeIgnored]);
-                $appCodeRequestParams->shouldVerifyRootTransaction = !$expectedShouldBeIgnored;
-                if ($appCodeRequestParams instanceof HttpAppCodeRequestParams) {
-                    $appCodeRequestParams->urlParts->path($urlParts->path)->query($urlParts->query);
-                    $appCodeRequestParams->expectedHttpResponseStatusCode
-                        = self::TRANSACTION_IGNORE_URLS_CUSTOM_HTTP_STATUS;
+        $sendRequest = function (UrlParts $urlParts, bool $expectedShouldBeIgnored) use ($appCodeHost): void {
+            $appCodeHost->sendRequest(
+                AppCodeTarget::asRouted([__CLASS__, 'appCodeTransactionIgnoreUrlsConfig']),
+                function (AppCodeRequestParams $appCodeRequestParams) use ($urlParts, $expectedShouldBeIgnored): void {
+                    $appCodeRequestParams->setAppCodeArgs(['expectedShouldBeIgnored' => $expectedShouldBeIgnored]);
+                    $appCodeRequestParams->shouldVerifyRootTransaction = !$expectedShouldBeIgnored;
+                    if ($appCodeRequestParams instanceof HttpAppCodeRequestParams) {
+                        $appCodeRequestParams->urlParts->path($urlParts->path)->query($urlParts->query);
+                        $appCodeRequestParams->expectedHttpResponseStatusCode
+                            = self::TRANSACTION_IGNORE_URLS_CUSTOM_HTTP_STATUS;
+                    }
                 }
-            }
-        );
+            );
+        };
+        $sendRequest($urlParts, $expectedShouldBeIgnored);
+        // Nothing is sent for the ignored request so it is followed by the one that is not ignored
+        // and only the latter's transaction is expected
+        $notIgnoredUrlParts = (new UrlParts())->path('/not_ignored');
+        if ($expectedShouldBeIgnored) {
+            $sendRequest($notIgnoredUrlParts, false);
+        }
         $dataFromAgent = $this->waitForOneEmptyTransaction($testCaseHandle);
         $tx = $dataFromAgent->singleTransaction();
+        self::assertSame('HTTP 2xx', $tx->result);
+        self::assertSame(Constants::OUTCOME_SUCCESS, $tx->outcome);
         if ($expectedShouldBeIgnored) {
-            $this->assertSame(self::IGNORED_TX_REPLACEMENT_NAME, $tx->name);
-            $this->assertSame(self::IGNORED_TX_REPLACEMENT_TYPE, $tx->type);
-            $this->assertNull($tx->result);
-            $this->assertNull($tx->outcome);
-        } else {
-            self::assertSame('HTTP 2xx', $tx->result);
-            self::assertSame(Constants::OUTCOME_SUCCESS, $tx->outcome);
+            self::assertNotNull($tx->context);
+            self::assertNotNull($tx->context->request);
+            self::assertNotNull($tx->context->request->url);
+            self::assertSame($notIgnoredUrlParts->path, $tx->context->request->url->path);
         }
     }
 }
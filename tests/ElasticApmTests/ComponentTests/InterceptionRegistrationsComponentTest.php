@@ -0,0 +1,215 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+declare(strict_types=1);
+
+namespace ElasticApmTests\ComponentTests;
+
+use Elastic\Apm\ElasticApm;
+use Elastic\Apm\Impl\AutoInstrument\PhpPartFacade;
+use Elastic\Apm\Impl\AutoInstrument\RegistrationContextInterface;
+use ElasticApmTests\ComponentTests\Util\AppCodeHostParams;
+use ElasticApmTests\ComponentTests\Util\AppCodeRequestParams;
+use ElasticApmTests\ComponentTests\Util\AppCodeTarget;
+use ElasticApmTests\ComponentTests\Util\ComponentTestCaseBase;
+use ElasticApmTests\ComponentTests\Util\ExpectedEventCounts;
+use ElasticApmTests\Util\AssertMessageStack;
+use ElasticApmTests\Util\MixedMap;
+use PDO;
+
+/**
+ * Registrations of intercepted internal functions are kept across requests handled by the same process
+ * and they are invalidated (original handlers restored) on configuration change and opcache reset.
+ * Methods are called through a class extending PDO so that copies of the inherited intercepted methods are used as well.
+ * Hooks get only as many leading arguments of the intercepted call as their registration asks for.
+ *
+ * @group smoke
+ * @group does_not_require_external_services
+ */
+final class InterceptionRegistrationsComponentTest extends ComponentTestCaseBase
+{
+    private const REQUEST_INDEX_KEY = 'request_index';
+    private const SHOULD_RESET_OPCACHE_KEY = 'should_reset_opcache';
+    private const HAS_RESET_OPCACHE_KEY = 'has_reset_opcache';
+    private const IS_USER_CODE_INTERCEPTION_SUPPORTED_KEY = 'is_user_code_interception_supported';
+
+    private const INTERNAL_FUNCTION_MAX_CAPTURED_ARGS_COUNT = 2;
+    private const USER_METHOD_MAX_CAPTURED_ARGS_COUNT = 3;
+
+    /** @var array<string, mixed[][]> */
+    private static $interceptedCallToCapturedArgs = [];
+
+    private const SELECT_SQL
+        = /** @lang text */
+        'SELECT 1';
+
+    /**
+     * Tests in this class specifiy expected spans individually
+     * so Span Compression feature should be disabled.
+     *
+     * @inheritDoc
+     */
+    protected function isSpanCompressionCompatible(): bool
+    {
+        return false;
+    }
+
+    public static function appCodeForTestRegistrationsKeptAndInvalidatedAcrossRequests(MixedMap $appCodeArgs): void
+    {
+        ElasticApm::getCurrentTransaction()->context()->setLabel(self::REQUEST_INDEX_KEY, $appCodeArgs->getInt(self::REQUEST_INDEX_KEY));
+
+        $pdo = new class ('sqlite::memory:') extends PDO {
+        };
+        self::assertTrue($pdo->setAttribute(PDO::ATTR_ERRMODE, PDO::ERRMODE_EXCEPTION));
+        self::assertNotFalse($queryResult = $pdo->query(self::SELECT_SQL));
+        self::assertSame(1, intval($queryResult->fetchColumn()));
+
+        $hasResetOpcache = false;
+        if ($appCodeArgs->getBool(self::SHOULD_RESET_OPCACHE_KEY) && function_exists('opcache_reset')) {
+            // The extension detects the reset on the next request and invalidates the registrations
+            $hasResetOpcache = opcache_reset();
+        }
+        ElasticApm::getCurrentTransaction()->context()->setLabel(self::HAS_RESET_OPCACHE_KEY, $hasResetOpcache);
+    }
+
+    public function testRegistrationsKeptAndInvalidatedAcrossRequests(): void
+    {
+        // Requests have to be handled by the same process
+        if (self::skipIfMainAppCodeHostIsNotHttp()) {
+            return;
+        }
+
+        $testCaseHandle = $this->getTestCaseHandle();
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams): void {
+                self::disableTimingDependentFeatures($appCodeParams);
+            }
+        );
+        // 1st request registers, 2nd one reuses the registrations and resets opcache, 3rd one registers again after invalidation
+        $shouldResetOpcachePerRequest = [false, true, false];
+        foreach ($shouldResetOpcachePerRequest as $requestIndex => $shouldResetOpcache) {
+            $appCodeHost->sendRequest(
+                AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestRegistrationsKeptAndInvalidatedAcrossRequests']),
+                function (AppCodeRequestParams $appCodeRequestParams) use ($requestIndex, $shouldResetOpcache): void {
+                    $appCodeRequestParams->setAppCodeArgs([self::REQUEST_INDEX_KEY => $requestIndex, self::SHOULD_RESET_OPCACHE_KEY => $shouldResetOpcache]);
+                }
+            );
+        }
+        $requestsCount = count($shouldResetOpcachePerRequest);
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent((new ExpectedEventCounts())->transactions($requestsCount)->spans($requestsCount));
+
+        AssertMessageStack::newScope(/* out */ $dbgCtx, ['dataFromAgent' => $dataFromAgent]);
+        $requestIndexToSpansCount = array_fill(0, $requestsCount, 0);
+        foreach ($dataFromAgent->idToSpan as $span) {
+            self::assertSame(self::SELECT_SQL, $span->name);
+            self::assertSame('sqlite', $span->subtype);
+            $tx = $dataFromAgent->idToTransaction[$span->transactionId];
+            $requestIndex = self::getLabel($tx, self::REQUEST_INDEX_KEY);
+            self::assertIsInt($requestIndex);
+            ++$requestIndexToSpansCount[$requestIndex];
+        }
+        // Each request has the span - both with the registrations reused and with the ones made after invalidation
+        self::assertSame(array_fill(0, $requestsCount, 1), $requestIndexToSpansCount);
+    }
+
+    /**
+     * @param string  $interceptedCallDesc
+     * @param mixed[] $capturedArgs
+     *
+     * @return null
+     */
+    private static function recordCapturedArgs(string $interceptedCallDesc, array $capturedArgs)
+    {
+        self::$interceptedCallToCapturedArgs[$interceptedCallDesc][] = $capturedArgs;
+        return null;
+    }
+
+    /**
+     * Declares only one parameter so that the rest of the arguments are extra arguments
+     * which Zend keeps in the call frame after all the compiled variables and temporaries
+     */
+    public static function userMethodWithExtraArgs(int $declaredParam): int
+    {
+        return $declaredParam + func_num_args();
+    }
+
+    public static function appCodeForTestMaxCapturedArgsCount(): void
+    {
+        self::$interceptedCallToCapturedArgs = [];
+        $isUserCodeInterceptionSupported = false;
+        $hasRegistered = PhpPartFacade::registerAdditionalInterceptions(
+            __CLASS__,
+            function (RegistrationContextInterface $ctx) use (&$isUserCodeInterceptionSupported): void {
+                // Functions that are not called by the agent itself so that the only calls intercepted are the ones below
+                $ctx->interceptCallsToInternalFunction(
+                    'levenshtein',
+                    function (array $capturedArgs) {
+                        return self::recordCapturedArgs('levenshtein', $capturedArgs);
+                    },
+                    self::INTERNAL_FUNCTION_MAX_CAPTURED_ARGS_COUNT
+                );
+                $ctx->interceptCallsToInternalFunction(
+                    'metaphone',
+                    function (array $capturedArgs) {
+                        return self::recordCapturedArgs('metaphone', $capturedArgs);
+                    },
+                    0 /* <- maxCapturedArgsCount */
+                );
+                $isUserCodeInterceptionSupported = $ctx->interceptCallsToUserMethod(
+                    __CLASS__,
+                    'userMethodWithExtraArgs',
+                    function (?object $thisObj, array $capturedArgs) {
+                        self::assertNull($thisObj);
+                        return self::recordCapturedArgs('userMethodWithExtraArgs', $capturedArgs);
+                    },
+                    self::USER_METHOD_MAX_CAPTURED_ARGS_COUNT
+                );
+            }
+        );
+        self::assertTrue($hasRegistered);
+        ElasticApm::getCurrentTransaction()->context()->setLabel(self::IS_USER_CODE_INTERCEPTION_SUPPORTED_KEY, $isUserCodeInterceptionSupported);
+
+        // Arguments that are not captured are still passed to the intercepted call
+        self::assertSame(3, levenshtein('kitten', 'sitting', 1, 1, 1));
+        self::assertSame('TMS', metaphone('Thompson', 3));
+        self::assertSame(['levenshtein' => [['kitten', 'sitting']], 'metaphone' => [[]]], self::$interceptedCallToCapturedArgs);
+
+        if (!$isUserCodeInterceptionSupported) {
+            return;
+        }
+
+        self::$interceptedCallToCapturedArgs = [];
+        self::assertSame(10 + 5, self::userMethodWithExtraArgs(10, 20, 30, 40, 50)); // @phpstan-ignore-line
+        self::assertSame(10 + 2, self::userMethodWithExtraArgs(10, 20)); // @phpstan-ignore-line
+        self::assertSame(10 + 1, self::userMethodWithExtraArgs(10));
+        $expectedCapturedArgs = [[10, 20, 30], [10, 20], [10]];
+        self::assertSame(['userMethodWithExtraArgs' => $expectedCapturedArgs], self::$interceptedCallToCapturedArgs);
+    }
+
+    public function testMaxCapturedArgsCount(): void
+    {
+        $testCaseHandle = $this->getTestCaseHandle();
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost();
+        $appCodeHost->sendRequest(AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestMaxCapturedArgsCount']));
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent((new ExpectedEventCounts())->transactions(1));
+        self::assertIsBool(self::getLabel($dataFromAgent->singleTransaction(), self::IS_USER_CODE_INTERCEPTION_SUPPORTED_KEY));
+    }
+}
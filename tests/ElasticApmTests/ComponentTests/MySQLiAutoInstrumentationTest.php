@@ -45,6 +45,7 @@ use ElasticApmTests\Util\DataProviderForTestBuilder;
 use ElasticApmTests\Util\MixedMap;
 use ElasticApmTests\Util\SpanExpectations;
 use ElasticApmTests\Util\SpanSequenceValidator;
+use mysqli;
 use PHPUnit\Framework\TestCase;
 
 /**
@@ -103,6 +104,18 @@ final class MySQLiAutoInstrumentationTest extends ComponentTestCaseBase
         = /** @lang text */
         'SELECT * FROM messages';
 
+    private const SELECT_1_SQL
+        = /** @lang text */
+        'SELECT 1';
+
+    private const SELECT_2_SQL
+        = /** @lang text */
+        'SELECT 2';
+
+    private const SELECT_3_SQL
+        = /** @lang text */
+        'SELECT 3';
+
     /**
      * Tests in this class specifiy expected spans individually
      * so Span Compression feature should be disabled.
@@ -517,4 +530,79 @@ final class MySQLiAutoInstrumentationTest extends ComponentTestCaseBase
         SpanSequenceValidator::updateExpectationsEndTime($expectedSpans);
         SpanSequenceValidator::assertSequenceAsExpected($expectedSpans, array_values($dataFromAgent->idToSpan));
     }
+
+    public static function appCodeForTestFunctionAndMethodFormsInSameRequest(MixedMap $appCodeArgs): void
+    {
+        $host = $appCodeArgs->getString(DbAutoInstrumentationUtilForTests::HOST_KEY);
+        $port = $appCodeArgs->getInt(DbAutoInstrumentationUtilForTests::PORT_KEY);
+        $user = $appCodeArgs->getString(DbAutoInstrumentationUtilForTests::USER_KEY);
+        $password = $appCodeArgs->getString(DbAutoInstrumentationUtilForTests::PASSWORD_KEY);
+        $dbName = $appCodeArgs->getString(self::CONNECT_DB_NAME_KEY);
+
+        mysqli_report(MYSQLI_REPORT_ERROR | MYSQLI_REPORT_STRICT);
+
+        $mySQLi = new mysqli($host, $user, $password, $dbName, $port);
+
+        // Function and method forms share the same internal handler - calls are interleaved
+        // so that each form is called both before and after the other one was called for the first time
+        self::assertNotFalse(mysqli_query($mySQLi, self::SELECT_1_SQL));
+        self::assertNotFalse($mySQLi->query(self::SELECT_2_SQL));
+        self::assertNotFalse(mysqli_query($mySQLi, self::SELECT_3_SQL));
+        self::assertTrue($mySQLi->select_db($dbName));
+        self::assertTrue(mysqli_select_db($mySQLi, $dbName));
+        self::assertTrue($mySQLi->select_db($dbName));
+
+        self::assertTrue($mySQLi->close());
+    }
+
+    /**
+     * Intercepted internal functions sharing the handler with methods (mysqli_query and mysqli::query, etc.)
+     * have to keep their own registrations when both forms are used in the same request
+     */
+    public function testFunctionAndMethodFormsInSameRequest(): void
+    {
+        $dbName = AmbientContextForTests::testConfig()->mysqlDb;
+        self::assertNotNull($dbName);
+
+        $testCaseHandle = $this->getTestCaseHandle();
+
+        $appCodeArgs = [
+            DbAutoInstrumentationUtilForTests::HOST_KEY     => AmbientContextForTests::testConfig()->mysqlHost,
+            DbAutoInstrumentationUtilForTests::PORT_KEY     => AmbientContextForTests::testConfig()->mysqlPort,
+            DbAutoInstrumentationUtilForTests::USER_KEY     => AmbientContextForTests::testConfig()->mysqlUser,
+            DbAutoInstrumentationUtilForTests::PASSWORD_KEY => AmbientContextForTests::testConfig()->mysqlPassword,
+            self::CONNECT_DB_NAME_KEY                       => $dbName,
+        ];
+
+        $methodFormExpectationsBuilder = new MySQLiDbSpanDataExpectationsBuilder(self::DB_TYPE, $dbName, /* isOOPApi */ true);
+        $functionFormExpectationsBuilder = new MySQLiDbSpanDataExpectationsBuilder(self::DB_TYPE, $dbName, /* isOOPApi */ false);
+        $expectedSpans = [
+            $methodFormExpectationsBuilder->fromNames('mysqli', '__construct'),
+            $functionFormExpectationsBuilder->fromStatement(self::SELECT_1_SQL),
+            $methodFormExpectationsBuilder->fromStatement(self::SELECT_2_SQL),
+            $functionFormExpectationsBuilder->fromStatement(self::SELECT_3_SQL),
+            $methodFormExpectationsBuilder->fromNames('mysqli', 'select_db'),
+            $functionFormExpectationsBuilder->fromNames('mysqli', 'select_db'),
+            $methodFormExpectationsBuilder->fromNames('mysqli', 'select_db'),
+        ];
+
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams): void {
+                self::disableTimingDependentFeatures($appCodeParams);
+            }
+        );
+        $appCodeHost->sendRequest(
+            AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestFunctionAndMethodFormsInSameRequest']),
+            function (AppCodeRequestParams $appCodeRequestParams) use ($appCodeArgs): void {
+                $appCodeRequestParams->setAppCodeArgs($appCodeArgs);
+            }
+        );
+
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent(
+            (new ExpectedEventCounts())->transactions(1)->spans(count($expectedSpans))
+        );
+
+        SpanSequenceValidator::updateExpectationsEndTime($expectedSpans);
+        SpanSequenceValidator::assertSequenceAsExpected($expectedSpans, array_values($dataFromAgent->idToSpan));
+    }
 }
@@ -25,6 +25,7 @@ declare(strict_types=1);
 
 namespace ElasticApmTests\ComponentTests;
 
+use Elastic\Apm\ElasticApm;
 use Elastic\Apm\Impl\AutoInstrument\PDOAutoInstrumentation;
 use Elastic\Apm\Impl\Config\OptionNames;
 use Elastic\Apm\Impl\Log\LoggableToString;
@@ -34,13 +35,16 @@ use ElasticApmTests\ComponentTests\Util\AppCodeRequestParams;
 use ElasticApmTests\ComponentTests\Util\AppCodeTarget;
 use ElasticApmTests\ComponentTests\Util\AutoInstrumentationUtilForTests;
 use ElasticApmTests\ComponentTests\Util\ComponentTestCaseBase;
+use ElasticApmTests\ComponentTests\Util\DataFromAgentPlusRaw;
 use ElasticApmTests\ComponentTests\Util\DbAutoInstrumentationUtilForTests;
 use ElasticApmTests\ComponentTests\Util\ExpectedEventCounts;
 use ElasticApmTests\Util\DataProviderForTestBuilder;
 use ElasticApmTests\Util\DbSpanExpectationsBuilder;
 use ElasticApmTests\Util\MixedMap;
+use ElasticApmTests\Util\SpanDto;
 use ElasticApmTests\Util\SpanExpectations;
 use ElasticApmTests\Util\SpanSequenceValidator;
+use ElasticApmTests\Util\TransactionDto;
 use PDO;
 
 /**
@@ -77,6 +81,27 @@ final class PDOAutoInstrumentationTest extends ComponentTestCaseBase
         = /** @lang text */
         'SELECT * FROM messages';
 
+    private const NESTED_QUERY_DEPTH_KEY = 'nested_query_depth';
+
+    /**
+     * maxInterceptedCallsNestingDepth in agent/native/ext/elastic_apm_API.h
+     */
+    private const MAX_INTERCEPTED_CALLS_NESTING_DEPTH = 64;
+
+    /**
+     * Internal option of the extension - it is not one of the options in OptionNames
+     */
+    private const NATIVE_FAST_PATH_SPANS_ENABLED_OPTION_NAME = 'native_fast_path_spans_enabled';
+
+    /**
+     * fastPathSpansMaxBufferedCount in agent/native/ext/fast_path_spans.h
+     */
+    private const FAST_PATH_SPANS_MAX_BUFFERED_COUNT = 1000;
+
+    private const FAST_PATH_SPANS_CALLS_COUNT_KEY = 'fast_path_spans_calls_count';
+    private const FAST_PATH_SPANS_MANUAL_SPAN_NAME = 'manual span';
+    private const FAST_PATH_SPANS_INNER_STATEMENT = 'SELECT 0';
+
     /**
      * Tests in this class specifiy expected spans individually
      * so Span Compression feature should be disabled.
@@ -314,4 +339,268 @@ final class PDOAutoInstrumentationTest extends ComponentTestCaseBase
         SpanSequenceValidator::updateExpectationsEndTime($expectedSpans);
         SpanSequenceValidator::assertSequenceAsExpected($expectedSpans, array_values($dataFromAgent->idToSpan));
     }
+
+    private static function buildNestedQueryStatement(int $depth): string
+    {
+        return 'SELECT nested_query(' . $depth . ')';
+    }
+
+    /**
+     * SQLite user defined function is called while PDO::query() that uses it is in progress
+     * so PDO::query() called from the function is an intercepted call nested in another intercepted call
+     */
+    private function skipIfSqliteUserFunctionsAreNotUsable(): bool
+    {
+        // PDO::sqliteCreateFunction() is deprecated since PHP 8.5 in favor of Pdo\Sqlite::createFunction()
+        if (!method_exists(PDO::class, 'sqliteCreateFunction') || PHP_VERSION_ID >= 80500) {
+            self::dummyAssert();
+            return true;
+        }
+
+        return false;
+    }
+
+    public static function appCodeForTestNestedInterceptedCalls(MixedMap $appCodeArgs): void
+    {
+        $depth = $appCodeArgs->getInt(self::NESTED_QUERY_DEPTH_KEY);
+
+        $pdo = new PDO(self::buildConnectionString(self::MEMORY_DB_NAME));
+        self::assertTrue($pdo->setAttribute(PDO::ATTR_ERRMODE, PDO::ERRMODE_EXCEPTION));
+        $nestedQuery = function (int $depth) use ($pdo): int {
+            if ($depth === 0) {
+                return 0;
+            }
+            self::assertNotFalse($queryResult = $pdo->query(self::buildNestedQueryStatement($depth - 1)));
+            return 1 + intval($queryResult->fetchColumn());
+        };
+        /** @noinspection PhpDeprecationInspection */
+        self::assertTrue($pdo->sqliteCreateFunction('nested_query', $nestedQuery, /* num_args */ 1));
+
+        // Calls nested deeper than the extension tracks are not instrumented but they still work
+        self::assertNotFalse($queryResult = $pdo->query(self::buildNestedQueryStatement($depth)));
+        self::assertSame($depth, intval($queryResult->fetchColumn()));
+    }
+
+    private function implTestNestedInterceptedCalls(int $depth, int $expectedSpansCount): void
+    {
+        $testCaseHandle = $this->getTestCaseHandle();
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams): void {
+                self::disableTimingDependentFeatures($appCodeParams);
+            }
+        );
+        $appCodeHost->sendRequest(
+            AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestNestedInterceptedCalls']),
+            function (AppCodeRequestParams $appCodeRequestParams) use ($depth): void {
+                $appCodeRequestParams->setAppCodeArgs([self::NESTED_QUERY_DEPTH_KEY => $depth]);
+            }
+        );
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent((new ExpectedEventCounts())->transactions(1)->spans($expectedSpansCount));
+        $tx = $dataFromAgent->singleTransaction();
+
+        $expectationsBuilder = new DbSpanExpectationsBuilder(/* dbType: */ 'sqlite', self::MEMORY_DB_NAME);
+        /** @var array<string, SpanDto> $nameToQuerySpan */
+        $nameToQuerySpan = [];
+        foreach ($dataFromAgent->idToSpan as $span) {
+            $nameToQuerySpan[$span->name] = $span;
+        }
+        self::assertCount($expectedSpansCount, $nameToQuerySpan);
+
+        /** @var SpanDto[] $querySpans */
+        $querySpans = [];
+        $parentId = $tx->id;
+        for ($i = 0; $i < $expectedSpansCount; ++$i) {
+            $statement = self::buildNestedQueryStatement($depth - $i);
+            self::assertArrayHasKey($statement, $nameToQuerySpan);
+            $span = $nameToQuerySpan[$statement];
+            $span->assertMatches($expectationsBuilder->fromStatement($statement));
+            // Each nested call's span is a child of the span of the call it is nested in
+            self::assertSame($parentId, $span->parentId);
+            if ($i !== 0) {
+                $parentSpan = $querySpans[$i - 1];
+                self::assertLessThanOrEqualTimestamp($parentSpan->timestamp, $span->timestamp);
+                self::assertLessThanOrEqualTimestamp(self::calcEndTime($span), self::calcEndTime($parentSpan));
+            }
+            $querySpans[] = $span;
+            $parentId = $span->id;
+        }
+    }
+
+    public function testNestedInterceptedCalls(): void
+    {
+        if ($this->skipIfSqliteUserFunctionsAreNotUsable()) {
+            return;
+        }
+
+        // outer query -> nested query -> the innermost query
+        $this->implTestNestedInterceptedCalls(/* depth */ 2, /* expectedSpansCount */ 3);
+    }
+
+    public function testInterceptedCallsNestedDeeperThanMaxDepth(): void
+    {
+        if ($this->skipIfSqliteUserFunctionsAreNotUsable()) {
+            return;
+        }
+
+        // Only the outermost maxInterceptedCallsNestingDepth calls have spans
+        $depth = self::MAX_INTERCEPTED_CALLS_NESTING_DEPTH + 6;
+        $this->implTestNestedInterceptedCalls($depth, self::MAX_INTERCEPTED_CALLS_NESTING_DEPTH);
+    }
+
+    private static function buildFastPathSpansStatement(int $index): string
+    {
+        return 'SELECT ' . ($index + 1);
+    }
+
+    /**
+     * Makes the given number of calls while the transaction is the current segment
+     * and then one more inside a manual span - beginning the manual span makes PHP part take the calls buffered by the extension
+     */
+    public static function appCodeForTestFastPathSpans(MixedMap $appCodeArgs): void
+    {
+        $callsCount = $appCodeArgs->getInt(self::FAST_PATH_SPANS_CALLS_COUNT_KEY);
+
+        $pdo = new PDO(self::buildConnectionString(self::MEMORY_DB_NAME));
+        self::assertTrue($pdo->setAttribute(PDO::ATTR_ERRMODE, PDO::ERRMODE_EXCEPTION));
+        for ($i = 0; $i < $callsCount; ++$i) {
+            self::assertNotFalse($pdo->query(self::buildFastPathSpansStatement($i)));
+        }
+
+        $manualSpan = ElasticApm::getCurrentTransaction()->beginCurrentSpan(self::FAST_PATH_SPANS_MANUAL_SPAN_NAME, 'app');
+        self::assertNotFalse($pdo->query(self::FAST_PATH_SPANS_INNER_STATEMENT));
+        $manualSpan->end();
+    }
+
+    private function sendFastPathSpansRequest(int $callsCount, int $transactionMaxSpans, int $expectedSpansCount, int $expectedDroppedSpansCount): DataFromAgentPlusRaw
+    {
+        $testCaseHandle = $this->getTestCaseHandle();
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams) use ($transactionMaxSpans): void {
+                self::disableTimingDependentFeatures($appCodeParams);
+                $appCodeParams->setAgentOption(self::NATIVE_FAST_PATH_SPANS_ENABLED_OPTION_NAME, true);
+                $appCodeParams->setAgentOption(OptionNames::TRANSACTION_MAX_SPANS, $transactionMaxSpans);
+            }
+        );
+        $appCodeHost->sendRequest(
+            AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestFastPathSpans']),
+            function (AppCodeRequestParams $appCodeRequestParams) use ($callsCount, $expectedDroppedSpansCount): void {
+                $appCodeRequestParams->setAppCodeArgs([self::FAST_PATH_SPANS_CALLS_COUNT_KEY => $callsCount]);
+                $appCodeRequestParams->shouldAssumeNoDroppedSpans = ($expectedDroppedSpansCount === 0);
+            }
+        );
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent((new ExpectedEventCounts())->transactions(1)->spans($expectedSpansCount));
+        self::assertCount($expectedSpansCount, $dataFromAgent->idToSpan);
+        // Dropped spans are reported in transaction's span_count.dropped
+        self::assertSame($expectedDroppedSpansCount, $dataFromAgent->singleTransaction()->droppedSpansCount);
+        return $dataFromAgent;
+    }
+
+    /**
+     * @return array<string, SpanDto>
+     */
+    private static function mapFastPathSpansByName(DataFromAgentPlusRaw $dataFromAgent): array
+    {
+        $nameToSpan = [];
+        foreach ($dataFromAgent->idToSpan as $span) {
+            self::assertArrayNotHasKey($span->name, $nameToSpan);
+            $nameToSpan[$span->name] = $span;
+        }
+        return $nameToSpan;
+    }
+
+    /**
+     * @return array{TransactionDto, SpanDto, SpanDto, SpanDto[]}
+     */
+    private function implTestFastPathSpans(int $callsCount, int $expectedRecordedCallsCount): array
+    {
+        // Recorded calls + manual span + the call inside it
+        $dataFromAgent = $this->sendFastPathSpansRequest(
+            $callsCount,
+            // Spans above the buffer's capacity should not be dropped by transaction_max_spans instead
+            2 * self::FAST_PATH_SPANS_MAX_BUFFERED_COUNT /* <- transactionMaxSpans */,
+            $expectedRecordedCallsCount + 2 /* <- expectedSpansCount */,
+            $callsCount - $expectedRecordedCallsCount /* <- expectedDroppedSpansCount */
+        );
+        $tx = $dataFromAgent->singleTransaction();
+        $manualSpan = $dataFromAgent->singleSpanByName(self::FAST_PATH_SPANS_MANUAL_SPAN_NAME);
+        $innerSpan = $dataFromAgent->singleSpanByName(self::FAST_PATH_SPANS_INNER_STATEMENT);
+
+        $nameToSpan = self::mapFastPathSpansByName($dataFromAgent);
+        // Each call has its own statement so spans are ordered as the calls were made
+        /** @var SpanDto[] $querySpans */
+        $querySpans = [];
+        for ($i = 0; $i < $expectedRecordedCallsCount; ++$i) {
+            $statement = self::buildFastPathSpansStatement($i);
+            self::assertArrayHasKey($statement, $nameToSpan);
+            $querySpans[] = $nameToSpan[$statement];
+        }
+        return [$tx, $manualSpan, $innerSpan, $querySpans];
+    }
+
+    private static function assertFastPathSpan(SpanDto $span, string $expectedName, string $expectedParentId): void
+    {
+        self::assertSame($expectedName, $span->name);
+        self::assertSame('db', $span->type);
+        self::assertSame('sqlite', $span->subtype);
+        self::assertSame($expectedParentId, $span->parentId);
+    }
+
+    public function testFastPathSpans(): void
+    {
+        $callsCount = 3;
+        [$tx, $manualSpan, $innerSpan, $querySpans] = $this->implTestFastPathSpans($callsCount, /* expectedRecordedCallsCount */ $callsCount);
+
+        self::assertSame($tx->id, $manualSpan->parentId);
+        self::assertFastPathSpan($innerSpan, self::FAST_PATH_SPANS_INNER_STATEMENT, $manualSpan->id);
+        // Call made inside the manual span is timed within it
+        self::assertLessThanOrEqualTimestamp($manualSpan->timestamp, $innerSpan->timestamp);
+        self::assertLessThanOrEqualTimestamp(self::calcEndTime($innerSpan), self::calcEndTime($manualSpan));
+
+        foreach ($querySpans as $index => $span) {
+            self::assertFastPathSpan($span, self::buildFastPathSpansStatement($index), $tx->id);
+            // Spans are built after the calls have ended but they are timed as the calls were made - one after another
+            if ($index !== 0) {
+                self::assertLessThanOrEqualTimestamp(self::calcEndTime($querySpans[$index - 1]), $span->timestamp);
+            }
+            self::assertLessThanOrEqualTimestamp(self::calcEndTime($span), $manualSpan->timestamp);
+        }
+    }
+
+    public function testFastPathSpansAboveBufferCapacity(): void
+    {
+        // Calls made while the buffer is full are not recorded
+        // but the buffer accepts calls again after PHP part has taken the recorded ones (when the manual span begins)
+        [$tx, $manualSpan, $innerSpan, $querySpans] = $this->implTestFastPathSpans(
+            self::FAST_PATH_SPANS_MAX_BUFFERED_COUNT + 100,
+            /* expectedRecordedCallsCount */ self::FAST_PATH_SPANS_MAX_BUFFERED_COUNT
+        );
+
+        self::assertFastPathSpan($innerSpan, self::FAST_PATH_SPANS_INNER_STATEMENT, $manualSpan->id);
+        // The calls recorded are the first ones
+        foreach ($querySpans as $index => $span) {
+            self::assertFastPathSpan($span, self::buildFastPathSpansStatement($index), $tx->id);
+        }
+    }
+
+    public function testFastPathSpansAboveTransactionMaxSpans(): void
+    {
+        // Buffered calls are built into spans only until transaction_max_spans is reached - the rest are only counted as dropped.
+        // The manual span and the call inside it are dropped as well.
+        $callsCount = 10;
+        $transactionMaxSpans = 4;
+        $dataFromAgent = $this->sendFastPathSpansRequest(
+            $callsCount,
+            $transactionMaxSpans,
+            $transactionMaxSpans /* <- expectedSpansCount */,
+            $callsCount - $transactionMaxSpans + 2 /* <- expectedDroppedSpansCount */
+        );
+
+        $tx = $dataFromAgent->singleTransaction();
+        $nameToSpan = self::mapFastPathSpansByName($dataFromAgent);
+        for ($i = 0; $i < $transactionMaxSpans; ++$i) {
+            $statement = self::buildFastPathSpansStatement($i);
+            self::assertArrayHasKey($statement, $nameToSpan);
+            self::assertFastPathSpan($nameToSpan[$statement], $statement, $tx->id);
+        }
+    }
 }
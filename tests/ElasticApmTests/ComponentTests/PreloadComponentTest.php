@@ -0,0 +1,105 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+declare(strict_types=1);
+
+namespace ElasticApmTests\ComponentTests;
+
+use Elastic\Apm\ElasticApm;
+use Elastic\Apm\Impl\AutoInstrument\Autoloader;
+use Elastic\Apm\Impl\AutoInstrument\PhpPartFacade;
+use ElasticApmTests\ComponentTests\Util\AppCodeHostParams;
+use ElasticApmTests\ComponentTests\Util\AppCodeTarget;
+use ElasticApmTests\ComponentTests\Util\ComponentTestCaseBase;
+use ElasticApmTests\ComponentTests\Util\ExpectedEventCounts;
+
+/**
+ * Agent's PHP part preloaded by opcache.preload=<agent>/php/preload.php -
+ * the extension finds PhpPartFacade in the class table, skips loading bootstrap_php_part_file
+ * and PhpPartFacade::bootstrap() registers the autoloader itself (see agent/native/ext/tracer_PHP_part.cpp)
+ *
+ * @group smoke
+ * @group does_not_require_external_services
+ */
+final class PreloadComponentTest extends ComponentTestCaseBase
+{
+    private const LABEL_KEY = 'preloaded_label';
+    private const LABEL_VALUE = 'preloaded_label_value';
+
+    private static function findPreloadScript(): ?string
+    {
+        $bootstrapPhpPartFile = ini_get('elastic_apm.bootstrap_php_part_file');
+        if (!is_string($bootstrapPhpPartFile) || $bootstrapPhpPartFile === '') {
+            return null;
+        }
+        $preloadScript = dirname($bootstrapPhpPartFile) . DIRECTORY_SEPARATOR . 'preload.php';
+        return file_exists($preloadScript) ? $preloadScript : null;
+    }
+
+    public static function appCodeForTestTransactionReportedWhenPhpPartIsPreloaded(): void
+    {
+        $opcacheStatus = opcache_get_status(/* include_scripts */ false);
+        self::assertIsArray($opcacheStatus);
+        self::assertArrayHasKey('preload_statistics', $opcacheStatus);
+        $preloadStatistics = $opcacheStatus['preload_statistics'];
+        self::assertIsArray($preloadStatistics);
+        self::assertArrayHasKey('classes', $preloadStatistics);
+        self::assertIsArray($preloadStatistics['classes']);
+        // the extension looks up the same class (by its lower case name) in the class table
+        self::assertContains(PhpPartFacade::class, $preloadStatistics['classes']);
+
+        // bootstrap file was not loaded so the autoloader was registered by PhpPartFacade::bootstrap()
+        foreach (get_included_files() as $includedFile) {
+            self::assertNotSame('bootstrap_php_part.php', basename($includedFile));
+        }
+        self::assertTrue(Autoloader::isRegistered());
+
+        ElasticApm::getCurrentTransaction()->context()->setLabel(self::LABEL_KEY, self::LABEL_VALUE);
+    }
+
+    public function testTransactionReportedWhenPhpPartIsPreloaded(): void
+    {
+        $preloadScript = self::findPreloadScript();
+        // opcache.preload is not supported on Windows
+        if ($preloadScript === null || !extension_loaded('Zend OPcache') || PHP_OS_FAMILY === 'Windows') {
+            self::dummyAssert();
+            return;
+        }
+
+        $testCaseHandle = $this->getTestCaseHandle();
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams) use ($preloadScript): void {
+                $appCodeParams->setPhpIniEntry('opcache.enable', '1');
+                $appCodeParams->setPhpIniEntry('opcache.enable_cli', '1');
+                $appCodeParams->setPhpIniEntry('opcache.preload', $preloadScript);
+                // preloading as root requires opcache.preload_user
+                if (function_exists('posix_geteuid') && ($user = posix_getpwuid(posix_geteuid())) !== false) {
+                    $appCodeParams->setPhpIniEntry('opcache.preload_user', $user['name']);
+                }
+            }
+        );
+        $appCodeHost->sendRequest(AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestTransactionReportedWhenPhpPartIsPreloaded']));
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent((new ExpectedEventCounts())->transactions(1));
+        $tx = $dataFromAgent->singleTransaction();
+        self::assertSame(self::LABEL_VALUE, self::getLabel($tx, self::LABEL_KEY));
+    }
+}
@@ -0,0 +1,201 @@
+<?php
+
+/*
+ * Licensed to Elasticsearch B.V. under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch B.V. licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+declare(strict_types=1);
+
+namespace ElasticApmTests\ComponentTests;
+
+use Elastic\Apm\ElasticApm;
+use Elastic\Apm\Impl\Config\OptionNames;
+use Elastic\Apm\Impl\GlobalTracerHolder;
+use Elastic\Apm\Impl\NoopTracer;
+use Elastic\Apm\Impl\Util\ElasticApmExtensionUtil;
+use Elastic\Apm\Impl\Util\UrlParts;
+use ElasticApmTests\ComponentTests\Util\AppCodeHostParams;
+use ElasticApmTests\ComponentTests\Util\AppCodeRequestParams;
+use ElasticApmTests\ComponentTests\Util\AppCodeTarget;
+use ElasticApmTests\ComponentTests\Util\ComponentTestCaseBase;
+use ElasticApmTests\ComponentTests\Util\CurlHandleWrappedForTests;
+use ElasticApmTests\ComponentTests\Util\ExpectedEventCounts;
+use ElasticApmTests\ComponentTests\Util\HttpAppCodeRequestParams;
+use ElasticApmTests\ComponentTests\Util\HttpClientUtilForTests;
+use ElasticApmTests\ComponentTests\Util\HttpServerHandle;
+use ElasticApmTests\ComponentTests\Util\TestInfraDataPerRequest;
+use ElasticApmTests\Util\AssertMessageStack;
+use ElasticApmTests\Util\MixedMap;
+use ElasticApmTests\Util\TransactionExpectations;
+
+/**
+ * The extension decides on request init whether HTTP request is ignored or sampled
+ * before PHP part is bootstrapped (see agent/native/ext/request_tracing_decision.h)
+ *
+ * @group smoke
+ * @group does_not_require_external_services
+ */
+final class RequestTracingDecisionComponentTest extends ComponentTestCaseBase
+{
+    private const IGNORED_URL_PATH = '/ignored_by_extension/123';
+    private const NOT_IGNORED_URL_PATH = '/not_ignored_by_extension';
+    private const SHOULD_BE_IGNORED_KEY = 'should_be_ignored';
+    private const SERVER_PORT_KEY = 'server_port';
+    private const DATA_PER_REQUEST_FOR_SERVER_SIDE_KEY = 'data_per_request_for_server_side';
+
+    public static function appCodeForTestIgnoredUrl(MixedMap $appCodeArgs): void
+    {
+        $shouldBeIgnored = $appCodeArgs->getBool(self::SHOULD_BE_IGNORED_KEY);
+        self::assertSame($shouldBeIgnored, ElasticApmExtensionUtil::isRequestIgnored());
+        self::assertSame($shouldBeIgnored, ElasticApm::getCurrentTransaction()->isNoop());
+        if (!$shouldBeIgnored) {
+            return;
+        }
+
+        // PHP part was not bootstrapped so public API is backed by noop tracer instead of a lazily built one
+        self::assertInstanceOf(NoopTracer::class, GlobalTracerHolder::getValue());
+        ElasticApm::captureTransaction(
+            'transaction in ignored request',
+            'test_tx_type',
+            function (): void {
+            }
+        );
+    }
+
+    public function testIgnoredUrl(): void
+    {
+        if (self::skipIfMainAppCodeHostIsNotHttp()) {
+            return;
+        }
+
+        $testCaseHandle = $this->getTestCaseHandle();
+        $appCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams): void {
+                $appCodeParams->setAgentOption(OptionNames::TRANSACTION_IGNORE_URLS, '/ignored_by_extension/*');
+            }
+        );
+        foreach ([self::IGNORED_URL_PATH => true, self::NOT_IGNORED_URL_PATH => false] as $urlPath => $shouldBeIgnored) {
+            $appCodeHost->sendRequest(
+                AppCodeTarget::asRouted([__CLASS__, 'appCodeForTestIgnoredUrl']),
+                function (AppCodeRequestParams $appCodeRequestParams) use ($urlPath, $shouldBeIgnored): void {
+                    $appCodeRequestParams->setAppCodeArgs([self::SHOULD_BE_IGNORED_KEY => $shouldBeIgnored]);
+                    $appCodeRequestParams->shouldVerifyRootTransaction = !$shouldBeIgnored;
+                    if ($appCodeRequestParams instanceof HttpAppCodeRequestParams) {
+                        $appCodeRequestParams->urlParts->path($urlPath);
+                    }
+                }
+            );
+        }
+
+        // Ignored request is sent first so if it sent anything it would be received together with the not ignored one
+        $dataFromAgent = $this->waitForOneEmptyTransaction($testCaseHandle);
+        $tx = $dataFromAgent->singleTransaction();
+        self::assertNotNull($tx->context);
+        self::assertNotNull($tx->context->request);
+        self::assertNotNull($tx->context->request->url);
+        self::assertSame(self::NOT_IGNORED_URL_PATH, $tx->context->request->url->path);
+    }
+
+    public static function appCodeClientForTestUnsampledRequestPropagatesTraceContext(MixedMap $appCodeArgs): void
+    {
+        AssertMessageStack::newScope(/* out */ $dbgCtx, AssertMessageStack::funcArgs());
+        self::assertTrue(extension_loaded('curl'));
+        self::assertFalse(ElasticApm::getCurrentTransaction()->isSampled());
+
+        $dataPerRequest = new TestInfraDataPerRequest();
+        $dataPerRequest->deserializeFromString($appCodeArgs->getString(self::DATA_PER_REQUEST_FOR_SERVER_SIDE_KEY));
+
+        /** @var ?CurlHandleWrappedForTests $curlHandle */
+        $curlHandle = null;
+        try {
+            $curlHandle = HttpClientUtilForTests::createCurlHandleToSendRequestToAppCode(
+                (new UrlParts())->host(HttpServerHandle::CLIENT_LOCALHOST_ADDRESS)->port($appCodeArgs->getInt(self::SERVER_PORT_KEY)),
+                $dataPerRequest,
+                self::buildResourcesClientForAppCode()
+            );
+            $curlExecRetVal = $curlHandle->exec();
+            $dbgCtx->add(['errno' => $curlHandle->errno(), 'error' => $curlHandle->error(), 'verboseOutput' => $curlHandle->verboseOutput()]);
+            self::assertNotFalse($curlExecRetVal);
+            self::assertSame(200, $curlHandle->getResponseStatusCode());
+        } finally {
+            if ($curlHandle !== null) {
+                $curlHandle->close();
+            }
+        }
+    }
+
+    public static function appCodeServerForTestUnsampledRequestPropagatesTraceContext(): void
+    {
+        // trace context propagated by the client side carries "not sampled" flag
+        self::assertFalse(ElasticApm::getCurrentTransaction()->isSampled());
+    }
+
+    /**
+     * Only curl instrumentation is loaded for the request the extension decided not to sample
+     * so that outgoing HTTP requests still carry trace context (see TransactionBuilder::$isSampledDecidedByExtension)
+     */
+    public function testUnsampledRequestPropagatesTraceContext(): void
+    {
+        if (self::skipIfMainAppCodeHostIsNotHttp()) {
+            return;
+        }
+
+        TransactionExpectations::$defaultIsSampled = false;
+        $testCaseHandle = $this->getTestCaseHandle();
+        $serverAppCodeHost = $testCaseHandle->ensureAdditionalHttpAppCodeHost();
+        $clientAppCodeHost = $testCaseHandle->ensureMainAppCodeHost(
+            function (AppCodeHostParams $appCodeParams): void {
+                $appCodeParams->setAgentOption(OptionNames::TRANSACTION_SAMPLE_RATE, '0');
+            }
+        );
+        $clientAppCodeHost->sendRequest(
+            AppCodeTarget::asRouted([__CLASS__, 'appCodeClientForTestUnsampledRequestPropagatesTraceContext']),
+            function (AppCodeRequestParams $appCodeRequestParams) use ($serverAppCodeHost): void {
+                $dataPerRequest = $serverAppCodeHost->buildDataPerRequest(
+                    AppCodeTarget::asRouted([__CLASS__, 'appCodeServerForTestUnsampledRequestPropagatesTraceContext'])
+                );
+                $appCodeRequestParams->setAppCodeArgs(
+                    [
+                        self::SERVER_PORT_KEY                      => $serverAppCodeHost->getHttpServerHandle()->getMainPort(),
+                        self::DATA_PER_REQUEST_FOR_SERVER_SIDE_KEY => $dataPerRequest->serializeToString(),
+                    ]
+                );
+            }
+        );
+
+        // unsampled transactions are still sent but they do not have spans
+        $dataFromAgent = $testCaseHandle->waitForDataFromAgent((new ExpectedEventCounts())->transactions(2)->spans(0));
+        $clientTx = null;
+        $serverTx = null;
+        foreach ($dataFromAgent->idToTransaction as $tx) {
+            self::assertFalse($tx->isSampled);
+            if ($tx->parentId === null) {
+                $clientTx = $tx;
+            } else {
+                $serverTx = $tx;
+            }
+        }
+        self::assertNotNull($clientTx);
+        self::assertNotNull($serverTx);
+        self::assertSame(0.0, $clientTx->sampleRate);
+        // there is no span for the outgoing HTTP request so the server side transaction is the child of the client side one
+        self::assertSame($clientTx->traceId, $serverTx->traceId);
+        self::assertSame($clientTx->id, $serverTx->parentId);
+    }
+}
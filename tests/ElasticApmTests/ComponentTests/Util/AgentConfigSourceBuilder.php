@@ -97,7 +97,10 @@ final class AgentConfigSourceBuilder implements LoggableInterface
      */
     public function getPhpIniFile(): ?string
     {
-        if (ArrayUtil::isEmpty($this->appCodeHostParams->getAgentOptions(AgentConfigSourceKind::iniFile()))) {
+        if (
+            ArrayUtil::isEmpty($this->appCodeHostParams->getAgentOptions(AgentConfigSourceKind::iniFile()))
+            && ArrayUtil::isEmpty($this->appCodeHostParams->getPhpIniEntries())
+        ) {
             return AmbientContextForTests::testConfig()->appCodePhpIni;
         }
 
@@ -161,6 +164,11 @@ final class AgentConfigSourceBuilder implements LoggableInterface
         }
 
         self::writeToFile($tempIniFileHandle, PHP_EOL);
+        // PHP directives are appended after the base INI file content so they override the ones set there
+        foreach ($this->appCodeHostParams->getPhpIniEntries() as $name => $value) {
+            self::writeToFile($tempIniFileHandle, $name . ' = ' . self::processOptionValueBeforeWriteToIni($value) . PHP_EOL);
+        }
+
         self::writeToFile($tempIniFileHandle, '[elastic_apm]' . PHP_EOL);
 
         $optionsForIni = $this->appCodeHostParams->getAgentOptions(AgentConfigSourceKind::iniFile());
@@ -54,6 +54,9 @@ class AppCodeHostParams implements LoggableInterface
     /** @var array<string, array<string, string|int|float|bool>> */
     private $agentOptions = [];
 
+    /** @var array<string, string> */
+    private $phpIniEntries = [];
+
     /** @var string */
     public $spawnedProcessInternalId;
 
@@ -123,6 +126,22 @@ class AppCodeHostParams implements LoggableInterface
         }
     }
 
+    /**
+     * Sets PHP configuration directive (not agent's option) in the INI file used by app code host
+     */
+    public function setPhpIniEntry(string $name, string $value): void
+    {
+        $this->phpIniEntries[$name] = $value;
+    }
+
+    /**
+     * @return array<string, string>
+     */
+    public function getPhpIniEntries(): array
+    {
+        return $this->phpIniEntries;
+    }
+
     /**
      * @param array<string, string> $baseEnvVars
      *
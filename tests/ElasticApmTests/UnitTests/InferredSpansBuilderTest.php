@@ -131,6 +131,30 @@ class InferredSpansBuilderTest extends MockClockTracerUnitTestCaseBase
         self::assertCount(0, $this->mockEventSink->idToSpan());
     }
 
+    public function testSharedFramesAreNotModified(): void
+    {
+        // Frames converted from the table of interned frames are the same instances across samples
+        $outerFrame = new ClassicFormatStackTraceFrame('outer.php', 10, /* class */ null, /* isStaticMethod */ null, 'outer');
+        $innerFrame = new ClassicFormatStackTraceFrame('inner.php', 20, /* class */ null, /* isStaticMethod */ null, 'inner');
+        $outerFrameAtOtherLine = new ClassicFormatStackTraceFrame('outer.php', 11, /* class */ null, /* isStaticMethod */ null, 'outer');
+
+        // Act
+        $this->withInferredSpansBuilderDuringTransaction(
+            function (InferredSpansBuilder $builder) use ($outerFrame, $innerFrame, $outerFrameAtOtherLine): void {
+                $builder->addStackTrace([$innerFrame, $outerFrame]);
+                $this->mockClock->fastForwardMilliseconds(self::DEFAULT_MIN_DURATION + 1);
+                $builder->addStackTrace([$innerFrame, $outerFrameAtOtherLine]);
+                $this->mockClock->fastForwardMilliseconds(self::DEFAULT_MIN_DURATION + 1);
+                $builder->addStackTrace([$innerFrame, $outerFrame]);
+            }
+        );
+
+        // Assert
+        self::assertSame(10, $outerFrame->line);
+        self::assertSame(11, $outerFrameAtOtherLine->line);
+        self::assertSame(20, $innerFrame->line);
+    }
+
     /**
      * @param InferredSpansBuilder $builder
      *
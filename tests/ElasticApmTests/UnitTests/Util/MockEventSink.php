@@ -60,7 +60,7 @@ final class MockEventSink implements EventSinkInterface
     }
 
     /** @inheritDoc */
-    public function consume(Metadata $metadata, array $spans, array $errors, ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction, ?Transaction $transaction): void
+    public function consume(Metadata $metadata, array $spans, array $errors, array $metricSets, ?BreakdownMetricsPerTransaction $breakdownMetricsPerTransaction, ?Transaction $transaction): void
     {
         $this->consumeMetadata($metadata);
 
@@ -72,6 +72,10 @@ final class MockEventSink implements EventSinkInterface
             $this->consumeError($error);
         }
 
+        foreach ($metricSets as $metricSet) {
+            $this->consumeMetricSet($metricSet);
+        }
+
         if ($breakdownMetricsPerTransaction !== null) {
             $breakdownMetricsPerTransaction->forEachMetricSet(
                 function (MetricSet $metricSetData) {
@@ -1370,4 +1370,50 @@ class StackTraceUtilTest extends TestCaseBase
 
         self::assertSameClassicFormatStackTraces($expectedOutput, $actualOutput);
     }
+
+    public function testConvertCompactToClassicFormat(): void
+    {
+        $compactFrames = [
+            null, null, null, 'sleep', null,
+            '/app/MyClass.php', 12, 'MyClass', 'myStaticMethod', true,
+            '/app/MyClass.php', 34, 'Elastic\\Apm\\Impl\\Tracer', 'captureTransaction', false,
+            '/app/index.php', 56, null, null, null,
+        ];
+
+        $expectedOutput = [
+            new ClassicFormatStackTraceFrame(null, null, null, null, 'sleep'),
+            new ClassicFormatStackTraceFrame('/app/MyClass.php', 12, 'MyClass', /* isStaticMethod */ true, 'myStaticMethod'),
+            new ClassicFormatStackTraceFrame('/app/index.php', 56),
+        ];
+
+        $actualOutput = self::stackTraceUtil()->convertCompactToClassicFormatExcludeElasticApm($compactFrames);
+
+        self::assertSameClassicFormatStackTraces($expectedOutput, $actualOutput);
+    }
+
+    public function testConvertInternedToClassicFormat(): void
+    {
+        $internedFrames = StackTraceUtil::convertCompactToClassicFormat(
+            [
+                null, null, null, 'sleep', null,
+                '/app/MyClass.php', 12, 'MyClass', 'myStaticMethod', true,
+                '/app/MyClass.php', 34, 'Elastic\\Apm\\Impl\\Tracer', 'captureTransaction', false,
+                '/app/index.php', 56, null, null, null,
+            ]
+        );
+
+        $actualOutput = self::stackTraceUtil()->convertInternedToClassicFormatExcludeElasticApm([0, 1, 2, 3, 1, 3], $internedFrames);
+
+        $expectedOutput = [
+            new ClassicFormatStackTraceFrame(null, null, null, null, 'sleep'),
+            new ClassicFormatStackTraceFrame('/app/MyClass.php', 12, 'MyClass', /* isStaticMethod */ true, 'myStaticMethod'),
+            new ClassicFormatStackTraceFrame('/app/index.php', 56),
+            new ClassicFormatStackTraceFrame('/app/MyClass.php', 12, 'MyClass', /* isStaticMethod */ true, 'myStaticMethod'),
+            new ClassicFormatStackTraceFrame('/app/index.php', 56),
+        ];
+        self::assertSameClassicFormatStackTraces($expectedOutput, $actualOutput);
+
+        // the same interned instance is reused for every occurrence of the frame
+        self::assertSame($actualOutput[1], $actualOutput[3]);
+    }
 }